@@ -31,10 +31,23 @@ SOURCES+= $$PWD/src/main.cpp \
     src/ReadGeo.cpp \
     src/MinRes.cpp \
     src/Grid_updateParticleFromGrid.cpp \
+    src/Grid_particleStencilCache.cpp \
     src/AlembicExport.cpp \
     src/Grid_interpolateParticleToGrid.cpp \
     src/Grid_deviatoricVelocity_New.cpp \
-    src/Grid_interpolateGridToParticle.cpp
+    src/Grid_interpolateGridToParticle.cpp \
+    src/ReadBinary.cpp \
+    src/Profiler.cpp \
+    src/SolverMetrics.cpp \
+    src/MemoryTracker.cpp \
+    src/TraceRecorder.cpp \
+    src/PerfCounters.cpp \
+    src/CollisionSDF.cpp \
+    src/MICPreconditioner.cpp \
+    src/DirectFactor.cpp \
+    src/StencilOperator.cpp \
+    src/Multigrid.cpp \
+    src/LinearSolver.cpp
 
 # same for the .h files
 HEADERS+= $$PWD/include/ReadGeo.h \
@@ -47,7 +60,20 @@ HEADERS+= $$PWD/include/ReadGeo.h \
     include/CellCentre.h \
     include/CellFace.h \
     include/InterpolationData.h \
-    include/AlembicExport.h
+    include/AlembicExport.h \
+    include/ReadBinary.h \
+    include/Profiler.h \
+    include/SolverMetrics.h \
+    include/MemoryTracker.h \
+    include/TraceRecorder.h \
+    include/PerfCounters.h \
+    include/CollisionSDF.h \
+    include/StencilSystem.h \
+    include/MICPreconditioner.h \
+    include/DirectFactor.h \
+    include/StencilOperator.h \
+    include/Multigrid.h \
+    include/LinearSolver.h
 
 
 # and add the include dir into the search path for Qt and make
@@ -67,6 +93,9 @@ LIBS+= -fopenmp
 
 QMAKE_CXXFLAGS+= -fopenmp
 
+# Per-stage timing of simulation steps. Remove to compile the timers out
+DEFINES+=PROFILING
+
 # where our exe is going to live (root of project)
 DESTDIR=./
 # add the glsl shader files
@@ -101,3 +130,6 @@ else{ # note brace must be here
         message("Using custom NGL location")
         include($(NGLDIR)/UseNGL.pri)
 }
+
+# std::from_chars for floats is used when reading geo files. Set after UseNGL.pri as it adds an older -std flag
+QMAKE_CXXFLAGS+= -std=c++17
@@ -0,0 +1,53 @@
+# Microbenchmarks of the MathFunctions kernels. Build separately from the simulation, eg.
+# cd benchmark && qmake MathFunctionsBenchmark.pro && make && ./MathFunctionsBenchmark
+TARGET=MathFunctionsBenchmark
+# where to put the .o files
+OBJECTS_DIR=obj
+# no Qt needed, console app only
+CONFIG-=qt app_bundle
+CONFIG+=console
+
+SOURCES+= src/MathFunctionsBenchmark.cpp \
+    src/Benchmark.cpp \
+    ../src/MathFunctions.cpp \
+    ../src/MinRes.cpp \
+    ../src/SolverMetrics.cpp \
+    ../src/MICPreconditioner.cpp \
+    ../src/MemoryTracker.cpp \
+    ../src/DirectFactor.cpp \
+    ../src/StencilOperator.cpp \
+    ../src/Multigrid.cpp
+
+HEADERS+= include/Benchmark.h \
+    ../include/MathFunctions.h \
+    ../include/MICPreconditioner.h \
+    ../include/MemoryTracker.h \
+    ../include/DirectFactor.h \
+    ../include/StencilOperator.h \
+    ../include/Multigrid.h
+
+INCLUDEPATH +=./include
+INCLUDEPATH +=../include
+INCLUDEPATH +=/usr/local/include/eigen3/Eigen/
+
+LIBS+= -fopenmp
+
+QMAKE_CXXFLAGS+= -fopenmp
+QMAKE_CXXFLAGS_RELEASE-= -O2
+QMAKE_CXXFLAGS_RELEASE+= -O3
+
+# where our exe is going to live
+DESTDIR=./
+
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+        message("including $HOME/NGL")
+        include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+        message("Using custom NGL location")
+        include($(NGLDIR)/UseNGL.pri)
+}
+
+# Same standard as the simulation. Set after UseNGL.pri as it adds an older -std flag
+QMAKE_CXXFLAGS+= -std=c++17
@@ -0,0 +1,77 @@
+# End to end scaling benchmark on generated scenes. Build separately from the simulation, eg.
+# cd benchmark && qmake ScalingBenchmark.pro && make && ./ScalingBenchmark
+TARGET=ScalingBenchmark
+# where to put the .o files
+OBJECTS_DIR=obj_scaling
+# core Qt Libs to use, needed by NGL
+QT+=gui opengl core
+# on a mac we don't create a .app bundle file
+CONFIG-=app_bundle
+CONFIG+=console
+
+# Simulation sources without the window, controller and main
+SOURCES+= src/ScalingBenchmark.cpp \
+    src/SceneGenerator.cpp \
+    ../src/Emitter.cpp \
+    ../src/Particle.cpp \
+    ../src/Grid.cpp \
+    ../src/MathFunctions.cpp \
+    ../src/Grid_deviatoricVelocity.cpp \
+    ../src/Grid_pressureVelocity.cpp \
+    ../src/Grid_Temperature.cpp \
+    ../src/ReadGeo.cpp \
+    ../src/MinRes.cpp \
+    ../src/Grid_updateParticleFromGrid.cpp \
+    ../src/Grid_particleStencilCache.cpp \
+    ../src/AlembicExport.cpp \
+    ../src/Grid_interpolateParticleToGrid.cpp \
+    ../src/Grid_deviatoricVelocity_New.cpp \
+    ../src/Grid_interpolateGridToParticle.cpp \
+    ../src/Profiler.cpp \
+    ../src/SolverMetrics.cpp \
+    ../src/MemoryTracker.cpp \
+    ../src/TraceRecorder.cpp \
+    ../src/PerfCounters.cpp \
+    ../src/CollisionSDF.cpp \
+    ../src/MICPreconditioner.cpp \
+    ../src/DirectFactor.cpp \
+    ../src/StencilOperator.cpp \
+    ../src/Multigrid.cpp \
+    ../src/LinearSolver.cpp
+
+HEADERS+= include/SceneGenerator.h
+
+INCLUDEPATH +=./include
+INCLUDEPATH +=../include
+INCLUDEPATH +=/usr/local/include/eigen3/Eigen/
+INCLUDEPATH+=/usr/local/include/OpenEXR
+
+linux*:INCLUDEPATH+= /public/devel/include
+linux*:LIBS+=-L/public/devel/lib -lAlembic -lhdf5 -lhdf5_hl
+
+linux*:LIBS+=-L/usr/local/lib -lHalf
+
+macx:LIBS+=-lAlembic
+
+LIBS+= -fopenmp
+
+QMAKE_CXXFLAGS+= -fopenmp
+
+# Stage times are reported per step. Remove to only report total step times
+DEFINES+=PROFILING
+
+# where our exe is going to live
+DESTDIR=./
+
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+        message("including $HOME/NGL")
+        include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+        message("Using custom NGL location")
+        include($(NGLDIR)/UseNGL.pri)
+}
+
+# Same standard as the simulation. Set after UseNGL.pri as it adds an older -std flag
+QMAKE_CXXFLAGS+= -std=c++17
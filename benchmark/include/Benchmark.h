@@ -0,0 +1,71 @@
+#ifndef BENCHMARK
+#define BENCHMARK
+
+#include <functional>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file Benchmark.h
+/// @brief Timing helpers shared by the benchmark executables. A kernel is run for a number of repetitions and the
+/// time per operation is summarised by min, median, mean and standard deviation.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class Benchmark
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Summary of one benchmark. Times are per operation
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Result
+  {
+    std::string m_name;
+    int m_noRepetitions;
+    long m_noOperations;
+    double m_minNs;
+    double m_medianNs;
+    double m_meanNs;
+    double m_stdDevNs;
+    double m_operationsPerSecond;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Runs _kernel once to warm up, then _noRepetitions times, timing each run
+  /// @param [in] _name is the name the result is reported under
+  /// @param [in] _noOperations is the number of operations the kernel performs per call
+  /// @param [in] _noRepetitions is the number of timed calls
+  /// @param [in] _kernel performs _noOperations operations when called
+  //----------------------------------------------------------------------------------------------------------------------
+  static Result run(std::string _name, long _noOperations, int _noRepetitions, const std::function<void()> &_kernel);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Summarises a list of timed repetitions, each in ns per operation
+  //----------------------------------------------------------------------------------------------------------------------
+  static Result summarise(std::string _name, long _noOperations, std::vector<double> _nsPerOperation);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Prints column names for printResult
+  //----------------------------------------------------------------------------------------------------------------------
+  static void printHeader();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Prints one result as a table row
+  //----------------------------------------------------------------------------------------------------------------------
+  static void printResult(const Result &_result);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Writes results as CSV with one line per result
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  static void writeCSV(std::string _fileName, const std::vector<Result> &_results);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Prevents the compiler from removing a computed value as unused
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename T>
+  static inline void keepValue(const T &_value)
+  {
+    asm volatile("" : : "r,m"(_value) : "memory");
+  }
+
+};
+
+#endif // BENCHMARK
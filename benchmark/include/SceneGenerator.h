@@ -0,0 +1,119 @@
+#ifndef SCENEGENERATOR
+#define SCENEGENERATOR
+
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file SceneGenerator.h
+/// @brief Procedural particle scenes for benchmarking, so runs don't depend on Houdini exported geo files.
+/// Particles are placed on a regular lattice inside a solid cube, sphere or closed triangle mesh which is centred in
+/// the bounding box. Lattice spacing is chosen so the number of particles is close to the requested number.
+/// Particle data is in the same form as read from geo files, ie. temperature in Celsius and phase 1 for solid.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class SceneGenerator
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Shapes that can be filled with particles
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Shape {Cube, Sphere, Mesh};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor
+  /// @param [in] _boundingBoxPosition is the lower, back left corner of the simulation bounding box
+  /// @param [in] _boundingBoxSize is the length of one side of the bounding box
+  //----------------------------------------------------------------------------------------------------------------------
+  SceneGenerator(Eigen::Vector3f _boundingBoxPosition, float _boundingBoxSize);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Read triangle mesh from obj file to use with Mesh shape. Polygons are split into triangles
+  /// @param [in] _fileName is name of obj file
+  //----------------------------------------------------------------------------------------------------------------------
+  void readMesh(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Fill shape with particles. Replaces any previously generated particles
+  /// @param [in] _shape is the shape to fill
+  /// @param [in] _noParticlesTarget is the number of particles wanted
+  /// @param [in] _density is the material density used to set particle mass from lattice spacing
+  /// @param [in] _temperature is the particle temperature in Celsius
+  /// @param [in] _phase is the particle phase, 1 for solid and 0 for liquid
+  //----------------------------------------------------------------------------------------------------------------------
+  void generate(Shape _shape, int _noParticlesTarget, float _density, float _temperature, float _phase);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get shape from name; cube, sphere or bunny/mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  static Shape getShape(std::string _name);
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of particles generated
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoParticles(){return m_positions.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get lattice spacing of generated particles
+  //----------------------------------------------------------------------------------------------------------------------
+  inline float getParticleSpacing(){return m_particleSpacing;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get particle data. Lists are passed to Emitter::createParticles
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<Eigen::Vector3f> &getPositions(){return m_positions;}
+  inline const std::vector<float> &getMass(){return m_mass;}
+  inline const std::vector<float> &getTemperature(){return m_temperature;}
+  inline const std::vector<float> &getPhase(){return m_phase;}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Lower, back left corner of the bounding box
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f m_boundingBoxPosition;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Length of one side of the bounding box
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_boundingBoxSize;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Lower corner and side length of the cube the shape is fitted into
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f m_shapePosition;
+  float m_shapeSize;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Mesh vertices, scaled and moved to fit inside shape cube, and triangle vertex indices
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Eigen::Vector3f> m_meshVertices;
+  std::vector<Eigen::Vector3i> m_meshTriangles;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Spacing of last generated lattice
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_particleSpacing;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Generated particle data
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Eigen::Vector3f> m_positions;
+  std::vector<float> m_mass;
+  std::vector<float> m_temperature;
+  std::vector<float> m_phase;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Find which lattice points lie inside shape
+  /// @param [in] _shape is the shape to sample
+  /// @param [in] _noSamples is the number of lattice points along one side of the shape cube
+  /// @param [out] o_isInside is set to 1 for lattice points inside shape, index i+j*n+k*n*n
+  //----------------------------------------------------------------------------------------------------------------------
+  void sampleShape(Shape _shape, int _noSamples, std::vector<char> &o_isInside);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Find lattice points inside mesh. Crossings are counted along lattice lines in x, y and z and a point is
+  /// inside if at least two directions agree, which allows for small holes in the mesh
+  //----------------------------------------------------------------------------------------------------------------------
+  void sampleMesh(int _noSamples, std::vector<char> &o_isInside);
+
+};
+
+#endif // SCENEGENERATOR
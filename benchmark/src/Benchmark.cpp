@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "Benchmark.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Benchmark::Result Benchmark::run(std::string _name, long _noOperations, int _noRepetitions, const std::function<void()> &_kernel)
+{
+  /// @brief First call is not timed so caches and branch predictors are warm
+
+  _kernel();
+
+  std::vector<double> nsPerOperation;
+  nsPerOperation.reserve(_noRepetitions);
+
+  for (int repetition=0; repetition<_noRepetitions; repetition++)
+  {
+    std::chrono::steady_clock::time_point start=std::chrono::steady_clock::now();
+    _kernel();
+    std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+
+    double nanoseconds=std::chrono::duration<double, std::nano>(end-start).count();
+    nsPerOperation.push_back(nanoseconds/_noOperations);
+  }
+
+  return summarise(_name, _noOperations, nsPerOperation);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Benchmark::Result Benchmark::summarise(std::string _name, long _noOperations, std::vector<double> _nsPerOperation)
+{
+  Result result;
+  result.m_name=_name;
+  result.m_noRepetitions=_nsPerOperation.size();
+  result.m_noOperations=_noOperations;
+  result.m_minNs=0.0;
+  result.m_medianNs=0.0;
+  result.m_meanNs=0.0;
+  result.m_stdDevNs=0.0;
+  result.m_operationsPerSecond=0.0;
+
+  if (_nsPerOperation.empty())
+  {
+    return result;
+  }
+
+  std::sort(_nsPerOperation.begin(), _nsPerOperation.end());
+
+  int noValues=_nsPerOperation.size();
+  result.m_minNs=_nsPerOperation.front();
+  result.m_medianNs=(noValues%2==1) ? _nsPerOperation[noValues/2] : 0.5*(_nsPerOperation[(noValues/2)-1]+_nsPerOperation[noValues/2]);
+
+  double sum=0.0;
+  for (double value : _nsPerOperation)
+  {
+    sum+=value;
+  }
+  result.m_meanNs=sum/noValues;
+
+  double sumSquares=0.0;
+  for (double value : _nsPerOperation)
+  {
+    sumSquares+=(value-result.m_meanNs)*(value-result.m_meanNs);
+  }
+  result.m_stdDevNs=(noValues>1) ? std::sqrt(sumSquares/(noValues-1)) : 0.0;
+
+  //Throughput from median as it is least affected by outliers
+  result.m_operationsPerSecond=(result.m_medianNs>0.0) ? 1e9/result.m_medianNs : 0.0;
+
+  return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Benchmark::printHeader()
+{
+  printf("%-36s %6s %12s %12s %12s %10s %14s\n", "Benchmark", "Reps", "Min ns/op", "Median ns/op", "Mean ns/op", "StdDev", "Mops/s");
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Benchmark::printResult(const Result &_result)
+{
+  printf("%-36s %6d %12.3f %12.3f %12.3f %10.3f %14.3f\n", _result.m_name.c_str(), _result.m_noRepetitions, _result.m_minNs,
+         _result.m_medianNs, _result.m_meanNs, _result.m_stdDevNs, _result.m_operationsPerSecond*1e-6);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Benchmark::writeCSV(std::string _fileName, const std::vector<Result> &_results)
+{
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"name,repetitions,operations,min_ns,median_ns,mean_ns,stddev_ns,ops_per_second\n";
+
+  for (const Result &result : _results)
+  {
+    file<<result.m_name<<","<<result.m_noRepetitions<<","<<result.m_noOperations<<","<<result.m_minNs<<","
+        <<result.m_medianNs<<","<<result.m_meanNs<<","<<result.m_stdDevNs<<","<<result.m_operationsPerSecond<<"\n";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,326 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+#include "Benchmark.h"
+#include "MathFunctions.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MathFunctionsBenchmark.cpp
+/// @brief Microbenchmarks of the MathFunctions kernels used per particle and per cell in a simulation step.
+/// Inputs are drawn from the ranges the kernels see in the simulation and are generated before timing.
+///
+/// The temperature solvers are compared on a stencil system of --solverCells cells per side. Both start from the same
+/// previous solution and stop on the same relative residual. Each repetition is one solve.
+///
+/// Usage: MathFunctionsBenchmark [--repetitions N] [--operations N] [--solverCells N] [--csv fileName]
+//----------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Read options
+
+  Generate input sets. Sizes are a power of two so inputs are cycled with a mask
+
+  Time each kernel over the same number of operations
+
+  Build temperature-like stencil system and time one solve with each solver
+
+  Print table and optionally write CSV
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  int noRepetitions=21;
+  long noOperations=1<<20;
+  int noSolverCells=98;
+  std::string csvFileName;
+
+  for (int i=1; i<argc-1; i++)
+  {
+    std::string option=argv[i];
+
+    if (option=="--repetitions")
+    {
+      noRepetitions=std::stoi(argv[++i]);
+    }
+    else if (option=="--operations")
+    {
+      noOperations=std::stol(argv[++i]);
+    }
+    else if (option=="--solverCells")
+    {
+      noSolverCells=std::stoi(argv[++i]);
+    }
+    else if (option=="--csv")
+    {
+      csvFileName=argv[++i];
+    }
+  }
+
+  //Inputs
+  const int noInputs=4096;
+  const int inputMask=noInputs-1;
+
+  std::mt19937 generator(1234);
+
+  //Distances from particle to grid node in cells. Cubic B-spline support is [-2,2], tight quadratic [-1.5,1.5].
+  //Ranges extend slightly past support so the zero branch is also taken
+  std::uniform_real_distribution<float> cubicDistance(-2.5, 2.5);
+  std::uniform_real_distribution<float> quadraticDistance(-2.0, 2.0);
+  std::vector<float> cubicInputs(noInputs);
+  std::vector<float> quadraticInputs(noInputs);
+
+  //Face direction and neighbour increments as looped over in the grid
+  std::uniform_int_distribution<int> faceDirection(0, 2);
+  std::uniform_int_distribution<int> indexIncrement(-2, 2);
+  std::vector<Eigen::Vector4i> integralInputs(noInputs);
+
+  //Particle positions inside a 3 unit bounding box with 14 cells, as in HoudiniExport/particles2.geo
+  std::uniform_real_distribution<float> position(-1.5, 1.5);
+  std::vector<Eigen::Vector3f> positionInputs(noInputs);
+  float cellSize=3.0/12.0;
+  Eigen::Vector3f gridEdgeOrigin(-1.5-cellSize, -1.5-cellSize, -1.5-cellSize);
+
+  //Deformation gradients close to identity, as for elastic solids, and symmetric positive definite 3x3 systems
+  std::normal_distribution<float> perturbation(0.0, 0.1);
+  std::vector<Eigen::Matrix3f> deformationInputs(noInputs);
+  std::vector<Eigen::Matrix3f> systemInputs(noInputs);
+  std::vector<Eigen::Vector3f> rightHandSideInputs(noInputs);
+
+  for (int i=0; i<noInputs; i++)
+  {
+    cubicInputs[i]=cubicDistance(generator);
+    quadraticInputs[i]=quadraticDistance(generator);
+    integralInputs[i]=Eigen::Vector4i(faceDirection(generator), indexIncrement(generator), indexIncrement(generator), indexIncrement(generator));
+    positionInputs[i]=Eigen::Vector3f(position(generator), position(generator), position(generator));
+
+    Eigen::Matrix3f deformation=Eigen::Matrix3f::Identity();
+    Eigen::Matrix3f system;
+    for (int row=0; row<3; row++)
+    {
+      for (int column=0; column<3; column++)
+      {
+        deformation(row,column)+=perturbation(generator);
+        system(row,column)=perturbation(generator);
+      }
+      rightHandSideInputs[i](row)=perturbation(generator);
+    }
+    deformationInputs[i]=deformation;
+    systemInputs[i]=(system*system.transpose())+Eigen::Matrix3f::Identity();
+  }
+
+  //Matrix decompositions are much slower so run fewer operations to keep total time similar
+  long noMatrixOperations=std::max(noOperations/16, 1L);
+
+  std::vector<Benchmark::Result> results;
+
+  results.push_back(Benchmark::run("calcCubicBSpline", noOperations, noRepetitions, [&]()
+  {
+    float sum=0.0;
+    for (long i=0; i<noOperations; i++)
+    {
+      sum+=MathFunctions::calcCubicBSpline(cubicInputs[i&inputMask]);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("calcCubicBSpline_Diff", noOperations, noRepetitions, [&]()
+  {
+    float sum=0.0;
+    for (long i=0; i<noOperations; i++)
+    {
+      sum+=MathFunctions::calcCubicBSpline_Diff(cubicInputs[i&inputMask]);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("calcCubicBSpline_Integ", noOperations, noRepetitions, [&]()
+  {
+    float sum=0.0;
+    for (long i=0; i<noOperations; i++)
+    {
+      const Eigen::Vector4i &input=integralInputs[i&inputMask];
+      sum+=MathFunctions::calcCubicBSpline_Integ(input(0), input(1), input(2), input(3));
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("calcTightQuadraticStencil", noOperations, noRepetitions, [&]()
+  {
+    float sum=0.0;
+    for (long i=0; i<noOperations; i++)
+    {
+      sum+=MathFunctions::calcTightQuadraticStencil(quadraticInputs[i&inputMask]);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("calcTightQuadraticStencil_Diff", noOperations, noRepetitions, [&]()
+  {
+    float sum=0.0;
+    for (long i=0; i<noOperations; i++)
+    {
+      sum+=MathFunctions::calcTightQuadraticStencil_Diff(quadraticInputs[i&inputMask]);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("getParticleGridCell", noOperations, noRepetitions, [&]()
+  {
+    int sum=0;
+    for (long i=0; i<noOperations; i++)
+    {
+      sum+=MathFunctions::getParticleGridCell(positionInputs[i&inputMask], cellSize, gridEdgeOrigin).sum();
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("polarDecomposition", noMatrixOperations, noRepetitions, [&]()
+  {
+    Eigen::Matrix3f R;
+    Eigen::Matrix3f S;
+    float sum=0.0;
+    for (long i=0; i<noMatrixOperations; i++)
+    {
+      MathFunctions::polarDecomposition(deformationInputs[i&inputMask], R, S);
+      sum+=R(0,0)+S(0,0);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("singularValueDecomposition", noMatrixOperations, noRepetitions, [&]()
+  {
+    Eigen::Matrix3f U;
+    Eigen::Matrix3f singularValues;
+    Eigen::Matrix3f V;
+    float sum=0.0;
+    for (long i=0; i<noMatrixOperations; i++)
+    {
+      MathFunctions::singularValueDecomposition(deformationInputs[i&inputMask], U, singularValues, V);
+      sum+=singularValues(0,0);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  results.push_back(Benchmark::run("linearSystemSolve", noMatrixOperations, noRepetitions, [&]()
+  {
+    Eigen::Vector3f solution;
+    float sum=0.0;
+    for (long i=0; i<noMatrixOperations; i++)
+    {
+      MathFunctions::linearSystemSolve(systemInputs[i&inputMask], rightHandSideInputs[i&inputMask], solution);
+      sum+=solution(0);
+    }
+    Benchmark::keepValue(sum);
+  }));
+
+  //Temperature system: a 7-point Laplacian plus a heat capacity term on the diagonal, as assembled by Grid. The
+  //boundary layer is colliding (no flux) and the top quarter is air (fixed temperature), neither has a row.
+  //The right hand side is the previous solution times the system plus a small change, and both solvers are started
+  //from the previous solution
+  int noSolverCellsTotal=noSolverCells*noSolverCells*noSolverCells;
+  int cellOffsets[3]={1, noSolverCells, noSolverCells*noSolverCells};
+  std::uniform_real_distribution<float> heatCapacity(5.0, 15.0);
+
+  //0 for interior, 1 for air and 2 for colliding
+  auto getCellState=[&](int _cellIndex)
+  {
+    int i=_cellIndex%noSolverCells;
+    int j=(_cellIndex/noSolverCells)%noSolverCells;
+    int k=_cellIndex/(noSolverCells*noSolverCells);
+
+    if (i==0 || j==0 || k==0 || i==noSolverCells-1 || j==noSolverCells-1 || k==noSolverCells-1)
+    {
+      return 2;
+    }
+    return (k>(3*noSolverCells)/4) ? 1 : 0;
+  };
+
+  StencilOperator temperatureOperator;
+  temperatureOperator.resize(noSolverCells);
+
+  for (int cellIndex=0; cellIndex<noSolverCellsTotal; cellIndex++)
+  {
+    if (getCellState(cellIndex)!=0)
+    {
+      continue;
+    }
+
+    int noCollidingNeighbours=0;
+    for (int direction=0; direction<3; direction++)
+    {
+      noCollidingNeighbours+=(getCellState(cellIndex-cellOffsets[direction])==2);
+      noCollidingNeighbours+=(getCellState(cellIndex+cellOffsets[direction])==2);
+
+      //Lower face coupling, only stored between interior cells
+      if (getCellState(cellIndex-cellOffsets[direction])==0)
+      {
+        temperatureOperator.m_coupling[direction][cellIndex]=1.0;
+      }
+    }
+
+    temperatureOperator.m_diagonal[cellIndex]=(6-noCollidingNeighbours)+heatCapacity(generator);
+  }
+
+  Eigen::VectorXd previousTemperature=Eigen::VectorXd::Zero(noSolverCellsTotal);
+  Eigen::VectorXd temperatureRightHandSide=Eigen::VectorXd::Zero(noSolverCellsTotal);
+  for (int cellIndex=0; cellIndex<noSolverCellsTotal; cellIndex++)
+  {
+    if (temperatureOperator.m_diagonal[cellIndex]!=0.0)
+    {
+      previousTemperature(cellIndex)=300.0+10.0*std::sin(0.05*cellIndex);
+    }
+  }
+  temperatureOperator.multiply(previousTemperature, temperatureRightHandSide);
+  for (int cellIndex=0; cellIndex<noSolverCellsTotal; cellIndex++)
+  {
+    temperatureRightHandSide(cellIndex)+=temperatureOperator.m_diagonal[cellIndex]*0.5*std::cos(0.07*cellIndex);
+  }
+
+  const float solverMaxLoops=3000;
+  const float solverTolerance=0.00001;
+  std::vector<SolverRecord> solverRecords(2);
+
+  results.push_back(Benchmark::run("conjugateGradient_MatrixFree", 1, noRepetitions, [&]()
+  {
+    Eigen::VectorXd temperature=previousTemperature;
+    MathFunctions::conjugateGradient_MatrixFree(temperatureOperator, nullptr, temperatureRightHandSide, temperature, true, solverMaxLoops, solverTolerance, solverRecords[0]);
+    Benchmark::keepValue(temperature(0));
+  }));
+
+  results.push_back(Benchmark::run("gaussSeidel_RedBlack", 1, noRepetitions, [&]()
+  {
+    Eigen::VectorXd temperature=previousTemperature;
+    MathFunctions::gaussSeidel_RedBlack(temperatureOperator, temperatureRightHandSide, temperature, solverMaxLoops, solverTolerance, 1.0, solverRecords[1]);
+    Benchmark::keepValue(temperature(0));
+  }));
+
+  //Report
+  Benchmark::printHeader();
+  for (const Benchmark::Result &result : results)
+  {
+    Benchmark::printResult(result);
+  }
+
+  //Residuals are ||b-Ax|| of the initial guess and of the solution
+  std::cout<<"Temperature system with "<<noSolverCells<<" cells per side:\n";
+  for (const SolverRecord &record : solverRecords)
+  {
+    std::cout<<"  "<<record.m_solverName<<": "<<record.m_iterations<<" iterations, residual "<<record.m_initialResidual
+             <<" to "<<record.m_finalResidual<<", converged "<<record.m_isConverged<<"\n";
+  }
+
+  if (!csvFileName.empty())
+  {
+    Benchmark::writeCSV(csvFileName, results);
+  }
+
+  return 0;
+}
@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "Emitter.h"
+#include "Grid.h"
+#include "Profiler.h"
+#include "ReadGeo.h"
+#include "SceneGenerator.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ScalingBenchmark.cpp
+/// @brief End to end benchmark of simulation steps on procedurally generated scenes. Each scene, particle count and
+/// grid resolution is run for each thread count. Strong scaling keeps the scene fixed, weak scaling multiplies the
+/// number of particles by the thread count relative to the first thread count. Efficiencies are relative to the run
+/// with the first thread count. Material and time step parameters are read from a geo file.
+///
+/// Stage times are only measured when built with PROFILING defined.
+/// The grid stores dense deviatoric matrices of size noCells^6, so keep --cells small.
+///
+/// Usage: ScalingBenchmark [--scenes cube,sphere,bunny] [--particles 2000,8000] [--cells 12] [--threads 1,2,4]
+///                         [--steps N] [--mode strong|weak|both] [--parameters file.geo] [--mesh file.obj]
+///                         [--csv fileName]
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Timings of one run
+//----------------------------------------------------------------------------------------------------------------------
+struct ScalingResult
+{
+  std::string m_scene;
+  std::string m_mode;
+  int m_noParticles;
+  int m_noCells;
+  int m_noThreads;
+  double m_msPerStep;
+  double m_stageMsPerStep[Profiler::NoStages];
+  double m_particlesPerSecond;
+  double m_efficiency;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Split comma separated list
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<std::string> splitList(std::string _list)
+{
+  std::vector<std::string> items;
+  std::istringstream listStream(_list);
+  std::string item;
+
+  while (std::getline(listStream, item, ','))
+  {
+    if (!item.empty())
+    {
+      items.push_back(item);
+    }
+  }
+
+  return items;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Split comma separated list of integers
+//----------------------------------------------------------------------------------------------------------------------
+static std::vector<int> splitIntList(std::string _list)
+{
+  std::vector<int> values;
+
+  for (const std::string &item : splitList(_list))
+  {
+    values.push_back(std::stoi(item));
+  }
+
+  return values;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Run simulation steps on generated particles and time them
+/// @param [in] _parameters is the geo file holding material, grid and time step parameters
+/// @param [in] _scene holds the generated particles
+/// @param [in] _noCells is the number of grid cells along one side of the bounding box
+/// @param [in] _noThreads is the number of OpenMP threads to use
+/// @param [in] _noSteps is the number of timed steps. An untimed first step is run before these
+/// @param [out] o_result gets particle count and timings
+//----------------------------------------------------------------------------------------------------------------------
+static void runSimulation(ReadGeo* _parameters, SceneGenerator &_scene, int _noCells, int _noThreads, int _noSteps, ScalingResult &o_result)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Set up emitter and grid as SimulationController does, but with generated particles. Steps are the same
+  Grid::simulateStep the controller runs
+
+  Run first step untimed, as it also calculates initial particle volumes
+
+  Time remaining steps, both in total and per stage
+
+  Delete grid and emitter so next run starts fresh
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  omp_set_num_threads(_noThreads);
+
+  const float velocityContributionAlpha=0.95;
+  const float temperatureContributionBeta=0.95;
+
+  float timeStep=_parameters->getSimulationParameter_Float("timeStep");
+  Eigen::Vector3f boundingBoxPosition=_parameters->getSimulationParameter_Vec3("gridOrigin");
+  float boundingBoxSize=_parameters->getSimulationParameter_Float("gridSize");
+
+  //Set up emitter
+  Emitter* emitter=new Emitter();
+  emitter->setStrainConstants(_parameters->getSimulationParameter_Float("LameMu"), _parameters->getSimulationParameter_Float("LameLambda"),
+                              _parameters->getSimulationParameter_Float("CompressionLimit"), _parameters->getSimulationParameter_Float("StretchLimit"),
+                              _parameters->getSimulationParameter_Float("HardnessCoefficient"));
+  emitter->setTemperatureConstants(_parameters->getSimulationParameter_Float("HeatCapacitySolid"), _parameters->getSimulationParameter_Float("HeatCapacityFluid"),
+                                   _parameters->getSimulationParameter_Float("HeatConductivitySolid"), _parameters->getSimulationParameter_Float("HeatConductivityFluid"),
+                                   _parameters->getSimulationParameter_Float("LatentHeat"), _parameters->getSimulationParameter_Float("FreezingTemperature")+273.0);
+  emitter->createParticles(_scene.getNoParticles(), _scene.getPositions(), _scene.getMass(), _scene.getTemperature(), _scene.getPhase());
+  emitter->setCollisionObject(boundingBoxPosition(0), boundingBoxPosition(0)+boundingBoxSize,
+                              boundingBoxPosition(1), boundingBoxPosition(1)+boundingBoxSize,
+                              boundingBoxPosition(2), boundingBoxPosition(2)+boundingBoxSize);
+
+  //Set up grid, with a layer of cells outside bounding box for collisions
+  Grid* grid=Grid::createGrid(boundingBoxPosition, boundingBoxSize, _noCells+2);
+  grid->setSurroundingTemperatures(_parameters->getSimulationParameter_Float("ambientTemperature")+273.0,
+                                   _parameters->getSimulationParameter_Float("heatSourceTemperature")+273.0);
+
+  //Untimed first step
+  grid->simulateStep(timeStep, emitter, true, velocityContributionAlpha, temperatureContributionBeta);
+
+#ifdef PROFILING
+  //Discard stage times of setup and first step
+  Profiler::instance()->endFrame(-1);
+#endif
+
+  //Timed steps
+  double startTime=omp_get_wtime();
+
+  for (int step=0; step<_noSteps; step++)
+  {
+    grid->simulateStep(timeStep, emitter, false, velocityContributionAlpha, temperatureContributionBeta);
+  }
+
+  double totalSeconds=omp_get_wtime()-startTime;
+
+  o_result.m_noParticles=_scene.getNoParticles();
+  o_result.m_noCells=_noCells;
+  o_result.m_noThreads=_noThreads;
+  o_result.m_msPerStep=(totalSeconds*1e3)/_noSteps;
+  o_result.m_particlesPerSecond=((double)o_result.m_noParticles*_noSteps)/totalSeconds;
+  o_result.m_efficiency=1.0;
+
+  for (int stage=0; stage<Profiler::NoStages; stage++)
+  {
+    o_result.m_stageMsPerStep[stage]=0.0;
+  }
+
+#ifdef PROFILING
+  Profiler::instance()->endFrame(_noThreads);
+  const Profiler::FrameRecord &frame=Profiler::instance()->getFrames().back();
+
+  for (int stage=0; stage<Profiler::NoStages; stage++)
+  {
+    o_result.m_stageMsPerStep[stage]=(frame.m_totalNanoseconds[stage]*1e-6)/_noSteps;
+  }
+#endif
+
+  Grid::deleteGrid();
+  delete emitter;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Print one result as a table row, followed by the stages that were timed
+//----------------------------------------------------------------------------------------------------------------------
+static void printResult(const ScalingResult &_result)
+{
+  printf("%-8s %-7s %10d %6d %8d %12.3f %14.1f %11.3f\n", _result.m_scene.c_str(), _result.m_mode.c_str(), _result.m_noParticles,
+         _result.m_noCells, _result.m_noThreads, _result.m_msPerStep, _result.m_particlesPerSecond, _result.m_efficiency);
+
+  for (int stage=0; stage<Profiler::NoStages; stage++)
+  {
+    if (_result.m_stageMsPerStep[stage]>0.0)
+    {
+      printf("    %-26s %12.3f ms/step\n", Profiler::getStageName((Profiler::Stage)stage), _result.m_stageMsPerStep[stage]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Write all results as CSV with one column per stage
+//----------------------------------------------------------------------------------------------------------------------
+static void writeCSV(std::string _fileName, const std::vector<ScalingResult> &_results)
+{
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"scene,mode,particles,cells,threads,ms_per_step,particles_per_second,efficiency";
+  for (int stage=0; stage<Profiler::NoStages; stage++)
+  {
+    file<<","<<Profiler::getStageName((Profiler::Stage)stage)<<"_ms";
+  }
+  file<<"\n";
+
+  for (const ScalingResult &result : _results)
+  {
+    file<<result.m_scene<<","<<result.m_mode<<","<<result.m_noParticles<<","<<result.m_noCells<<","<<result.m_noThreads<<","
+        <<result.m_msPerStep<<","<<result.m_particlesPerSecond<<","<<result.m_efficiency;
+    for (int stage=0; stage<Profiler::NoStages; stage++)
+    {
+      file<<","<<result.m_stageMsPerStep[stage];
+    }
+    file<<"\n";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char *argv[])
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Read options. Default thread counts are powers of two up to the number of processors
+
+  For each scene, particle count and grid resolution
+    Strong scaling: generate scene once, run for each thread count
+    Weak scaling: generate scene with particles scaled by thread count, run for each thread count
+    Efficiency relative to run with first thread count
+
+  Print table and optionally write CSV
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  std::vector<std::string> sceneNames={"cube", "sphere", "bunny"};
+  std::vector<int> particleCounts={4000};
+  std::vector<int> cellCounts={12};
+  std::vector<int> threadCounts;
+  int noSteps=5;
+  std::string mode="both";
+  std::string parameterFileName="../HoudiniExport/particles2.geo";
+  std::string meshFileName="../HoudiniExport/stanfordBunny.obj";
+  std::string csvFileName;
+
+  for (int i=1; i<argc-1; i++)
+  {
+    std::string option=argv[i];
+
+    if (option=="--scenes")
+    {
+      sceneNames=splitList(argv[++i]);
+    }
+    else if (option=="--particles")
+    {
+      particleCounts=splitIntList(argv[++i]);
+    }
+    else if (option=="--cells")
+    {
+      cellCounts=splitIntList(argv[++i]);
+    }
+    else if (option=="--threads")
+    {
+      threadCounts=splitIntList(argv[++i]);
+    }
+    else if (option=="--steps")
+    {
+      noSteps=std::max(std::stoi(argv[++i]), 1);
+    }
+    else if (option=="--mode")
+    {
+      mode=argv[++i];
+    }
+    else if (option=="--parameters")
+    {
+      parameterFileName=argv[++i];
+    }
+    else if (option=="--mesh")
+    {
+      meshFileName=argv[++i];
+    }
+    else if (option=="--csv")
+    {
+      csvFileName=argv[++i];
+    }
+  }
+
+  if (threadCounts.empty())
+  {
+    int noProcessors=omp_get_num_procs();
+    for (int noThreads=1; noThreads<noProcessors; noThreads*=2)
+    {
+      threadCounts.push_back(noThreads);
+    }
+    threadCounts.push_back(noProcessors);
+  }
+
+  //Profiler must exist before any threaded stage is timed
+#ifdef PROFILING
+  Profiler::instance();
+#endif
+
+  ReadGeo* parameters=new ReadGeo(parameterFileName);
+  Eigen::Vector3f boundingBoxPosition=parameters->getSimulationParameter_Vec3("gridOrigin");
+  float boundingBoxSize=parameters->getSimulationParameter_Float("gridSize");
+
+  //Scenes match particles2.geo; solid at 10 Celsius with about 28 units mass per unit volume
+  const float density=28.0;
+  const float temperature=10.0;
+  const float phase=1.0;
+
+  SceneGenerator scene(boundingBoxPosition, boundingBoxSize);
+  bool isMeshRead=false;
+
+  std::vector<ScalingResult> results;
+
+  for (const std::string &sceneName : sceneNames)
+  {
+    SceneGenerator::Shape shape=SceneGenerator::getShape(sceneName);
+
+    if (shape==SceneGenerator::Mesh && !isMeshRead)
+    {
+      scene.readMesh(meshFileName);
+      isMeshRead=true;
+    }
+
+    for (int noParticles : particleCounts)
+    {
+      for (int noCells : cellCounts)
+      {
+        if (mode=="strong" || mode=="both")
+        {
+          scene.generate(shape, noParticles, density, temperature, phase);
+          double baseTime=0.0;
+
+          for (size_t threadIndex=0; threadIndex<threadCounts.size(); threadIndex++)
+          {
+            ScalingResult result;
+            result.m_scene=sceneName;
+            result.m_mode="strong";
+            runSimulation(parameters, scene, noCells, threadCounts[threadIndex], noSteps, result);
+
+            //Ideal strong scaling halves time when threads are doubled
+            if (threadIndex==0)
+            {
+              baseTime=result.m_msPerStep*threadCounts[0];
+            }
+            result.m_efficiency=baseTime/(result.m_msPerStep*result.m_noThreads);
+
+            results.push_back(result);
+          }
+        }
+
+        if (mode=="weak" || mode=="both")
+        {
+          double baseTimePerParticle=0.0;
+
+          for (size_t threadIndex=0; threadIndex<threadCounts.size(); threadIndex++)
+          {
+            //Particle counts are approximate, so compare time per particle per thread
+            int noScaledParticles=(noParticles*threadCounts[threadIndex])/threadCounts[0];
+            scene.generate(shape, noScaledParticles, density, temperature, phase);
+
+            ScalingResult result;
+            result.m_scene=sceneName;
+            result.m_mode="weak";
+            runSimulation(parameters, scene, noCells, threadCounts[threadIndex], noSteps, result);
+
+            //Ideal weak scaling keeps time per step constant when particles and threads grow together
+            double timePerParticle=(result.m_msPerStep*result.m_noThreads)/result.m_noParticles;
+            if (threadIndex==0)
+            {
+              baseTimePerParticle=timePerParticle;
+            }
+            result.m_efficiency=baseTimePerParticle/timePerParticle;
+
+            results.push_back(result);
+          }
+        }
+      }
+    }
+  }
+
+  delete parameters;
+
+  //Report
+  printf("\n%-8s %-7s %10s %6s %8s %12s %14s %11s\n", "Scene", "Mode", "Particles", "Cells", "Threads", "ms/step", "Particles/s", "Efficiency");
+  for (const ScalingResult &result : results)
+  {
+    printResult(result);
+  }
+
+  if (!csvFileName.empty())
+  {
+    writeCSV(csvFileName, results);
+  }
+
+  return 0;
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "SceneGenerator.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SceneGenerator::SceneGenerator(Eigen::Vector3f _boundingBoxPosition, float _boundingBoxSize)
+{
+  /// @brief Shape is fitted into a cube of 0.6 times the bounding box size, centred in the bounding box
+
+  m_boundingBoxPosition=_boundingBoxPosition;
+  m_boundingBoxSize=_boundingBoxSize;
+
+  m_shapeSize=0.6*m_boundingBoxSize;
+  float shapeOffset=0.5*(m_boundingBoxSize-m_shapeSize);
+  m_shapePosition=m_boundingBoxPosition+Eigen::Vector3f(shapeOffset, shapeOffset, shapeOffset);
+
+  m_particleSpacing=0.0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SceneGenerator::readMesh(std::string _fileName)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Read v and f lines. Face indices can be given as v, v/vt, v//vn or v/vt/vn and can be negative
+
+  Fan triangulate polygons
+
+  Scale mesh uniformly so its longest side fits the shape cube, then centre it in the cube
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::ifstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open mesh file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  m_meshVertices.clear();
+  m_meshTriangles.clear();
+
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::istringstream lineStream(line);
+    std::string type;
+    lineStream>>type;
+
+    if (type=="v")
+    {
+      Eigen::Vector3f vertex;
+      lineStream>>vertex(0)>>vertex(1)>>vertex(2);
+      m_meshVertices.push_back(vertex);
+    }
+    else if (type=="f")
+    {
+      std::vector<int> faceIndices;
+      std::string vertexToken;
+      while (lineStream>>vertexToken)
+      {
+        int index=std::stoi(vertexToken.substr(0, vertexToken.find('/')));
+        //Obj indices start at 1, negative indices count back from last vertex read
+        faceIndices.push_back(index>0 ? index-1 : m_meshVertices.size()+index);
+      }
+
+      for (size_t i=2; i<faceIndices.size(); i++)
+      {
+        m_meshTriangles.push_back(Eigen::Vector3i(faceIndices[0], faceIndices[i-1], faceIndices[i]));
+      }
+    }
+  }
+
+  if (m_meshVertices.empty() || m_meshTriangles.empty())
+  {
+    std::cout<<"No triangles found in mesh file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  //Fit mesh into shape cube
+  Eigen::Vector3f minCorner=m_meshVertices[0];
+  Eigen::Vector3f maxCorner=m_meshVertices[0];
+  for (const Eigen::Vector3f &vertex : m_meshVertices)
+  {
+    minCorner=minCorner.cwiseMin(vertex);
+    maxCorner=maxCorner.cwiseMax(vertex);
+  }
+
+  Eigen::Vector3f meshSize=maxCorner-minCorner;
+  float scale=m_shapeSize/meshSize.maxCoeff();
+  Eigen::Vector3f offset=m_shapePosition+(0.5*(Eigen::Vector3f(m_shapeSize, m_shapeSize, m_shapeSize)-(scale*meshSize)));
+
+  for (Eigen::Vector3f &vertex : m_meshVertices)
+  {
+    vertex=offset+(scale*(vertex-minCorner));
+  }
+
+  std::cout<<"Read mesh "<<_fileName<<" with "<<m_meshVertices.size()<<" vertices and "<<m_meshTriangles.size()<<" triangles\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SceneGenerator::generate(Shape _shape, int _noParticlesTarget, float _density, float _temperature, float _phase)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Start from lattice size which would give target number if the whole shape cube was filled.
+
+  Sample shape, then correct lattice size using the filled fraction found. Repeat a few times as filled
+  fraction changes slightly with lattice size
+
+  Create particles at lattice points inside shape
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  if (_shape==Mesh && m_meshTriangles.empty())
+  {
+    std::cout<<"No mesh read, can't generate mesh scene\n";
+    exit(EXIT_FAILURE);
+  }
+
+  int noSamples=std::max((int)std::round(std::cbrt((float)_noParticlesTarget)), 1);
+  std::vector<char> isInside;
+
+  for (int iteration=0; iteration<4; iteration++)
+  {
+    sampleShape(_shape, noSamples, isInside);
+    int noInside=std::count(isInside.begin(), isInside.end(), 1);
+
+    if (noInside==0)
+    {
+      noSamples*=2;
+      continue;
+    }
+
+    float fillFraction=(float)noInside/(float)isInside.size();
+    int newNoSamples=std::max((int)std::round(std::cbrt(_noParticlesTarget/fillFraction)), 1);
+
+    if (newNoSamples==noSamples)
+    {
+      break;
+    }
+    noSamples=newNoSamples;
+  }
+
+  sampleShape(_shape, noSamples, isInside);
+
+  //Lattice points are at sample cell centres
+  m_particleSpacing=m_shapeSize/noSamples;
+  float particleMass=_density*pow(m_particleSpacing,3);
+
+  m_positions.clear();
+  m_mass.clear();
+  m_temperature.clear();
+  m_phase.clear();
+
+  for (int k=0; k<noSamples; k++)
+  {
+    for (int j=0; j<noSamples; j++)
+    {
+      for (int i=0; i<noSamples; i++)
+      {
+        if (isInside[i+(j*noSamples)+(k*noSamples*noSamples)]==1)
+        {
+          m_positions.push_back(m_shapePosition+(m_particleSpacing*Eigen::Vector3f(i+0.5, j+0.5, k+0.5)));
+          m_mass.push_back(particleMass);
+          m_temperature.push_back(_temperature);
+          m_phase.push_back(_phase);
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SceneGenerator::Shape SceneGenerator::getShape(std::string _name)
+{
+  if (_name=="cube")
+  {
+    return Cube;
+  }
+  else if (_name=="sphere")
+  {
+    return Sphere;
+  }
+  else if (_name=="bunny" || _name=="mesh")
+  {
+    return Mesh;
+  }
+
+  std::cout<<"Unknown scene "<<_name<<", use cube, sphere or bunny\n";
+  exit(EXIT_FAILURE);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SceneGenerator::sampleShape(Shape _shape, int _noSamples, std::vector<char> &o_isInside)
+{
+  o_isInside.assign(_noSamples*_noSamples*_noSamples, 0);
+
+  if (_shape==Mesh)
+  {
+    sampleMesh(_noSamples, o_isInside);
+    return;
+  }
+
+  //Cube fills all of shape cube. Sphere is inscribed in it
+  float radius=0.5*_noSamples;
+
+  for (int k=0; k<_noSamples; k++)
+  {
+    for (int j=0; j<_noSamples; j++)
+    {
+      for (int i=0; i<_noSamples; i++)
+      {
+        bool isInside=true;
+
+        if (_shape==Sphere)
+        {
+          Eigen::Vector3f fromCentre(i+0.5-radius, j+0.5-radius, k+0.5-radius);
+          isInside=(fromCentre.squaredNorm()<=(radius*radius));
+        }
+
+        o_isInside[i+(j*_noSamples)+(k*_noSamples*_noSamples)]=isInside;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SceneGenerator::sampleMesh(int _noSamples, std::vector<char> &o_isInside)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  For each axis direction
+    For each lattice line along that direction
+      Find where line crosses triangles, using barycentric coordinates in the plane of the other two axes
+      Sort crossings. Points between crossing 0-1, 2-3 etc. are inside
+
+  Point is inside if inside for at least two directions
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  float spacing=m_shapeSize/_noSamples;
+  int noLatticePoints=_noSamples*_noSamples*_noSamples;
+  std::vector<char> noInsideVotes(noLatticePoints, 0);
+
+  for (int axis=0; axis<3; axis++)
+  {
+    int axisU=(axis+1)%3;
+    int axisV=(axis+2)%3;
+
+#pragma omp parallel for
+    for (int line=0; line<(_noSamples*_noSamples); line++)
+    {
+      int indexU=line%_noSamples;
+      int indexV=line/_noSamples;
+      float u=m_shapePosition(axisU)+((indexU+0.5)*spacing);
+      float v=m_shapePosition(axisV)+((indexV+0.5)*spacing);
+
+      std::vector<float> crossings;
+
+      for (const Eigen::Vector3i &triangle : m_meshTriangles)
+      {
+        const Eigen::Vector3f &a=m_meshVertices[triangle(0)];
+        const Eigen::Vector3f &b=m_meshVertices[triangle(1)];
+        const Eigen::Vector3f &c=m_meshVertices[triangle(2)];
+
+        //Barycentric coordinates of line in triangle projected to the u-v plane
+        float determinant=((b(axisU)-a(axisU))*(c(axisV)-a(axisV)))-((c(axisU)-a(axisU))*(b(axisV)-a(axisV)));
+        if (determinant==0.0)
+        {
+          continue;
+        }
+
+        float weightB=(((u-a(axisU))*(c(axisV)-a(axisV)))-((c(axisU)-a(axisU))*(v-a(axisV))))/determinant;
+        float weightC=(((b(axisU)-a(axisU))*(v-a(axisV)))-((u-a(axisU))*(b(axisV)-a(axisV))))/determinant;
+
+        if (weightB<0.0 || weightC<0.0 || (weightB+weightC)>1.0)
+        {
+          continue;
+        }
+
+        crossings.push_back(a(axis)+(weightB*(b(axis)-a(axis)))+(weightC*(c(axis)-a(axis))));
+      }
+
+      std::sort(crossings.begin(), crossings.end());
+
+      for (size_t crossing=0; (crossing+1)<crossings.size(); crossing+=2)
+      {
+        //Lattice points along line between the two crossings
+        int firstIndex=std::max((int)std::ceil(((crossings[crossing]-m_shapePosition(axis))/spacing)-0.5), 0);
+        int lastIndex=std::min((int)std::floor(((crossings[crossing+1]-m_shapePosition(axis))/spacing)-0.5), _noSamples-1);
+
+        for (int index=firstIndex; index<=lastIndex; index++)
+        {
+          Eigen::Vector3i latticeIndex;
+          latticeIndex(axis)=index;
+          latticeIndex(axisU)=indexU;
+          latticeIndex(axisV)=indexV;
+
+          //Each lattice point is only on one line per axis, so no two threads write the same vote in a pass
+          noInsideVotes[latticeIndex(0)+(latticeIndex(1)*_noSamples)+(latticeIndex(2)*_noSamples*_noSamples)]+=1;
+        }
+      }
+    }
+  }
+
+  for (int i=0; i<noLatticePoints; i++)
+  {
+    o_isInside[i]=(noInsideVotes[i]>=2);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
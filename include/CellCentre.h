@@ -39,9 +39,10 @@ struct CellCentre
   //----------------------------------------------------------------------------------------------------------------------
   int m_noParticlesContributing;
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief List of interpolation data containing particle pointer and interpolation weights
+  /// @brief Interpolation data containing particle pointer and interpolation weights of the particles affecting cell.
+  /// Points into the interpolation index of the grid and holds m_noParticlesContributing entries
   //----------------------------------------------------------------------------------------------------------------------
-  std::vector<InterpolationData*> m_interpolationData;
+  InterpolationData* m_interpolationData=nullptr;
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Collision state of cell. Is it colliding, empty or interior
   //----------------------------------------------------------------------------------------------------------------------
@@ -30,9 +30,10 @@ struct CellFace
   //----------------------------------------------------------------------------------------------------------------------
   int m_noParticlesContributing;
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief List of interpolation data containing particle pointer and interpolation weights
+  /// @brief Interpolation data containing particle pointer and interpolation weights of the particles affecting cell.
+  /// Points into the interpolation index of the grid and holds m_noParticlesContributing entries
   //----------------------------------------------------------------------------------------------------------------------
-  std::vector<InterpolationData*> m_interpolationData;
+  InterpolationData* m_interpolationData=nullptr;
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Collision state of cell. Is it colliding, empty or interior
   //----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,120 @@
+#ifndef COLLISIONSDF
+#define COLLISIONSDF
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file CollisionSDF.h
+/// @brief Collision object read from an OBJ mesh and voxelized once into a narrow band signed distance field with
+/// gradients. Distances are negative inside the mesh and clamped to +-band width away from the surface. Lookups are
+/// trilinear, so they are cheap enough to do for every particle every step.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class CollisionSDF
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Reads mesh and calculates distances and gradients
+  /// @param [in] _fileName is name of OBJ file. Only v and f lines are used, polygons are split into triangles
+  /// @param [in] _voxelSize is the distance between distance samples
+  /// @param [in] _bandWidth is the distance from the surface that distances are calculated for
+  /// @param [in] _scale is applied to the mesh vertices before _offset
+  /// @param [in] _offset is added to the scaled mesh vertices
+  //----------------------------------------------------------------------------------------------------------------------
+  CollisionSDF(std::string _fileName, float _voxelSize, float _bandWidth, float _scale, Eigen::Vector3f _offset);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Removes field from memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  ~CollisionSDF();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get signed distance at _position. Positions outside the sampled box get the band width
+  //----------------------------------------------------------------------------------------------------------------------
+  float getDistance(const Eigen::Vector3f &_position) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get gradient of signed distance at _position, ie. the outward surface normal near the surface. Positions
+  /// outside the sampled box get zero
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f getGradient(const Eigen::Vector3f &_position) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get whether _position is inside or on the surface of the object
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isInside(const Eigen::Vector3f &_position) const {return getDistance(_position)<=0.0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get lower and upper corner of the mesh bounding box
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const Eigen::Vector3f &getBoundsMin() const {return m_boundsMin;}
+  inline const Eigen::Vector3f &getBoundsMax() const {return m_boundsMax;}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Position of sample (0,0,0)
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f m_origin;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Mesh bounding box
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f m_boundsMin;
+  Eigen::Vector3f m_boundsMax;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Distance between samples and its inverse
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_voxelSize;
+  float m_voxelSizeInverse;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Distance from surface that distances are calculated for
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_bandWidth;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of samples in x, y and z
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_noSamples[3];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Signed distance and its gradient for each sample, x fastest
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_distance;
+  std::vector<Eigen::Vector3f> m_gradient;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory accounted to the memory tracker for the field
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedBytes;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Read vertices and triangles from OBJ file
+  //----------------------------------------------------------------------------------------------------------------------
+  void readObj(std::string _fileName, float _scale, const Eigen::Vector3f &_offset, std::vector<Eigen::Vector3f> &o_vertices, std::vector<Eigen::Vector3i> &o_triangles);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set unsigned distance to the closest triangle for samples within band width of a triangle
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcDistances(const std::vector<Eigen::Vector3f> &_vertices, const std::vector<Eigen::Vector3i> &_triangles);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Make distances negative inside the mesh. Counts crossings of rays along x through each row of samples
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcSigns(const std::vector<Eigen::Vector3f> &_vertices, const std::vector<Eigen::Vector3i> &_triangles);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate normalised central difference gradients of the distances
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcGradients();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Find sample cell and trilinear weights of _position. Returns false if outside sampled box
+  //----------------------------------------------------------------------------------------------------------------------
+  bool getTrilinearWeights(const Eigen::Vector3f &_position, int &o_sampleIndex, float o_weights[3]) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get index of sample _i, _j, _k
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getSampleIndex(int _i, int _j, int _k) const {return _i+(m_noSamples[0]*(_j+(m_noSamples[1]*_k)));}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get distance from _point to triangle _a, _b, _c
+  //----------------------------------------------------------------------------------------------------------------------
+  static float calcPointTriangleDistance(const Eigen::Vector3f &_point, const Eigen::Vector3f &_a, const Eigen::Vector3f &_b, const Eigen::Vector3f &_c);
+
+};
+
+#endif // COLLISIONSDF
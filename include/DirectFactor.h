@@ -0,0 +1,98 @@
+#ifndef DIRECTFACTOR
+#define DIRECTFACTOR
+
+#include <vector>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/SparseCore>
+#include <eigen3/Eigen/SparseCholesky>
+
+struct StencilSystem;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file DirectFactor.h
+/// @brief Sparse LDLT factor of a 7 point stencil system that is kept between solves. Uses the lower triangle of the
+/// system like the other solvers. The symbolic analysis is done once per pattern version, and the numeric
+/// factorisation is only redone when the coefficients have changed by more than a threshold since it was last done.
+/// In between the factor is used as preconditioner for conjugate gradient, which converges in one iteration while the
+/// coefficients are those that were factorised. Meant for small grids where the factor fits in memory.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class DirectFactor
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor
+  //----------------------------------------------------------------------------------------------------------------------
+  DirectFactor();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Removes factor from memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  ~DirectFactor();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Bring factor up to date with the system. The first solve of a new pattern isn't factorised, as the pattern
+  /// changes often while cells melt or move and the analysis would be wasted. If the pattern is the same at the next
+  /// solve it is analysed and factorised. After that the factor is only redone numerically when the largest change of
+  /// a coefficient, relative to the largest coefficient, exceeds _refactorThreshold
+  /// @param [in] _system is the system with its values for this solve
+  /// @param [in] _refactorThreshold is the relative coefficient change that makes the factor be redone
+  /// @return whether the factor can be used for this solve. If not, the system should be solved iteratively
+  //----------------------------------------------------------------------------------------------------------------------
+  bool update(const StencilSystem &_system, float _refactorThreshold);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Apply factor, ie. solve LDL^T z=r
+  //----------------------------------------------------------------------------------------------------------------------
+  void solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of numeric factorisations and number of solves that reused a factor
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoFactorisations() const {return m_noFactorisations;}
+  inline int getNoReuses() const {return m_noReuses;}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Pattern version of the system at the last update, and the version the factor was analysed for
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_seenPatternVersion;
+  int m_analysedPatternVersion;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether the last numeric factorisation succeeded
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isFactorised;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Matrix that is factorised. The system with every diagonal in the pattern, and one on the diagonal of rows
+  /// without a pivot, so rows of cells that leave the interior don't change the pattern
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::SparseMatrix<double> m_factorMatrix;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief System values when the factor was last computed, to measure how much coefficients have changed
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<double> m_factorisedValues;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Symbolic and numeric factorisation
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower> m_LDLT;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Counters of numeric factorisations and reuses
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_noFactorisations;
+  int m_noReuses;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Bytes accounted to the memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedBytes;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set m_factorMatrix from the current system values and factorise it numerically
+  /// @param [in] _system is the system with its values for this solve
+  /// @param [in] _isNewPattern is true if the symbolic analysis must be done first
+  //----------------------------------------------------------------------------------------------------------------------
+  void factorise(const StencilSystem &_system, bool _isNewPattern);
+
+};
+
+#endif // DIRECTFACTOR
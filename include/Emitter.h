@@ -10,7 +10,10 @@
 #include <ngl/Camera.h>
 
 #include "Particle.h"
+#include "CollisionSDF.h"
 #include "AlembicExport.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 /// @file Emitter.h
@@ -40,6 +43,11 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void createParticles(int _noParticles, const std::vector<Eigen::Vector3f> &_particlePositions, const std::vector<float> &_particleMass, const std::vector<float> &_particleTemperature, const std::vector<float> &_particlePhase);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Generate particles from contiguous arrays, eg. memory mapped from a binary particle file.
+  /// Positions are stored as x,y,z for each particle. Temperatures are in Celsius.
+  //----------------------------------------------------------------------------------------------------------------------
+  void createParticles(int _noParticles, const float* _particlePositions, const float* _particleMass, const float* _particleTemperature, const float* _particlePhase);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set material constants
   //----------------------------------------------------------------------------------------------------------------------
   void setStrainConstants(float _lameMuConstant, float _lameLambdaConstant, float _compressionLim, float _stretchLim, float _hardnessCoefficient);
@@ -49,6 +57,24 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void setCollisionObject(float _xMin, float _xMax, float _yMin, float _yMax, float _zMin, float _zMax);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add collision object read from a mesh. Emitter takes ownership and deletes it on destruction
+  //----------------------------------------------------------------------------------------------------------------------
+  void addCollisionObject(CollisionSDF* _collisionObject);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get collision objects read from meshes
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<CollisionSDF*> &getCollisionObjects() const {return m_collisionObjects;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set particle sleeping. Solid particles that are still and cold for a number of steps go to sleep and are
+  /// woken by heat or by grid motion around them
+  /// @param [in] _isSleepingEnabled turns sleeping on or off
+  /// @param [in] _velocityThreshold is the largest particle and surrounding grid speed of a sleeping particle
+  /// @param [in] _deformationThreshold is the largest entry of dt*velGrad of a particle that can go to sleep
+  /// @param [in] _temperatureMargin is how far below transition temperature a sleeping particle has to be
+  /// @param [in] _noStillSteps is the number of still steps in a row before a particle goes to sleep
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSleepParameters(bool _isSleepingEnabled, float _velocityThreshold, float _deformationThreshold, float _temperatureMargin, int _noStillSteps);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set render parameters
   //----------------------------------------------------------------------------------------------------------------------
   void setRenderParameters(std::string _shaderName, float _particleRadius);
@@ -104,6 +130,12 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void presetParticles(float _velocityContribAlpha, float _tempContribBeta);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Print number of solid, liquid and sleeping particles and how many solid and liquid particles were preset
+  /// per second over the presetParticles calls since the last print. Called once per frame, it shows how throughput
+  /// changes as the object melts. Starts the next period
+  //----------------------------------------------------------------------------------------------------------------------
+  void printPhaseThroughput();
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Update particles.
   //----------------------------------------------------------------------------------------------------------------------
   void updateParticles(float _dt);
@@ -181,6 +213,28 @@ private:
   /// @brief List of particles contained by emitter
   //----------------------------------------------------------------------------------------------------------------------
   std::vector<Particle*> m_particles;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Particles split by phase at the start of presetParticles and updateParticles, so each list is handled by
+  /// the kernels specialised for its phase
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Particle*> m_solidParticles;
+  std::vector<Particle*> m_liquidParticles;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Sleeping particles. Kept out of the solid and liquid lists so they skip the preset and update kernels
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Particle*> m_sleepingParticles;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time spent presetting solid and liquid particles, and number of particles preset, since the last
+  /// printPhaseThroughput call
+  //----------------------------------------------------------------------------------------------------------------------
+  double m_solidPresetMilliseconds;
+  double m_liquidPresetMilliseconds;
+  int64_t m_noSolidPresets;
+  int64_t m_noLiquidPresets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory accounted to the memory tracker for particles and the particle list
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedParticleBytes;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Collision object boundaries
@@ -191,6 +245,19 @@ private:
   float m_yMax;
   float m_zMin;
   float m_zMax;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Collision objects read from meshes
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<CollisionSDF*> m_collisionObjects;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Particle sleeping parameters, see setSleepParameters
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isSleepingEnabled;
+  float m_sleepVelocityThreshold;
+  float m_sleepDeformationThreshold;
+  float m_sleepTemperatureMargin;
+  int m_noSleepSteps;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Shader name used to set which shader to use when rendering particles
@@ -201,6 +268,16 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   float m_particleRadius;
 
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Update memory accounted for particle storage after particles are created
+  //----------------------------------------------------------------------------------------------------------------------
+  void trackParticleStorage();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Fill m_solidParticles and m_liquidParticles from the current particle phases, and m_sleepingParticles
+  /// with the particles that are sleeping
+  //----------------------------------------------------------------------------------------------------------------------
+  void splitParticlesByPhase();
+
 };
 
 #endif // EMITTER
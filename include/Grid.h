@@ -12,7 +12,12 @@
 #include "CellCentre.h"
 #include "CellFace.h"
 #include "Emitter.h"
+#include "CollisionSDF.h"
+#include "StencilSystem.h"
+#include "LinearSolver.h"
 #include "MathFunctions.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 /// @file Grid.h
@@ -25,8 +30,7 @@
 /// @done:Staggered grid
 ///
 ///
-/// @todo Reserve memory for interpolation data vectors
-///       Verify particle position in grid
+/// @todo Verify particle position in grid
 ///       Check that particles stored correctly in interp data
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 
@@ -46,6 +50,10 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   static Grid* getGrid();
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Delete instance of grid so a new grid can be created, eg. with a different number of cells
+  //----------------------------------------------------------------------------------------------------------------------
+  static void deleteGrid();
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Destructor
   //----------------------------------------------------------------------------------------------------------------------
   ~Grid();
@@ -65,6 +73,46 @@ public:
   /// Reads in temperatures in celsius and sets them to kelvin for calculations
   //----------------------------------------------------------------------------------------------------------------------
   void setSurroundingTemperatures(float _ambientTemp, float _heatSourceTemp);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set multi-rate heat integration. The heat equation is solved every _noSubsteps velocity steps using the
+  /// accumulated time step. Particle temperatures are left untouched on steps in between.
+  /// @param [in] _noSubsteps is the number of velocity steps per heat solve. 1 solves every step
+  /// @param [in] _isReportingDrift sets whether each heat solve is compared to solving every step
+  //----------------------------------------------------------------------------------------------------------------------
+  void setTemperatureSubsteps(int _noSubsteps, bool _isReportingDrift);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set deterministic mode. Grid to particle transfers are gathered per particle in a fixed order and the
+  /// pressure and heat solves use conjugateGradient_Deterministic, so results are bitwise identical for any number of
+  /// threads. Costs the per particle interpolation lists and a row major copy of each system matrix. Measured with
+  /// 2240 particles and 14^3 cells on one thread a step is 2-9%, about 5% on average, slower than fast mode
+  /// @param [in] _isDeterministic is true for deterministic mode, false for the fast threaded scatters
+  //----------------------------------------------------------------------------------------------------------------------
+  void setDeterministic(bool _isDeterministic);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set whether transfers use the particle stencil cache instead of the cell interpolation lists. Each particle
+  /// stores its 4x4x4 centre and face weights once per step, and particle to grid transfers and the deviatoric force
+  /// are scattered from particles in coloured blocks, so they are the same for any number of threads
+  /// @param [in] _isParticleStencilCache is true for the particle stencil cache, false for the cell lists
+  //----------------------------------------------------------------------------------------------------------------------
+  void setParticleStencilCache(bool _isParticleStencilCache);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set method, iteration cap and tolerance of the pressure, temperature and deviatoric solves. The pressure
+  /// stage solves its test matrix and the deviatoric update dense matrices, neither with the stencil layout, so
+  /// ConjugateGradient_MIC and LDLT_Reuse are only possible for temperature. Other systems asking for them use
+  /// ConjugateGradient and LDLT, as do those asking for GaussSeidel_RedBlack. The matrix free methods solve the 7 point
+  /// pressure system as a StencilOperator, so are only possible for pressure, and change the pressure solve from the
+  /// test matrix to that system
+  /// @param [in] _pressureSolver is used for the pressure solve
+  /// @param [in] _temperatureSolver is used for the temperature solve
+  /// @param [in] _deviatoricSolver is used for the three solves of the implicit deviatoric update
+  //----------------------------------------------------------------------------------------------------------------------
+  void setSolverSettings(const SolverSettings &_pressureSolver, const SolverSettings &_temperatureSolver, const SolverSettings &_deviatoricSolver);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Find which cell faces are inside the collision objects. The objects don't move, so this is done once and
+  /// classifyCells sets the stored faces to colliding every step
+  /// @param [in] _collisionObjects are the collision objects read from meshes
+  //----------------------------------------------------------------------------------------------------------------------
+  void setCollisionObjects(const std::vector<CollisionSDF*> &_collisionObjects);
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Find no of particles in each grid cell. Takes particle in emitter and checks positions against grid cells
@@ -79,6 +127,11 @@ public:
   /// temperature calculations
   //----------------------------------------------------------------------------------------------------------------------
   void update(float _dt, Emitter *_emitter, bool _isFirstStep, float _velocityContribAlpha, float _temperatureContribBeta);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Does one simulation step: presets particles, updates the grid, updates particles and stores the records of
+  /// the linear solves of the step. Used by SimulationController and the scaling benchmark, so both run the same step
+  //----------------------------------------------------------------------------------------------------------------------
+  void simulateStep(float _dt, Emitter *_emitter, bool _isFirstStep, float _velocityContribAlpha, float _temperatureContribBeta);
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Get cell state for visualisation
@@ -179,6 +232,32 @@ private:
   /// @brief B vector for deviatoric velocity calculation
   //----------------------------------------------------------------------------------------------------------------------
   Eigen::VectorXf m_Bvector_deviatoric_Z;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory accounted to the memory tracker for cells and for the deviatoric matrices and vectors
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedGridBytes;
+  int64_t m_trackedDeviatoricBytes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory accounted to the memory tracker for the interpolation data of the current step
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedInterpolationBytes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Pressure and temperature systems. Their patterns are kept while classification is unchanged
+  //----------------------------------------------------------------------------------------------------------------------
+  StencilSystem m_pressureSystem;
+  StencilSystem m_temperatureSystem;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Pressure system as matrix free operator, and the multigrid built from it. Used instead of m_pressureSystem
+  /// by the matrix free solver methods
+  //----------------------------------------------------------------------------------------------------------------------
+  StencilOperator m_pressureOperator;
+  Multigrid m_pressureMultigrid;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solver method, iteration cap and tolerance of each system
+  //----------------------------------------------------------------------------------------------------------------------
+  SolverSettings m_pressureSolver;
+  SolverSettings m_temperatureSolver;
+  SolverSettings m_deviatoricSolver;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Ambient temperature; temperature of the surrounding air. In Kelvin
@@ -197,6 +276,85 @@ private:
   /// @brief Determine whether should use implicit or explicit intergration for deviatoric velocity
   //----------------------------------------------------------------------------------------------------------------------
   float m_isImplictIntegration;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Determine whether the heat equation is solved concurrently with the velocity update. The two only share
+  /// cell data that is read only after classification, so can run at the same time
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isConcurrentTemperature;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of velocity steps per heat equation solve
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_temperatureSubsteps;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of velocity steps taken since last heat equation solve
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_temperatureStepCounter;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time step used by heat equation solve. Accumulated over velocity steps when subcycling
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_temperatureDt;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether heat equation was solved this step, otherwise particle temperatures are kept
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isTemperatureSolved;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether subcycled heat solves are compared to solving with one substep per velocity step
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isReportingTemperatureDrift;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether grid to particle transfers and linear solves are done in a fixed order
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isDeterministic;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Cell of each particle in emitter order, clamped to the grid
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_particleCellIndices;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Particles sorted by cell with a counting sort. Holds emitter indices, and the particles of cell c are
+  /// between m_cellParticleOffsets[c] and [c+1]. Within a cell particles are in emitter order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_sortedParticleIndices;
+  std::vector<int> m_cellParticleOffsets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Cells with non-zero weights for each sorted particle
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<ParticleStencil> m_particleStencils;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Interpolation index from cells to particles. Node n=(4*cellIndex)+faceDirection+1 holds the entries
+  /// between m_interpolationOffsets[n] and [n+1] in increasing sorted particle order. Storage is kept between steps
+  /// and the cell centres and faces point into it
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<InterpolationData> m_interpolationData;
+  std::vector<int> m_interpolationOffsets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Index into m_interpolationData grouped by sorted particle, centres first then X, Y and Z faces, each in
+  /// increasing cell index. Only stored in deterministic mode. Data of sorted particle p is between
+  /// m_particleInterpolationOffsets[p] and [p+1]
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_particleInterpolationData;
+  std::vector<int> m_particleInterpolationOffsets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether transfers use the particle stencil cache instead of the cell interpolation lists
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isParticleStencilCache;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Interpolation weights of each particle, ordered by block. Blocks are 4x4x4 cells and grouped by colour,
+  /// which is the parity of the block along each axis. Particles of block b are between m_blockCacheOffsets[b] and
+  /// [b+1], and blocks of colour c are between m_colourBlockOffsets[c] and [c+1]. A particle only reaches 2 cells out
+  /// of its block, so blocks of the same colour never write to the same cell
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<ParticleStencilCache> m_particleStencilCache;
+  std::vector<int> m_blockCacheOffsets;
+  int m_colourBlockOffsets[9];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Sum of cubic B spline weights of the X, Y and Z faces, scattered with the particle stencil cache
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_faceWeightSums[3];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether the X, Y and Z face of each cell is inside a collision object. Empty if there are no collision
+  /// objects
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<char> m_isFaceInCollisionObject[3];
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Clear list of InterpolationData
@@ -207,9 +365,15 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   void findParticleContributionToCell(Emitter *_emitter);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Sort particles by cell with a counting sort and find the cells each particle has non-zero weights for
+  //----------------------------------------------------------------------------------------------------------------------
+  void sortParticlesByCell(Emitter *_emitter);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Calculate interpolation weights for transitions Particle-Grid and Grid-Particle
+  /// @param [in] _faceDirection is 0, 1 or 2 for x, y and z faces, -1 for cell centre
+  /// @param [out] o_interpolationData gets the particle, weights and cell
   //----------------------------------------------------------------------------------------------------------------------
-  void calcInterpolationWeights(Particle *_particle, int _i, int _j, int _k);
+  void calcInterpolationWeights(Particle *_particle, int _i, int _j, int _k, int _faceDirection, InterpolationData &o_interpolationData);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Transfer particle data to grid
   //----------------------------------------------------------------------------------------------------------------------
@@ -219,10 +383,54 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   void calcInitialParticleVolumes(Emitter* _emitter);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate initial particle volumes by gathering cell contributions per particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcInitialParticleVolumes_Deterministic(Emitter* _emitter);
+
+  //PARTICLE STENCIL CACHE
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Sort particles by cell, order them by block and calculate their cached interpolation weights
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildParticleStencilCache(Emitter* _emitter);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Transfer particle data to grid by scattering from the particle stencil cache
+  //----------------------------------------------------------------------------------------------------------------------
+  void transferParticleData_Cached(Emitter* _emitter);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate initial particle volumes by gathering cell centre masses with the particle stencil cache
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcInitialParticleVolumes_Cached();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Scatter the deviatoric force of each particle to the m_deviatoricForce of the faces in its stencil
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcDeviatoricForce_Cached();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate B component of face from the scattered force and weight sum, same as
+  /// calcBComponent_DeviatoricVelocity
+  //----------------------------------------------------------------------------------------------------------------------
+  float calcBComponent_DeviatoricVelocity_Cached(CellFace *_cellFace, float _weightSum, Eigen::Vector3f _eVector);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get A matrices for deviatoric velocity calculation by adding the contribution of each particle to every
+  /// pair of interior faces in its stencil at most 2 cells apart, then the face masses on the diagonal. Replaces the
+  /// search for common particles in calcAComponent_DeviatoricVelocity
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcAComponents_DeviatoricVelocity_Cached(Eigen::MatrixXf &o_AX, Eigen::MatrixXf &o_AY, Eigen::MatrixXf &o_AZ);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Update particle data from grid by gathering the 4x4x4 centres and faces of each particle
+  //----------------------------------------------------------------------------------------------------------------------
+  void updateParticleFromGrid_Cached(float _velocityContribAlpha, float _tempContribBeta);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Verify whether cell centres and faces are colliding, empty or interior
   /// @todo Change to switch/case statements instead of if statements
   //----------------------------------------------------------------------------------------------------------------------
   void classifyCells();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Rebuild pattern of a 7 point stencil system if a cell has become interior that has no row in it. Rows of
+  /// cells that are no longer interior are kept but set to zero. Values of interior rows are left to be overwritten
+  /// @param [in,out] io_system is the system to check and rebuild
+  /// @return true if the pattern was rebuilt
+  //----------------------------------------------------------------------------------------------------------------------
+  bool updateStencilPattern(StencilSystem &io_system);
 
   //NEW INTERPOLATION AND DEVIATORIC CALC SETUP - 14.08.16
   //----------------------------------------------------------------------------------------------------------------------
@@ -336,9 +544,9 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   Eigen::Matrix3f calculate_dR(const Eigen::Matrix3f &_deltaDeformElastic_Deviatoric, const Eigen::Matrix3f &_R_deformElastic_Deviatoric, const Eigen::Matrix3f &_S_deformElastic_Deviatoric);
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Search list of particles to find same particle in two cells
+  /// @brief Search list of particles to find same particle in two cells. Lists are ordered by sorted particle index
   //----------------------------------------------------------------------------------------------------------------------
-  void searchCellsForCommonParticle(unsigned int _particleId, CellFace* _cellFace, unsigned int &o_particleIndexInFace, bool &o_isFound);
+  void searchCellsForCommonParticle(unsigned int _particleSortedIndex, CellFace* _cellFace, unsigned int &o_particleIndexInFace, bool &o_isFound);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set boundary velocity. Set as stick on collision, ie. zero velocity for colliding faces
   //----------------------------------------------------------------------------------------------------------------------
@@ -359,7 +567,15 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set up A in Ax=B for Poisson equation which solves for pressure
   //----------------------------------------------------------------------------------------------------------------------
-  void calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, Eigen::SparseMatrix<double> &o_A, Eigen::MatrixXf &o_A_test);
+  void calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, StencilSystem &io_system, Eigen::MatrixXf &o_A_test);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set up the row of A of an interior cell in the matrix free operator. Same values as in the stencil system
+  //----------------------------------------------------------------------------------------------------------------------
+  void calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, StencilOperator &io_operator);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate the pressure term on the diagonal of A of an interior cell
+  //----------------------------------------------------------------------------------------------------------------------
+  float calcPressureConstant(int _cellIndex);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Calculate exact volume of cell at boundaries. If not done, then this volume will be too small, and lead to
   /// errors
@@ -375,19 +591,44 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   void calcTemperature();
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solve heat equation for one time step. Only interior cells are set in o_temperature
+  /// @param [in] _dt is the time step to solve for
+  /// @param [in] _temperature is the temperature at the start of the step for all cells
+  /// @param [out] o_temperature is the solution
+  /// @param [out] o_record gets the convergence record of the solve
+  //----------------------------------------------------------------------------------------------------------------------
+  void solveTemperature(float _dt, const Eigen::VectorXd &_temperature, Eigen::VectorXd &o_temperature, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Compare subcycled solution with solving m_temperatureSubsteps smaller steps and print the difference
+  /// @param [in] _temperature is the temperature at the start of the accumulated step
+  /// @param [in] _subcycledTemperature is the solution of one accumulated step
+  //----------------------------------------------------------------------------------------------------------------------
+  void reportTemperatureDrift(const Eigen::VectorXd &_temperature, const Eigen::VectorXd &_subcycledTemperature);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set up B in Ax=B to solve for temperature
   //----------------------------------------------------------------------------------------------------------------------
-  float calcBComponent_temperature(int _cellIndex);
+  float calcBComponent_temperature(int _cellIndex, float _temperature);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set up A in Ax=B to solve for temperature
   //----------------------------------------------------------------------------------------------------------------------
-  void calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, Eigen::SparseMatrix<double> &o_A);
+  void calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, float _dt, StencilSystem &io_system);
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Update particle data from grid
   //----------------------------------------------------------------------------------------------------------------------
   void updateParticleFromGrid(float _velocityContribAlpha, float _tempContribBeta);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Update particle data from grid by gathering cell contributions per particle. Each particle adds them in
+  /// increasing cell order, which is the order of a single threaded updateParticleFromGrid
+  //----------------------------------------------------------------------------------------------------------------------
+  void updateParticleFromGrid_Deterministic(float _velocityContribAlpha, float _tempContribBeta);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Wake sleeping particles that have been heated to within the sleep temperature margin of the transition
+  /// temperature, or where a face of the cell they are in moves faster than the sleep velocity threshold. Face
+  /// velocities come from the particles around the cell, so this catches contact and moving neighbours
+  //----------------------------------------------------------------------------------------------------------------------
+  void wakeParticles(Emitter* _emitter);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Update particle position directly
   //----------------------------------------------------------------------------------------------------------------------
   void updateParticlePositionDirectly(float _velocityContribAlpha, int _cellIndex);
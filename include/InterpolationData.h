@@ -8,11 +8,73 @@
 struct InterpolationData
 {
   Particle* m_particle;
+  int m_particleSortedIndex;  //Position of particle when sorted by cell. Lists of a cell are in increasing order
   float m_cubicBSpline;
   Eigen::Vector3f m_cubicBSpline_Diff;
   float m_cubicBSpline_Integ;
   float m_tightQuadStencil;
   Eigen::Vector3f m_tightQuadStencil_Diff;
+  int m_cellIndex;
+  int m_faceDirection;  //0, 1 or 2 for x, y and z faces, -1 for cell centre
+};
+
+//Cells with non-zero interpolation weights for a particle. Along each axis the weights are non-zero for m_noCells
+//cells starting at m_first. Index [0] is for cell centres, [1] for faces with normal along the axis, which are half a
+//cell lower. _faceDirection is 0, 1 or 2 for x, y and z faces, -1 for cell centre
+struct ParticleStencil
+{
+  int m_first[2][3];
+  int m_noCells[2][3];
+
+  //Number of cell centres or faces in stencil
+  inline int getSize(int _faceDirection) const
+  {
+    return m_noCells[(_faceDirection==0)][0]*m_noCells[(_faceDirection==1)][1]*m_noCells[(_faceDirection==2)][2];
+  }
+
+  //Whether the cell centre or face of cell _i, _j, _k is in stencil
+  inline bool contains(int _faceDirection, int _i, int _j, int _k) const
+  {
+    int i=_i-m_first[(_faceDirection==0)][0];
+    int j=_j-m_first[(_faceDirection==1)][1];
+    int k=_k-m_first[(_faceDirection==2)][2];
+
+    return (i>=0 && i<m_noCells[(_faceDirection==0)][0] &&
+            j>=0 && j<m_noCells[(_faceDirection==1)][1] &&
+            k>=0 && k<m_noCells[(_faceDirection==2)][2]);
+  }
+
+  //Position of cell centre or face of cell _i, _j, _k when the stencil is listed as centres, then X, Y and Z faces,
+  //each with i fastest
+  inline int getPosition(int _faceDirection, int _i, int _j, int _k) const
+  {
+    int position=0;
+    for (int direction=-1; direction<_faceDirection; direction++)
+    {
+      position+=getSize(direction);
+    }
+
+    int i=_i-m_first[(_faceDirection==0)][0];
+    int j=_j-m_first[(_faceDirection==1)][1];
+    int k=_k-m_first[(_faceDirection==2)][2];
+
+    return position+i+(m_noCells[(_faceDirection==0)][0]*(j+(m_noCells[(_faceDirection==1)][1]*k)));
+  }
+};
+
+//Interpolation weights of one particle for the 4x4x4 cell centres and faces around it, used instead of the cell lists
+//when the particle stencil cache is on. Node type t is 0 for cell centres and 1, 2 and 3 for X, Y and Z faces. Node
+//n=a+4*(b+4*c) of type t is cell (m_base[t][0]+a, m_base[t][1]+b, m_base[t][2]+c) and nodes outside the grid have
+//zero weight. Gradients are only stored for faces, index [t-1], as cell centres only use the weights. Each row of 64
+//nodes starts on a cache line so loops over the nodes vectorise
+struct alignas(64) ParticleStencilCache
+{
+  float m_cubicBSpline[4][64];
+  float m_cubicBSpline_Diff[3][3][64];
+  float m_tightQuadStencil[4][64];
+  float m_tightQuadStencil_Diff[3][3][64];
+  int m_base[4][3];
+  Particle* m_particle;
 };
 
 #endif // INTERPOLATIONDATA
@@ -0,0 +1,99 @@
+#ifndef LINEARSOLVER
+#define LINEARSOLVER
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/SparseCore>
+
+#include "StencilSystem.h"
+#include "StencilOperator.h"
+#include "Multigrid.h"
+#include "SolverMetrics.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file LinearSolver.h
+/// @brief Solver backend of the grid systems. Each system has SolverSettings giving the method, iteration cap and
+/// tolerance, read from the parameter file, and is solved through LinearSolver which calls the method in
+/// MathFunctions. Stencil systems can use all methods, other matrices all methods that don't need the stencil layout.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Method and stopping criteria of the solves of one system
+//----------------------------------------------------------------------------------------------------------------------
+struct SolverSettings
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solver methods. Numbers are the values used in the parameter file. LDLT factorises every solve, LDLT_Reuse
+  /// keeps the factor of a stencil system between solves. ConjugateGradient_MixedPrecision iterates in float and
+  /// refines in double. ConjugateGradient_MatrixFree and ConjugateGradient_Multigrid solve a StencilOperator, with
+  /// Jacobi and multigrid preconditioner. GaussSeidel_RedBlack does red-black Gauss-Seidel/SOR sweeps of a stencil
+  /// system from the previous solution, for approximate solves
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Method {ConjugateGradient, ConjugateGradient_MIC, BiCGSTAB, MinRes, LDLT, LDLT_Reuse, ConjugateGradient_MixedPrecision,
+               ConjugateGradient_MatrixFree, ConjugateGradient_Multigrid, GaussSeidel_RedBlack, NoMethods};
+
+  Method m_method;
+  float m_maxLoops;
+  float m_tolerance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Relative coefficient change that makes LDLT_Reuse factorise again
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_refactorThreshold;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief SOR weight of GaussSeidel_RedBlack. 1 is Gauss-Seidel, between 1 and 2 over-relaxes
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_relaxation;
+};
+
+struct LinearSolver
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solve a 7 point stencil system. ConjugateGradient is deterministic in deterministic mode, and
+  /// ConjugateGradient_MIC, LDLT_Reuse and GaussSeidel_RedBlack always are. Rows without a pivot get one on the
+  /// diagonal for LDLT, which leaves them zero as B is zero there. LDLT_Reuse solves with ConjugateGradient when the
+  /// factor can't be used
+  /// @param [in] _settings gives method and stopping criteria
+  /// @param [in] io_system is the system. Keeps the MIC preconditioner, LDLT factor and stencil operator between solves
+  /// @param [in] _noCells is the number of cells along each side of the grid
+  /// @param [in] _isDeterministic is true for results that don't depend on the number of threads
+  /// @param [in] _B is the right hand side. Zero for cells without a row in the system
+  /// @param [in,out] io_x is the solution. GaussSeidel_RedBlack starts from the values it holds, the other methods from
+  /// zero
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void solve(const SolverSettings &_settings, StencilSystem &io_system, int _noCells, bool _isDeterministic, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solve a sparse system without stencil layout. ConjugateGradient_MIC, LDLT_Reuse and GaussSeidel_RedBlack
+  /// are not possible, so must not be set
+  //----------------------------------------------------------------------------------------------------------------------
+  static void solve(const SolverSettings &_settings, const Eigen::SparseMatrix<double> &_A, bool _isDeterministic, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solve a dense system. MinRes uses the dense MINRES starting from io_x, the other methods a sparse copy
+  /// of A starting from zero. ConjugateGradient_MIC and LDLT_Reuse are not possible, so must not be set
+  //----------------------------------------------------------------------------------------------------------------------
+  static void solve(const SolverSettings &_settings, const Eigen::MatrixXf &_A, bool _isDeterministic, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solve a matrix free stencil operator with ConjugateGradient_MatrixFree or ConjugateGradient_Multigrid.
+  /// Both are deterministic
+  /// @param [in] _settings gives method and stopping criteria
+  /// @param [in] _A is the operator of the system
+  /// @param [in] io_multigrid keeps the coarse levels between solves, for ConjugateGradient_Multigrid
+  /// @param [in] _B is the right hand side. Zero for cells without a row in the operator
+  /// @param [out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void solve(const SolverSettings &_settings, const StencilOperator &_A, Multigrid &io_multigrid, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether method solves a StencilOperator rather than a matrix
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool isMatrixFree(SolverSettings::Method _method);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get name of method as used in messages
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char* getMethodName(SolverSettings::Method _method);
+
+};
+
+#endif // LINEARSOLVER
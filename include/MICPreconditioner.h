@@ -0,0 +1,104 @@
+#ifndef MICPRECONDITIONER
+#define MICPRECONDITIONER
+
+#include <vector>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+struct StencilSystem;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file MICPreconditioner.h
+/// @brief Modified incomplete Cholesky, MIC(0), preconditioner for a 7 point stencil system. Uses the lower triangle of
+/// the system like the solvers, so the matrix is symmetric with the coefficients of row c to cells c-1, c-n and c-n^2.
+/// The factor is kept as one value per cell in natural cell order. Cell (i,j,k) only depends on its three lower
+/// neighbours, so the line of cells along x at (j,k) depends on lines (j-1,k) and (j,k-1). The factorisation and
+/// triangular solves are level scheduled over j+k, with the lines of a level done in parallel and the cells of a line
+/// in order, so memory is read along x. Results don't depend on the number of threads.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class MICPreconditioner
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor
+  //----------------------------------------------------------------------------------------------------------------------
+  MICPreconditioner();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Removes arrays from memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  ~MICPreconditioner();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Copy coefficients of the system and calculate the factor. Levels are only rebuilt if the pattern of the
+  /// system has been rebuilt since last call
+  /// @param [in] _system is the system with its values for this solve
+  /// @param [in] _noCells is the number of cells along each side of the grid
+  //----------------------------------------------------------------------------------------------------------------------
+  void compute(const StencilSystem &_system, int _noCells);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Apply preconditioner, ie. solve (D+L)D^-1(D+L)^T z=r by a forward and a backward sweep over the levels.
+  /// Cells without a row in the pattern get z=r
+  //----------------------------------------------------------------------------------------------------------------------
+  void solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Multiply with the symmetric system the preconditioner was computed from, using the copied coefficients.
+  /// Rows of cells without a row in the pattern are left as they are in o_Ap, so should be zero
+  //----------------------------------------------------------------------------------------------------------------------
+  void multiply(const Eigen::VectorXd &_p, Eigen::VectorXd &o_Ap) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of cells with a row in the pattern
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoRows() const {return m_levelCells.size();}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Amount of the dropped fill in that is added back to the diagonal. 0 gives IC(0), 1 full MIC(0)
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double m_tuning=0.97;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief If the modified diagonal falls below this fraction of the system diagonal, the system diagonal is used
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double m_safety=0.25;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Pattern version of the system the levels were built for
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_patternVersion;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Cell index offsets of the x, y and z neighbours
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_offsets[3];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Cells with a row in the pattern, sorted by level j+k and by cell index within a level, so the cells of a
+  /// line are together and in order. Line m has cells m_levelCells[m_lineOffsets[m]] to
+  /// m_levelCells[m_lineOffsets[m+1]-1], and level l has lines m_levelOffsets[l] to m_levelOffsets[l+1]-1
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_levelCells;
+  std::vector<int> m_lineOffsets;
+  std::vector<int> m_levelOffsets;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Diagonal of the system and coefficient to the lower x, y and z neighbour of each cell. Zero for cells
+  /// without a row in the pattern, so the neighbours of a row never have to be checked
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<double> m_diagonal;
+  std::vector<double> m_lower[3];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief 1/sqrt of the factor diagonal of each cell
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<double> m_precon;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Bytes accounted to the memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedBytes;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Build line and level lists from the rows of the pattern
+  //----------------------------------------------------------------------------------------------------------------------
+  void buildLevels(const StencilSystem &_system, int _noCells);
+
+};
+
+#endif // MICPRECONDITIONER
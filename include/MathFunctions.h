@@ -10,11 +10,18 @@
 #include <eigen3/Eigen/Core>
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/IterativeLinearSolvers>
+#include <eigen3/Eigen/SparseCholesky>
 #include <eigen3/Eigen/QR>
 #include <eigen3/Eigen/SVD>
 
 #include <omp.h>
 
+#include "SolverMetrics.h"
+#include "MICPreconditioner.h"
+#include "DirectFactor.h"
+#include "StencilOperator.h"
+#include "Multigrid.h"
+
 
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -77,17 +84,137 @@ struct MathFunctions
   /// @param [in] _maxLoops is the max number of loops the method will do
   /// @param [in] _tolerance is the value below which the function will exit.
   /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
   /// @todo Need to work out how to apply a preconditioner
   //----------------------------------------------------------------------------------------------------------------------
-  static void MinRes(const Eigen::MatrixXf &_A, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, const Eigen::MatrixXf &_preconditioner, float _shift, float _maxLoops, float _tolerance, bool _show);
+  static void MinRes(const Eigen::MatrixXf &_A, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, const Eigen::MatrixXf &_preconditioner, float _shift, float _maxLoops, float _tolerance, bool _show, SolverRecord &o_record);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Solves Ax=B using conjugate gradient method. Only works for square matrix A
   /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
   /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
   /// @param [in] _x0 is a 1 dimensional vector giving the first guess at the solution
   /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Same Jacobi preconditioned conjugate gradient as conjugateGradient, using the lower triangle of A, but with
+  /// threaded matrix-vector products and dot products that sum in a fixed order. Result is bitwise identical for any
+  /// number of threads
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient_Deterministic(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Conjugate gradient in mixed precision. Jacobi preconditioned inner solves run in float over a float copy
+  /// of A, so matrix and vectors take half the memory traffic, and are corrected by iterative refinement with the
+  /// residual of the double system until it meets the same relative tolerance as conjugateGradient. Uses the lower
+  /// triangle of A and sums dot products with deterministicDot, so the result doesn't depend on the number of threads
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param [in] _maxLoops is the max number of inner iterations, over all refinements
+  /// @param [in] _minResidual is the relative residual of the double system to reach
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets inner iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient_MixedPrecision(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Conjugate gradient for a 7 point stencil system preconditioned with MIC(0). Products with A use the
+  /// coefficients copied by the preconditioner, and dot products use deterministicDot, so the result is bitwise
+  /// identical for any number of threads. Stops on the same relative residual as conjugateGradient
+  /// @param [in] _preconditioner has been computed from the system to solve
+  /// @param [in] _B is the right hand side. Must be zero for cells without a row in the system
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient_MIC(const MICPreconditioner &_preconditioner, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Conjugate gradient for a matrix free 7 point operator, preconditioned with a multigrid V-cycle or, without
+  /// multigrid, with Jacobi. Dot products use deterministicDot, so the result is bitwise identical for any number of
+  /// threads. Stops on the same relative residual as conjugateGradient
+  /// @param [in] _A is the operator of the system
+  /// @param [in] io_multigrid is computed for _A and used as preconditioner. nullptr for Jacobi
+  /// @param [in] _B is the right hand side. Must be zero for cells without a row in the operator
+  /// @param [in] io_x is the initial guess if _isWarmStart, and is set to the solution
+  /// @param [in] _isWarmStart is true to start from io_x, false to start from zero
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient_MatrixFree(const StencilOperator &_A, Multigrid *io_multigrid, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, bool _isWarmStart, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Red-black Gauss-Seidel/SOR sweeps for a matrix free 7 point operator, starting from io_x. Cheap per sweep
+  /// and converges fast for diagonally dominant systems, so meant for approximate solves. The residual is checked every
+  /// m_gaussSeidelCheckInterval sweeps and after the last, with the same relative criterion as conjugateGradient.
+  /// Bitwise identical for any number of threads
+  /// @param [in] _A is the operator of the system
+  /// @param [in] _B is the right hand side. Must be zero for cells without a row in the operator
+  /// @param [in] _maxLoops is the max number of sweeps unless _minResidual is met first
+  /// @param [in] _relaxation is the SOR weight, 1 for Gauss-Seidel
+  /// @param [in] io_x is the initial guess and is set to the solution. Cells without a row are left as they are
+  /// @param [out] o_record gets sweeps, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void gaussSeidel_RedBlack(const StencilOperator &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, float _maxLoops, float _minResidual, float _relaxation, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Conjugate gradient preconditioned with a kept LDLT factor of the lower triangle of A. Converges in one
+  /// iteration if the factor is of A, and in a few if it is of a system with slightly different coefficients. Stops on
+  /// the same relative residual as conjugateGradient
+  /// @param [in] _factor has been updated for A
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void conjugateGradient_LDLT(const DirectFactor &_factor, const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solves Ax=B using Eigen's BiCGSTAB with Jacobi preconditioner. Uses all of A, so A doesn't have to be
+  /// symmetric
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _minResidual is met first.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void biConjugateGradientStabilised(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solves Ax=B using Eigen's MINRES without preconditioner, like the dense MinRes. Uses the lower triangle of
+  /// A as a symmetric matrix, which may be indefinite
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param [in] _maxLoops is the max number of loops the method will do unless _tolerance is met first.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets iterations, residuals, time and whether solve converged
+  //----------------------------------------------------------------------------------------------------------------------
+  static void MinRes(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _tolerance, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solves Ax=B with a sparse LDLT factorisation of the lower triangle of A. Every row must have a non zero
+  /// pivot
+  /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
+  /// @param[out] o_x is the solution
+  /// @param [out] o_record gets time and residual. Iterations are zero
+  //----------------------------------------------------------------------------------------------------------------------
+  static void sparseLDLT(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Dot product summed in fixed size blocks. Blocks are summed in parallel, then the block sums are added in
+  /// block order, so the result doesn't depend on the number of threads
+  //----------------------------------------------------------------------------------------------------------------------
+  static double deterministicDot(const Eigen::VectorXd &_a, const Eigen::VectorXd &_b);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Float version of deterministicDot, summed in double
+  //----------------------------------------------------------------------------------------------------------------------
+  static double deterministicDot(const Eigen::VectorXf &_a, const Eigen::VectorXf &_b);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of vector entries in each block of deterministicDot
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr int m_reductionBlockSize=1024;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Residual reduction of each inner float solve of conjugateGradient_MixedPrecision. Float CG can't be
+  /// trusted much further, and the refinement makes up the rest
+  //----------------------------------------------------------------------------------------------------------------------
+  static constexpr double m_innerTolerance=0.0001;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Sweeps of gaussSeidel_RedBlack between residual checks. A check costs about as much as a sweep
   //----------------------------------------------------------------------------------------------------------------------
-  static void conjugateGradient(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual);
+  static const int m_gaussSeidelCheckInterval=4;
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Solves Ax=B for all possible matrices A. Will use a method in Eigen that is slow, so only used for small matrices
   /// @param [in] _A and _B which are a 2 and 1 dimensional matrix respectively.
@@ -0,0 +1,187 @@
+#ifndef MEMORYTRACKER
+#define MEMORYTRACKER
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file MemoryTracker.h
+/// @brief Accounting of memory allocated by each subsystem of the simulation. Owners of large allocations report
+/// them with allocate and release, or with a ScopedAllocation for temporaries. Current and peak usage are stored per
+/// frame together with the resident set size of the process, and written as CSV and JSON summaries.
+/// An estimate from grid and particle counts is used at startup to reject runs that won't fit in memory.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class MemoryTracker
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Subsystems memory is accounted to
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Subsystem {GridFields, Interpolation, ParticleStorage, LinearSystems, ExportBuffers, CollisionObjects, NoSubsystems};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Usage of one finished frame. Peak is the highest usage since the previous frame
+  //----------------------------------------------------------------------------------------------------------------------
+  struct FrameRecord
+  {
+    int m_frameNo;
+    int64_t m_currentBytes[NoSubsystems];
+    int64_t m_peakBytes[NoSubsystems];
+    int64_t m_totalCurrentBytes;
+    int64_t m_totalPeakBytes;
+    int64_t m_residentBytes;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instance of memory tracker, creating it if it doesn't exist
+  //----------------------------------------------------------------------------------------------------------------------
+  static MemoryTracker* instance();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add allocated memory to subsystem. Can be called from several threads at once
+  /// @param [in] _subsystem is the subsystem that allocated
+  /// @param [in] _bytes is the size allocated
+  //----------------------------------------------------------------------------------------------------------------------
+  void allocate(Subsystem _subsystem, int64_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Remove freed memory from subsystem. Can be called from several threads at once
+  /// @param [in] _subsystem is the subsystem that freed memory
+  /// @param [in] _bytes is the size freed
+  //----------------------------------------------------------------------------------------------------------------------
+  void release(Subsystem _subsystem, int64_t _bytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get memory currently accounted to subsystem
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int64_t getCurrentBytes(Subsystem _subsystem) const {return m_currentBytes[_subsystem].load(std::memory_order_relaxed);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Store current and peak usage of the finished frame and start peaks of next frame from current usage
+  /// @param [in] _frameNo is the number of the frame that has finished
+  //----------------------------------------------------------------------------------------------------------------------
+  void endFrame(int _frameNo);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Print usage of last finished frame
+  //----------------------------------------------------------------------------------------------------------------------
+  void printLastFrame();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write one line per frame and subsystem with current and peak usage in MB
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeCSV(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write same data as writeCSV as a JSON array of frames
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeJSON(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get aggregates of finished frames
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<FrameRecord> &getFrames() const {return m_frames;}
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Estimate peak usage of each subsystem for a simulation
+  /// @param [in] _noCells is the number of grid cells along one side, including the outer collision cells
+  /// @param [in] _noParticles is the number of particles
+  /// @param [out] o_bytes gets the estimate for each subsystem
+  //----------------------------------------------------------------------------------------------------------------------
+  static void estimateUsage(int _noCells, int _noParticles, int64_t o_bytes[NoSubsystems]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Print estimate and compare it with the memory limit
+  /// @param [in] _noCells is the number of grid cells along one side, including the outer collision cells
+  /// @param [in] _noParticles is the number of particles
+  /// @param [in] _limitBytes is the memory available to the simulation. If zero or less the physical memory is used
+  /// @return true if estimate fits within the limit
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool checkEstimate(int _noCells, int _noParticles, int64_t _limitBytes);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get physical memory of the machine, or zero if it can't be found
+  //----------------------------------------------------------------------------------------------------------------------
+  static int64_t getPhysicalBytes();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get resident set size of the process, or zero if it can't be found
+  //----------------------------------------------------------------------------------------------------------------------
+  static int64_t getResidentBytes();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get name of subsystem as written to summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char* getSubsystemName(Subsystem _subsystem);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get memory held by an Eigen sparse matrix; values and inner indices as allocated, and outer indices
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename SparseMatrixType>
+  static inline int64_t getSparseMatrixBytes(const SparseMatrixType &_matrix)
+  {
+    return (_matrix.data().allocatedSize()*(sizeof(typename SparseMatrixType::Scalar)+sizeof(typename SparseMatrixType::StorageIndex)))
+           +((_matrix.outerSize()+1)*sizeof(typename SparseMatrixType::StorageIndex));
+  }
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Private as singleton
+  //----------------------------------------------------------------------------------------------------------------------
+  MemoryTracker();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory tracker instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static MemoryTracker* m_instance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory currently allocated by each subsystem
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<int64_t> m_currentBytes[NoSubsystems];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Highest memory allocated by each subsystem in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<int64_t> m_peakBytes[NoSubsystems];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory currently allocated by all subsystems, and highest in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<int64_t> m_totalCurrentBytes;
+  std::atomic<int64_t> m_totalPeakBytes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Usage of finished frames
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<FrameRecord> m_frames;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Raise _peak to _value if _value is higher
+  //----------------------------------------------------------------------------------------------------------------------
+  static void updatePeak(std::atomic<int64_t> &_peak, int64_t _value);
+
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Accounts memory of a temporary for the rest of the enclosing scope
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+class ScopedAllocation
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Adds _bytes to _subsystem
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ScopedAllocation(MemoryTracker::Subsystem _subsystem, int64_t _bytes) : m_subsystem(_subsystem), m_bytes(_bytes)
+  {
+    MemoryTracker::instance()->allocate(m_subsystem, m_bytes);
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Removes the bytes again
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ~ScopedAllocation()
+  {
+    MemoryTracker::instance()->release(m_subsystem, m_bytes);
+  }
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Subsystem and size accounted
+  //----------------------------------------------------------------------------------------------------------------------
+  MemoryTracker::Subsystem m_subsystem;
+  int64_t m_bytes;
+
+};
+
+#endif // MEMORYTRACKER
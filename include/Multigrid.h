@@ -0,0 +1,85 @@
+#ifndef MULTIGRID
+#define MULTIGRID
+
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+#include "StencilOperator.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file Multigrid.h
+/// @brief Geometric multigrid V-cycle over the grid cells, used as preconditioner for conjugate gradient. Coarse
+/// levels halve the number of cells along each side and are built as P^T A P from the StencilOperator of the level
+/// above, where P gives each fine cell the value of its coarse cell. The cycle smooths with red-black Gauss-Seidel
+/// before and after the coarse correction, with the colours in reverse order after, so it is symmetric as conjugate
+/// gradient needs.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class Multigrid
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor
+  //----------------------------------------------------------------------------------------------------------------------
+  Multigrid();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Build coarse levels from the operator to precondition. The operator must be kept unchanged while the
+  /// multigrid is used
+  /// @param [in] _fine is the operator of the system that is solved
+  //----------------------------------------------------------------------------------------------------------------------
+  void compute(const StencilOperator &_fine);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Apply preconditioner, ie. one V-cycle for Az=r starting from z=0
+  //----------------------------------------------------------------------------------------------------------------------
+  void solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of levels, including the finest
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoLevels() const {return m_coarseOperators.size()+1;}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Levels are added until there are no more than this many cells along each side inside the boundary
+  //----------------------------------------------------------------------------------------------------------------------
+  static const int m_coarsestNoCells=4;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Smoothing sweeps before and after the coarse correction, and sweeps on the coarsest level
+  //----------------------------------------------------------------------------------------------------------------------
+  static const int m_noSmoothingSweeps=2;
+  static const int m_noCoarsestSweeps=20;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Operator of the finest level, which is the system that is solved
+  //----------------------------------------------------------------------------------------------------------------------
+  const StencilOperator* m_fineOperator;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Operators of the coarse levels, level l at l-1
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<StencilOperator> m_coarseOperators;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Right hand side, solution and work vector of each level
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Eigen::VectorXd> m_rightHandSides;
+  std::vector<Eigen::VectorXd> m_solutions;
+  std::vector<Eigen::VectorXd> m_products;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get operator of a level
+  //----------------------------------------------------------------------------------------------------------------------
+  const StencilOperator& getOperator(int _level) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief V-cycle on a level for its right hand side, starting from zero. Result is in m_solutions
+  //----------------------------------------------------------------------------------------------------------------------
+  void cycle(int _level);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Red-black Gauss-Seidel sweeps on a level, each starting with the given colour. Cells without a row are
+  /// left as they are
+  //----------------------------------------------------------------------------------------------------------------------
+  void smooth(int _level, int _noSweeps, StencilOperator::Colour _firstColour);
+
+};
+
+#endif // MULTIGRID
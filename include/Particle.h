@@ -23,10 +23,37 @@ enum Phase
 };
 
 class Emitter;
+class CollisionSDF;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Constants used by Particle::updateBatch. Read from the emitter once per step instead of once per particle
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+struct ParticleUpdateConstants
+{
+  float m_dt;
+  float m_xMin;
+  float m_xMax;
+  float m_yMin;
+  float m_yMax;
+  float m_zMin;
+  float m_zMax;
+  float m_transitionTemperature;
+  float m_latentHeat;
+  float m_heatCapacitySolid;
+  float m_heatCapacityFluid;
+  const CollisionSDF* const* m_collisionObjects;
+  int m_noCollisionObjects;
+};
 
 class Particle
 {
 public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Max number of particles in a batch given to updateBatch. Eight floats fill an AVX register
+  //----------------------------------------------------------------------------------------------------------------------
+  static const int m_updateBatchSize=8;
+
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Particle constructor
   //----------------------------------------------------------------------------------------------------------------------
@@ -65,6 +92,15 @@ public:
   /// @brief Get particle phase
   //----------------------------------------------------------------------------------------------------------------------
   inline Phase getPhase(){return m_phase;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get whether particle is sleeping. Sleeping particles keep their deformation and stress, have zero
+  /// velocity and only have their temperature updated
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isSleeping(){return m_isSleeping;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Wake a sleeping particle so it is simulated fully from the next step
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void wake(){m_isSleeping=false; m_noStillSteps=0;}
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Get particle data for grid cell face
@@ -142,6 +178,10 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   inline void addParticleTemperature(float _temperatureContribution){m_temperature+=_temperatureContribution;}
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Resets temperature to that of previous step. Used on steps where the heat equation is not solved
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void keepPreviousTemperature(){m_temperature=m_previousTemperature;}
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Add position contribution from grid
   //----------------------------------------------------------------------------------------------------------------------
   inline void addParticlePosition(Eigen::Vector3f _positionContribution){m_newPosition+=_positionContribution;}
@@ -153,10 +193,42 @@ public:
   //----------------------------------------------------------------------------------------------------------------------
   void presetParticlesForTimeStep(float _velocityContribAlpha, float _tempContribBeta);
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Same as presetParticlesForTimeStep for a particle known to have phase _phase. The liquid version skips
+  /// the singular value and polar decompositions, since its elastic deformation gradient is a scaled identity and its
+  /// lame mu is zero. Instantiated for Phase::Solid and Phase::Liquid
+  //----------------------------------------------------------------------------------------------------------------------
+  template <Phase _phase>
+  void presetForTimeStep(float _velocityContribAlpha, float _tempContribBeta);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Preset a sleeping particle. Only the temperature is reset for the FLIP update, all deformation dependent
+  /// variables keep their values from when the particle went to sleep
+  //----------------------------------------------------------------------------------------------------------------------
+  void presetSleepingForTimeStep(float _tempContribBeta);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Count steps where the particle is a solid with velocity, deformation change and temperature below the
+  /// thresholds, and put it to sleep after _noStillSteps such steps in a row. Any other step resets the count
+  /// @param [in] _dt is the time step
+  /// @param [in] _velocityThreshold is the largest speed of a still particle
+  /// @param [in] _deformationThreshold is the largest entry of dt*velGrad of a still particle
+  /// @param [in] _maxTemperature is the highest temperature of a still particle
+  /// @param [in] _noStillSteps is the number of still steps before the particle goes to sleep
+  //----------------------------------------------------------------------------------------------------------------------
+  void updateSleepState(float _dt, float _velocityThreshold, float _deformationThreshold, float _maxTemperature, int _noStillSteps);
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Update particle. Calls to update velocity, position, temperature and deformation gradient
   /// @param [in] _dt: Time step
   //----------------------------------------------------------------------------------------------------------------------
   void update(float _dt, float _xMin, float _xMax, float _yMin, float _yMax, float _zMin, float _zMax);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Update a batch of particles that all have phase _phase at the start of the update. Gives the same result
+  /// as update, but copies the particle data into batch arrays first so the maths vectorises across particles.
+  /// Instantiated for Phase::Solid and Phase::Liquid
+  /// @param [in] _particles points to the first particle pointer of the batch
+  /// @param [in] _noParticles is the number of particles in the batch, at most m_updateBatchSize
+  /// @param [in] _constants are the time step and emitter constants
+  //----------------------------------------------------------------------------------------------------------------------
+  template <Phase _phase>
+  static void updateBatch(Particle* const* _particles, int _noParticles, const ParticleUpdateConstants &_constants);
 
 private:
   //----------------------------------------------------------------------------------------------------------------------
@@ -263,6 +335,11 @@ private:
   /// @brief Says if particle is solid or liquid.
   //----------------------------------------------------------------------------------------------------------------------
   Phase m_phase;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether particle is sleeping, and the number of still steps in a row while awake
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isSleeping;
+  int m_noStillSteps;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Emitter that particle belongs to
@@ -274,6 +351,11 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   void applyPlasticity();
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Calculate plasticity contribution of a liquid particle, whose elastic deformation gradient is a scaled
+  /// identity, so the clamped singular values are found without a singular value decomposition
+  //----------------------------------------------------------------------------------------------------------------------
+  void applyLiquidPlasticity();
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Calculate differential of elasto-plastic potential energy
   //----------------------------------------------------------------------------------------------------------------------
   void calcPotentialEnergyDiff();
@@ -0,0 +1,85 @@
+#ifndef PERFCOUNTERS
+#define PERFCOUNTERS
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file PerfCounters.h
+/// @brief Optional hardware performance counters read with perf_event_open on linux. Each OpenMP thread gets its own
+/// counter group, and reads sum all groups, so a stage count includes the work of every thread while the stage ran.
+/// If the counters can't be opened, eg. on other platforms, in virtual machines or because of perf_event_paranoid,
+/// the counters are reported as unavailable and nothing else changes.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class PerfCounters
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Counted hardware events. CacheMisses are last level cache misses
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Counter {Cycles, Instructions, CacheMisses, BranchMisses, NoCounters};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instance of counters, creating it if it doesn't exist
+  //----------------------------------------------------------------------------------------------------------------------
+  static PerfCounters* instance();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Open counters on every thread of the OpenMP thread pool. Must be called from outside parallel regions.
+  /// Threads created later, eg. by a larger omp_set_num_threads, are not counted
+  //----------------------------------------------------------------------------------------------------------------------
+  void start();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Close all counters
+  //----------------------------------------------------------------------------------------------------------------------
+  void stop();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get whether counters are open and can be read
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isAvailable() const {return m_isAvailable;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Read counters summed over all threads. Values are scaled up if the kernel had to multiplex the counters.
+  /// Sets all values to zero if the counters are unavailable
+  /// @param [out] o_values is the count of each counter since start
+  //----------------------------------------------------------------------------------------------------------------------
+  void read(uint64_t o_values[NoCounters]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get name of counter as written to summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char* getCounterName(Counter _counter);
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Private as singleton
+  //----------------------------------------------------------------------------------------------------------------------
+  PerfCounters();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Counters instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static PerfCounters* m_instance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether counters were opened on all threads
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isAvailable;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief File descriptor of each counter of each thread. The first counter of a thread is the group leader
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<int>> m_threadFileDescriptors;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Locks m_threadFileDescriptors while threads open their counters
+  //----------------------------------------------------------------------------------------------------------------------
+  std::mutex m_threadFileDescriptorsMutex;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Open counter group of calling thread and add it to the list
+  /// @return Whether all counters could be opened
+  //----------------------------------------------------------------------------------------------------------------------
+  bool openThreadCounters();
+
+};
+
+#endif // PERFCOUNTERS
@@ -0,0 +1,195 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PerfCounters.h"
+#include "TraceRecorder.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file Profiler.h
+/// @brief Per-stage timing of the simulation step. Stages are timed with PROFILE_STAGE, which places a scoped timer
+/// for the rest of the enclosing block. Times are summed per frame and written as CSV and JSON summaries.
+/// Each timed call is also added to the TraceRecorder timeline. If PerfCounters have been started, hardware counts
+/// are summed per stage too. Stages that run concurrently, eg. temperature and velocity, include each other's counts.
+/// Timing is only compiled in when PROFILING is defined, otherwise PROFILE_STAGE expands to nothing.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class Profiler
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Timed stages of a simulation step
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Stage {ClearCellData, FindParticleContribution, TransferParticleData, ClassifyCells, InitialParticleVolumes,
+              DeviatoricVelocity, BoundaryVelocity, ProjectVelocity, Temperature, GridToParticle,
+              PresetParticles, UpdateParticles, ExportParticles, NoStages};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time aggregates of one finished frame
+  //----------------------------------------------------------------------------------------------------------------------
+  struct FrameRecord
+  {
+    int m_frameNo;
+    uint64_t m_calls[NoStages];
+    uint64_t m_totalNanoseconds[NoStages];
+    uint64_t m_maxNanoseconds[NoStages];
+    bool m_hasCounters;
+    uint64_t m_counters[NoStages][PerfCounters::NoCounters];
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instance of profiler, creating it if it doesn't exist
+  //----------------------------------------------------------------------------------------------------------------------
+  static Profiler* instance();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add time spent in a stage to the current frame. Can be called from several threads at once
+  /// @param [in] _stage is the stage that was timed
+  /// @param [in] _nanoseconds is the time spent
+  //----------------------------------------------------------------------------------------------------------------------
+  void addStageTime(Stage _stage, uint64_t _nanoseconds);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add hardware counts of a stage to the current frame. Can be called from several threads at once
+  /// @param [in] _stage is the stage that was counted
+  /// @param [in] _counts is the count of each counter during the stage
+  //----------------------------------------------------------------------------------------------------------------------
+  void addStageCounters(Stage _stage, const uint64_t _counts[PerfCounters::NoCounters]);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Store the current frame aggregates and start a new frame
+  /// @param [in] _frameNo is the number of the frame that has finished
+  //----------------------------------------------------------------------------------------------------------------------
+  void endFrame(int _frameNo);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write one line per frame and stage with calls, total, mean and max time in ms. If hardware counters were
+  /// available, their totals and the instructions per cycle follow
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeCSV(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write same data as writeCSV as a JSON array of frames
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeJSON(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get name of stage as written to summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char* getStageName(Stage _stage);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instructions per cycle of a stage in a frame, or zero if no cycles were counted
+  //----------------------------------------------------------------------------------------------------------------------
+  static double getInstructionsPerCycle(const FrameRecord &_frame, Stage _stage);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get aggregates of finished frames, in order of endFrame calls
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<FrameRecord> &getFrames() const {return m_frames;}
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Private as singleton
+  //----------------------------------------------------------------------------------------------------------------------
+  Profiler();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Profiler instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static Profiler* m_instance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of calls of each stage in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint64_t> m_calls[NoStages];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Total time of each stage in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint64_t> m_totalNanoseconds[NoStages];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Longest single call of each stage in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint64_t> m_maxNanoseconds[NoStages];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Hardware counts of each stage in current frame
+  //----------------------------------------------------------------------------------------------------------------------
+  std::atomic<uint64_t> m_counters[NoStages][PerfCounters::NoCounters];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Aggregates of finished frames
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<FrameRecord> m_frames;
+
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Times the enclosing scope and adds it to the profiler on destruction
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+class ScopedStageTimer
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Reads hardware counters if available, then starts timer
+  /// @param [in] _stage is the stage the scope belongs to
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ScopedStageTimer(Profiler::Stage _stage) : m_stage(_stage), m_isCounting(PerfCounters::instance()->isAvailable())
+  {
+    if (m_isCounting)
+    {
+      PerfCounters::instance()->read(m_startCounts);
+    }
+    m_start=std::chrono::steady_clock::now();
+  }
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Stops timer and records time, trace event and hardware counts
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ~ScopedStageTimer()
+  {
+    std::chrono::steady_clock::time_point end=std::chrono::steady_clock::now();
+
+    if (m_isCounting)
+    {
+      uint64_t counts[PerfCounters::NoCounters];
+      PerfCounters::instance()->read(counts);
+      for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+      {
+        counts[counter]=(counts[counter]>m_startCounts[counter]) ? counts[counter]-m_startCounts[counter] : 0;
+      }
+      Profiler::instance()->addStageCounters(m_stage, counts);
+    }
+
+    Profiler::instance()->addStageTime(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(end-m_start).count());
+    TraceRecorder::instance()->addEvent(Profiler::getStageName(m_stage), "stage", m_start, end, nullptr, 0);
+  }
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Stage being timed
+  //----------------------------------------------------------------------------------------------------------------------
+  Profiler::Stage m_stage;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time at construction
+  //----------------------------------------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_start;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether hardware counters are read, and their values at construction
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isCounting;
+  uint64_t m_startCounts[PerfCounters::NoCounters];
+
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Times rest of enclosing block as stage _stage, eg. PROFILE_STAGE(ClassifyCells);
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+#ifdef PROFILING
+  #define PROFILE_CONCATENATE_INNER(_a, _b) _a##_b
+  #define PROFILE_CONCATENATE(_a, _b) PROFILE_CONCATENATE_INNER(_a, _b)
+  #define PROFILE_STAGE(_stage) ScopedStageTimer PROFILE_CONCATENATE(scopedStageTimer_, __LINE__)(Profiler::_stage)
+#else
+  #define PROFILE_STAGE(_stage)
+#endif
+
+#endif // PROFILER
@@ -0,0 +1,156 @@
+#ifndef READBINARY
+#define READBINARY
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file ReadBinary.h
+/// @brief Reads particle data and simulation parameters from the binary particle format. The file is memory mapped and
+/// the particle arrays are used in place. Also converts geo files to the binary format.
+///
+/// Layout, all values native endian:
+///   BinaryHeader
+///   BinaryParameter x m_noParameters
+///   P           float[3*m_noPoints]   at m_positionOffset
+///   mass        float[m_noPoints]     at m_massOffset
+///   phase       float[m_noPoints]     at m_phaseOffset
+///   temperature float[m_noPoints]     at m_temperatureOffset
+/// Each array starts on a 64 byte boundary.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class ReadBinary
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief File header. Offsets are in bytes from the start of the file
+  //----------------------------------------------------------------------------------------------------------------------
+  struct BinaryHeader
+  {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_noParameters;
+    uint64_t m_noPoints;
+    uint64_t m_positionOffset;
+    uint64_t m_massOffset;
+    uint64_t m_phaseOffset;
+    uint64_t m_temperatureOffset;
+  };
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Simulation parameter entry. m_size is 1 for floats and 3 for vec3s
+  //----------------------------------------------------------------------------------------------------------------------
+  struct BinaryParameter
+  {
+    char m_name[48];
+    uint32_t m_size;
+    float m_value[3];
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Memory maps file with filename _fileName and checks the header
+  /// @param [in] _fileName is name of file to be read
+  //----------------------------------------------------------------------------------------------------------------------
+  ReadBinary(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Unmaps file, so pointers returned by the getters are no longer valid
+  //----------------------------------------------------------------------------------------------------------------------
+  ~ReadBinary();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns number of points in file
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoPoints() const {return m_header->m_noPoints;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns mapped point positions, stored as x,y,z for each point
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float* getPointPositions() const {return getArray(m_header->m_positionOffset);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns mapped point masses
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float* getPointMass() const {return getArray(m_header->m_massOffset);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns mapped point phases, 1 for solid and 0 for liquid
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float* getPointPhase() const {return getArray(m_header->m_phaseOffset);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns mapped point temperatures in Celsius
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float* getPointTemperature() const {return getArray(m_header->m_temperatureOffset);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns a simulation parameter, ie. one for entire file. In this case a float value
+  /// @param [in] _paramName is the name of the parameter to be read
+  //----------------------------------------------------------------------------------------------------------------------
+  float getSimulationParameter_Float(std::string _paramName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns a simulation parameter, ie. one for entire file. In this case a vec3
+  /// @param [in] _paramName is the name of the parameter to be read
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::Vector3f getSimulationParameter_Vec3(std::string _paramName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Checks whether an optional simulation parameter is in the file
+  /// @param [in] _paramName is the name of the parameter to look for
+  //----------------------------------------------------------------------------------------------------------------------
+  bool hasSimulationParameter(std::string _paramName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Checks whether a file starts with the binary particle format identifier
+  /// @param [in] _fileName is name of file to check
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool isBinaryFile(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Reads a geo file and writes its particles and simulation parameters to a binary particle file
+  /// @param [in] _geoFileName is name of geo file to read
+  /// @param [in] _binaryFileName is name of binary file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  static void convertGeo(std::string _geoFileName, std::string _binaryFileName);
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Identifier at start of every binary particle file
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char m_binaryMagic[8];
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Version of layout written by convertGeo
+  //----------------------------------------------------------------------------------------------------------------------
+  static const uint32_t m_binaryVersion=1;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Alignment of arrays in bytes, one cache line
+  //----------------------------------------------------------------------------------------------------------------------
+  static const uint64_t m_binaryAlignment=64;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Start of mapped file
+  //----------------------------------------------------------------------------------------------------------------------
+  const char* m_data;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Size of mapped file in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_size;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Header at start of mapped file
+  //----------------------------------------------------------------------------------------------------------------------
+  const BinaryHeader* m_header;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Parameter table following the header
+  //----------------------------------------------------------------------------------------------------------------------
+  const BinaryParameter* m_parameters;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns float array at _offset bytes into mapped file
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const float* getArray(uint64_t _offset) const {return reinterpret_cast<const float*>(m_data+_offset);}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Finds parameter with name _paramName. Returns nullptr if not found
+  //----------------------------------------------------------------------------------------------------------------------
+  const BinaryParameter* findParameter(std::string _paramName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Rounds _offset up to the next array alignment boundary
+  //----------------------------------------------------------------------------------------------------------------------
+  static uint64_t alignOffset(uint64_t _offset);
+
+};
+
+#endif // READBINARY
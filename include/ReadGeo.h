@@ -2,8 +2,9 @@
 #define READGEO
 
 #include <iostream>
-#include <fstream>
 #include <vector>
+#include <string>
+#include <unordered_map>
 
 #include <eigen3/Eigen/Core>
 
@@ -12,8 +13,9 @@
 //------------------------------------------------------------------------------------------------------------------------------------------------------
 /// @file ReadGeo.h
 /// @brief Reads data from file. Reads point positions, point parameters and overall simulation parameters.
+/// The file is memory mapped and tokenized once on construction, after which all attributes are served from memory.
 /// @author Ina M. Sorensen
-/// @version 2.0
+/// @version 3.0
 /// @date 27.06.16
 ///
 /// @todo
@@ -24,47 +26,95 @@ class ReadGeo
 {
 public:
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Constructor. Opens file with filename _fileName for reading.
+  /// @brief Constructor. Memory maps file with filename _fileName and reads all attributes in a single pass.
   /// @param [in] _fileName is name of file to be read
   //----------------------------------------------------------------------------------------------------------------------
   ReadGeo(std::string _fileName);
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Destructor. Closes file
+  /// @brief Destructor
   //----------------------------------------------------------------------------------------------------------------------
   ~ReadGeo();
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Reads point positions from file and returns them in positionData
-  /// @param [out] Pointer to vector containing position data
+  /// @brief Returns point positions read from file
+  /// @param [out] o_noPoints is the number of points according to the file
+  /// @param [out] o_positionData is the vector containing position data
   //----------------------------------------------------------------------------------------------------------------------
-  void getPointPositions(int o_noPoints, std::vector<Eigen::Vector3f> &o_positionData);
+  void getPointPositions(int &o_noPoints, std::vector<Eigen::Vector3f> &o_positionData);
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Reads a point parameter, ie. a different value for each point.
+  /// @brief Returns a point parameter, ie. a different value for each point.
   /// @param [in] _paramName is the name of the parameter to be read
   /// @param [out] o_data is the vector containing the parameter values
   //----------------------------------------------------------------------------------------------------------------------
   void getPointParameter_Float(std::string _paramName, std::vector<float> &o_data);
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Reads a simulation parameter, ie. one for entire file. In this case a float value
+  /// @brief Returns a simulation parameter, ie. one for entire file. In this case a float value
   /// @param [in] _paramName is the name of the parameter to be read
   //----------------------------------------------------------------------------------------------------------------------
   float getSimulationParameter_Float(std::string _paramName);
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Reads a simulation parameter, ie. one for entire file. In this case a vec3
+  /// @brief Returns a simulation parameter, ie. one for entire file. In this case a vec3
   /// @param [in] _paramName is the name of the parameter to be read
   //----------------------------------------------------------------------------------------------------------------------
   Eigen::Vector3f getSimulationParameter_Vec3(std::string _paramName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Checks whether an optional simulation parameter is in the file
+  /// @param [in] _paramName is the name of the parameter to look for
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool hasSimulationParameter(std::string _paramName) const {return m_globalAttributes.count(_paramName)!=0;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Returns all simulation parameters read from file by name. Used when converting to other formats
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::unordered_map<std::string, std::vector<float>> &getSimulationParameters() const {return m_globalAttributes;}
 
 private:
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Variable which allows the file to be read
+  /// @brief Whether the file was mapped and read successfully
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isRead;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of points according to the "pointcount" entry of the file
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_noPoints;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Point attribute values by name. Tuple attributes such as P are stored flattened
+  //----------------------------------------------------------------------------------------------------------------------
+  std::unordered_map<std::string, std::vector<float>> m_pointAttributes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Global (detail) attribute values by name. Tuple attributes such as gridOrigin are stored flattened
   //----------------------------------------------------------------------------------------------------------------------
-  std::ifstream m_file;
+  std::unordered_map<std::string, std::vector<float>> m_globalAttributes;
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Function to find line of data in file
+  /// @brief Size of data below which values are parsed serially
   //----------------------------------------------------------------------------------------------------------------------
-  void getDataLine(std::string _attributeType, std::string _paramName, std::string _dataType, std::string *o_data);
+  static const size_t m_parallelParseThreshold=65536;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Tokenizes the mapped file once, storing every point and global attribute
+  /// @param [in] _data is the start of the mapped file
+  /// @param [in] _size is the size of the mapped file in bytes
+  //----------------------------------------------------------------------------------------------------------------------
+  void parseFile(const char* _data, size_t _size);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Finds the end of the bracketed data block that starts at _begin, ie. the matching "]"
+  /// @param [in] _begin points to the first character after the opening "["
+  /// @param [in] _end is the end of the mapped file
+  //----------------------------------------------------------------------------------------------------------------------
+  const char* findDataEnd(const char* _begin, const char* _end);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Parses all numbers between _begin and _end, ignoring brackets, commas and whitespace.
+  /// Large blocks are split on value boundaries and parsed in parallel.
+  /// @param [in] _begin is the start of the data block
+  /// @param [in] _end is the end of the data block
+  /// @param [out] o_data is the vector the values are appended to
+  //----------------------------------------------------------------------------------------------------------------------
+  void parseValues(const char* _begin, const char* _end, std::vector<float> &o_data);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Serially parses all numbers between _begin and _end. Used by parseValues for each block or chunk
+  /// @param [in] _begin is the start of the range, which must not split a number
+  /// @param [in] _end is the end of the range, which must not split a number
+  /// @param [out] o_data is the vector the values are appended to
+  //----------------------------------------------------------------------------------------------------------------------
+  void parseValueRange(const char* _begin, const char* _end, std::vector<float> &o_data);
 
 };
 
 #endif // READGEO
-
@@ -6,6 +6,7 @@
 #include "Emitter.h"
 #include "Grid.h"
 #include "ReadGeo.h"
+#include "ReadBinary.h"
 #include "AlembicExport.h"
 
 //------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -216,6 +217,45 @@ private:
   /// @brief Heat source temperature. In celsius
   //----------------------------------------------------------------------------------------------------------------------
   float m_heatSourceTemperature;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of velocity steps per heat equation solve. Optional parameter, 1 if not in file
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_temperatureSubsteps;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether to report drift of subcycled heat solves against solving every step
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isReportingTemperatureDrift;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Memory available to the simulation in MB. Runs estimated to use more are rejected. If zero the physical
+  /// memory is used
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_memoryLimitMB;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether grid transfers and solves run in deterministic mode, see Grid::setDeterministic
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isDeterministic;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether grid transfers use the particle stencil cache, see Grid::setParticleStencilCache
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isParticleStencilCache;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solver method, iteration cap and tolerance of each grid system, see Grid::setSolverSettings
+  //----------------------------------------------------------------------------------------------------------------------
+  SolverSettings m_pressureSolver;
+  SolverSettings m_temperatureSolver;
+  SolverSettings m_deviatoricSolver;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether hardware performance counters are added to the stage timings
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isCountingHardwareEvents;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Particle sleeping parameters, see Emitter::setSleepParameters
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isSleepingEnabled;
+  float m_sleepVelocityThreshold;
+  float m_sleepDeformationThreshold;
+  float m_sleepTemperatureMargin;
+  int m_noSleepSteps;
 
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Transfer constant giving relative FLIP and PIC contribution to velocity
@@ -231,6 +271,19 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   std::string m_readFileName;
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of OBJ file to read a collision object from, and whether to read it
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_collisionObjectFileName;
+  bool m_hasCollisionObject;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Collision object placement and distance field resolution, see CollisionSDF. Zero voxel size or band width
+  /// means half a grid cell and three voxels
+  //----------------------------------------------------------------------------------------------------------------------
+  float m_collisionObjectScale;
+  Eigen::Vector3f m_collisionObjectOffset;
+  float m_collisionObjectVoxelSize;
+  float m_collisionObjectBandWidth;
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set to true if want to export particle data to alembic file
   //----------------------------------------------------------------------------------------------------------------------
   bool m_isExporting;
@@ -239,19 +292,53 @@ private:
   //----------------------------------------------------------------------------------------------------------------------
   std::string m_exportFileName;
   //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of stage timing summaries, without extension. Written as .csv and .json when PROFILING is defined
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_profileFileName;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of solver convergence summaries, without extension. Written with the stage timing summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_solverMetricsFileName;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of Chrome trace-event timeline. Written with the stage timing summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_traceFileName;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of per frame memory usage summaries, without extension. Written as .csv and .json
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_memoryUsageFileName;
+  //----------------------------------------------------------------------------------------------------------------------
   /// @brief Alembic exporter pointer
   //----------------------------------------------------------------------------------------------------------------------
 //  std::unique_ptr <AlembicExport> m_alembicExporter;
   AlembicExport* m_alembicExporter;
 
   //----------------------------------------------------------------------------------------------------------------------
-  /// @brief Read in simulation parameters from geo file
+  /// @brief Read in simulation parameters from geo or binary particle file
+  /// @param [in] _file is the ReadGeo or ReadBinary file, already opened, that holds the parameters
   //----------------------------------------------------------------------------------------------------------------------
-  void readSimulationParameters();
+  template <typename FileType>
+  void readSimulationParameters(FileType* _file);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Read optional solver settings of a system. Parameters are <system>Solver, with the number of a
+  /// SolverSettings::Method, <system>MaxLoops, <system>Tolerance, <system>RefactorThreshold and <system>Relaxation.
+  /// Settings not in the file are left as they are
+  /// @param [in] _file is the ReadGeo or ReadBinary file, already opened, that holds the parameters
+  /// @param [in] _systemName is the start of the parameter names, eg. pressure
+  /// @param [in,out] io_settings are the settings of the system
+  //----------------------------------------------------------------------------------------------------------------------
+  template <typename FileType>
+  void readSolverSettings(FileType* _file, std::string _systemName, SolverSettings &io_settings);
   //----------------------------------------------------------------------------------------------------------------------
   /// @brief Set up particles from emitter by using default values or reading from file.
+  /// @param [in] _file is the geo file, already read, that holds the particle data
+  //----------------------------------------------------------------------------------------------------------------------
+  void setupParticles(ReadGeo* _file);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set up particles from emitter using the arrays mapped from a binary particle file.
+  /// @param [in] _file is the binary particle file holding the particle data
   //----------------------------------------------------------------------------------------------------------------------
-  void setupParticles();
+  void setupParticles(ReadBinary* _file);
 
 
 
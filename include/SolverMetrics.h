@@ -0,0 +1,104 @@
+#ifndef SOLVERMETRICS
+#define SOLVERMETRICS
+
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file SolverMetrics.h
+/// @brief Convergence record of the linear solves in each simulation step. The solvers fill a SolverRecord which is
+/// added for the system it solved, and records are kept per step so tolerances can be tuned and solves that hit the
+/// iteration cap can be found. Written as CSV and JSON summaries.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief Result of one linear solve. Residuals are absolute, ie. ||b-Ax||
+//----------------------------------------------------------------------------------------------------------------------
+struct SolverRecord
+{
+  std::string m_solverName;
+  int m_iterations;
+  int m_maxIterations;
+  double m_tolerance;
+  double m_initialResidual;
+  double m_finalResidual;
+  double m_milliseconds;
+  bool m_isConverged;
+};
+
+class SolverMetrics
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Linear systems solved in a simulation step
+  //----------------------------------------------------------------------------------------------------------------------
+  enum System {Pressure, Temperature, DeviatoricX, DeviatoricY, DeviatoricZ, NoSystems};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solves of one step. m_isSolved is false for systems that weren't solved in the step
+  //----------------------------------------------------------------------------------------------------------------------
+  struct StepRecord
+  {
+    int m_stepNo;
+    bool m_isSolved[NoSystems];
+    SolverRecord m_solves[NoSystems];
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instance of solver metrics, creating it if it doesn't exist
+  //----------------------------------------------------------------------------------------------------------------------
+  static SolverMetrics* instance();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add solve to the current step. Prints a warning if the solve did not converge.
+  /// Different systems can be added from different threads at once, eg. temperature and pressure
+  /// @param [in] _system is the system that was solved
+  /// @param [in] _record is the result from the solver
+  //----------------------------------------------------------------------------------------------------------------------
+  void addSolve(System _system, const SolverRecord &_record);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Store the current step and start a new one
+  //----------------------------------------------------------------------------------------------------------------------
+  void endStep();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write one line per step and solved system
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeCSV(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write same data as writeCSV as a JSON array of steps
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeJSON(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get finished steps
+  //----------------------------------------------------------------------------------------------------------------------
+  inline const std::vector<StepRecord> &getSteps() const {return m_steps;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get name of system as written to summaries
+  //----------------------------------------------------------------------------------------------------------------------
+  static const char* getSystemName(System _system);
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Private as singleton
+  //----------------------------------------------------------------------------------------------------------------------
+  SolverMetrics();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solver metrics instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static SolverMetrics* m_instance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Solves of step currently running
+  //----------------------------------------------------------------------------------------------------------------------
+  StepRecord m_currentStep;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Finished steps
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<StepRecord> m_steps;
+
+};
+
+#endif // SOLVERMETRICS
@@ -0,0 +1,113 @@
+#ifndef STENCILOPERATOR
+#define STENCILOPERATOR
+
+#include <vector>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+
+struct StencilSystem;
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file StencilOperator.h
+/// @brief Matrix free symmetric 7 point operator over the grid cells. Stored as structure of arrays with one diagonal
+/// and one coupling per lower cell face, so (Ax)_c = d_c*x_c - sum over faces f of c of w_f*x_(other cell of f).
+/// Cells without a row have zero diagonal and zero couplings on their faces, so their rows are zero and they never
+/// have to be checked. Cells on the grid boundary are always without a row, so neighbours of other cells are in range.
+/// Used instead of the sparse matrix for the pressure solve, and for the coarse levels of Multigrid. Also smooths with
+/// red-black Gauss-Seidel/SOR: cells with even i+j+k are red and only couple to black cells, so each colour is updated
+/// in parallel and vectorised, and the result doesn't depend on the number of threads.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class StencilOperator
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Colours of the red-black ordering. Red cells have even i+j+k
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Colour {Red, Black};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor
+  //----------------------------------------------------------------------------------------------------------------------
+  StencilOperator();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Removes arrays from memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  ~StencilOperator();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Copying would count the arrays twice in the memory tracker, so move only
+  //----------------------------------------------------------------------------------------------------------------------
+  StencilOperator(const StencilOperator &_other)=delete;
+  StencilOperator& operator=(const StencilOperator &_other)=delete;
+  StencilOperator(StencilOperator &&_other);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set size of the grid and zero all rows. Arrays are only reallocated if the size changes
+  /// @param [in] _noCells is the number of cells along each side of the grid
+  //----------------------------------------------------------------------------------------------------------------------
+  void resize(int _noCells);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set to the lower triangle of a stencil system as a symmetric matrix, which is what the other solvers of the
+  /// system use. Cells without a row in the system, ie. empty and colliding cells, get no row
+  /// @param [in] _system is the stencil system
+  /// @param [in] _noCells is the number of cells along each side of the grid
+  //----------------------------------------------------------------------------------------------------------------------
+  void assign(const StencilSystem &_system, int _noCells);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief y=Ax. Lines along x are done in parallel and vectorised over i. Each row is summed in a fixed order, so
+  /// the result doesn't depend on the number of threads
+  //----------------------------------------------------------------------------------------------------------------------
+  void multiply(const Eigen::VectorXd &_x, Eigen::VectorXd &o_y) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Build the operator of the grid with half as many cells along each side, as P^T A P where P gives each fine
+  /// cell the value of its coarse cell. Coarse cell I holds fine cells 2I-1 and 2I along each direction
+  /// @param [out] o_coarse is set to the coarse operator
+  //----------------------------------------------------------------------------------------------------------------------
+  void coarsen(StencilOperator &o_coarse) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief One red-black Gauss-Seidel/SOR sweep, x_c=(1-w)*x_c+w*(b_c+sum of couplings*neighbour x)/d_c for all cells
+  /// of the first colour, then all cells of the other colour. Cells without a row keep their value, so Dirichlet values
+  /// of cells outside the system are left as they are. A sweep starting with red followed by one starting with black
+  /// is symmetric
+  /// @param [in] _B is the right hand side
+  /// @param [in] io_x is the solution, updated in place
+  /// @param [in] _relaxation is the SOR weight w, 1 for Gauss-Seidel
+  /// @param [in] _firstColour is the colour updated first
+  //----------------------------------------------------------------------------------------------------------------------
+  void smoothRedBlack(const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, double _relaxation, Colour _firstColour) const;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of cells along each side, and in total
+  //----------------------------------------------------------------------------------------------------------------------
+  inline int getNoCells() const {return m_noCells;}
+  inline int getTotNoCells() const {return m_diagonal.size();}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of cells with a row
+  //----------------------------------------------------------------------------------------------------------------------
+  int getNoRows() const;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Diagonal of each cell
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_diagonal;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Coupling over the lower x, y and z face of each cell, ie. to cells c-1, c-n and c-n^2. The matrix entries
+  /// are -w
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<float> m_coupling[3];
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of cells along each side of the grid
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_noCells;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Bytes accounted to the memory tracker
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedBytes;
+
+};
+
+#endif // STENCILOPERATOR
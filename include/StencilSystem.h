@@ -0,0 +1,79 @@
+#ifndef STENCILSYSTEM
+#define STENCILSYSTEM
+
+#include <vector>
+#include <cstdint>
+
+#include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/SparseCore>
+
+#include "MICPreconditioner.h"
+#include "DirectFactor.h"
+#include "StencilOperator.h"
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file StencilSystem.h
+/// @brief Sparse matrix of a 7 point stencil system over the grid cells, kept between steps. Rows are cell indices and
+/// the row of an interior cell holds its diagonal and six neighbours, so the pattern only depends on which cells are
+/// interior. Grid::updateStencilPattern rebuilds the pattern when a cell without a row becomes interior, otherwise
+/// values are written in place through the stored entry positions and rows of cells that have left are zero.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+struct StencilSystem
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Entries of the row of an interior cell
+  //----------------------------------------------------------------------------------------------------------------------
+  enum Entry {Diagonal, Neighbour_i1jk, Neighbour_i_1jk, Neighbour_ij1k, Neighbour_ij_1k, Neighbour_ijk1, Neighbour_ijk_1, NoEntries};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief System matrix. Compressed column major, so can be passed straight to the solvers
+  //----------------------------------------------------------------------------------------------------------------------
+  Eigen::SparseMatrix<double> m_A;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether each cell has a row in the pattern, ie. was interior when the pattern was built
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<char> m_isInterior;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Position in m_A.valuePtr() of each entry, NoEntries per cell. Only set for interior cells
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<int> m_entryPositions;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of times the pattern has been built. Anything derived from the pattern, like a symbolic
+  /// factorisation, is still valid while this is unchanged
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_patternVersion=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of updates that reused the pattern
+  //----------------------------------------------------------------------------------------------------------------------
+  int m_noReuses=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Bytes accounted to the memory tracker for the matrix and pattern
+  //----------------------------------------------------------------------------------------------------------------------
+  int64_t m_trackedBytes=0;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief MIC(0) factor, if the system is solved with ConjugateGradient_MIC
+  //----------------------------------------------------------------------------------------------------------------------
+  MICPreconditioner m_micPreconditioner;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief LDLT factor kept between solves, if the system is solved with LDLT_Reuse
+  //----------------------------------------------------------------------------------------------------------------------
+  DirectFactor m_directFactor;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Lower triangle as matrix free operator, if the system is solved with GaussSeidel_RedBlack
+  //----------------------------------------------------------------------------------------------------------------------
+  StencilOperator m_stencilOperator;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set value of an entry in the row of an interior cell
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setValue(int _cellIndex, Entry _entry, double _value)
+  {
+    m_A.valuePtr()[m_entryPositions[(NoEntries*_cellIndex)+_entry]]=_value;
+  }
+};
+
+#endif // STENCILSYSTEM
@@ -0,0 +1,160 @@
+#ifndef TRACERECORDER
+#define TRACERECORDER
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @file TraceRecorder.h
+/// @brief Per-thread event timeline of the simulation, written in Chrome trace-event JSON format so it can be opened
+/// in Perfetto or chrome://tracing. Events are recorded with TRACE_SCOPE, which places a scoped event for the rest of
+/// the enclosing block. Each thread appends to its own event list, so recording needs no locking.
+/// Recording is only compiled in when PROFILING is defined, otherwise TRACE_SCOPE expands to nothing.
+///
+/// @todo
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+
+class TraceRecorder
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief One finished event. Names must be string literals as only the pointers are stored
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Event
+  {
+    const char* m_name;
+    const char* m_category;
+    uint64_t m_startNanoseconds;
+    uint64_t m_durationNanoseconds;
+    const char* m_argumentName;
+    int64_t m_argumentValue;
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get instance of trace recorder, creating it if it doesn't exist
+  //----------------------------------------------------------------------------------------------------------------------
+  static TraceRecorder* instance();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Set whether events are recorded. Recording is on by default
+  //----------------------------------------------------------------------------------------------------------------------
+  inline void setEnabled(bool _isEnabled) {m_isEnabled=_isEnabled;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get whether events are recorded
+  //----------------------------------------------------------------------------------------------------------------------
+  inline bool isEnabled() const {return m_isEnabled;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Add finished event to the list of the calling thread. Can be called from several threads at once
+  /// @param [in] _name is the name shown on the timeline
+  /// @param [in] _category is the event category, eg. stage, thread or solver
+  /// @param [in] _start and _end are the event times
+  /// @param [in] _argumentName is the name of an integer shown with the event, or nullptr if none
+  /// @param [in] _argumentValue is the value of the integer
+  //----------------------------------------------------------------------------------------------------------------------
+  void addEvent(const char* _name, const char* _category, std::chrono::steady_clock::time_point _start,
+                std::chrono::steady_clock::time_point _end, const char* _argumentName, int64_t _argumentValue);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Write events as a Chrome trace-event JSON file. Must not be called while other threads record.
+  /// The first call creates the file, later calls with the same name append the events recorded since the last call.
+  /// Written events are removed, so memory use and write time only depend on the events of one call interval
+  /// @param [in] _fileName is name of file to write
+  //----------------------------------------------------------------------------------------------------------------------
+  void writeJSON(std::string _fileName);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get number of events recorded by all threads and not yet written
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t getNoEvents();
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Private as singleton
+  //----------------------------------------------------------------------------------------------------------------------
+  TraceRecorder();
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Trace recorder instance
+  //----------------------------------------------------------------------------------------------------------------------
+  static TraceRecorder* m_instance;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Whether events are recorded
+  //----------------------------------------------------------------------------------------------------------------------
+  bool m_isEnabled;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time events are measured from
+  //----------------------------------------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_startTime;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Event lists of each thread that has recorded. The index is used as thread id in the trace
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::vector<Event>*> m_threadEvents;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Locks m_threadEvents when a thread records its first event
+  //----------------------------------------------------------------------------------------------------------------------
+  std::mutex m_threadEventsMutex;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name of the file written by the last call to writeJSON, empty if none
+  //----------------------------------------------------------------------------------------------------------------------
+  std::string m_fileName;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Number of threads whose thread_name metadata event has been written to m_fileName
+  //----------------------------------------------------------------------------------------------------------------------
+  size_t m_noNamedThreads;
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Get event list of calling thread, creating it on first call from the thread
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<Event>* getThreadEvents();
+
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Records the enclosing scope as an event on destruction
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+class ScopedTraceEvent
+{
+public:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Constructor. Starts event
+  /// @param [in] _name is the event name. Must be a string literal
+  /// @param [in] _category is the event category. Must be a string literal
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ScopedTraceEvent(const char* _name, const char* _category) :
+    m_name(_name), m_category(_category), m_start(std::chrono::steady_clock::now()) {}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Destructor. Ends event and records it
+  //----------------------------------------------------------------------------------------------------------------------
+  inline ~ScopedTraceEvent()
+  {
+    TraceRecorder::instance()->addEvent(m_name, m_category, m_start, std::chrono::steady_clock::now(), nullptr, 0);
+  }
+
+private:
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Name and category of event
+  //----------------------------------------------------------------------------------------------------------------------
+  const char* m_name;
+  const char* m_category;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief Time at construction
+  //----------------------------------------------------------------------------------------------------------------------
+  std::chrono::steady_clock::time_point m_start;
+
+};
+
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+/// @brief Records rest of enclosing block as an event, eg. TRACE_SCOPE("ClassifyCells", "thread");
+/// Placed at the top of an omp parallel region with an omp for nowait inside, it shows the work of each thread
+//------------------------------------------------------------------------------------------------------------------------------------------------------
+
+#ifdef PROFILING
+  #define TRACE_CONCATENATE_INNER(_a, _b) _a##_b
+  #define TRACE_CONCATENATE(_a, _b) TRACE_CONCATENATE_INNER(_a, _b)
+  #define TRACE_SCOPE(_name, _category) ScopedTraceEvent TRACE_CONCATENATE(scopedTraceEvent_, __LINE__)(_name, _category)
+#else
+  #define TRACE_SCOPE(_name, _category)
+#endif
+
+#endif // TRACERECORDER
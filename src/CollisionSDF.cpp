@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "CollisionSDF.h"
+#include "MemoryTracker.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CollisionSDF::CollisionSDF(std::string _fileName, float _voxelSize, float _bandWidth, float _scale, Eigen::Vector3f _offset)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Read mesh
+
+  Set up samples covering the mesh bounding box plus band width and one voxel on each side, so the
+  band is never cut off by the sampled box
+
+  Calculate unsigned narrow band distances, then signs, then gradients
+
+  Account field to the memory tracker
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  m_voxelSize=_voxelSize;
+  m_voxelSizeInverse=1.0/_voxelSize;
+  m_bandWidth=_bandWidth;
+  m_trackedBytes=0;
+
+  std::vector<Eigen::Vector3f> vertices;
+  std::vector<Eigen::Vector3i> triangles;
+  readObj(_fileName, _scale, _offset, vertices, triangles);
+
+  m_boundsMin=vertices[0];
+  m_boundsMax=vertices[0];
+  for (const Eigen::Vector3f &vertex : vertices)
+  {
+    m_boundsMin=m_boundsMin.cwiseMin(vertex);
+    m_boundsMax=m_boundsMax.cwiseMax(vertex);
+  }
+
+  float padding=m_bandWidth+m_voxelSize;
+  m_origin=m_boundsMin-Eigen::Vector3f(padding, padding, padding);
+  for (int axis=0; axis<3; axis++)
+  {
+    m_noSamples[axis]=(int)std::ceil((m_boundsMax(axis)-m_boundsMin(axis)+(2.0*padding))*m_voxelSizeInverse)+1;
+  }
+
+  int noSamples=m_noSamples[0]*m_noSamples[1]*m_noSamples[2];
+  m_distance.assign(noSamples, m_bandWidth);
+  m_gradient.assign(noSamples, Eigen::Vector3f::Zero());
+
+  calcDistances(vertices, triangles);
+  calcSigns(vertices, triangles);
+  calcGradients();
+
+  m_trackedBytes=(int64_t)noSamples*(sizeof(float)+sizeof(Eigen::Vector3f));
+  MemoryTracker::instance()->allocate(MemoryTracker::CollisionObjects, m_trackedBytes);
+
+  std::cout<<"Collision object "<<_fileName<<": "<<triangles.size()<<" triangles, "<<m_noSamples[0]<<"x"<<m_noSamples[1]
+           <<"x"<<m_noSamples[2]<<" distance samples\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+CollisionSDF::~CollisionSDF()
+{
+  MemoryTracker::instance()->release(MemoryTracker::CollisionObjects, m_trackedBytes);
+  m_trackedBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void CollisionSDF::readObj(std::string _fileName, float _scale, const Eigen::Vector3f &_offset, std::vector<Eigen::Vector3f> &o_vertices, std::vector<Eigen::Vector3i> &o_triangles)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Read v lines as vertices and f lines as polygons. Face entries may be v, v/vt, v//vn or v/vt/vn,
+  and negative indices count from the last vertex read. Polygons are split into a triangle fan
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::ifstream file(_fileName.c_str());
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open collision object file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::string line;
+  std::vector<int> polygon;
+  while (std::getline(file, line))
+  {
+    std::istringstream lineStream(line);
+    std::string type;
+    lineStream>>type;
+
+    if (type=="v")
+    {
+      Eigen::Vector3f vertex;
+      lineStream>>vertex(0)>>vertex(1)>>vertex(2);
+      o_vertices.push_back((_scale*vertex)+_offset);
+    }
+    else if (type=="f")
+    {
+      polygon.clear();
+      std::string entry;
+      while (lineStream>>entry)
+      {
+        int index=std::atoi(entry.c_str());
+        index=(index<0) ? ((int)o_vertices.size()+index) : (index-1);
+        polygon.push_back(index);
+      }
+
+      for (int corner=2; corner<(int)polygon.size(); corner++)
+      {
+        o_triangles.push_back(Eigen::Vector3i(polygon[0], polygon[corner-1], polygon[corner]));
+      }
+    }
+  }
+
+  //Check that the mesh can be used
+  if (o_vertices.empty() || o_triangles.empty())
+  {
+    std::cout<<"Collision object file "<<_fileName<<" has no triangles\n";
+    exit(EXIT_FAILURE);
+  }
+
+  for (const Eigen::Vector3i &triangle : o_triangles)
+  {
+    if (triangle.minCoeff()<0 || triangle.maxCoeff()>=(int)o_vertices.size())
+    {
+      std::cout<<"Collision object file "<<_fileName<<" has a face with an invalid vertex index\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void CollisionSDF::calcDistances(const std::vector<Eigen::Vector3f> &_vertices, const std::vector<Eigen::Vector3i> &_triangles)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over z slices of samples. Each slice is only written by one thread
+    Loop over triangles whose bounding box grown by band width overlaps the slice
+      Loop over samples of slice inside grown bounding box
+        Keep smallest distance to triangle
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noTriangles=_triangles.size();
+
+#pragma omp parallel for schedule(dynamic)
+  for (int k=0; k<m_noSamples[2]; k++)
+  {
+    float z=m_origin(2)+(k*m_voxelSize);
+
+    for (int triangleIndex=0; triangleIndex<noTriangles; triangleIndex++)
+    {
+      const Eigen::Vector3f &a=_vertices[_triangles[triangleIndex](0)];
+      const Eigen::Vector3f &b=_vertices[_triangles[triangleIndex](1)];
+      const Eigen::Vector3f &c=_vertices[_triangles[triangleIndex](2)];
+
+      Eigen::Vector3f lower=a.cwiseMin(b).cwiseMin(c)-Eigen::Vector3f(m_bandWidth, m_bandWidth, m_bandWidth);
+      Eigen::Vector3f upper=a.cwiseMax(b).cwiseMax(c)+Eigen::Vector3f(m_bandWidth, m_bandWidth, m_bandWidth);
+
+      if (z<lower(2) || z>upper(2))
+      {
+        continue;
+      }
+
+      int iMin=std::max<int>((int)std::ceil((lower(0)-m_origin(0))*m_voxelSizeInverse), 0);
+      int iMax=std::min<int>((int)std::floor((upper(0)-m_origin(0))*m_voxelSizeInverse), m_noSamples[0]-1);
+      int jMin=std::max<int>((int)std::ceil((lower(1)-m_origin(1))*m_voxelSizeInverse), 0);
+      int jMax=std::min<int>((int)std::floor((upper(1)-m_origin(1))*m_voxelSizeInverse), m_noSamples[1]-1);
+
+      for (int j=jMin; j<=jMax; j++)
+      {
+        for (int i=iMin; i<=iMax; i++)
+        {
+          Eigen::Vector3f samplePosition=m_origin+(m_voxelSize*Eigen::Vector3f(i, j, k));
+          float distance=calcPointTriangleDistance(samplePosition, a, b, c);
+
+          int sampleIndex=getSampleIndex(i, j, k);
+          m_distance[sampleIndex]=std::min<float>(m_distance[sampleIndex], distance);
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void CollisionSDF::calcSigns(const std::vector<Eigen::Vector3f> &_vertices, const std::vector<Eigen::Vector3i> &_triangles)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over rows of samples along x
+    Find x of every triangle crossing a ray along x through the row. The ray is moved by a small
+    amount in y and z so it doesn't pass exactly through shared edges and vertices
+    Sort crossings. A sample is inside if an odd number of crossings lie before it
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noTriangles=_triangles.size();
+  float rayShift=1.0e-3*m_voxelSize;
+
+#pragma omp parallel
+  {
+    std::vector<float> crossings;
+
+#pragma omp for schedule(dynamic)
+    for (int row=0; row<(m_noSamples[1]*m_noSamples[2]); row++)
+    {
+      int j=row%m_noSamples[1];
+      int k=row/m_noSamples[1];
+      float y=m_origin(1)+(j*m_voxelSize)+rayShift;
+      float z=m_origin(2)+(k*m_voxelSize)+(0.7*rayShift);
+
+      crossings.clear();
+      for (int triangleIndex=0; triangleIndex<noTriangles; triangleIndex++)
+      {
+        const Eigen::Vector3f &a=_vertices[_triangles[triangleIndex](0)];
+        const Eigen::Vector3f &b=_vertices[_triangles[triangleIndex](1)];
+        const Eigen::Vector3f &c=_vertices[_triangles[triangleIndex](2)];
+
+        if (y<std::min({a(1), b(1), c(1)}) || y>std::max({a(1), b(1), c(1)}) || z<std::min({a(2), b(2), c(2)}) || z>std::max({a(2), b(2), c(2)}))
+        {
+          continue;
+        }
+
+        //Barycentric coordinates of ray in the yz projection of the triangle
+        float area=((b(1)-a(1))*(c(2)-a(2)))-((c(1)-a(1))*(b(2)-a(2)));
+        if (area==0.0)
+        {
+          continue;
+        }
+        float weightB=(((y-a(1))*(c(2)-a(2)))-((c(1)-a(1))*(z-a(2))))/area;
+        float weightC=(((b(1)-a(1))*(z-a(2)))-((y-a(1))*(b(2)-a(2))))/area;
+        float weightA=1.0-weightB-weightC;
+
+        if (weightA>=0.0 && weightB>=0.0 && weightC>=0.0)
+        {
+          crossings.push_back((weightA*a(0))+(weightB*b(0))+(weightC*c(0)));
+        }
+      }
+
+      std::sort(crossings.begin(), crossings.end());
+
+      int noCrossingsBefore=0;
+      for (int i=0; i<m_noSamples[0]; i++)
+      {
+        float x=m_origin(0)+(i*m_voxelSize);
+        while (noCrossingsBefore<(int)crossings.size() && crossings[noCrossingsBefore]<x)
+        {
+          noCrossingsBefore++;
+        }
+
+        if ((noCrossingsBefore%2)==1)
+        {
+          int sampleIndex=getSampleIndex(i, j, k);
+          m_distance[sampleIndex]=-m_distance[sampleIndex];
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void CollisionSDF::calcGradients()
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Central differences inside the sampled box and one sided differences on its sides. Normalised where
+  non-zero, so the gradient is the outward normal of the closest surface
+  ------------------------------------------------------------------------------------------------------
+  */
+
+#pragma omp parallel for
+  for (int k=0; k<m_noSamples[2]; k++)
+  {
+    for (int j=0; j<m_noSamples[1]; j++)
+    {
+      for (int i=0; i<m_noSamples[0]; i++)
+      {
+        int index[3]={i, j, k};
+        Eigen::Vector3f gradient;
+
+        for (int axis=0; axis<3; axis++)
+        {
+          int lowerIndex[3]={i, j, k};
+          int upperIndex[3]={i, j, k};
+          lowerIndex[axis]=std::max<int>(index[axis]-1, 0);
+          upperIndex[axis]=std::min<int>(index[axis]+1, m_noSamples[axis]-1);
+
+          float lowerDistance=m_distance[getSampleIndex(lowerIndex[0], lowerIndex[1], lowerIndex[2])];
+          float upperDistance=m_distance[getSampleIndex(upperIndex[0], upperIndex[1], upperIndex[2])];
+          gradient(axis)=(upperDistance-lowerDistance)/((upperIndex[axis]-lowerIndex[axis])*m_voxelSize);
+        }
+
+        float gradientNorm=gradient.norm();
+        if (gradientNorm>0.0)
+        {
+          gradient*=(1.0/gradientNorm);
+        }
+
+        m_gradient[getSampleIndex(i, j, k)]=gradient;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool CollisionSDF::getTrilinearWeights(const Eigen::Vector3f &_position, int &o_sampleIndex, float o_weights[3]) const
+{
+  int index[3];
+  for (int axis=0; axis<3; axis++)
+  {
+    float samplePosition=(_position(axis)-m_origin(axis))*m_voxelSizeInverse;
+    if (!(samplePosition>=0.0 && samplePosition<(m_noSamples[axis]-1)))
+    {
+      return false;
+    }
+
+    index[axis]=(int)samplePosition;
+    o_weights[axis]=samplePosition-index[axis];
+  }
+
+  o_sampleIndex=getSampleIndex(index[0], index[1], index[2]);
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float CollisionSDF::getDistance(const Eigen::Vector3f &_position) const
+{
+  int sampleIndex;
+  float weights[3];
+  if (!getTrilinearWeights(_position, sampleIndex, weights))
+  {
+    return m_bandWidth;
+  }
+
+  int strideY=m_noSamples[0];
+  int strideZ=m_noSamples[0]*m_noSamples[1];
+  const float* distance=&m_distance[sampleIndex];
+
+  float x00=distance[0]+(weights[0]*(distance[1]-distance[0]));
+  float x10=distance[strideY]+(weights[0]*(distance[strideY+1]-distance[strideY]));
+  float x01=distance[strideZ]+(weights[0]*(distance[strideZ+1]-distance[strideZ]));
+  float x11=distance[strideZ+strideY]+(weights[0]*(distance[strideZ+strideY+1]-distance[strideZ+strideY]));
+
+  float y0=x00+(weights[1]*(x10-x00));
+  float y1=x01+(weights[1]*(x11-x01));
+
+  return y0+(weights[2]*(y1-y0));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Eigen::Vector3f CollisionSDF::getGradient(const Eigen::Vector3f &_position) const
+{
+  int sampleIndex;
+  float weights[3];
+  if (!getTrilinearWeights(_position, sampleIndex, weights))
+  {
+    return Eigen::Vector3f::Zero();
+  }
+
+  int strideY=m_noSamples[0];
+  int strideZ=m_noSamples[0]*m_noSamples[1];
+  const Eigen::Vector3f* gradient=&m_gradient[sampleIndex];
+
+  Eigen::Vector3f x00=gradient[0]+(weights[0]*(gradient[1]-gradient[0]));
+  Eigen::Vector3f x10=gradient[strideY]+(weights[0]*(gradient[strideY+1]-gradient[strideY]));
+  Eigen::Vector3f x01=gradient[strideZ]+(weights[0]*(gradient[strideZ+1]-gradient[strideZ]));
+  Eigen::Vector3f x11=gradient[strideZ+strideY]+(weights[0]*(gradient[strideZ+strideY+1]-gradient[strideZ+strideY]));
+
+  Eigen::Vector3f y0=x00+(weights[1]*(x10-x00));
+  Eigen::Vector3f y1=x01+(weights[1]*(x11-x01));
+
+  return y0+(weights[2]*(y1-y0));
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float CollisionSDF::calcPointTriangleDistance(const Eigen::Vector3f &_point, const Eigen::Vector3f &_a, const Eigen::Vector3f &_b, const Eigen::Vector3f &_c)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Find closest point on triangle by checking which vertex, edge or face region _point projects to,
+  then return distance to it
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  Eigen::Vector3f ab=_b-_a;
+  Eigen::Vector3f ac=_c-_a;
+  Eigen::Vector3f ap=_point-_a;
+
+  //Vertex region a
+  float d1=ab.dot(ap);
+  float d2=ac.dot(ap);
+  if (d1<=0.0 && d2<=0.0)
+  {
+    return ap.norm();
+  }
+
+  //Vertex region b
+  Eigen::Vector3f bp=_point-_b;
+  float d3=ab.dot(bp);
+  float d4=ac.dot(bp);
+  if (d3>=0.0 && d4<=d3)
+  {
+    return bp.norm();
+  }
+
+  //Edge region ab
+  float vc=(d1*d4)-(d3*d2);
+  if (vc<=0.0 && d1>=0.0 && d3<=0.0)
+  {
+    float v=d1/(d1-d3);
+    return (_point-(_a+(v*ab))).norm();
+  }
+
+  //Vertex region c
+  Eigen::Vector3f cp=_point-_c;
+  float d5=ab.dot(cp);
+  float d6=ac.dot(cp);
+  if (d6>=0.0 && d5<=d6)
+  {
+    return cp.norm();
+  }
+
+  //Edge region ac
+  float vb=(d5*d2)-(d1*d6);
+  if (vb<=0.0 && d2>=0.0 && d6<=0.0)
+  {
+    float w=d2/(d2-d6);
+    return (_point-(_a+(w*ac))).norm();
+  }
+
+  //Edge region bc
+  float va=(d3*d6)-(d5*d4);
+  if (va<=0.0 && (d4-d3)>=0.0 && (d5-d6)>=0.0)
+  {
+    float w=(d4-d3)/((d4-d3)+(d5-d6));
+    return (_point-(_b+(w*(_c-_b)))).norm();
+  }
+
+  //Face region
+  float denominator=1.0/(va+vb+vc);
+  float v=vb*denominator;
+  float w=vc*denominator;
+  return (_point-(_a+(v*ab)+(w*ac))).norm();
+}
@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "DirectFactor.h"
+#include "StencilSystem.h"
+#include "MemoryTracker.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+DirectFactor::DirectFactor()
+{
+  m_seenPatternVersion=-1;
+  m_analysedPatternVersion=-1;
+  m_isFactorised=false;
+  m_noFactorisations=0;
+  m_noReuses=0;
+  m_trackedBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+DirectFactor::~DirectFactor()
+{
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool DirectFactor::update(const StencilSystem &_system, float _refactorThreshold)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  New pattern: remember it and don't use the factor, so the solve is iterative
+
+  Same pattern as last solve but not analysed: analyse and factorise
+
+  Otherwise find largest change of a coefficient since the factorisation, and the largest factorised
+  coefficient. Factorise if the relative change is above the threshold, else reuse
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  if (_system.m_patternVersion!=m_seenPatternVersion)
+  {
+    m_seenPatternVersion=_system.m_patternVersion;
+    return false;
+  }
+
+  if (m_analysedPatternVersion!=m_seenPatternVersion)
+  {
+    factorise(_system, true);
+    m_analysedPatternVersion=m_seenPatternVersion;
+    return m_isFactorised;
+  }
+
+  int noValues=_system.m_A.nonZeros();
+  const double* values=_system.m_A.valuePtr();
+  double maxChange=0.0;
+  double maxValue=0.0;
+
+#pragma omp parallel for reduction(max:maxChange,maxValue)
+  for (int position=0; position<noValues; position++)
+  {
+    maxChange=std::max(maxChange, std::abs(values[position]-m_factorisedValues[position]));
+    maxValue=std::max(maxValue, std::abs(m_factorisedValues[position]));
+  }
+
+  if (!m_isFactorised || maxChange>(_refactorThreshold*maxValue))
+  {
+    factorise(_system, false);
+  }
+  else
+  {
+    m_noReuses+=1;
+  }
+
+  return m_isFactorised;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void DirectFactor::factorise(const StencilSystem &_system, bool _isNewPattern)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Add a diagonal entry to every row, one where the system diagonal is zero and zero elsewhere. The sum
+  keeps explicit zeros, so the pattern of the factorised matrix only depends on the system pattern
+
+  Analyse pattern if new, factorise numerically and keep the factorised values
+
+  Update memory tracker with the factor
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noRows=_system.m_A.rows();
+  Eigen::VectorXd diagonal=_system.m_A.diagonal();
+
+  std::vector<Eigen::Triplet<double>> pivots;
+  pivots.reserve(noRows);
+  for (int row=0; row<noRows; row++)
+  {
+    pivots.push_back(Eigen::Triplet<double>(row, row, (diagonal(row)==0.0) ? 1.0 : 0.0));
+  }
+
+  Eigen::SparseMatrix<double> emptyRows(noRows, noRows);
+  emptyRows.setFromTriplets(pivots.begin(), pivots.end());
+
+  m_factorMatrix=_system.m_A+emptyRows;
+
+  if (_isNewPattern)
+  {
+    m_LDLT.analyzePattern(m_factorMatrix);
+  }
+  m_LDLT.factorize(m_factorMatrix);
+
+  m_isFactorised=(m_LDLT.info()==Eigen::Success);
+  if (!m_isFactorised)
+  {
+    std::cout<<"LDLT factorisation failed, solving iteratively\n";
+  }
+
+  m_factorisedValues.assign(_system.m_A.valuePtr(), _system.m_A.valuePtr()+_system.m_A.nonZeros());
+  m_noFactorisations+=1;
+
+  int64_t bytes=MemoryTracker::getSparseMatrixBytes(m_factorMatrix)
+                +MemoryTracker::getSparseMatrixBytes(m_LDLT.matrixL().nestedExpression())
+                +(m_factorisedValues.capacity()*sizeof(double));
+
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+  m_trackedBytes=bytes;
+  MemoryTracker::instance()->allocate(MemoryTracker::LinearSystems, m_trackedBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void DirectFactor::solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z) const
+{
+  o_z=m_LDLT.solve(_residual);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
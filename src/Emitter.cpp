@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+
 #include <ngl/Transformation.h>
 #include <ngl/ShaderLib.h>
 #include <ngl/VAOPrimitives.h>
@@ -19,6 +22,11 @@ Emitter::Emitter()
   */
 
   m_noParticles=0;
+  m_trackedParticleBytes=0;
+  m_solidPresetMilliseconds=0.0;
+  m_liquidPresetMilliseconds=0.0;
+  m_noSolidPresets=0;
+  m_noLiquidPresets=0;
 
   m_lameMuConstant=0.0;
   m_lameLambdaConstant=0.0;
@@ -39,6 +47,12 @@ Emitter::Emitter()
   m_zMin=0.0;
   m_zMax=0.0;
 
+  m_isSleepingEnabled=false;
+  m_sleepVelocityThreshold=0.0;
+  m_sleepDeformationThreshold=0.0;
+  m_sleepTemperatureMargin=0.0;
+  m_noSleepSteps=0;
+
   m_particleShaderName="";
   m_particleRadius=0.0;
 
@@ -73,6 +87,15 @@ Emitter::~Emitter()
   //Clear vector
   m_particles.clear();
 
+  for (CollisionSDF* collisionObject : m_collisionObjects)
+  {
+    delete collisionObject;
+  }
+  m_collisionObjects.clear();
+
+  MemoryTracker::instance()->release(MemoryTracker::ParticleStorage, m_trackedParticleBytes);
+  m_trackedParticleBytes=0;
+
   std::cout<<"Deleting emitter\n";
 }
 
@@ -99,6 +122,60 @@ void Emitter::createParticles(int _noParticles, const std::vector<Eigen::Vector3
     Particle* particle=new Particle(i, position, mass, temperature, solid, m_latentHeat, this);
     m_particles.push_back(particle);
   }
+
+  trackParticleStorage();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Emitter::createParticles(int _noParticles, const float *_particlePositions, const float *_particleMass, const float *_particleTemperature, const float *_particlePhase)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Generates particles straight from arrays without copying them into vectors first.
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  m_noParticles=_noParticles;
+
+  m_particles.reserve(m_particles.size()+m_noParticles);
+
+  //Create particles
+  for (int i=0; i<m_noParticles; i++)
+  {
+    Eigen::Vector3f position(_particlePositions[3*i], _particlePositions[(3*i)+1], _particlePositions[(3*i)+2]);
+    float mass=_particleMass[i];
+    float temperature=_particleTemperature[i]+273.0;  //Add 273 as temperature in Kelvin whereas read in is in Celsius
+    bool solid=_particlePhase[i];
+
+    Particle* particle=new Particle(i, position, mass, temperature, solid, m_latentHeat, this);
+    m_particles.push_back(particle);
+  }
+
+  trackParticleStorage();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Emitter::trackParticleStorage()
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Reserve the phase lists used by updateParticles so they are never reallocated during the simulation
+
+  Replace the memory accounted for particles with the current particles and list capacities
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  m_solidParticles.reserve(m_particles.size());
+  m_liquidParticles.reserve(m_particles.size());
+  m_sleepingParticles.reserve(m_particles.size());
+
+  int64_t listCapacity=m_particles.capacity()+m_solidParticles.capacity()+m_liquidParticles.capacity()+m_sleepingParticles.capacity();
+  int64_t particleBytes=((int64_t)m_particles.size()*sizeof(Particle))+(listCapacity*sizeof(Particle*));
+
+  MemoryTracker::instance()->allocate(MemoryTracker::ParticleStorage, particleBytes-m_trackedParticleBytes);
+  m_trackedParticleBytes=particleBytes;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -151,6 +228,33 @@ void Emitter::setCollisionObject(float _xMin, float _xMax, float _yMin, float _y
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Emitter::addCollisionObject(CollisionSDF *_collisionObject)
+{
+  m_collisionObjects.push_back(_collisionObject);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Emitter::setSleepParameters(bool _isSleepingEnabled, float _velocityThreshold, float _deformationThreshold, float _temperatureMargin, int _noStillSteps)
+{
+  m_isSleepingEnabled=_isSleepingEnabled;
+  m_sleepVelocityThreshold=_velocityThreshold;
+  m_sleepDeformationThreshold=_deformationThreshold;
+  m_sleepTemperatureMargin=_temperatureMargin;
+  m_noSleepSteps=_noStillSteps;
+
+  //Wake all particles if sleeping is turned off
+  if (!m_isSleepingEnabled)
+  {
+    for (int i=0; i<m_noParticles; i++)
+    {
+      m_particles[i]->wake();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Emitter::setRenderParameters(std::string _shaderName, float _particleRadius)
 {
   /* Outline
@@ -169,25 +273,186 @@ void Emitter::presetParticles(float _velocityContribAlpha, float _tempContribBet
 {
   /* Outline
   ------------------------------------------------------------------------------------------------------
-  Calls particle preset for all particles
+  Split particles by phase, then preset solid and liquid particles with the preset specialised for each
+  phase. Each list is timed separately for the throughput report
+
+  Sleeping particles only get their temperature reset
   ------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(PresetParticles);
+
+  splitParticlesByPhase();
+
+  int noSolidParticles=m_solidParticles.size();
+  int noLiquidParticles=m_liquidParticles.size();
+  int noSleepingParticles=m_sleepingParticles.size();
+
 #pragma omp parallel for
-  for (int i=0; i<m_noParticles; ++i)
+  for (int i=0; i<noSleepingParticles; ++i)
+  {
+    m_sleepingParticles[i]->presetSleepingForTimeStep(_tempContribBeta);
+  }
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("PresetSolidParticles", "thread");
+
+#pragma omp for
+    for (int i=0; i<noSolidParticles; ++i)
+    {
+      m_solidParticles[i]->presetForTimeStep<Phase::Solid>(_velocityContribAlpha, _tempContribBeta);
+    }
+  }
+
+  std::chrono::steady_clock::time_point solidEndTime=std::chrono::steady_clock::now();
+
+#pragma omp parallel
   {
-    m_particles[i]->presetParticlesForTimeStep(_velocityContribAlpha, _tempContribBeta);
+    TRACE_SCOPE("PresetLiquidParticles", "thread");
+
+#pragma omp for
+    for (int i=0; i<noLiquidParticles; ++i)
+    {
+      m_liquidParticles[i]->presetForTimeStep<Phase::Liquid>(_velocityContribAlpha, _tempContribBeta);
+    }
   }
+
+  std::chrono::steady_clock::time_point liquidEndTime=std::chrono::steady_clock::now();
+
+  m_solidPresetMilliseconds+=std::chrono::duration<double, std::milli>(solidEndTime-startTime).count();
+  m_liquidPresetMilliseconds+=std::chrono::duration<double, std::milli>(liquidEndTime-solidEndTime).count();
+  m_noSolidPresets+=noSolidParticles;
+  m_noLiquidPresets+=noLiquidParticles;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Emitter::updateParticles(float _dt)
+void Emitter::printPhaseThroughput()
 {
-#pragma omp parallel for
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Print particle count, liquid fraction and particles preset per second for each phase since last print
+
+  Reset preset times and counts for the next period
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noSolidParticles=m_solidParticles.size();
+  int noLiquidParticles=m_liquidParticles.size();
+  int noSleepingParticles=m_sleepingParticles.size();
+  float liquidFraction=(m_noParticles>0) ? ((float)noLiquidParticles/(float)m_noParticles) : 0.0;
+
+  double solidThroughput=(m_solidPresetMilliseconds>0.0) ? (m_noSolidPresets/(m_solidPresetMilliseconds/1000.0)) : 0.0;
+  double liquidThroughput=(m_liquidPresetMilliseconds>0.0) ? (m_noLiquidPresets/(m_liquidPresetMilliseconds/1000.0)) : 0.0;
+
+  std::cout<<"Particle preset: "<<noSolidParticles<<" solid at "<<solidThroughput<<" particles/s, "
+           <<noLiquidParticles<<" liquid at "<<liquidThroughput<<" particles/s, "<<noSleepingParticles<<" sleeping, liquid fraction "
+           <<liquidFraction<<"\n";
+
+  m_solidPresetMilliseconds=0.0;
+  m_liquidPresetMilliseconds=0.0;
+  m_noSolidPresets=0;
+  m_noLiquidPresets=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Emitter::splitParticlesByPhase()
+{
+  m_solidParticles.clear();
+  m_liquidParticles.clear();
+  m_sleepingParticles.clear();
   for (int i=0; i<m_noParticles; i++)
   {
-    m_particles[i]->update(_dt, m_xMin, m_xMax, m_yMin, m_yMax, m_zMin, m_zMax);
+    if (m_particles[i]->isSleeping())
+    {
+      m_sleepingParticles.push_back(m_particles[i]);
+    }
+    else if (m_particles[i]->getPhase()==Phase::Solid)
+    {
+      m_solidParticles.push_back(m_particles[i]);
+    }
+    else
+    {
+      m_liquidParticles.push_back(m_particles[i]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Emitter::updateParticles(float _dt)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Read constants once for all particles
+
+  Split particles into solid and liquid lists, then update each list in batches of
+  Particle::m_updateBatchSize using the batch update specialised for that phase. Sleeping particles
+  are not updated
+
+  If sleeping is enabled, check which of the particles that were solid at the start of the update can
+  go to sleep
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  PROFILE_STAGE(UpdateParticles);
+
+  ParticleUpdateConstants constants;
+  constants.m_dt=_dt;
+  constants.m_xMin=m_xMin;
+  constants.m_xMax=m_xMax;
+  constants.m_yMin=m_yMin;
+  constants.m_yMax=m_yMax;
+  constants.m_zMin=m_zMin;
+  constants.m_zMax=m_zMax;
+  constants.m_transitionTemperature=m_transitionTemperature;
+  constants.m_latentHeat=m_latentHeat;
+  constants.m_heatCapacitySolid=m_heatCapacitySolid;
+  constants.m_heatCapacityFluid=m_heatCapacityFluid;
+  constants.m_collisionObjects=m_collisionObjects.data();
+  constants.m_noCollisionObjects=m_collisionObjects.size();
+
+  //Split particles by phase at start of update
+  splitParticlesByPhase();
+
+  const int batchSize=Particle::m_updateBatchSize;
+  int noSolidParticles=m_solidParticles.size();
+  int noLiquidParticles=m_liquidParticles.size();
+  int noSolidBatches=(noSolidParticles+batchSize-1)/batchSize;
+  int noLiquidBatches=(noLiquidParticles+batchSize-1)/batchSize;
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("UpdateParticles", "thread");
+
+#pragma omp for nowait
+    for (int batch=0; batch<noSolidBatches; batch++)
+    {
+      int firstParticle=batch*batchSize;
+      Particle::updateBatch<Phase::Solid>(&m_solidParticles[firstParticle], std::min(batchSize, noSolidParticles-firstParticle), constants);
+    }
+
+#pragma omp for nowait
+    for (int batch=0; batch<noLiquidBatches; batch++)
+    {
+      int firstParticle=batch*batchSize;
+      Particle::updateBatch<Phase::Liquid>(&m_liquidParticles[firstParticle], std::min(batchSize, noLiquidParticles-firstParticle), constants);
+    }
+  }
+
+  if (m_isSleepingEnabled)
+  {
+    float maxSleepTemperature=m_transitionTemperature-m_sleepTemperatureMargin;
+
+#pragma omp parallel for
+    for (int i=0; i<noSolidParticles; i++)
+    {
+      m_solidParticles[i]->updateSleepState(_dt, m_sleepVelocityThreshold, m_sleepDeformationThreshold, maxSleepTemperature, m_noSleepSteps);
+    }
   }
 }
 
@@ -319,10 +584,19 @@ void Emitter::renderParticles(ngl::Mat4 _modelMatrixCamera, ngl::Camera* _camera
 
 void Emitter::exportParticles(AlembicExport *_alembicExporter)
 {
+  PROFILE_STAGE(ExportParticles);
+
   //Set up particle position and id containers
   std::vector<Imath::V3f> positions;
   std::vector<Alembic::Util::uint64_t> IDs;
 
+  positions.reserve(m_noParticles);
+  IDs.reserve(m_noParticles);
+
+  //Account export buffers to memory tracker until exported
+  ScopedAllocation exportAllocation(MemoryTracker::ExportBuffers,
+                                    (int64_t)m_noParticles*(sizeof(Imath::V3f)+sizeof(Alembic::Util::uint64_t)));
+
   //Get positions and ids of particles
   unsigned int noParticles=m_noParticles;
   for (unsigned int i=0; i<noParticles; i++)
@@ -1,6 +1,7 @@
 #include "Grid.h"
 
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <math.h>
@@ -63,6 +64,39 @@ Grid::Grid(Eigen::Vector3f _originEdge, float _boundingBoxSize, int _noCells)
   //Set whether implicit or explicit integration
 //  m_isImplictIntegration=true;
   m_isImplictIntegration=false;
+  //Set whether heat equation is solved alongside velocity update
+  m_isConcurrentTemperature=true;
+  //Set heat equation to be solved every step
+  m_temperatureSubsteps=1;
+  m_temperatureStepCounter=0;
+  m_temperatureDt=0.0;
+  m_isTemperatureSolved=true;
+  m_isReportingTemperatureDrift=false;
+  //Use fast threaded scatters and Eigen solvers unless deterministic mode is set
+  m_isDeterministic=false;
+  //Use the cell interpolation lists unless particle stencil cache is set
+  m_isParticleStencilCache=false;
+  //Solve with conjugate gradient for pressure and temperature and MINRES for deviatoric velocity unless set
+  m_pressureSolver.m_method=SolverSettings::ConjugateGradient;
+  m_pressureSolver.m_maxLoops=3000;
+  m_pressureSolver.m_tolerance=0.00001;
+  m_pressureSolver.m_refactorThreshold=0.01;
+  m_pressureSolver.m_relaxation=1.0;
+  m_temperatureSolver.m_method=SolverSettings::ConjugateGradient;
+  m_temperatureSolver.m_maxLoops=3000;
+  m_temperatureSolver.m_tolerance=0.00001;
+  m_temperatureSolver.m_refactorThreshold=0.01;
+  m_temperatureSolver.m_relaxation=1.0;
+  m_deviatoricSolver.m_method=SolverSettings::MinRes;
+  m_deviatoricSolver.m_maxLoops=20;
+  m_deviatoricSolver.m_tolerance=0.0000001;
+  m_deviatoricSolver.m_refactorThreshold=0.01;
+  m_deviatoricSolver.m_relaxation=1.0;
+
+  //Create solver metrics and memory tracker here, as solves can run in concurrent sections and first call must
+  //be from one thread
+  SolverMetrics::instance();
+  MemoryTracker::instance();
 
   //Set storage for A matrices and B vectors for deviatoric velocity calculations
   m_Amatrix_deviatoric_X.setZero(m_totNoCells, m_totNoCells);
@@ -114,6 +148,13 @@ Grid::Grid(Eigen::Vector3f _originEdge, float _boundingBoxSize, int _noCells)
     }
   }
 
+  //Account cells and dense deviatoric storage to the memory tracker
+  m_trackedGridBytes=(int64_t)m_totNoCells*(sizeof(CellCentre)+(3*sizeof(CellFace))+(4*sizeof(void*)));
+  m_trackedDeviatoricBytes=3*(((int64_t)m_totNoCells*m_totNoCells*sizeof(float))+(m_totNoCells*sizeof(float)));
+  m_trackedInterpolationBytes=0;
+
+  MemoryTracker::instance()->allocate(MemoryTracker::GridFields, m_trackedGridBytes);
+  MemoryTracker::instance()->allocate(MemoryTracker::LinearSystems, m_trackedDeviatoricBytes);
 
 }
 
@@ -123,10 +164,19 @@ Grid::~Grid()
 {
   /* Outline
   ------------------------------------------------------------------------------------------------------
+  Remove interpolation index and cached systems from memory tracker
+
   Delete all cell face and centre pointers
   ------------------------------------------------------------------------------------------------------
   */
 
+  MemoryTracker::instance()->release(MemoryTracker::Interpolation, m_trackedInterpolationBytes);
+  MemoryTracker::instance()->release(MemoryTracker::GridFields, m_trackedGridBytes);
+  MemoryTracker::instance()->release(MemoryTracker::CollisionObjects, 3*(int64_t)m_isFaceInCollisionObject[0].size());
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedDeviatoricBytes);
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_pressureSystem.m_trackedBytes);
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_temperatureSystem.m_trackedBytes);
+
   int noCellCentresCurrent=m_cellCentres.size();
   int noCellFacesXCurrent=m_cellFacesX.size();
   int noCellFacesYCurrent=m_cellFacesY.size();
@@ -217,6 +267,16 @@ Grid* Grid::getGrid()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Grid::deleteGrid()
+{
+  /// @brief Deletes grid instance and resets instance pointer so createGrid makes a new grid
+
+  delete m_instance;
+  m_instance=nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 Eigen::Vector3f Grid::getGridCornerPosition()
 {
   Eigen::Vector3f gridCornerPos=m_origin;
@@ -250,6 +310,183 @@ void Grid::setSurroundingTemperatures(float _ambientTemp, float _heatSourceTemp)
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Grid::setTemperatureSubsteps(int _noSubsteps, bool _isReportingDrift)
+{
+  /// @brief Sets how many velocity steps each heat solve covers. Values below 1 are treated as 1
+
+  m_temperatureSubsteps=std::max(_noSubsteps, 1);
+  m_isReportingTemperatureDrift=_isReportingDrift;
+
+  m_temperatureStepCounter=0;
+  m_temperatureDt=0.0;
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::setDeterministic(bool _isDeterministic)
+{
+  /// @brief Per particle interpolation lists are only built in deterministic mode, so changing mode takes effect from
+  /// the next update
+
+  m_isDeterministic=_isDeterministic;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::setParticleStencilCache(bool _isParticleStencilCache)
+{
+  m_isParticleStencilCache=_isParticleStencilCache;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::setSolverSettings(const SolverSettings &_pressureSolver, const SolverSettings &_temperatureSolver, const SolverSettings &_deviatoricSolver)
+{
+  m_pressureSolver=_pressureSolver;
+  m_temperatureSolver=_temperatureSolver;
+  m_deviatoricSolver=_deviatoricSolver;
+
+  //MIC and the kept factor need the stencil layout, and the matrices solved for pressure and deviatoric velocity
+  //don't have it
+  if (m_pressureSolver.m_method==SolverSettings::ConjugateGradient_MIC)
+  {
+    std::cout<<"ConjugateGradient_MIC needs the 7 point pressure system, but the test matrix is solved for pressure. Using ConjugateGradient for pressure\n";
+    m_pressureSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+  if (m_pressureSolver.m_method==SolverSettings::LDLT_Reuse)
+  {
+    std::cout<<"LDLT_Reuse needs the 7 point pressure system, but the test matrix is solved for pressure. Using LDLT for pressure\n";
+    m_pressureSolver.m_method=SolverSettings::LDLT;
+  }
+  if (m_deviatoricSolver.m_method==SolverSettings::ConjugateGradient_MIC)
+  {
+    std::cout<<"ConjugateGradient_MIC needs a 7 point stencil system. Using ConjugateGradient for deviatoric velocity\n";
+    m_deviatoricSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+  if (m_deviatoricSolver.m_method==SolverSettings::LDLT_Reuse)
+  {
+    std::cout<<"LDLT_Reuse needs a 7 point stencil system. Using LDLT for deviatoric velocity\n";
+    m_deviatoricSolver.m_method=SolverSettings::LDLT;
+  }
+
+  //Red-black Gauss-Seidel needs the stencil layout, and is only accurate enough when the solve can be approximate
+  if (m_pressureSolver.m_method==SolverSettings::GaussSeidel_RedBlack)
+  {
+    std::cout<<"GaussSeidel_RedBlack needs the 7 point pressure system, but the test matrix is solved for pressure. Using ConjugateGradient for pressure\n";
+    m_pressureSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+  if (m_deviatoricSolver.m_method==SolverSettings::GaussSeidel_RedBlack)
+  {
+    std::cout<<"GaussSeidel_RedBlack needs a 7 point stencil system. Using ConjugateGradient for deviatoric velocity\n";
+    m_deviatoricSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+
+  //Matrix free methods need a stencil operator, which is only set up for pressure
+  if (LinearSolver::isMatrixFree(m_pressureSolver.m_method))
+  {
+    std::cout<<LinearSolver::getMethodName(m_pressureSolver.m_method)<<" solves the 7 point pressure system instead of the test matrix\n";
+  }
+  if (LinearSolver::isMatrixFree(m_temperatureSolver.m_method))
+  {
+    std::cout<<LinearSolver::getMethodName(m_temperatureSolver.m_method)<<" needs a stencil operator. Using ConjugateGradient for temperature\n";
+    m_temperatureSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+  if (LinearSolver::isMatrixFree(m_deviatoricSolver.m_method))
+  {
+    std::cout<<LinearSolver::getMethodName(m_deviatoricSolver.m_method)<<" needs a stencil operator. Using ConjugateGradient for deviatoric velocity\n";
+    m_deviatoricSolver.m_method=SolverSettings::ConjugateGradient;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::setCollisionObjects(const std::vector<CollisionSDF*> &_collisionObjects)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over all cells
+    Find position of the X, Y and Z faces, which are the lower faces of the cell
+    Face is inside if inside any collision object
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  MemoryTracker::instance()->release(MemoryTracker::CollisionObjects, 3*(int64_t)m_isFaceInCollisionObject[0].size());
+
+  for (int direction=0; direction<3; direction++)
+  {
+    m_isFaceInCollisionObject[direction].clear();
+  }
+
+  if (_collisionObjects.empty())
+  {
+    return;
+  }
+
+  for (int direction=0; direction<3; direction++)
+  {
+    m_isFaceInCollisionObject[direction].assign(m_totNoCells, 0);
+  }
+  MemoryTracker::instance()->allocate(MemoryTracker::CollisionObjects, 3*(int64_t)m_totNoCells);
+
+  float halfCellSize=m_cellSize/2.0;
+  int noFacesInside=0;
+
+#pragma omp parallel for reduction(+:noFacesInside)
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
+    Eigen::Vector3f cellPosition=m_origin+(m_cellSize*Eigen::Vector3f(m_cellCentres[cellIndex]->m_iIndex, m_cellCentres[cellIndex]->m_jIndex, m_cellCentres[cellIndex]->m_kIndex));
+
+    for (int direction=0; direction<3; direction++)
+    {
+      Eigen::Vector3f facePosition=cellPosition;
+      facePosition(direction)-=halfCellSize;
+
+      for (const CollisionSDF* collisionObject : _collisionObjects)
+      {
+        if (collisionObject->isInside(facePosition))
+        {
+          m_isFaceInCollisionObject[direction][cellIndex]=1;
+          noFacesInside+=1;
+          break;
+        }
+      }
+    }
+  }
+
+  std::cout<<"Cell faces inside collision objects: "<<noFacesInside<<"\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::simulateStep(float _dt, Emitter *_emitter, bool _isFirstStep, float _velocityContribAlpha, float _temperatureContribBeta)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Preset particles, ie. update elastic/plastic
+
+  Update grid, which transfers particle data to grid, calculates new velocity and temperature and transfers
+  them back to particles
+
+  Update particles
+
+  Store convergence of the linear solves in this step
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  TRACE_SCOPE("Step", "step");
+
+  _emitter->presetParticles(_velocityContribAlpha, _temperatureContribBeta);
+
+  update(_dt, _emitter, _isFirstStep, _velocityContribAlpha, _temperatureContribBeta);
+
+  _emitter->updateParticles(_dt);
+
+  SolverMetrics::instance()->endStep();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Grid::update(float _dt, Emitter* _emitter, bool _isFirstStep, float _velocityContribAlpha, float _temperatureContribBeta)
 {
   /* Outline
@@ -272,10 +509,13 @@ void Grid::update(float _dt, Emitter* _emitter, bool _isFirstStep, float _veloci
 
   Project velocity, ie. calc pressure
 
-  Solve heat equation - do this in a separate thread?
+  Solve heat equation - runs concurrently with the three velocity stages above as it only reads the cell data
+  set during transfer and classification. Only solved every m_temperatureSubsteps steps with the accumulated dt
 
   Update particle from grid
 
+  Wake sleeping particles
+
   ---------------------------------------------------------------------------------------------------------------
   */
 
@@ -322,11 +562,20 @@ void Grid::update(float _dt, Emitter* _emitter, bool _isFirstStep, float _veloci
 
 
   //findParticleInCell - need to find out which particles are in which cells and their respective interp weight
-  findParticleContributionToCell(_emitter);
+  //Then transfer particle data to grid. The particle stencil cache stores the weights per particle instead
+  if (m_isParticleStencilCache)
+  {
+    buildParticleStencilCache(_emitter);
+    transferParticleData_Cached(_emitter);
+  }
+  else
+  {
+    findParticleContributionToCell(_emitter);
 
-  ///Combine data transfer and classification of cells
-  //Transfer particle data to grid
-  transferParticleData(_emitter);
+    ///Combine data transfer and classification of cells
+    //Transfer particle data to grid
+    transferParticleData(_emitter);
+  }
 
 //  //If first step calculate particle density during this loop as well
 //  if (_isFirstStep)
@@ -343,21 +592,73 @@ void Grid::update(float _dt, Emitter* _emitter, bool _isFirstStep, float _veloci
     calcInitialParticleVolumes(_emitter);
   }
 
-  //Calculate deviatoric force and velocity update from it
-  calcDeviatoricVelocity();
+  //Velocity stages and temperature solve form two independent branches. Each branch gets its own share of threads
+  //for the parallel loops inside it. The temperature solve is mostly serial so it only gets one.
+  int noThreads=omp_get_max_threads();
+  bool isConcurrent=(m_isConcurrentTemperature && noThreads>1);
+  int previousMaxActiveLevels=omp_get_max_active_levels();
+  omp_set_max_active_levels(2);
+
+#pragma omp parallel sections num_threads(2) if(isConcurrent)
+  {
+#pragma omp section
+    {
+      omp_set_num_threads(isConcurrent ? (noThreads-1) : noThreads);
+
+      //Branch events on the timeline show the overlap with the temperature branch
+      TRACE_SCOPE("VelocityBranch", "branch");
+
+      //Calculate deviatoric force and velocity update from it
+      calcDeviatoricVelocity();
+
+      //Set boundary velocities here for now
+      setBoundaryVelocity();
+
+      //Project velocity
+      projectVelocity();
+    }
+#pragma omp section
+    {
+      omp_set_num_threads(isConcurrent ? 1 : noThreads);
 
-  //Set boundary velocities here for now
-  setBoundaryVelocity();
+      TRACE_SCOPE("TemperatureBranch", "branch");
 
-  //Project velocity
-  projectVelocity();
+      //Accumulate time step and calculate new temperature when enough steps have passed
+      m_temperatureDt+=_dt;
+      m_temperatureStepCounter+=1;
+      m_isTemperatureSolved=(m_temperatureStepCounter>=m_temperatureSubsteps);
 
-  //Calculate new temperature
-  calcTemperature();
+      if (m_isTemperatureSolved)
+      {
+        calcTemperature();
+
+        m_temperatureDt=0.0;
+        m_temperatureStepCounter=0;
+      }
+    }
+  }
+
+  omp_set_max_active_levels(previousMaxActiveLevels);
 
   //Update particle values from grid
   updateParticleFromGrid(_velocityContribAlpha, _temperatureContribBeta);
 
+  //Without a heat solve the particles keep their temperature instead of being smoothed through the grid
+  if (!m_isTemperatureSolved)
+  {
+#pragma omp parallel for
+    for (int particleIndex=0; particleIndex<_emitter->m_noParticles; particleIndex++)
+    {
+      _emitter->m_particles[particleIndex]->keepPreviousTemperature();
+    }
+  }
+
+  //Wake sleeping particles that have been heated or are in moving cells
+  if (_emitter->m_isSleepingEnabled)
+  {
+    wakeParticles(_emitter);
+  }
+
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -367,12 +668,14 @@ void Grid::clearCellData()
   /* Outline
   --------------------------------------------------------------------------------------------------------------
   Loop over all cells
-    Clear m_interpolationData
+    Detach cell from interpolation index of previous step
     Set all variables to zero
     Set collision state of cell centre to colliding and faces to interior
   --------------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(ClearCellData);
+
   //Set storage for A matrices and B vectors for deviatoric velocity calculations
   m_Amatrix_deviatoric_X.setZero(m_totNoCells, m_totNoCells);
   m_Amatrix_deviatoric_Y.setZero(m_totNoCells, m_totNoCells);
@@ -382,58 +685,61 @@ void Grid::clearCellData()
   m_Bvector_deviatoric_Y.setZero(m_totNoCells);
   m_Bvector_deviatoric_Z.setZero(m_totNoCells);
 
-#pragma omp parallel for
-  for(int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+#pragma omp parallel
   {
+    TRACE_SCOPE("ClearCellData", "thread");
+
+#pragma omp for nowait
+    for(int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
 //    //Test parallel
 //    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
 
-    //Clear list of interpolation data including particle pointers.
-    m_cellCentres[cellIndex]->m_interpolationData.clear();
-    m_cellFacesX[cellIndex]->m_interpolationData.clear();
-    m_cellFacesY[cellIndex]->m_interpolationData.clear();
-    m_cellFacesZ[cellIndex]->m_interpolationData.clear();    
-
-    //Reset cell centre values to zero
-    m_cellCentres[cellIndex]->m_noParticlesContributing=0;
-    m_cellCentres[cellIndex]->m_mass=0.0;
-    m_cellCentres[cellIndex]->m_testMass=0.0;
-    m_cellCentres[cellIndex]->m_detDeformationGrad=0.0;
-    m_cellCentres[cellIndex]->m_detDeformationGradElastic=0.0;
-    m_cellCentres[cellIndex]->m_detDeformationGradPlastic=0.0;
-    m_cellCentres[cellIndex]->m_heatCapacity=0.0;
-    m_cellCentres[cellIndex]->m_temperature=0.0;
-    m_cellCentres[cellIndex]->m_lameLambdaInverse=0.0;
-    m_cellCentres[cellIndex]->m_temperature=0.0;
-    m_cellCentres[cellIndex]->m_state=State::Colliding;
-
-    //Reset cell face X values to zero
-    m_cellFacesX[cellIndex]->m_noParticlesContributing=0;
-    m_cellFacesX[cellIndex]->m_mass=0.0;
-    m_cellFacesX[cellIndex]->m_testMass=0.0;
-    m_cellFacesX[cellIndex]->m_deviatoricForce=0.0;
-    m_cellFacesX[cellIndex]->m_velocity=0.0;
-    m_cellFacesX[cellIndex]->m_heatConductivity=0.0;
-    m_cellFacesX[cellIndex]->m_state=State::Interior;
-
-    //Reset cell face Y values to zero
-    m_cellFacesY[cellIndex]->m_noParticlesContributing=0;
-    m_cellFacesY[cellIndex]->m_mass=0.0;
-    m_cellFacesY[cellIndex]->m_testMass=0.0;
-    m_cellFacesY[cellIndex]->m_deviatoricForce=0.0;
-    m_cellFacesY[cellIndex]->m_velocity=0.0;
-    m_cellFacesY[cellIndex]->m_heatConductivity=0.0;
-    m_cellFacesY[cellIndex]->m_state=State::Interior;
-
-    //Reset cell face Z values to zero
-    m_cellFacesZ[cellIndex]->m_noParticlesContributing=0;
-    m_cellFacesZ[cellIndex]->m_mass=0.0;
-    m_cellFacesZ[cellIndex]->m_testMass=0.0;
-    m_cellFacesZ[cellIndex]->m_deviatoricForce=0.0;
-    m_cellFacesZ[cellIndex]->m_velocity=0.0;
-    m_cellFacesZ[cellIndex]->m_heatConductivity=0.0;
-    m_cellFacesZ[cellIndex]->m_state=State::Interior;
+      //Reset cell centre values to zero
+      m_cellCentres[cellIndex]->m_noParticlesContributing=0;
+      m_cellCentres[cellIndex]->m_interpolationData=nullptr;
+      m_cellCentres[cellIndex]->m_mass=0.0;
+      m_cellCentres[cellIndex]->m_testMass=0.0;
+      m_cellCentres[cellIndex]->m_detDeformationGrad=0.0;
+      m_cellCentres[cellIndex]->m_detDeformationGradElastic=0.0;
+      m_cellCentres[cellIndex]->m_detDeformationGradPlastic=0.0;
+      m_cellCentres[cellIndex]->m_heatCapacity=0.0;
+      m_cellCentres[cellIndex]->m_temperature=0.0;
+      m_cellCentres[cellIndex]->m_lameLambdaInverse=0.0;
+      m_cellCentres[cellIndex]->m_temperature=0.0;
+      m_cellCentres[cellIndex]->m_state=State::Colliding;
+
+      //Reset cell face X values to zero
+      m_cellFacesX[cellIndex]->m_noParticlesContributing=0;
+      m_cellFacesX[cellIndex]->m_interpolationData=nullptr;
+      m_cellFacesX[cellIndex]->m_mass=0.0;
+      m_cellFacesX[cellIndex]->m_testMass=0.0;
+      m_cellFacesX[cellIndex]->m_deviatoricForce=0.0;
+      m_cellFacesX[cellIndex]->m_velocity=0.0;
+      m_cellFacesX[cellIndex]->m_heatConductivity=0.0;
+      m_cellFacesX[cellIndex]->m_state=State::Interior;
+
+      //Reset cell face Y values to zero
+      m_cellFacesY[cellIndex]->m_noParticlesContributing=0;
+      m_cellFacesY[cellIndex]->m_interpolationData=nullptr;
+      m_cellFacesY[cellIndex]->m_mass=0.0;
+      m_cellFacesY[cellIndex]->m_testMass=0.0;
+      m_cellFacesY[cellIndex]->m_deviatoricForce=0.0;
+      m_cellFacesY[cellIndex]->m_velocity=0.0;
+      m_cellFacesY[cellIndex]->m_heatConductivity=0.0;
+      m_cellFacesY[cellIndex]->m_state=State::Interior;
+
+      //Reset cell face Z values to zero
+      m_cellFacesZ[cellIndex]->m_noParticlesContributing=0;
+      m_cellFacesZ[cellIndex]->m_interpolationData=nullptr;
+      m_cellFacesZ[cellIndex]->m_mass=0.0;
+      m_cellFacesZ[cellIndex]->m_testMass=0.0;
+      m_cellFacesZ[cellIndex]->m_deviatoricForce=0.0;
+      m_cellFacesZ[cellIndex]->m_velocity=0.0;
+      m_cellFacesZ[cellIndex]->m_heatConductivity=0.0;
+      m_cellFacesZ[cellIndex]->m_state=State::Interior;
 
+    }
   }
 }
 
@@ -443,17 +749,202 @@ void Grid::findParticleContributionToCell(Emitter* _emitter)
 {
   /* Outline
   ----------------------------------------------------------------------------------------------------
-   Loop over all particles - This is where parallel should be inserted I think
+   Sort particles by cell and find the cells each particle has non-zero weights for
+
+   Loop over all cells
+   {
+     A particle in cell i has non-zero weights for cells between i-2 and i+3, +3 because faces defined as
+     lower faces of cell. The candidates of cell i are then the sorted particles of cells i-3 to i+2,
+     which are next to each other in the sorted list for each j and k
+
+     Count candidates whose stencil contains the cell centre and each face
+   }
+
+   Prefix sum of counts gives the offsets of each cell centre and face in the interpolation index
+
+   In deterministic mode prefix sum of the stencil sizes gives the offsets of each particle
+
+   Loop over all cells again
    {
-     Find position of particle in grid using getParticleGridCell
-     This gives vector of i,j,k for cell
+     Pass candidates in stencil to calcInterpolationWeights and store in index in sorted particle order
+     In deterministic mode store position in index in the list of the particle too
+     Point cell centre and faces to their part of the index
+   }
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  PROFILE_STAGE(FindParticleContribution);
+
+  sortParticlesByCell(_emitter);
+
+  int totNoParticles=_emitter->m_noParticles;
+  int totNoNodes=4*m_totNoCells;
+
+  m_interpolationOffsets.assign(totNoNodes+1, 0);
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("FindParticleContribution", "thread");
+
+#pragma omp for
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+      int iMin=std::max(iIndex-3, 0);
+      int iMax=std::min(iIndex+2, m_noCells-1);
+
+      int noContributing[4]={0, 0, 0, 0};
+
+      for (int k=std::max(kIndex-3, 0); k<=std::min(kIndex+2, m_noCells-1); k++)
+      {
+        for (int j=std::max(jIndex-3, 0); j<=std::min(jIndex+2, m_noCells-1); j++)
+        {
+          int firstCandidate=m_cellParticleOffsets[MathFunctions::getVectorIndex(iMin, j, k, m_noCells)];
+          int endCandidate=m_cellParticleOffsets[MathFunctions::getVectorIndex(iMax, j, k, m_noCells)+1];
+
+          for (int sortedIndex=firstCandidate; sortedIndex<endCandidate; sortedIndex++)
+          {
+            const ParticleStencil &stencil=m_particleStencils[sortedIndex];
+
+            for (int faceDirection=-1; faceDirection<3; faceDirection++)
+            {
+              if (stencil.contains(faceDirection, iIndex, jIndex, kIndex))
+              {
+                noContributing[faceDirection+1]+=1;
+              }
+            }
+          }
+        }
+      }
+
+      for (int node=0; node<4; node++)
+      {
+        m_interpolationOffsets[(4*cellIndex)+node+1]=noContributing[node];
+      }
+    }
+
+    //Offsets of each cell centre and face, and of each particle in deterministic mode
+#pragma omp single
+    {
+      for (int node=0; node<totNoNodes; node++)
+      {
+        m_interpolationOffsets[node+1]+=m_interpolationOffsets[node];
+      }
+      m_interpolationData.resize(m_interpolationOffsets[totNoNodes]);
+
+      if (m_isDeterministic)
+      {
+        m_particleInterpolationOffsets.resize(totNoParticles+1);
+        m_particleInterpolationOffsets[0]=0;
+        for (int sortedIndex=0; sortedIndex<totNoParticles; sortedIndex++)
+        {
+          const ParticleStencil &stencil=m_particleStencils[sortedIndex];
+          int stencilSize=stencil.getSize(-1)+stencil.getSize(0)+stencil.getSize(1)+stencil.getSize(2);
+          m_particleInterpolationOffsets[sortedIndex+1]=m_particleInterpolationOffsets[sortedIndex]+stencilSize;
+        }
+        m_particleInterpolationData.resize(m_particleInterpolationOffsets[totNoParticles]);
+      }
+    }
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+      int iMin=std::max(iIndex-3, 0);
+      int iMax=std::min(iIndex+2, m_noCells-1);
 
-     Get neighbour cells between i-2 and i+3 and similarly for j and k. +3 because faces defined as lower
-     faces of cell.
+      int dataIndex[4];
+      for (int node=0; node<4; node++)
+      {
+        dataIndex[node]=m_interpolationOffsets[(4*cellIndex)+node];
+      }
+
+      for (int k=std::max(kIndex-3, 0); k<=std::min(kIndex+2, m_noCells-1); k++)
+      {
+        for (int j=std::max(jIndex-3, 0); j<=std::min(jIndex+2, m_noCells-1); j++)
+        {
+          int firstCandidate=m_cellParticleOffsets[MathFunctions::getVectorIndex(iMin, j, k, m_noCells)];
+          int endCandidate=m_cellParticleOffsets[MathFunctions::getVectorIndex(iMax, j, k, m_noCells)+1];
+
+          for (int sortedIndex=firstCandidate; sortedIndex<endCandidate; sortedIndex++)
+          {
+            const ParticleStencil &stencil=m_particleStencils[sortedIndex];
+
+            for (int faceDirection=-1; faceDirection<3; faceDirection++)
+            {
+              if (stencil.contains(faceDirection, iIndex, jIndex, kIndex))
+              {
+                int node=faceDirection+1;
+                Particle* particle=_emitter->m_particles[m_sortedParticleIndices[sortedIndex]];
+
+                InterpolationData &interpolationData=m_interpolationData[dataIndex[node]];
+                calcInterpolationWeights(particle, iIndex, jIndex, kIndex, faceDirection, interpolationData);
+                interpolationData.m_particleSortedIndex=sortedIndex;
+
+                if (m_isDeterministic)
+                {
+                  int stencilPosition=stencil.getPosition(faceDirection, iIndex, jIndex, kIndex);
+                  m_particleInterpolationData[m_particleInterpolationOffsets[sortedIndex]+stencilPosition]=dataIndex[node];
+                }
+
+                dataIndex[node]+=1;
+              }
+            }
+          }
+        }
+      }
 
-     Pass in cell i,j,k to calcInterpolationWeights
+      //Point cell centre and faces to their part of the index
+      CellCentre* cellCentre=m_cellCentres[cellIndex];
+      cellCentre->m_noParticlesContributing=m_interpolationOffsets[(4*cellIndex)+1]-m_interpolationOffsets[4*cellIndex];
+      cellCentre->m_interpolationData=m_interpolationData.data()+m_interpolationOffsets[4*cellIndex];
 
+      CellFace* cellFaces[3]={m_cellFacesX[cellIndex], m_cellFacesY[cellIndex], m_cellFacesZ[cellIndex]};
+      for (int faceDirection=0; faceDirection<3; faceDirection++)
+      {
+        int node=(4*cellIndex)+faceDirection+1;
+        cellFaces[faceDirection]->m_noParticlesContributing=m_interpolationOffsets[node+1]-m_interpolationOffsets[node];
+        cellFaces[faceDirection]->m_interpolationData=m_interpolationData.data()+m_interpolationOffsets[node];
+      }
     }
+  }
+
+  //Account the index to the memory tracker. Storage is kept between steps, so track its capacity
+  int64_t interpolationBytes=(m_interpolationData.capacity()*sizeof(InterpolationData))
+                             +((m_interpolationOffsets.capacity()+m_particleCellIndices.capacity()+m_sortedParticleIndices.capacity()
+                                +m_cellParticleOffsets.capacity()+m_particleInterpolationData.capacity()
+                                +m_particleInterpolationOffsets.capacity())*sizeof(int))
+                             +(m_particleStencils.capacity()*sizeof(ParticleStencil));
+
+  MemoryTracker::instance()->release(MemoryTracker::Interpolation, m_trackedInterpolationBytes);
+  m_trackedInterpolationBytes=interpolationBytes;
+  MemoryTracker::instance()->allocate(MemoryTracker::Interpolation, m_trackedInterpolationBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::sortParticlesByCell(Emitter* _emitter)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over particles
+    Find cell of particle, clamped to grid, and count particles in each cell
+
+  Prefix sum of the counts gives the offset of each cell in the sorted list
+
+  Loop over particles
+    Place particle in its cell. Order within a cell depends on the threads, so sort each cell by emitter
+    index after so the sorted order is the same for any number of threads
+
+  Loop over sorted particles
+    Find the cell centres and faces along each axis which have non-zero cubic B spline weight, ie. cells
+    between i-2 and i+3 with |x_p-x_i|<2*cellSize. Test done the same way as calcInterpolationWeights
   ------------------------------------------------------------------------------------------------------
   */
 
@@ -464,33 +955,101 @@ void Grid::findParticleContributionToCell(Emitter* _emitter)
   gridEdgePosition(0)-=halfCellSize;
   gridEdgePosition(1)-=halfCellSize;
   gridEdgePosition(2)-=halfCellSize;
-//  gridEdgePosition(0)+=halfCellSize;
-//  gridEdgePosition(1)+=halfCellSize;
-//  gridEdgePosition(2)+=halfCellSize;
 
   int totNoParticles=_emitter->m_noParticles;
-//#pragma omp parallel for
-  for (int particleItr=0; particleItr<totNoParticles; particleItr++)
+
+  m_particleCellIndices.resize(totNoParticles);
+  m_sortedParticleIndices.resize(totNoParticles);
+  m_particleStencils.resize(totNoParticles);
+  m_cellParticleOffsets.assign(m_totNoCells+1, 0);
+
+#pragma omp parallel
   {
-    Eigen::Vector3f particlePosition=_emitter->m_particles[particleItr]->getPosition();
-    Eigen::Vector3i particleIndex=MathFunctions::getParticleGridCell(particlePosition, m_cellSize, gridEdgePosition);
+#pragma omp for
+    for (int particleItr=0; particleItr<totNoParticles; particleItr++)
+    {
+      Eigen::Vector3f particlePosition=_emitter->m_particles[particleItr]->getPosition();
+      Eigen::Vector3i particleIndex=MathFunctions::getParticleGridCell(particlePosition, m_cellSize, gridEdgePosition);
+
+      //Particles outside grid are clamped to the outer cells. They are candidates of a few more cells, but have
+      //no cells in their stencil
+      int i=std::min(std::max(particleIndex(0), 0), m_noCells-1);
+      int j=std::min(std::max(particleIndex(1), 0), m_noCells-1);
+      int k=std::min(std::max(particleIndex(2), 0), m_noCells-1);
+
+      int cellIndex=MathFunctions::getVectorIndex(i, j, k, m_noCells);
+      m_particleCellIndices[particleItr]=cellIndex;
+
+#pragma omp atomic
+      m_cellParticleOffsets[cellIndex+1]+=1;
+    }
+
+#pragma omp single
+    {
+      for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+      {
+        m_cellParticleOffsets[cellIndex+1]+=m_cellParticleOffsets[cellIndex];
+      }
+    }
+
+    //Offset of each cell is moved to the end of the cell as particles are placed
+#pragma omp for
+    for (int particleItr=0; particleItr<totNoParticles; particleItr++)
+    {
+      int sortedIndex;
+#pragma omp atomic capture
+      sortedIndex=m_cellParticleOffsets[m_particleCellIndices[particleItr]]++;
+
+      m_sortedParticleIndices[sortedIndex]=particleItr;
+    }
+
+#pragma omp single
+    {
+      for (int cellIndex=m_totNoCells; cellIndex>0; cellIndex--)
+      {
+        m_cellParticleOffsets[cellIndex]=m_cellParticleOffsets[cellIndex-1];
+      }
+      m_cellParticleOffsets[0]=0;
+    }
 
-    //Loop over i+-2, j+-2, k+-2
-    int iParticle=particleIndex(0);
-    int jParticle=particleIndex(1);
-    int kParticle=particleIndex(2);
+#pragma omp for
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      std::sort(m_sortedParticleIndices.begin()+m_cellParticleOffsets[cellIndex], m_sortedParticleIndices.begin()+m_cellParticleOffsets[cellIndex+1]);
+    }
 
-    for (int k=(kParticle-2); k<(kParticle+4); k++)
+#pragma omp for nowait
+    for (int sortedIndex=0; sortedIndex<totNoParticles; sortedIndex++)
     {
-      for (int j=(jParticle-2); j<(jParticle+4); j++)
+      Eigen::Vector3f particlePosition=_emitter->m_particles[m_sortedParticleIndices[sortedIndex]]->getPosition();
+      Eigen::Vector3i particleIndex=MathFunctions::getParticleGridCell(particlePosition, m_cellSize, gridEdgePosition);
+
+      ParticleStencil &stencil=m_particleStencils[sortedIndex];
+
+      for (int axis=0; axis<3; axis++)
       {
-        for (int i=(iParticle-2); i<(iParticle+4); i++)
+        //Cell centres, then faces which are half a cell lower along the axis
+        for (int isFace=0; isFace<2; isFace++)
         {
-          //Check that not in outer cells or outside grid
-          if (i>=0 && i<=(m_noCells-1) && j>=0 && j<=(m_noCells-1) && k>=0 && k<=(m_noCells-1))
+          stencil.m_first[isFace][axis]=0;
+          stencil.m_noCells[isFace][axis]=0;
+
+          for (int index=std::max(particleIndex(axis)-2, 0); index<=std::min(particleIndex(axis)+3, m_noCells-1); index++)
           {
-            //Calculate interpolation weight and store particle if unlike zero
-            calcInterpolationWeights(_emitter->m_particles[particleItr], i, j, k);
+            float position=(index*m_cellSize)+m_origin(axis);
+            if (isFace==1)
+            {
+              position-=halfCellSize;
+            }
+
+            if (std::abs((particlePosition(axis)-position)/m_cellSize)<2.0)
+            {
+              if (stencil.m_noCells[isFace][axis]==0)
+              {
+                stencil.m_first[isFace][axis]=index;
+              }
+              stencil.m_noCells[isFace][axis]+=1;
+            }
           }
         }
       }
@@ -500,26 +1059,21 @@ void Grid::findParticleContributionToCell(Emitter* _emitter)
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Grid::calcInterpolationWeights(Particle* _particle, int _i, int _j, int _k)
+void Grid::calcInterpolationWeights(Particle* _particle, int _i, int _j, int _k, int _faceDirection, InterpolationData &o_interpolationData)
 {
   /* Outline
   ------------------------------------------------------------------------------------------------------
-  Calculate interpolation weights for the particle and the cell with given _i, _j,_k
-
-  Calculate i*, ix, iy, iz for the cell in question
+  Calculate interpolation weights for the particle and the cell centre or face with given _i, _j,_k
 
-  Calculate x values for these
-
-  Set up floats to recieve from maths functions
+  Calculate position of cell centre, or face which is half a cell lower along its normal
 
   Pass in x and get interpolation weights:
        cubicBspline
        cubicBspline_Diff
-       cubicBspline_Integ
        tightQuadraticStencil
        tightQuadraticStencil_Diff
 
-  Store interpolation weights in cell centre and face
+  Store interpolation weights, particle and cell
   ------------------------------------------------------------------------------------------------------
   */
 
@@ -528,284 +1082,81 @@ void Grid::calcInterpolationWeights(Particle* _particle, int _i, int _j, int _k)
   float yPos=(_j*m_cellSize)+m_origin(1);
   float zPos=(_k*m_cellSize)+m_origin(2);
 
-  //Position vectors for centre and faces
-  Eigen::Vector3f centreVector(xPos, yPos, zPos);
-
+  //Position vector for centre or face
   float halfCellSize=m_cellSize/2.0;
-  Eigen::Vector3f faceXVector(xPos-halfCellSize, yPos, zPos);
-  Eigen::Vector3f faceYVector(xPos, yPos-halfCellSize, zPos);
-  Eigen::Vector3f faceZVector(xPos, yPos, zPos-halfCellSize);
-
-  Eigen::Vector3f particlePosition=_particle->getPosition();
-
-  ///Addition so particle and grid is in same reference
-//  particlePosition(0)+=halfCellSize;
-//  particlePosition(1)+=halfCellSize;
-//  particlePosition(2)+=halfCellSize;
-
-  //Calculate posDifference for each face and cell centre
-  Eigen::Vector3f centrePosDiff=particlePosition-centreVector;
-  Eigen::Vector3f faceXPosDiff=particlePosition-faceXVector;
-  Eigen::Vector3f faceYPosDiff=particlePosition-faceYVector;
-  Eigen::Vector3f faceZPosDiff=particlePosition-faceZVector;
-
-  //Need to calculate weights for each of these
-  //Check whether worth calculating all?
-
-  //Centre
-  float NxCentre_cubicBS=MathFunctions::calcCubicBSpline(centrePosDiff(0)/m_cellSize);
-  float NyCentre_cubicBS=MathFunctions::calcCubicBSpline(centrePosDiff(1)/m_cellSize);
-  float NzCentre_cubicBS=MathFunctions::calcCubicBSpline(centrePosDiff(2)/m_cellSize);
-  float NCentre_cubicBS=NxCentre_cubicBS*NyCentre_cubicBS*NzCentre_cubicBS;
-
-  //FaceX
-  float NxFaceX_cubicBS=MathFunctions::calcCubicBSpline(faceXPosDiff(0)/m_cellSize);
-  float NyFaceX_cubicBS=MathFunctions::calcCubicBSpline(faceXPosDiff(1)/m_cellSize);
-  float NzFaceX_cubicBS=MathFunctions::calcCubicBSpline(faceXPosDiff(2)/m_cellSize);
-  float NFaceX_cubicBS=NxFaceX_cubicBS*NyFaceX_cubicBS*NzFaceX_cubicBS;
-
-  //FaceY
-  float NxFaceY_cubicBS=MathFunctions::calcCubicBSpline(faceYPosDiff(0)/m_cellSize);
-  float NyFaceY_cubicBS=MathFunctions::calcCubicBSpline(faceYPosDiff(1)/m_cellSize);
-  float NzFaceY_cubicBS=MathFunctions::calcCubicBSpline(faceYPosDiff(2)/m_cellSize);
-  float NFaceY_cubicBS=NxFaceY_cubicBS*NyFaceY_cubicBS*NzFaceY_cubicBS;
-
-  //FaceZ
-  float NxFaceZ_cubicBS=MathFunctions::calcCubicBSpline(faceZPosDiff(0)/m_cellSize);
-  float NyFaceZ_cubicBS=MathFunctions::calcCubicBSpline(faceZPosDiff(1)/m_cellSize);
-  float NzFaceZ_cubicBS=MathFunctions::calcCubicBSpline(faceZPosDiff(2)/m_cellSize);
-  float NFaceZ_cubicBS=NxFaceZ_cubicBS*NyFaceZ_cubicBS*NzFaceZ_cubicBS;
-
-  //Check whether worth keep going, ie. if cubicBS are non-zero
-  //NB! Might need to check if smaller than smallest value difference
-
-  int cellListIndex=MathFunctions::getVectorIndex(_i, _j, _k, m_noCells);
-  //Centre
-  if (NCentre_cubicBS!=0)
+  Eigen::Vector3f cellVector(xPos, yPos, zPos);
+  if (_faceDirection!=-1)
   {
-    //Create interpolation data pointer
-    InterpolationData* newInterpolationData= new InterpolationData;
-
-    //Store particle
-    newInterpolationData->m_particle=_particle;
+    cellVector(_faceDirection)-=halfCellSize;
+  }
 
-    //Store cubicBSpline
-    newInterpolationData->m_cubicBSpline=NCentre_cubicBS;
+  Eigen::Vector3f particlePosition=_particle->getPosition();
 
-    //Calculate and store cubicBSpline differentiated or nabla*weight for cubicBS weight
-    Eigen::Vector3f cubicBS_Diff;
+  //Calculate posDifference
+  Eigen::Vector3f posDiff=particlePosition-cellVector;
 
-    float dNx_cubicBS=MathFunctions::calcCubicBSpline_Diff(centrePosDiff(0)/m_cellSize);
-    float dNy_cubicBS=MathFunctions::calcCubicBSpline_Diff(centrePosDiff(1)/m_cellSize);
-    float dNz_cubicBS=MathFunctions::calcCubicBSpline_Diff(centrePosDiff(2)/m_cellSize);
+  //Cubic B spline
+  float Nx_cubicBS=MathFunctions::calcCubicBSpline(posDiff(0)/m_cellSize);
+  float Ny_cubicBS=MathFunctions::calcCubicBSpline(posDiff(1)/m_cellSize);
+  float Nz_cubicBS=MathFunctions::calcCubicBSpline(posDiff(2)/m_cellSize);
 
-    cubicBS_Diff(0)=dNx_cubicBS*NyCentre_cubicBS*NzCentre_cubicBS;
-    cubicBS_Diff(1)=dNy_cubicBS*NxCentre_cubicBS*NzCentre_cubicBS;
-    cubicBS_Diff(2)=dNz_cubicBS*NxCentre_cubicBS*NyCentre_cubicBS;
+  //Store particle
+  o_interpolationData.m_particle=_particle;
 
-    cubicBS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_cubicBSpline_Diff=cubicBS_Diff;
+  //Store cubicBSpline
+  o_interpolationData.m_cubicBSpline=Nx_cubicBS*Ny_cubicBS*Nz_cubicBS;
 
+  //Calculate and store cubicBSpline differentiated or nabla*weight for cubicBS weight
+  Eigen::Vector3f cubicBS_Diff;
 
-    //Calculate and store Tight Quadratic stencil
-    float NxCentre_quadS=MathFunctions::calcTightQuadraticStencil(centrePosDiff(0)/m_cellSize);
-    float NyCentre_quadS=MathFunctions::calcTightQuadraticStencil(centrePosDiff(1)/m_cellSize);
-    float NzCentre_quadS=MathFunctions::calcTightQuadraticStencil(centrePosDiff(2)/m_cellSize);
-    float NCentre_quadS=NxCentre_quadS*NyCentre_quadS*NzCentre_quadS;
-    newInterpolationData->m_tightQuadStencil=NCentre_quadS;
+  float dNx_cubicBS=MathFunctions::calcCubicBSpline_Diff(posDiff(0)/m_cellSize);
+  float dNy_cubicBS=MathFunctions::calcCubicBSpline_Diff(posDiff(1)/m_cellSize);
+  float dNz_cubicBS=MathFunctions::calcCubicBSpline_Diff(posDiff(2)/m_cellSize);
 
+  cubicBS_Diff(0)=dNx_cubicBS*Ny_cubicBS*Nz_cubicBS;
+  cubicBS_Diff(1)=dNy_cubicBS*Nx_cubicBS*Nz_cubicBS;
+  cubicBS_Diff(2)=dNz_cubicBS*Nx_cubicBS*Ny_cubicBS;
 
-    //Calculate and store Tight Quadratic stencil differentiated or nabla*weight for quadratic stencil
-    Eigen::Vector3f quadS_Diff;
+  cubicBS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
+  o_interpolationData.m_cubicBSpline_Diff=cubicBS_Diff;
 
-    float dNx_quadS=MathFunctions::calcTightQuadraticStencil_Diff(centrePosDiff(0)/m_cellSize);
-    float dNy_quadS=MathFunctions::calcTightQuadraticStencil_Diff(centrePosDiff(1)/m_cellSize);
-    float dNz_quadS=MathFunctions::calcTightQuadraticStencil_Diff(centrePosDiff(2)/m_cellSize);
 
-    quadS_Diff(0)=dNx_quadS*NyCentre_quadS*NzCentre_quadS;
-    quadS_Diff(1)=dNy_quadS*NxCentre_quadS*NzCentre_quadS;
-    quadS_Diff(2)=dNz_quadS*NxCentre_quadS*NyCentre_quadS;
+  //Calculate and store Tight Quadratic stencil
+  float Nx_quadS=MathFunctions::calcTightQuadraticStencil(posDiff(0)/m_cellSize);
+  float Ny_quadS=MathFunctions::calcTightQuadraticStencil(posDiff(1)/m_cellSize);
+  float Nz_quadS=MathFunctions::calcTightQuadraticStencil(posDiff(2)/m_cellSize);
+  o_interpolationData.m_tightQuadStencil=Nx_quadS*Ny_quadS*Nz_quadS;
 
-    quadS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_tightQuadStencil_Diff=quadS_Diff;
 
+  //Calculate and store Tight Quadratic stencil differentiated or nabla*weight for quadratic stencil
+  Eigen::Vector3f quadS_Diff;
 
-    //Store interpolation data
-    m_cellCentres[cellListIndex]->m_interpolationData.push_back(newInterpolationData);
-  }
+  float dNx_quadS=MathFunctions::calcTightQuadraticStencil_Diff(posDiff(0)/m_cellSize);
+  float dNy_quadS=MathFunctions::calcTightQuadraticStencil_Diff(posDiff(1)/m_cellSize);
+  float dNz_quadS=MathFunctions::calcTightQuadraticStencil_Diff(posDiff(2)/m_cellSize);
 
-  //FaceX
-  if (NFaceX_cubicBS!=0)
-  {
-    //Create interpolation data pointer
-    InterpolationData* newInterpolationData= new InterpolationData;
+  quadS_Diff(0)=dNx_quadS*Ny_quadS*Nz_quadS;
+  quadS_Diff(1)=dNy_quadS*Nx_quadS*Nz_quadS;
+  quadS_Diff(2)=dNz_quadS*Nx_quadS*Ny_quadS;
 
-    //Store particle
-    newInterpolationData->m_particle=_particle;
+  quadS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
+  o_interpolationData.m_tightQuadStencil_Diff=quadS_Diff;
 
-    //Store cubicBSpline
-    newInterpolationData->m_cubicBSpline=NFaceX_cubicBS;
 
-    //Calculate and store cubicBSpline differentiated or nabla*weight for cubicBS weight
-    Eigen::Vector3f cubicBS_Diff;
+  //Store cell it belongs to, so particles can find their interpolation data in deterministic mode
+  o_interpolationData.m_cellIndex=MathFunctions::getVectorIndex(_i, _j, _k, m_noCells);
+  o_interpolationData.m_faceDirection=_faceDirection;
+}
 
-    float dNx_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceXPosDiff(0)/m_cellSize);
-    float dNy_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceXPosDiff(1)/m_cellSize);
-    float dNz_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceXPosDiff(2)/m_cellSize);
+//----------------------------------------------------------------------------------------------------------------------
 
-    cubicBS_Diff(0)=dNx_cubicBS*NyFaceX_cubicBS*NzFaceX_cubicBS;
-    cubicBS_Diff(1)=dNy_cubicBS*NxFaceX_cubicBS*NzFaceX_cubicBS;
-    cubicBS_Diff(2)=dNz_cubicBS*NxFaceX_cubicBS*NyFaceX_cubicBS;
+void Grid::transferParticleData(Emitter* _emitter)
+{
+  /* Outline
+  -----------------------------------------------------------------------------------------------------
+  Loop done in update - could be moved to here and remove cellIndex input
 
-    cubicBS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_cubicBSpline_Diff=cubicBS_Diff;
-
-
-    //Calculate and store Tight Quadratic stencil
-    float NxFaceX_quadS=MathFunctions::calcTightQuadraticStencil(faceXPosDiff(0)/m_cellSize);
-    float NyFaceX_quadS=MathFunctions::calcTightQuadraticStencil(faceXPosDiff(1)/m_cellSize);
-    float NzFaceX_quadS=MathFunctions::calcTightQuadraticStencil(faceXPosDiff(2)/m_cellSize);
-    float NFaceX_quadS=NxFaceX_quadS*NyFaceX_quadS*NzFaceX_quadS;
-    newInterpolationData->m_tightQuadStencil=NFaceX_quadS;
-
-
-    //Calculate and store Tight Quadratic stencil differentiated or nabla*weight for quadratic stencil
-    Eigen::Vector3f quadS_Diff;
-
-    float dNx_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceXPosDiff(0)/m_cellSize);
-    float dNy_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceXPosDiff(1)/m_cellSize);
-    float dNz_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceXPosDiff(2)/m_cellSize);
-
-    quadS_Diff(0)=dNx_quadS*NyFaceX_quadS*NzFaceX_quadS;
-    quadS_Diff(1)=dNy_quadS*NxFaceX_quadS*NzFaceX_quadS;
-    quadS_Diff(2)=dNz_quadS*NxFaceX_quadS*NyFaceX_quadS;
-
-    quadS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_tightQuadStencil_Diff=quadS_Diff;
-
-
-    //Store interpolation data
-    m_cellFacesX[cellListIndex]->m_interpolationData.push_back(newInterpolationData);
-  }
-
-  //FaceY
-  if (NFaceY_cubicBS!=0)
-  {
-    //Create interpolation data pointer
-    InterpolationData* newInterpolationData= new InterpolationData;
-
-    //Store particle
-    newInterpolationData->m_particle=_particle;
-
-    //Store cubicBSpline
-    newInterpolationData->m_cubicBSpline=NFaceY_cubicBS;
-
-    //Calculate and store cubicBSpline differentiated or nabla*weight for cubicBS weight
-    Eigen::Vector3f cubicBS_Diff;
-
-    float dNx_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceYPosDiff(0)/m_cellSize);
-    float dNy_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceYPosDiff(1)/m_cellSize);
-    float dNz_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceYPosDiff(2)/m_cellSize);
-
-    cubicBS_Diff(0)=dNx_cubicBS*NyFaceY_cubicBS*NzFaceY_cubicBS;
-    cubicBS_Diff(1)=dNy_cubicBS*NxFaceY_cubicBS*NzFaceY_cubicBS;
-    cubicBS_Diff(2)=dNz_cubicBS*NxFaceY_cubicBS*NyFaceY_cubicBS;
-
-    cubicBS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_cubicBSpline_Diff=cubicBS_Diff;
-
-
-    //Calculate and store Tight Quadratic stencil
-    float NxFaceY_quadS=MathFunctions::calcTightQuadraticStencil(faceYPosDiff(0)/m_cellSize);
-    float NyFaceY_quadS=MathFunctions::calcTightQuadraticStencil(faceYPosDiff(1)/m_cellSize);
-    float NzFaceY_quadS=MathFunctions::calcTightQuadraticStencil(faceYPosDiff(2)/m_cellSize);
-    float NFaceY_quadS=NxFaceY_quadS*NyFaceY_quadS*NzFaceY_quadS;
-    newInterpolationData->m_tightQuadStencil=NFaceY_quadS;
-
-
-    //Calculate and store Tight Quadratic stencil differentiated or nabla*weight for quadratic stencil
-    Eigen::Vector3f quadS_Diff;
-
-    float dNx_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceYPosDiff(0)/m_cellSize);
-    float dNy_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceYPosDiff(1)/m_cellSize);
-    float dNz_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceYPosDiff(2)/m_cellSize);
-
-    quadS_Diff(0)=dNx_quadS*NyFaceY_quadS*NzFaceY_quadS;
-    quadS_Diff(1)=dNy_quadS*NxFaceY_quadS*NzFaceY_quadS;
-    quadS_Diff(2)=dNz_quadS*NxFaceY_quadS*NyFaceY_quadS;
-
-    quadS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_tightQuadStencil_Diff=quadS_Diff;
-
-
-    //Store interpolation data
-    m_cellFacesY[cellListIndex]->m_interpolationData.push_back(newInterpolationData);
-  }
-
-  //FaceZ
-  if (NFaceZ_cubicBS!=0)
-  {
-    //Create interpolation data pointer
-    InterpolationData* newInterpolationData= new InterpolationData;
-
-    //Store particle
-    newInterpolationData->m_particle=_particle;
-
-    //Store cubicBSpline
-    newInterpolationData->m_cubicBSpline=NFaceZ_cubicBS;
-
-    //Calculate and store cubicBSpline differentiated or nabla*weight for cubicBS weight
-    Eigen::Vector3f cubicBS_Diff;
-
-    float dNx_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceZPosDiff(0)/m_cellSize);
-    float dNy_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceZPosDiff(1)/m_cellSize);
-    float dNz_cubicBS=MathFunctions::calcCubicBSpline_Diff(faceZPosDiff(2)/m_cellSize);
-
-    cubicBS_Diff(0)=dNx_cubicBS*NyFaceZ_cubicBS*NzFaceZ_cubicBS;
-    cubicBS_Diff(1)=dNy_cubicBS*NxFaceZ_cubicBS*NzFaceZ_cubicBS;
-    cubicBS_Diff(2)=dNz_cubicBS*NxFaceZ_cubicBS*NyFaceZ_cubicBS;
-
-    cubicBS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_cubicBSpline_Diff=cubicBS_Diff;
-
-
-    //Calculate and store Tight Quadratic stencil
-    float NxFaceZ_quadS=MathFunctions::calcTightQuadraticStencil(faceZPosDiff(0)/m_cellSize);
-    float NyFaceZ_quadS=MathFunctions::calcTightQuadraticStencil(faceZPosDiff(1)/m_cellSize);
-    float NzFaceZ_quadS=MathFunctions::calcTightQuadraticStencil(faceZPosDiff(2)/m_cellSize);
-    float NFaceZ_quadS=NxFaceZ_quadS*NyFaceZ_quadS*NzFaceZ_quadS;
-    newInterpolationData->m_tightQuadStencil=NFaceZ_quadS;
-
-
-    //Calculate and store Tight Quadratic stencil differentiated or nabla*weight for quadratic stencil
-    Eigen::Vector3f quadS_Diff;
-
-    float dNx_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceZPosDiff(0)/m_cellSize);
-    float dNy_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceZPosDiff(1)/m_cellSize);
-    float dNz_quadS=MathFunctions::calcTightQuadraticStencil_Diff(faceZPosDiff(2)/m_cellSize);
-
-    quadS_Diff(0)=dNx_quadS*NyFaceZ_quadS*NzFaceZ_quadS;
-    quadS_Diff(1)=dNy_quadS*NxFaceZ_quadS*NzFaceZ_quadS;
-    quadS_Diff(2)=dNz_quadS*NxFaceZ_quadS*NyFaceZ_quadS;
-
-    quadS_Diff*=(1.0/m_cellSize); ///Not sure about this part?
-    newInterpolationData->m_tightQuadStencil_Diff=quadS_Diff;
-
-
-    //Store interpolation data
-    m_cellFacesZ[cellListIndex]->m_interpolationData.push_back(newInterpolationData);
-  }
-}
-
-//----------------------------------------------------------------------------------------------------------------------
-
-void Grid::transferParticleData(Emitter* _emitter)
-{
-  /* Outline
-  -----------------------------------------------------------------------------------------------------
-  Loop done in update - could be moved to here and remove cellIndex input
-
-    Check that m_InterpolationData is not empty - If it is, set everything to zero?
+    Check that m_InterpolationData is not empty - If it is, set everything to zero?
 
     For each particle in the list calculate all variables, i for cell faces i={x,y,z} and c for cell centre
       m_i
@@ -822,182 +1173,189 @@ void Grid::transferParticleData(Emitter* _emitter)
   -----------------------------------------------------------------------------------------------------
   */
 
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  PROFILE_STAGE(TransferParticleData);
+
+#pragma omp parallel
   {
+    TRACE_SCOPE("TransferParticleData", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
 //    //Test parallel
 //    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
 
-    //Face X
-    //Check that non-empty, ie. that it has particles in it
-    int noParticles_CellFaceX=m_cellFacesX[cellIndex]->m_interpolationData.size();
-    if (noParticles_CellFaceX!=0)
-    {
-      for (int particleIterator=0; particleIterator<noParticles_CellFaceX; particleIterator++)
+      //Face X
+      //Check that non-empty, ie. that it has particles in it
+      int noParticles_CellFaceX=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+      if (noParticles_CellFaceX!=0)
       {
-        //Get interpolation weight: cubic B spline
-        float weight=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator]->m_cubicBSpline;
-
-        //Get particle data
-        float mass=0.0;
-        Eigen::Vector3f velocity;
-        Phase phase=Phase::Solid;
-        m_cellFacesX[cellIndex]->m_interpolationData[particleIterator]->m_particle->getParticleData_CellFace(mass, velocity, phase);
-        float velocityX=velocity(0);
-
-        //Add to cell face data
-        m_cellFacesX[cellIndex]->m_mass+=(weight*mass);
-        m_cellFacesX[cellIndex]->m_velocity+=((weight*mass)*velocityX);
-
-        //Find heat conductivity depending on phase
-        float heatConductivity=0.0;
-        if (phase==Phase::Solid)
+        for (int particleIterator=0; particleIterator<noParticles_CellFaceX; particleIterator++)
         {
-          heatConductivity=_emitter->m_heatConductivitySolid;
-        }
-        else
-        {
-          heatConductivity=_emitter->m_heatConductivityFluid;
-        }
-        m_cellFacesX[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
+          //Get interpolation weight: cubic B spline
+          float weight=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator].m_cubicBSpline;
+
+          //Get particle data
+          float mass=0.0;
+          Eigen::Vector3f velocity;
+          Phase phase=Phase::Solid;
+          m_cellFacesX[cellIndex]->m_interpolationData[particleIterator].m_particle->getParticleData_CellFace(mass, velocity, phase);
+          float velocityX=velocity(0);
+
+          //Add to cell face data
+          m_cellFacesX[cellIndex]->m_mass+=(weight*mass);
+          m_cellFacesX[cellIndex]->m_velocity+=((weight*mass)*velocityX);
+
+          //Find heat conductivity depending on phase
+          float heatConductivity=0.0;
+          if (phase==Phase::Solid)
+          {
+            heatConductivity=_emitter->m_heatConductivitySolid;
+          }
+          else
+          {
+            heatConductivity=_emitter->m_heatConductivityFluid;
+          }
+          m_cellFacesX[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
 
-      }
+        }
 
-      //Multiply data by 1/m_{i}
-      m_cellFacesX[cellIndex]->m_velocity*=(1.0/m_cellFacesX[cellIndex]->m_mass);
-      m_cellFacesX[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesX[cellIndex]->m_mass);
+        //Multiply data by 1/m_{i}
+        m_cellFacesX[cellIndex]->m_velocity*=(1.0/m_cellFacesX[cellIndex]->m_mass);
+        m_cellFacesX[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesX[cellIndex]->m_mass);
 
-    }
+      }
 
-    //Face Y
-    int noParticles_CellFaceY=m_cellFacesY[cellIndex]->m_interpolationData.size();
-    if (noParticles_CellFaceY!=0)
-    {
-      for (int particleIterator=0; particleIterator<noParticles_CellFaceY; particleIterator++)
+      //Face Y
+      int noParticles_CellFaceY=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+      if (noParticles_CellFaceY!=0)
       {
-        //Get interpolation weight
-        float weight=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator]->m_cubicBSpline;
-
-        //Get particle data
-        float mass=0.0;
-        Eigen::Vector3f velocity;
-        Phase phase=Phase::Solid;
-        m_cellFacesY[cellIndex]->m_interpolationData[particleIterator]->m_particle->getParticleData_CellFace(mass, velocity, phase);
-        float velocityY=velocity(1);
-
-        //Add to cell face data
-        m_cellFacesY[cellIndex]->m_mass+=(weight*mass);
-        m_cellFacesY[cellIndex]->m_velocity+=((weight*mass)*velocityY);
-
-        //Find heat conductivity depending on phase
-        float heatConductivity=0.0;
-        if (phase==Phase::Solid)
-        {
-          heatConductivity=_emitter->m_heatConductivitySolid;
-        }
-        else
+        for (int particleIterator=0; particleIterator<noParticles_CellFaceY; particleIterator++)
         {
-          heatConductivity=_emitter->m_heatConductivityFluid;
-        }
-        m_cellFacesY[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
+          //Get interpolation weight
+          float weight=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator].m_cubicBSpline;
+
+          //Get particle data
+          float mass=0.0;
+          Eigen::Vector3f velocity;
+          Phase phase=Phase::Solid;
+          m_cellFacesY[cellIndex]->m_interpolationData[particleIterator].m_particle->getParticleData_CellFace(mass, velocity, phase);
+          float velocityY=velocity(1);
+
+          //Add to cell face data
+          m_cellFacesY[cellIndex]->m_mass+=(weight*mass);
+          m_cellFacesY[cellIndex]->m_velocity+=((weight*mass)*velocityY);
+
+          //Find heat conductivity depending on phase
+          float heatConductivity=0.0;
+          if (phase==Phase::Solid)
+          {
+            heatConductivity=_emitter->m_heatConductivitySolid;
+          }
+          else
+          {
+            heatConductivity=_emitter->m_heatConductivityFluid;
+          }
+          m_cellFacesY[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
 
-      }
+        }
 
-      //Multiply data by 1/m_{i}
-      m_cellFacesY[cellIndex]->m_velocity*=(1.0/m_cellFacesY[cellIndex]->m_mass);
-      m_cellFacesY[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesY[cellIndex]->m_mass);
+        //Multiply data by 1/m_{i}
+        m_cellFacesY[cellIndex]->m_velocity*=(1.0/m_cellFacesY[cellIndex]->m_mass);
+        m_cellFacesY[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesY[cellIndex]->m_mass);
 
-    }
+      }
 
-    //Face Z
-    int noParticles_CellFaceZ=m_cellFacesZ[cellIndex]->m_interpolationData.size();
-    if (noParticles_CellFaceZ!=0)
-    {
-      for (int particleIterator=0; particleIterator<noParticles_CellFaceZ; particleIterator++)
+      //Face Z
+      int noParticles_CellFaceZ=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
+      if (noParticles_CellFaceZ!=0)
       {
-        //Get interpolation weight
-        float weight=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator]->m_cubicBSpline;
-
-        //Get particle data
-        float mass=0.0;
-        Eigen::Vector3f velocity;
-        Phase phase=Phase::Solid;
-        m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator]->m_particle->getParticleData_CellFace(mass, velocity, phase);
-        float velocityZ=velocity(2);
-
-        //Add to cell face data
-        m_cellFacesZ[cellIndex]->m_mass+=(weight*mass);
-        m_cellFacesZ[cellIndex]->m_velocity+=((weight*mass)*velocityZ);
-
-        //Find heat conductivity depending on phase
-        float heatConductivity=0.0;
-        if (phase==Phase::Solid)
+        for (int particleIterator=0; particleIterator<noParticles_CellFaceZ; particleIterator++)
         {
-          heatConductivity=_emitter->m_heatConductivitySolid;
-        }
-        else
-        {
-          heatConductivity=_emitter->m_heatConductivityFluid;
-        }
-        m_cellFacesZ[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
+          //Get interpolation weight
+          float weight=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator].m_cubicBSpline;
+
+          //Get particle data
+          float mass=0.0;
+          Eigen::Vector3f velocity;
+          Phase phase=Phase::Solid;
+          m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator].m_particle->getParticleData_CellFace(mass, velocity, phase);
+          float velocityZ=velocity(2);
+
+          //Add to cell face data
+          m_cellFacesZ[cellIndex]->m_mass+=(weight*mass);
+          m_cellFacesZ[cellIndex]->m_velocity+=((weight*mass)*velocityZ);
+
+          //Find heat conductivity depending on phase
+          float heatConductivity=0.0;
+          if (phase==Phase::Solid)
+          {
+            heatConductivity=_emitter->m_heatConductivitySolid;
+          }
+          else
+          {
+            heatConductivity=_emitter->m_heatConductivityFluid;
+          }
+          m_cellFacesZ[cellIndex]->m_heatConductivity+=((weight*mass)*heatConductivity);
 
-      }
+        }
 
-      //Multiply data by 1/m_{i}
-      m_cellFacesZ[cellIndex]->m_velocity*=(1.0/m_cellFacesZ[cellIndex]->m_mass);
-      m_cellFacesZ[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesZ[cellIndex]->m_mass);
+        //Multiply data by 1/m_{i}
+        m_cellFacesZ[cellIndex]->m_velocity*=(1.0/m_cellFacesZ[cellIndex]->m_mass);
+        m_cellFacesZ[cellIndex]->m_heatConductivity*=(1.0/m_cellFacesZ[cellIndex]->m_mass);
 
-    }
+      }
 
-    //Cell centre
-    int noParticles_CellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-    if (noParticles_CellCentre!=0)
-    {
-      for (int particleIterator=0; particleIterator<noParticles_CellCentre; particleIterator++)
+      //Cell centre
+      int noParticles_CellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+      if (noParticles_CellCentre!=0)
       {
-        //Get interpolation weight
-        float weight=m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_cubicBSpline;
-
-        //Get particle data
-        float mass=0.0;
-        float detDeformGrad=0.0;
-        float detDeformGradElast=0.0;
-        Phase phase=Phase::Solid;
-        float temperature=0.0;
-        float lameLambdaInverse=0.0;
-        m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_particle->getParticleData_CellCentre(mass, detDeformGrad, detDeformGradElast, phase, temperature, lameLambdaInverse);
-
-        //Add to cell centre data
-        m_cellCentres[cellIndex]->m_mass+=(weight*mass);
-        m_cellCentres[cellIndex]->m_detDeformationGrad+=((weight*mass)*detDeformGrad);
-        m_cellCentres[cellIndex]->m_detDeformationGradElastic+=((weight*mass)*detDeformGradElast);
-        m_cellCentres[cellIndex]->m_temperature+=((weight*mass)*temperature);
-        m_cellCentres[cellIndex]->m_lameLambdaInverse+=((weight*mass)*lameLambdaInverse);
-
-        //Get heat capacity depending on phase
-        float heatCapacity=0.0;
-        if (phase==Phase::Solid)
+        for (int particleIterator=0; particleIterator<noParticles_CellCentre; particleIterator++)
         {
-          heatCapacity=_emitter->m_heatCapacitySolid;
-        }
-        else
-        {
-          heatCapacity=_emitter->m_heatCapacityFluid;
-        }
-        m_cellCentres[cellIndex]->m_heatCapacity+=((weight*mass)*heatCapacity);
+          //Get interpolation weight
+          float weight=m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_cubicBSpline;
+
+          //Get particle data
+          float mass=0.0;
+          float detDeformGrad=0.0;
+          float detDeformGradElast=0.0;
+          Phase phase=Phase::Solid;
+          float temperature=0.0;
+          float lameLambdaInverse=0.0;
+          m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_particle->getParticleData_CellCentre(mass, detDeformGrad, detDeformGradElast, phase, temperature, lameLambdaInverse);
+
+          //Add to cell centre data
+          m_cellCentres[cellIndex]->m_mass+=(weight*mass);
+          m_cellCentres[cellIndex]->m_detDeformationGrad+=((weight*mass)*detDeformGrad);
+          m_cellCentres[cellIndex]->m_detDeformationGradElastic+=((weight*mass)*detDeformGradElast);
+          m_cellCentres[cellIndex]->m_temperature+=((weight*mass)*temperature);
+          m_cellCentres[cellIndex]->m_lameLambdaInverse+=((weight*mass)*lameLambdaInverse);
+
+          //Get heat capacity depending on phase
+          float heatCapacity=0.0;
+          if (phase==Phase::Solid)
+          {
+            heatCapacity=_emitter->m_heatCapacitySolid;
+          }
+          else
+          {
+            heatCapacity=_emitter->m_heatCapacityFluid;
+          }
+          m_cellCentres[cellIndex]->m_heatCapacity+=((weight*mass)*heatCapacity);
 
-      }
+        }
 
-      //Multiply data by 1/m_{c}
-      m_cellCentres[cellIndex]->m_detDeformationGrad*=(1.0/m_cellCentres[cellIndex]->m_mass);
-      m_cellCentres[cellIndex]->m_detDeformationGradElastic*=(1.0/m_cellCentres[cellIndex]->m_mass);
-      m_cellCentres[cellIndex]->m_heatCapacity*=(1.0/m_cellCentres[cellIndex]->m_mass);
-      m_cellCentres[cellIndex]->m_temperature*=(1.0/m_cellCentres[cellIndex]->m_mass);
-      m_cellCentres[cellIndex]->m_lameLambdaInverse*=(1.0/m_cellCentres[cellIndex]->m_mass);
+        //Multiply data by 1/m_{c}
+        m_cellCentres[cellIndex]->m_detDeformationGrad*=(1.0/m_cellCentres[cellIndex]->m_mass);
+        m_cellCentres[cellIndex]->m_detDeformationGradElastic*=(1.0/m_cellCentres[cellIndex]->m_mass);
+        m_cellCentres[cellIndex]->m_heatCapacity*=(1.0/m_cellCentres[cellIndex]->m_mass);
+        m_cellCentres[cellIndex]->m_temperature*=(1.0/m_cellCentres[cellIndex]->m_mass);
+        m_cellCentres[cellIndex]->m_lameLambdaInverse*=(1.0/m_cellCentres[cellIndex]->m_mass);
 
-      //Calculate detDeformationGrad_Plastic, ie. J_{Pc}=J_{c}/J_{Ec}
-      m_cellCentres[cellIndex]->m_detDeformationGradPlastic=m_cellCentres[cellIndex]->m_detDeformationGrad;
-      m_cellCentres[cellIndex]->m_detDeformationGradPlastic*=(1.0/m_cellCentres[cellIndex]->m_detDeformationGradElastic);
+        //Calculate detDeformationGrad_Plastic, ie. J_{Pc}=J_{c}/J_{Ec}
+        m_cellCentres[cellIndex]->m_detDeformationGradPlastic=m_cellCentres[cellIndex]->m_detDeformationGrad;
+        m_cellCentres[cellIndex]->m_detDeformationGradPlastic*=(1.0/m_cellCentres[cellIndex]->m_detDeformationGradElastic);
+      }
     }
   }
 }
@@ -1006,29 +1364,48 @@ void Grid::transferParticleData(Emitter* _emitter)
 
 void Grid::calcInitialParticleVolumes(Emitter *_emitter)
 {
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  PROFILE_STAGE(InitialParticleVolumes);
+
+  if (m_isParticleStencilCache)
+  {
+    calcInitialParticleVolumes_Cached();
+    return;
+  }
+
+  if (m_isDeterministic)
   {
-    //Test parallel
+    calcInitialParticleVolumes_Deterministic(_emitter);
+    return;
+  }
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("InitialParticleVolumes", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      //Test parallel
 //    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
 
-    //Cell volume
-    float cellVolume=pow(m_cellSize,3);
+      //Cell volume
+      float cellVolume=pow(m_cellSize,3);
 
-    //Add grid cells contribution to particle density
-    int noParticles_CellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
+      //Add grid cells contribution to particle density
+      int noParticles_CellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
 
-    //Get cell centre mass
-    float mass=m_cellCentres[cellIndex]->m_mass;
+      //Get cell centre mass
+      float mass=m_cellCentres[cellIndex]->m_mass;
 
-    for (int particleIterator=0; particleIterator<noParticles_CellCentre; particleIterator++)
-    {
-      //Get cubicBSpline weight for cell centre i and particle particleIterator
-      float weight=m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_cubicBSpline;
+      for (int particleIterator=0; particleIterator<noParticles_CellCentre; particleIterator++)
+      {
+        //Get cubicBSpline weight for cell centre i and particle particleIterator
+        float weight=m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_cubicBSpline;
 
-      //Add density from this cell to particle
-      float density=(weight*mass)/cellVolume;
-      m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_particle->addParticleDensity(density);
+        //Add density from this cell to particle
+        float density=(weight*mass)/cellVolume;
+        m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_particle->addParticleDensity(density);
+      }
     }
   }
 
@@ -1042,6 +1419,56 @@ void Grid::calcInitialParticleVolumes(Emitter *_emitter)
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Grid::calcInitialParticleVolumes_Deterministic(Emitter *_emitter)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over sorted particles
+    Loop over interpolation data of particle, which is in a fixed order
+      If cell centre, add density contribution of cell to particle
+    Calculate particle volume
+
+  Each particle is only written by one thread, so no scattered additions
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  //Cell volume
+  float cellVolume=pow(m_cellSize,3);
+
+  int noParticles=_emitter->getNoParticles();
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("InitialParticleVolumes", "thread");
+
+#pragma omp for nowait
+    for (int sortedIndex=0; sortedIndex<noParticles; sortedIndex++)
+    {
+      Particle* particle=_emitter->m_particles[m_sortedParticleIndices[sortedIndex]];
+
+      for (int dataIndex=m_particleInterpolationOffsets[sortedIndex]; dataIndex<m_particleInterpolationOffsets[sortedIndex+1]; dataIndex++)
+      {
+        const InterpolationData* interpolationData=&m_interpolationData[m_particleInterpolationData[dataIndex]];
+
+        if (interpolationData->m_faceDirection==-1)
+        {
+          //Get cell centre mass and cubicBSpline weight
+          float mass=m_cellCentres[interpolationData->m_cellIndex]->m_mass;
+          float weight=interpolationData->m_cubicBSpline;
+
+          //Add density from this cell to particle
+          float density=(weight*mass)/cellVolume;
+          particle->addParticleDensity(density);
+        }
+      }
+
+      particle->calcInitialVolume();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Grid::classifyCells()
 {
   /* Outline - Current setup might be time consuming since two loops. Could rectify this for bounding box, but not for level sets I think
@@ -1049,6 +1476,7 @@ void Grid::classifyCells()
   Loop over all cell faces
     Check faces against collision
       For now use bounding box, so colliding if i<2||>n-2, j<2||>n-2, k<2||>n-2
+      Faces inside collision objects are colliding as well
 
   Loop over all cell centres
     Check if 3 faces are colliding - If cell centre is i<n-1, j<n-1 or k<n-1 then check the faces of the nearest neighbour
@@ -1062,138 +1490,101 @@ void Grid::classifyCells()
   ----------------------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(ClassifyCells);
+
+  bool isCheckingCollisionObjects=!m_isFaceInCollisionObject[0].empty();
+
   //Loop over cell faces - This loop could be made smaller when just checking the outer cells.
   //But this is possibly easier to thread
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+#pragma omp parallel
   {
-    //Test parallel
-//    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
-
-    //Find cell index. Will be same for the other faces
-    int iIndex=m_cellFacesX[cellIndex]->m_iIndex;
-    int jIndex=m_cellFacesX[cellIndex]->m_jIndex;
-    int kIndex=m_cellFacesX[cellIndex]->m_kIndex;
-
-    //This checks whether cell faces belong to outer cells. To set collision cells to be the outer rim of cells
-    if (iIndex==0 || iIndex==(m_noCells-1) || jIndex==0 || jIndex==(m_noCells-1) || kIndex==0 || kIndex==(m_noCells-1) )
-    {
-      //Set faces to colliding
-      m_cellFacesX[cellIndex]->m_state=State::Colliding;
-      m_cellFacesY[cellIndex]->m_state=State::Colliding;
-      m_cellFacesZ[cellIndex]->m_state=State::Colliding;
-    }
+    TRACE_SCOPE("ClassifyCells", "thread");
 
-    //Also need to set cell faces adjacent to the outer cells to colliding. This must be done separately for each cell
-    if (iIndex==1)
-    {
-      m_cellFacesX[cellIndex]->m_state=State::Colliding;
-    }
-    if (jIndex==1)
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
     {
-      m_cellFacesY[cellIndex]->m_state=State::Colliding;
-    }
-    if (kIndex==1)
-    {
-      m_cellFacesZ[cellIndex]->m_state=State::Colliding;
-    }
-  }
-
-  //This step will work for level set collisions as well.
-  //Loop over all cells again to check which cell centres are collding
-  //Seems inefficient.
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
-  {
-    //Test parallel
+      //Test parallel
 //    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
 
-    //Find cell index.
-    int iIndex=m_cellCentres[cellIndex]->m_iIndex;
-    int jIndex=m_cellCentres[cellIndex]->m_jIndex;
-    int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+      //Find cell index. Will be same for the other faces
+      int iIndex=m_cellFacesX[cellIndex]->m_iIndex;
+      int jIndex=m_cellFacesX[cellIndex]->m_jIndex;
+      int kIndex=m_cellFacesX[cellIndex]->m_kIndex;
 
-    //Get indices of faces in the positive ijk directions
-    int cellIndex_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
-    int cellIndex_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
-    int cellIndex_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
-
-    //Face X
-    //Check if lower x face colliding
-    if (m_cellFacesX[cellIndex]->m_state!=State::Colliding)
-    {
-      //Check whether empty or not
-      int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
-
-      //Get particle number for upper faces of cell, unless outermost cells in grid
-      int noParticlesInCellFaceX1=0;
-      int noParticlesInCellFaceY1=0;
-      int noParticlesInCellFaceZ1=0;
-
-      if (iIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
-      }
-      if (jIndex!=(m_noCells-1))
+      //This checks whether cell faces belong to outer cells. To set collision cells to be the outer rim of cells
+      if (iIndex==0 || iIndex==(m_noCells-1) || jIndex==0 || jIndex==(m_noCells-1) || kIndex==0 || kIndex==(m_noCells-1) )
       {
-        noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
+        //Set faces to colliding
+        m_cellFacesX[cellIndex]->m_state=State::Colliding;
+        m_cellFacesY[cellIndex]->m_state=State::Colliding;
+        m_cellFacesZ[cellIndex]->m_state=State::Colliding;
       }
-      if (kIndex!=(m_noCells-1))
+
+      //Also need to set cell faces adjacent to the outer cells to colliding. This must be done separately for each cell
+      if (iIndex==1)
       {
-        noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
+        m_cellFacesX[cellIndex]->m_state=State::Colliding;
       }
-
-      //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//      if (noParticlesInCellCentre!=0
-//          && noParticlesInCellFaceX1!=0
-//          && noParticlesInCellFaceX_1!=0
-//          && noParticlesInCellFaceY1!=0
-//          && noParticlesInCellFaceY_1!=0
-//          && noParticlesInCellFaceZ1!=0
-//          && noParticlesInCellFaceZ_1!=0)
-      if (noParticlesInCellCentre>m_noParticlesThreshold
-          && noParticlesInCellFaceX1>m_noParticlesThreshold
-          && noParticlesInCellFaceX_1>m_noParticlesThreshold
-          && noParticlesInCellFaceY1>m_noParticlesThreshold
-          && noParticlesInCellFaceY_1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
+      if (jIndex==1)
       {
-        m_cellCentres[cellIndex]->m_state=State::Interior;
+        m_cellFacesY[cellIndex]->m_state=State::Colliding;
       }
-      //Otherwise the cell is empty
-      else
+      if (kIndex==1)
       {
-        m_cellCentres[cellIndex]->m_state=State::Empty;
-        m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
+        m_cellFacesZ[cellIndex]->m_state=State::Colliding;
       }
 
-      //Set face to empty as well
-      if (noParticlesInCellFaceX_1<=m_noParticlesThreshold)
+      //Faces inside collision objects, found once in setCollisionObjects
+      if (isCheckingCollisionObjects)
       {
-        m_cellFacesX[cellIndex]->m_state=State::Empty;
+        if (m_isFaceInCollisionObject[0][cellIndex])
+        {
+          m_cellFacesX[cellIndex]->m_state=State::Colliding;
+        }
+        if (m_isFaceInCollisionObject[1][cellIndex])
+        {
+          m_cellFacesY[cellIndex]->m_state=State::Colliding;
+        }
+        if (m_isFaceInCollisionObject[2][cellIndex])
+        {
+          m_cellFacesZ[cellIndex]->m_state=State::Colliding;
+        }
       }
-
-      //Go to next cellIndex
-      continue;
     }
+  }
 
-    //Check upper x face as well
-    if (iIndex<(m_noCells-1))
+  //This step will work for level set collisions as well.
+  //Loop over all cells again to check which cell centres are collding
+  //Seems inefficient.
+#pragma omp parallel
+  {
+    TRACE_SCOPE("ClassifyCells", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
     {
-      //Get index of cell with X face next to current cell
-//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
+      //Test parallel
+//    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
+
+      //Find cell index.
+      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
 
-      if (m_cellFacesX[cellIndex_i1jk]->m_state!=State::Colliding)
+      //Get indices of faces in the positive ijk directions
+      int cellIndex_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
+      int cellIndex_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
+      int cellIndex_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
+
+      //Face X
+      //Check if lower x face colliding
+      if (m_cellFacesX[cellIndex]->m_state!=State::Colliding)
       {
         //Check whether empty or not
-        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
+        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
 
         //Get particle number for upper faces of cell, unless outermost cells in grid
         int noParticlesInCellFaceX1=0;
@@ -1202,25 +1593,25 @@ void Grid::classifyCells()
 
         if (iIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
+          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
         }
         if (jIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
+          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
         }
         if (kIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
+          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
         }
 
         //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//        if (noParticlesInCellCentre!=0
-//            && noParticlesInCellFaceX1!=0
-//            && noParticlesInCellFaceX_1!=0
-//            && noParticlesInCellFaceY1!=0
-//            && noParticlesInCellFaceY_1!=0
-//            && noParticlesInCellFaceZ1!=0
-//            && noParticlesInCellFaceZ_1!=0)
+//      if (noParticlesInCellCentre!=0
+//          && noParticlesInCellFaceX1!=0
+//          && noParticlesInCellFaceX_1!=0
+//          && noParticlesInCellFaceY1!=0
+//          && noParticlesInCellFaceY_1!=0
+//          && noParticlesInCellFaceZ1!=0
+//          && noParticlesInCellFaceZ_1!=0)
         if (noParticlesInCellCentre>m_noParticlesThreshold
             && noParticlesInCellFaceX1>m_noParticlesThreshold
             && noParticlesInCellFaceX_1>m_noParticlesThreshold
@@ -1238,87 +1629,87 @@ void Grid::classifyCells()
           m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
         }
 
+        //Set face to empty as well
+        if (noParticlesInCellFaceX_1<=m_noParticlesThreshold)
+        {
+          m_cellFacesX[cellIndex]->m_state=State::Empty;
+        }
+
         //Go to next cellIndex
         continue;
       }
-    }
-
-    //Face Y
-    //Check if lower x face colliding
-    if (m_cellFacesY[cellIndex]->m_state!=State::Colliding)
-    {
-      //Check whether empty or not
-      int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
-
-      //Get particle number for upper faces of cell, unless outermost cells in grid
-      int noParticlesInCellFaceX1=0;
-      int noParticlesInCellFaceY1=0;
-      int noParticlesInCellFaceZ1=0;
-
-      if (iIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
-      }
-      if (jIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
-      }
-      if (kIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
-      }
 
-      //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//      if (noParticlesInCellCentre!=0
-//          && noParticlesInCellFaceX1!=0
-//          && noParticlesInCellFaceX_1!=0
-//          && noParticlesInCellFaceY1!=0
-//          && noParticlesInCellFaceY_1!=0
-//          && noParticlesInCellFaceZ1!=0
-//          && noParticlesInCellFaceZ_1!=0)
-      if (noParticlesInCellCentre>m_noParticlesThreshold
-          && noParticlesInCellFaceX1>m_noParticlesThreshold
-          && noParticlesInCellFaceX_1>m_noParticlesThreshold
-          && noParticlesInCellFaceY1>m_noParticlesThreshold
-          && noParticlesInCellFaceY_1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
+      //Check upper x face as well
+      if (iIndex<(m_noCells-1))
       {
-        m_cellCentres[cellIndex]->m_state=State::Interior;
-      }
-      //Otherwise the cell is empty
-      else
-      {
-        m_cellCentres[cellIndex]->m_state=State::Empty;
-        m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
-      }
+        //Get index of cell with X face next to current cell
+//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
 
-      //Set face to empty as well
-      if (noParticlesInCellFaceY_1<=m_noParticlesThreshold)
-      {
-        m_cellFacesY[cellIndex]->m_state=State::Empty;
-      }
+        if (m_cellFacesX[cellIndex_i1jk]->m_state!=State::Colliding)
+        {
+          //Check whether empty or not
+          int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
+
+          //Get particle number for upper faces of cell, unless outermost cells in grid
+          int noParticlesInCellFaceX1=0;
+          int noParticlesInCellFaceY1=0;
+          int noParticlesInCellFaceZ1=0;
+
+          if (iIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
+          }
+          if (jIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
+          }
+          if (kIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
+          }
 
-      //Go to next cellIndex
-      continue;
-    }
+          //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
+//        if (noParticlesInCellCentre!=0
+//            && noParticlesInCellFaceX1!=0
+//            && noParticlesInCellFaceX_1!=0
+//            && noParticlesInCellFaceY1!=0
+//            && noParticlesInCellFaceY_1!=0
+//            && noParticlesInCellFaceZ1!=0
+//            && noParticlesInCellFaceZ_1!=0)
+          if (noParticlesInCellCentre>m_noParticlesThreshold
+              && noParticlesInCellFaceX1>m_noParticlesThreshold
+              && noParticlesInCellFaceX_1>m_noParticlesThreshold
+              && noParticlesInCellFaceY1>m_noParticlesThreshold
+              && noParticlesInCellFaceY_1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
+          {
+            m_cellCentres[cellIndex]->m_state=State::Interior;
+          }
+          //Otherwise the cell is empty
+          else
+          {
+            m_cellCentres[cellIndex]->m_state=State::Empty;
+            m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
+          }
 
-    //Check upper y face as well
-    if (jIndex<(m_noCells-1))
-    {
-      //Get index of cell with Y face next to current cell
-//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
+          //Go to next cellIndex
+          continue;
+        }
+      }
 
-      if (m_cellFacesY[cellIndex_ij1k]->m_state!=State::Colliding)
+      //Face Y
+      //Check if lower x face colliding
+      if (m_cellFacesY[cellIndex]->m_state!=State::Colliding)
       {
         //Check whether empty or not
-        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
+        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
 
         //Get particle number for upper faces of cell, unless outermost cells in grid
         int noParticlesInCellFaceX1=0;
@@ -1327,25 +1718,25 @@ void Grid::classifyCells()
 
         if (iIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
+          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
         }
         if (jIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
+          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
         }
         if (kIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
+          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
         }
 
         //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//        if (noParticlesInCellCentre!=0
-//            && noParticlesInCellFaceX1!=0
-//            && noParticlesInCellFaceX_1!=0
-//            && noParticlesInCellFaceY1!=0
-//            && noParticlesInCellFaceY_1!=0
-//            && noParticlesInCellFaceZ1!=0
-//            && noParticlesInCellFaceZ_1!=0)
+//      if (noParticlesInCellCentre!=0
+//          && noParticlesInCellFaceX1!=0
+//          && noParticlesInCellFaceX_1!=0
+//          && noParticlesInCellFaceY1!=0
+//          && noParticlesInCellFaceY_1!=0
+//          && noParticlesInCellFaceZ1!=0
+//          && noParticlesInCellFaceZ_1!=0)
         if (noParticlesInCellCentre>m_noParticlesThreshold
             && noParticlesInCellFaceX1>m_noParticlesThreshold
             && noParticlesInCellFaceX_1>m_noParticlesThreshold
@@ -1363,87 +1754,87 @@ void Grid::classifyCells()
           m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
         }
 
+        //Set face to empty as well
+        if (noParticlesInCellFaceY_1<=m_noParticlesThreshold)
+        {
+          m_cellFacesY[cellIndex]->m_state=State::Empty;
+        }
+
         //Go to next cellIndex
         continue;
       }
-    }
 
-    //Face Z
-    //Check if lower x face colliding
-    if (m_cellFacesZ[cellIndex]->m_state!=State::Colliding)
-    {
-      //Check whether empty or not
-      int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-      int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
-
-      //Get particle number for upper faces of cell, unless outermost cells in grid
-      int noParticlesInCellFaceX1=0;
-      int noParticlesInCellFaceY1=0;
-      int noParticlesInCellFaceZ1=0;
-
-      if (iIndex!=(m_noCells-1))
+      //Check upper y face as well
+      if (jIndex<(m_noCells-1))
       {
-        noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
-      }
-      if (jIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
-      }
-      if (kIndex!=(m_noCells-1))
-      {
-        noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
-      }
-
-      //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//      if (noParticlesInCellCentre!=0
-//          && noParticlesInCellFaceX1!=0
-//          && noParticlesInCellFaceX_1!=0
-//          && noParticlesInCellFaceY1!=0
-//          && noParticlesInCellFaceY_1!=0
-//          && noParticlesInCellFaceZ1!=0
-//          && noParticlesInCellFaceZ_1!=0)
-      if (noParticlesInCellCentre>m_noParticlesThreshold
-          && noParticlesInCellFaceX1>m_noParticlesThreshold
-          && noParticlesInCellFaceX_1>m_noParticlesThreshold
-          && noParticlesInCellFaceY1>m_noParticlesThreshold
-          && noParticlesInCellFaceY_1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ1>m_noParticlesThreshold
-          && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
-      {
-        m_cellCentres[cellIndex]->m_state=State::Interior;
-      }
-      //Otherwise the cell is empty
-      else
-      {
-        m_cellCentres[cellIndex]->m_state=State::Empty;
-        m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
-      }
+        //Get index of cell with Y face next to current cell
+//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
 
-      //Set face to empty as well
-      if (noParticlesInCellFaceZ_1<=m_noParticlesThreshold)
-      {
-        m_cellFacesZ[cellIndex]->m_state=State::Empty;
-      }
+        if (m_cellFacesY[cellIndex_ij1k]->m_state!=State::Colliding)
+        {
+          //Check whether empty or not
+          int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
+
+          //Get particle number for upper faces of cell, unless outermost cells in grid
+          int noParticlesInCellFaceX1=0;
+          int noParticlesInCellFaceY1=0;
+          int noParticlesInCellFaceZ1=0;
+
+          if (iIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
+          }
+          if (jIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
+          }
+          if (kIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
+          }
 
-      //Go to next cellIndex
-      continue;
-    }
+          //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
+//        if (noParticlesInCellCentre!=0
+//            && noParticlesInCellFaceX1!=0
+//            && noParticlesInCellFaceX_1!=0
+//            && noParticlesInCellFaceY1!=0
+//            && noParticlesInCellFaceY_1!=0
+//            && noParticlesInCellFaceZ1!=0
+//            && noParticlesInCellFaceZ_1!=0)
+          if (noParticlesInCellCentre>m_noParticlesThreshold
+              && noParticlesInCellFaceX1>m_noParticlesThreshold
+              && noParticlesInCellFaceX_1>m_noParticlesThreshold
+              && noParticlesInCellFaceY1>m_noParticlesThreshold
+              && noParticlesInCellFaceY_1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
+          {
+            m_cellCentres[cellIndex]->m_state=State::Interior;
+          }
+          //Otherwise the cell is empty
+          else
+          {
+            m_cellCentres[cellIndex]->m_state=State::Empty;
+            m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
+          }
 
-    //Check upper x face as well
-    if (kIndex<(m_noCells-1))
-    {
-      //Get index of cell with Z face next to current cell
-//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
+          //Go to next cellIndex
+          continue;
+        }
+      }
 
-      if (m_cellFacesZ[cellIndex_ijk1]->m_state!=State::Colliding)
+      //Face Z
+      //Check if lower x face colliding
+      if (m_cellFacesZ[cellIndex]->m_state!=State::Colliding)
       {
         //Check whether empty or not
-        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_interpolationData.size();
-        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_interpolationData.size();
+        int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+        int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
 
         //Get particle number for upper faces of cell, unless outermost cells in grid
         int noParticlesInCellFaceX1=0;
@@ -1452,25 +1843,25 @@ void Grid::classifyCells()
 
         if (iIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_interpolationData.size();
+          noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
         }
         if (jIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_interpolationData.size();
+          noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
         }
         if (kIndex!=(m_noCells-1))
         {
-          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_interpolationData.size();
+          noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
         }
 
         //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
-//        if (noParticlesInCellCentre!=0
-//            && noParticlesInCellFaceX1!=0
-//            && noParticlesInCellFaceX_1!=0
-//            && noParticlesInCellFaceY1!=0
-//            && noParticlesInCellFaceY_1!=0
-//            && noParticlesInCellFaceZ1!=0
-//            && noParticlesInCellFaceZ_1!=0)
+//      if (noParticlesInCellCentre!=0
+//          && noParticlesInCellFaceX1!=0
+//          && noParticlesInCellFaceX_1!=0
+//          && noParticlesInCellFaceY1!=0
+//          && noParticlesInCellFaceY_1!=0
+//          && noParticlesInCellFaceZ1!=0
+//          && noParticlesInCellFaceZ_1!=0)
         if (noParticlesInCellCentre>m_noParticlesThreshold
             && noParticlesInCellFaceX1>m_noParticlesThreshold
             && noParticlesInCellFaceX_1>m_noParticlesThreshold
@@ -1488,24 +1879,92 @@ void Grid::classifyCells()
           m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
         }
 
+        //Set face to empty as well
+        if (noParticlesInCellFaceZ_1<=m_noParticlesThreshold)
+        {
+          m_cellFacesZ[cellIndex]->m_state=State::Empty;
+        }
+
         //Go to next cellIndex
         continue;
       }
-    }
 
-    //This section will not be reached if faces that are non-colliding are found
-    //Set temperatures for colliding cells that are colliding with a heat source object
-    //Heat source object set to j=0 plane, ie. jIndex==0
-    if (jIndex==0)
-    {
-      m_cellCentres[cellIndex]->m_temperature=m_heatSourceTemperature;
-    }
-    //Need to set empty collision cells to ambient temperature
-    else if (m_cellCentres[cellIndex]->m_interpolationData.size()==0)
-    {
-      m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
-    }
+      //Check upper x face as well
+      if (kIndex<(m_noCells-1))
+      {
+        //Get index of cell with Z face next to current cell
+//      int neighbourFaceIndex=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
+
+        if (m_cellFacesZ[cellIndex_ijk1]->m_state!=State::Colliding)
+        {
+          //Check whether empty or not
+          int noParticlesInCellCentre=m_cellCentres[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceX_1=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceY_1=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+          int noParticlesInCellFaceZ_1=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
+
+          //Get particle number for upper faces of cell, unless outermost cells in grid
+          int noParticlesInCellFaceX1=0;
+          int noParticlesInCellFaceY1=0;
+          int noParticlesInCellFaceZ1=0;
+
+          if (iIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceX1=m_cellFacesX[cellIndex_i1jk]->m_noParticlesContributing;
+          }
+          if (jIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceY1=m_cellFacesY[cellIndex_ij1k]->m_noParticlesContributing;
+          }
+          if (kIndex!=(m_noCells-1))
+          {
+            noParticlesInCellFaceZ1=m_cellFacesZ[cellIndex_ijk1]->m_noParticlesContributing;
+          }
 
+          //If cell centre and all faces belonging to cells have particles affecting it, then cell is interior
+//        if (noParticlesInCellCentre!=0
+//            && noParticlesInCellFaceX1!=0
+//            && noParticlesInCellFaceX_1!=0
+//            && noParticlesInCellFaceY1!=0
+//            && noParticlesInCellFaceY_1!=0
+//            && noParticlesInCellFaceZ1!=0
+//            && noParticlesInCellFaceZ_1!=0)
+          if (noParticlesInCellCentre>m_noParticlesThreshold
+              && noParticlesInCellFaceX1>m_noParticlesThreshold
+              && noParticlesInCellFaceX_1>m_noParticlesThreshold
+              && noParticlesInCellFaceY1>m_noParticlesThreshold
+              && noParticlesInCellFaceY_1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ1>m_noParticlesThreshold
+              && noParticlesInCellFaceZ_1>m_noParticlesThreshold)
+          {
+            m_cellCentres[cellIndex]->m_state=State::Interior;
+          }
+          //Otherwise the cell is empty
+          else
+          {
+            m_cellCentres[cellIndex]->m_state=State::Empty;
+            m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
+          }
+
+          //Go to next cellIndex
+          continue;
+        }
+      }
+
+      //This section will not be reached if faces that are non-colliding are found
+      //Set temperatures for colliding cells that are colliding with a heat source object
+      //Heat source object set to j=0 plane, ie. jIndex==0
+      if (jIndex==0)
+      {
+        m_cellCentres[cellIndex]->m_temperature=m_heatSourceTemperature;
+      }
+      //Need to set empty collision cells to ambient temperature
+      else if (m_cellCentres[cellIndex]->m_noParticlesContributing==0)
+      {
+        m_cellCentres[cellIndex]->m_temperature=m_ambientTemperature;
+      }
+
+    }
   }
 }
 
@@ -1620,6 +2079,122 @@ void Grid::classifyCells()
 
 ////----------------------------------------------------------------------------------------------------------------------
 
+bool Grid::updateStencilPattern(StencilSystem &io_system)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Find interior cells and compare with the ones the pattern was built for. If all interior cells have rows in the
+  pattern, keep it and zero the rows of cells that are no longer interior. Stored zeros add nothing to the products
+  in the solvers, so the solution is the same as with a pattern built for the current cells
+
+  Otherwise insert zero at the diagonal and six neighbours of each interior cell, as the A components
+  do, and compress
+
+  Find position of each entry of interior rows in the value array. Columns are sorted by row, so use a
+  binary search in the column
+
+  Account matrix and pattern to memory tracker
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::vector<char> isInterior(m_totNoCells);
+
+#pragma omp parallel for
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
+    isInterior[cellIndex]=(m_cellCentres[cellIndex]->m_state==State::Interior);
+  }
+
+  bool isCovered=true;
+
+  if (io_system.m_isInterior.size()==isInterior.size())
+  {
+#pragma omp parallel for reduction(&&:isCovered)
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      if (isInterior[cellIndex] && !io_system.m_isInterior[cellIndex])
+      {
+        isCovered=false;
+      }
+    }
+  }
+  else
+  {
+    isCovered=false;
+  }
+
+  if (isCovered)
+  {
+#pragma omp parallel for
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      if (io_system.m_isInterior[cellIndex] && !isInterior[cellIndex])
+      {
+        for (int entry=0; entry<StencilSystem::NoEntries; entry++)
+        {
+          io_system.setValue(cellIndex, (StencilSystem::Entry)entry, 0.0);
+        }
+      }
+    }
+
+    io_system.m_noReuses+=1;
+    return false;
+  }
+
+  io_system.m_isInterior.swap(isInterior);
+
+  //Neighbour offsets in order of StencilSystem::Entry
+  int neighbourOffsets[StencilSystem::NoEntries]={0, 1, -1, m_noCells, -m_noCells, m_noCells*m_noCells, -m_noCells*m_noCells};
+
+  std::vector<Eigen::Triplet<double>> entries;
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
+    if (io_system.m_isInterior[cellIndex])
+    {
+      for (int entry=0; entry<StencilSystem::NoEntries; entry++)
+      {
+        entries.push_back(Eigen::Triplet<double>(cellIndex, cellIndex+neighbourOffsets[entry], 0.0));
+      }
+    }
+  }
+
+  io_system.m_A.resize(m_totNoCells, m_totNoCells);
+  io_system.m_A.setFromTriplets(entries.begin(), entries.end());
+  io_system.m_A.makeCompressed();
+
+  io_system.m_entryPositions.assign(StencilSystem::NoEntries*m_totNoCells, -1);
+
+  const int* outerIndices=io_system.m_A.outerIndexPtr();
+  const int* innerIndices=io_system.m_A.innerIndexPtr();
+
+#pragma omp parallel for
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
+    if (io_system.m_isInterior[cellIndex])
+    {
+      for (int entry=0; entry<StencilSystem::NoEntries; entry++)
+      {
+        int column=cellIndex+neighbourOffsets[entry];
+        const int* position=std::lower_bound(innerIndices+outerIndices[column], innerIndices+outerIndices[column+1], cellIndex);
+        io_system.m_entryPositions[(StencilSystem::NoEntries*cellIndex)+entry]=position-innerIndices;
+      }
+    }
+  }
+
+  io_system.m_patternVersion+=1;
+
+  int64_t systemBytes=MemoryTracker::getSparseMatrixBytes(io_system.m_A)+io_system.m_isInterior.capacity()
+                      +(io_system.m_entryPositions.capacity()*sizeof(int));
+
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, io_system.m_trackedBytes);
+  io_system.m_trackedBytes=systemBytes;
+  MemoryTracker::instance()->allocate(MemoryTracker::LinearSystems, io_system.m_trackedBytes);
+
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Grid::findNoParticlesInCells(Emitter *_emitter, std::vector<int> &o_listParticleNo)
 {
   /* Outline
@@ -1,5 +1,8 @@
 #include "Grid.h"
 
+#include <algorithm>
+#include <cmath>
+
 //----------------------------------------------------------------------------------------------------------------------
 
 void Grid::calcTemperature()
@@ -7,39 +10,84 @@ void Grid::calcTemperature()
   /* Outline
   ----------------------------------------------------------------------------------------------------------------
 
-  Set up A and B and T
-
   Store current temp as previous
 
-  Set B
-
-  Set A
+  Solve for accumulated time step
 
-  Solve conjugate gradient
+  Compare with solving every step if reporting drift
 
   Store result
   ----------------------------------------------------------------------------------------------------------------
   */
 
-  //Set up matrices for linear system
-  Eigen::SparseMatrix<double> A_matrix(m_totNoCells, m_totNoCells);
-  Eigen::VectorXd B_vector(m_totNoCells);
-  Eigen::VectorXd solution(m_totNoCells);
+  PROFILE_STAGE(Temperature);
 
-  //Initialise A and B to zero
-  A_matrix.setZero();
-  B_vector.setZero();
-  solution.setZero();
+  Eigen::VectorXd temperature(m_totNoCells);
+  Eigen::VectorXd solution(m_totNoCells);
 
-  //Calculate A and B elements
-  ///NB! This doesn't work when threaded because of the workings of the sparse matrix.
-  /// TODO: Check if faster if create just Eigen::MatrixXf then copy values across, or do B_vector separately and threaded
-//#pragma omp parallel for
+#pragma omp parallel for
   for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
   {
     //Store current temp as previous
     m_cellCentres[cellIndex]->m_previousTemperature=m_cellCentres[cellIndex]->m_temperature;
+    temperature(cellIndex)=m_cellCentres[cellIndex]->m_temperature;
+  }
+
+  SolverRecord solverRecord;
+  solveTemperature(m_temperatureDt, temperature, solution, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::Temperature, solverRecord);
+
+  if (m_isReportingTemperatureDrift && m_temperatureSubsteps>1)
+  {
+    reportTemperatureDrift(temperature, solution);
+  }
+
+  //Update temperature
+#pragma omp parallel for
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
+    //Only update interior cells
+    if (m_cellCentres[cellIndex]->m_state==State::Interior)
+    {
+      m_cellCentres[cellIndex]->m_temperature=solution(cellIndex);
+
+      //Need to divide by mass again
+//      float mass=m_cellCentres[cellIndex]->m_mass;
+//      m_cellCentres[cellIndex]->m_temperature=solution(cellIndex)/mass;
+    }
+  }
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::solveTemperature(float _dt, const Eigen::VectorXd &_temperature, Eigen::VectorXd &o_temperature, SolverRecord &o_record)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+
+  Set up A and B and T. Pattern of A is rebuilt only if the interior cells have changed
+
+  Set B, and previous temperature as initial guess of the methods that take one
+
+  Set A, writing values in place
+
+  Solve with the temperature solver settings
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  //Set up matrices for linear system
+  updateStencilPattern(m_temperatureSystem);
+  Eigen::VectorXd B_vector(m_totNoCells);
 
+  //Initialise B to zero
+  B_vector.setZero();
+  o_temperature.setZero(m_totNoCells);
+
+  //Calculate A and B elements. Each interior cell writes its own row of the cached pattern, so can be threaded
+#pragma omp parallel for
+  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  {
     //Only update interior cells
     if (m_cellCentres[cellIndex]->m_state==State::Interior)
     {
@@ -49,40 +97,82 @@ void Grid::calcTemperature()
       int kIndex=m_cellCentres[cellIndex]->m_kIndex;
 
       //Calculate B element
-      B_vector(cellIndex)=calcBComponent_temperature(cellIndex);
+      B_vector(cellIndex)=calcBComponent_temperature(cellIndex, _temperature(cellIndex));
+
+      //Initial guess, only used by GaussSeidel_RedBlack
+      o_temperature(cellIndex)=_temperature(cellIndex);
 
       //Insert A elements
-      calcAComponent_temperature(cellIndex, iIndex, jIndex, kIndex, A_matrix);
+      calcAComponent_temperature(cellIndex, iIndex, jIndex, kIndex, _dt, m_temperatureSystem);
     }
 
   }
 
+  //Account system temporaries to memory tracker while they are alive. The matrix is accounted with its pattern
+  ScopedAllocation systemAllocation(MemoryTracker::LinearSystems, B_vector.size()*sizeof(double));
+
   //Solve system
-  float maxLoops=3000;
-  float minResidual=0.00001;
-  MathFunctions::conjugateGradient(A_matrix, B_vector, solution, maxLoops, minResidual);
+  LinearSolver::solve(m_temperatureSolver, m_temperatureSystem, m_noCells, m_isDeterministic, B_vector, o_temperature, o_record);
 
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::reportTemperatureDrift(const Eigen::VectorXd &_temperature, const Eigen::VectorXd &_subcycledTemperature)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Solve m_temperatureSubsteps steps of dt/substeps, starting from the same temperature. Cell states and material
+  values are kept as for the subcycled solve, so only the time integration differs
+
+  Find max and mean difference over interior cells and print
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  float substepDt=m_temperatureDt/((float)m_temperatureSubsteps);
+
+  Eigen::VectorXd referenceTemperature=_temperature;
+  Eigen::VectorXd substepSolution(m_totNoCells);
+
+  //Reference solves are only for comparison, so not added to solver metrics
+  SolverRecord substepRecord;
+
+  for (int substep=0; substep<m_temperatureSubsteps; substep++)
+  {
+    solveTemperature(substepDt, referenceTemperature, substepSolution, substepRecord);
+
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      if (m_cellCentres[cellIndex]->m_state==State::Interior)
+      {
+        referenceTemperature(cellIndex)=substepSolution(cellIndex);
+      }
+    }
+  }
+
+  double maxDrift=0.0;
+  double sumDrift=0.0;
+  int noInteriorCells=0;
 
-  //Update temperature
-#pragma omp parallel for
   for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
   {
-    //Only update interior cells
     if (m_cellCentres[cellIndex]->m_state==State::Interior)
     {
-      m_cellCentres[cellIndex]->m_temperature=solution(cellIndex);
-
-      //Need to divide by mass again
-//      float mass=m_cellCentres[cellIndex]->m_mass;
-//      m_cellCentres[cellIndex]->m_temperature=solution(cellIndex)/mass;
+      double drift=std::abs(_subcycledTemperature(cellIndex)-referenceTemperature(cellIndex));
+      maxDrift=std::max(maxDrift, drift);
+      sumDrift+=drift;
+      noInteriorCells+=1;
     }
   }
 
+  std::cout<<"Temperature drift of "<<m_temperatureSubsteps<<" step subcycling: max "<<maxDrift<<"K, mean "
+           <<(noInteriorCells>0 ? sumDrift/noInteriorCells : 0.0)<<"K over "<<noInteriorCells<<" interior cells\n";
+
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-float Grid::calcBComponent_temperature(int _cellIndex)
+float Grid::calcBComponent_temperature(int _cellIndex, float _temperature)
 {
   /* Outline
   ----------------------------------------------------------------------------------------------------------------
@@ -96,7 +186,7 @@ float Grid::calcBComponent_temperature(int _cellIndex)
 
   float mass=m_cellCentres[_cellIndex]->m_mass;
   float heatCapacity=m_cellCentres[_cellIndex]->m_heatCapacity;
-  float temperature=m_cellCentres[_cellIndex]->m_temperature;
+  float temperature=_temperature;
 
 //  bComponent=temperature;
   bComponent=mass*heatCapacity*temperature;
@@ -106,7 +196,7 @@ float Grid::calcBComponent_temperature(int _cellIndex)
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Grid::calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, Eigen::SparseMatrix<double> &o_A)
+void Grid::calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, float _dt, StencilSystem &io_system)
 {
   /* Outline
   ----------------------------------------------------------------------------------------------------------------
@@ -123,7 +213,7 @@ void Grid::calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex,
   Calculate A[ijk,ijk]
     A[ijk,ijk]=1.0 + constant*(heatConductivityX*A_X + heatConductivityY*A_Y + heatConductivityZ*A_Z)
 
-  Insert A components into matrix
+  Write A components into the entries of the cached pattern
 
   ----------------------------------------------------------------------------------------------------------------
   */
@@ -146,7 +236,7 @@ void Grid::calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex,
 
   //Calculate constant
 //  float constant=(m_dt*volume)/(mass*heatCapacity);
-  float constant=(m_dt*volume);
+  float constant=(_dt*volume);
 
   //Set up sumInvDensity
 //  float A_ijk_X=(-2.0);
@@ -297,15 +387,14 @@ void Grid::calcAComponent_temperature(int _cellIndex, int _iIndex, int _jIndex,
   //Add mass*heatCapacity to A_ijk
   A_ijk+=(mass*heatCapacity);
 
-  //Insert values into matrix
-  //Might need to do this in main function for parallelisation
-  o_A.insert(_cellIndex, _cellIndex)=A_ijk;
-  o_A.insert(_cellIndex, cellIndex_i1jk)=A_i1jk;
-  o_A.insert(_cellIndex, cellIndex_i_1jk)=A_i_1jk;
-  o_A.insert(_cellIndex, cellIndex_ij1k)=A_ij1k;
-  o_A.insert(_cellIndex, cellIndex_ij_1k)=A_ij_1k;
-  o_A.insert(_cellIndex, cellIndex_ijk1)=A_ijk1;
-  o_A.insert(_cellIndex, cellIndex_ijk_1)=A_ijk_1;
+  //Write values into the entries of the cached pattern
+  io_system.setValue(_cellIndex, StencilSystem::Diagonal, A_ijk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_i1jk, A_i1jk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_i_1jk, A_i_1jk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ij1k, A_ij1k);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ij_1k, A_ij_1k);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ijk1, A_ijk1);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ijk_1, A_ijk_1);
 
 }
 
@@ -45,6 +45,8 @@ void Grid::calcDeviatoricVelocity()
   ----------------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(DeviatoricVelocity);
+
   //Set e_{a(i)} vectors
   Eigen::Vector3f e_x(1.0, 0.0, 0.0);
   Eigen::Vector3f e_y(0.0, 1.0, 0.0);
@@ -71,6 +73,12 @@ void Grid::calcDeviatoricVelocity()
   bool implicitUpdate=false;
 //  bool implicitUpdate=true;
 
+  //With the particle stencil cache the force sums are scattered from particles before the loop over cells
+  if (m_isParticleStencilCache)
+  {
+    calcDeviatoricForce_Cached();
+  }
+
 //#pragma omp parallel for
   for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
   {
@@ -96,19 +104,39 @@ void Grid::calcDeviatoricVelocity()
 
     //Only set B components for non-empty cells
 //    if (noParticles_FaceX!=0 && noParticles_FaceY!=0 && noParticles_FaceZ!=0)
-    if (state_FaceX==State::Interior)
+    if (m_isParticleStencilCache)
     {
-      b_X(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesX[cellIndex], e_x);
-    }
+      if (state_FaceX==State::Interior)
+      {
+        b_X(cellIndex)=calcBComponent_DeviatoricVelocity_Cached(m_cellFacesX[cellIndex], m_faceWeightSums[0][cellIndex], e_x);
+      }
 
-    if (state_FaceY==State::Interior)
-    {
-      b_Y(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesY[cellIndex], e_y);
-    }
+      if (state_FaceY==State::Interior)
+      {
+        b_Y(cellIndex)=calcBComponent_DeviatoricVelocity_Cached(m_cellFacesY[cellIndex], m_faceWeightSums[1][cellIndex], e_y);
+      }
 
-    if (state_FaceZ==State::Interior)
+      if (state_FaceZ==State::Interior)
+      {
+        b_Z(cellIndex)=calcBComponent_DeviatoricVelocity_Cached(m_cellFacesZ[cellIndex], m_faceWeightSums[2][cellIndex], e_z);
+      }
+    }
+    else
     {
-      b_Z(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesZ[cellIndex], e_z);
+      if (state_FaceX==State::Interior)
+      {
+        b_X(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesX[cellIndex], e_x);
+      }
+
+      if (state_FaceY==State::Interior)
+      {
+        b_Y(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesY[cellIndex], e_y);
+      }
+
+      if (state_FaceZ==State::Interior)
+      {
+        b_Z(cellIndex)=calcBComponent_DeviatoricVelocity(m_cellFacesZ[cellIndex], e_z);
+      }
     }
 
 //    if (state_FaceX!=State::Empty || state_FaceY!=State::Empty || state_FaceZ!=State::Empty)
@@ -122,13 +150,18 @@ void Grid::calcDeviatoricVelocity()
 //    }
 
 
-    //Get A components for implicit update
+    //Get A components for implicit update. The particle stencil cache gets all of them after the loop
     if (implicitUpdate==true)
     {
+      if (m_isParticleStencilCache)
+      {
+        continue;
+      }
+
       //Calculate number of particles in faces of cellIndex
-      int noParticles_FaceX=m_cellFacesX[cellIndex]->m_interpolationData.size();
-      int noParticles_FaceY=m_cellFacesY[cellIndex]->m_interpolationData.size();
-      int noParticles_FaceZ=m_cellFacesZ[cellIndex]->m_interpolationData.size();
+      int noParticles_FaceX=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+      int noParticles_FaceY=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+      int noParticles_FaceZ=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
 
       //Only set A components for non-empty cells
 //      if (noParticles_FaceX!=0 && noParticles_FaceY!=0 && noParticles_FaceZ!=0)
@@ -174,6 +207,11 @@ void Grid::calcDeviatoricVelocity()
 
   if (implicitUpdate==true)
   {
+    if (m_isParticleStencilCache)
+    {
+      calcAComponents_DeviatoricVelocity_Cached(A_X, A_Y, A_Z);
+    }
+
     implicitUpdateVelocity(A_X, b_X, A_Y, b_Y, A_Z, b_Z);
 
   }
@@ -271,17 +309,17 @@ float Grid::calcBComponent_DeviatoricVelocity(CellFace *_cellFace, Eigen::Vector
   float forceSum=0.0;
   float weightSum=0.0;
 
-  int noParticles=_cellFace->m_interpolationData.size();
+  int noParticles=_cellFace->m_noParticlesContributing;
   for (int particleIterator=0; particleIterator<noParticles; particleIterator++)
   {
     //Get cubic B spline
-    float weight=_cellFace->m_interpolationData[particleIterator]->m_cubicBSpline;
+    float weight=_cellFace->m_interpolationData[particleIterator].m_cubicBSpline;
 
     //Get cubic B spline differentiated
-    Eigen::Vector3f weight_diff=_cellFace->m_interpolationData[particleIterator]->m_cubicBSpline_Diff;
+    Eigen::Vector3f weight_diff=_cellFace->m_interpolationData[particleIterator].m_cubicBSpline_Diff;
 
     //Get particle pointer
-    Particle* particle=_cellFace->m_interpolationData[particleIterator]->m_particle;
+    Particle* particle=_cellFace->m_interpolationData[particleIterator].m_particle;
 
     float forceFromParticle=calcDeviatoricForce(particle, _eVector, weight_diff);
 
@@ -545,7 +583,7 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
             for (int particleIterator_i=0; particleIterator_i<_noParticlesFaceX; particleIterator_i++)
             {
               //Get id of particle i
-              unsigned int particleId_i=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle->getId();
+              unsigned int particleId_i=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i].m_particleSortedIndex;
 
               bool isFound=false;
               unsigned int particleId_j;
@@ -554,11 +592,11 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
               if (isFound==true)
               {
                 //Get weights and mass
-                Eigen::Vector3f weight_i_diff=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i]->m_cubicBSpline_Diff;
-                Eigen::Vector3f weight_j_diff=m_cellFacesX[neighbourCellIndex]->m_interpolationData[particleId_j]->m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_i_diff=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i].m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_j_diff=m_cellFacesX[neighbourCellIndex]->m_interpolationData[particleId_j].m_cubicBSpline_Diff;
 
                 //Get particle pointer
-                Particle* commonParticle=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle;
+                Particle* commonParticle=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator_i].m_particle;
 
                 //Calculate A value for specific particle
                 float AValue_particle=calcAValue_DeviatoricVelocity(commonParticle, weight_i_diff, weight_j_diff, e_x);
@@ -591,7 +629,7 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
             for (int particleIterator_i=0; particleIterator_i<_noParticlesFaceY; particleIterator_i++)
             {
               //Get id of particle i
-              unsigned int particleId_i=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle->getId();
+              unsigned int particleId_i=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i].m_particleSortedIndex;
 
               bool isFound=false;
               unsigned int particleId_j;
@@ -600,11 +638,11 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
               if (isFound==true)
               {
                 //Get weights and mass
-                Eigen::Vector3f weight_i_diff=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i]->m_cubicBSpline_Diff;
-                Eigen::Vector3f weight_j_diff=m_cellFacesY[neighbourCellIndex]->m_interpolationData[particleId_j]->m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_i_diff=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i].m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_j_diff=m_cellFacesY[neighbourCellIndex]->m_interpolationData[particleId_j].m_cubicBSpline_Diff;
 
                 //Get particle pointer
-                Particle* commonParticle=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle;
+                Particle* commonParticle=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator_i].m_particle;
 
                 //Calculate A value for specific particle
                 float AValue_particle=calcAValue_DeviatoricVelocity(commonParticle, weight_i_diff, weight_j_diff, e_y);
@@ -639,7 +677,7 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
             for (int particleIterator_i=0; particleIterator_i<_noParticlesFaceZ; particleIterator_i++)
             {
               //Get id of particle i
-              unsigned int particleId_i=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle->getId();
+              unsigned int particleId_i=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i].m_particleSortedIndex;
 
               bool isFound=false;
               unsigned int particleId_j;
@@ -648,11 +686,11 @@ void Grid::calcAComponent_DeviatoricVelocity(int _cellIndex, int _noParticlesFac
               if (isFound==true)
               {
                 //Get weights and mass
-                Eigen::Vector3f weight_i_diff=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i]->m_cubicBSpline_Diff;
-                Eigen::Vector3f weight_j_diff=m_cellFacesZ[neighbourCellIndex]->m_interpolationData[particleId_j]->m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_i_diff=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i].m_cubicBSpline_Diff;
+                Eigen::Vector3f weight_j_diff=m_cellFacesZ[neighbourCellIndex]->m_interpolationData[particleId_j].m_cubicBSpline_Diff;
 
                 //Get particle pointer
-                Particle* commonParticle=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i]->m_particle;
+                Particle* commonParticle=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator_i].m_particle;
 
                 //Calculate A value for specific particle
                 float AValue_particle=calcAValue_DeviatoricVelocity(commonParticle, weight_i_diff, weight_j_diff, e_z);
@@ -1049,20 +1087,21 @@ void Grid::implicitUpdateVelocity(const Eigen::MatrixXf &_A_X, const Eigen::Vect
   solution_Y.setZero();
   Eigen::VectorXf solution_Z(m_totNoCells);
   solution_Z.setZero();
-  Eigen::MatrixXf emptyPreconditioner;
 //  float shift=(-1.0);
-  float shift=(0.0);
-  float tolerance=0.0000001;
-  int maxNoLoops=20;
 
   Eigen::MatrixXf A_X_trans=_A_X.transpose();
   Eigen::MatrixXf test=_A_X-A_X_trans;
 
 
 
-  MathFunctions::MinRes(_A_X, _bVector_X, solution_X, emptyPreconditioner, shift, maxNoLoops, tolerance, false);
-  MathFunctions::MinRes(_A_Y, _bVector_Y, solution_Y, emptyPreconditioner, shift, maxNoLoops, tolerance, false);
-  MathFunctions::MinRes(_A_Z, _bVector_Z, solution_Z, emptyPreconditioner, shift, maxNoLoops, tolerance, false);
+  //Solve with the deviatoric solver settings, MINRES unless set
+  SolverRecord solverRecord;
+  LinearSolver::solve(m_deviatoricSolver, _A_X, m_isDeterministic, _bVector_X, solution_X, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricX, solverRecord);
+  LinearSolver::solve(m_deviatoricSolver, _A_Y, m_isDeterministic, _bVector_Y, solution_Y, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricY, solverRecord);
+  LinearSolver::solve(m_deviatoricSolver, _A_Z, m_isDeterministic, _bVector_Z, solution_Z, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricZ, solverRecord);
 
 
   //Read in solutions
@@ -1077,23 +1116,27 @@ void Grid::implicitUpdateVelocity(const Eigen::MatrixXf &_A_X, const Eigen::Vect
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Grid::searchCellsForCommonParticle(unsigned int _particleId, CellFace* _cellFace, unsigned int &o_particleIndexInFace, bool &o_isFound)
+void Grid::searchCellsForCommonParticle(unsigned int _particleSortedIndex, CellFace* _cellFace, unsigned int &o_particleIndexInFace, bool &o_isFound)
 {
 //  Particle* sameParticlePointer=nullptr;
   o_isFound=false;
 
   //Get number of particles in cell
-  int noParticlesInList=_cellFace->m_interpolationData.size();
+  int noParticlesInList=_cellFace->m_noParticlesContributing;
+  if (noParticlesInList==0)
+  {
+    return;
+  }
 
   //Check that id contained in list of j
-  unsigned int particleId_Min=_cellFace->m_interpolationData[0]->m_particle->getId();
+  unsigned int particleId_Min=_cellFace->m_interpolationData[0].m_particleSortedIndex;
 
-  if (_particleId>particleId_Min)
+  if (_particleSortedIndex>particleId_Min)
   {
     //Check if smaller than particle id max
-    unsigned int particleId_Max=_cellFace->m_interpolationData[noParticlesInList-1]->m_particle->getId();
+    unsigned int particleId_Max=_cellFace->m_interpolationData[noParticlesInList-1].m_particleSortedIndex;
 
-    if (_particleId<particleId_Max)
+    if (_particleSortedIndex<particleId_Max)
     {
       //Search through list
       int lowerBound=0;
@@ -1105,9 +1148,9 @@ void Grid::searchCellsForCommonParticle(unsigned int _particleId, CellFace* _cel
         middleIndex=lowerBound+((upperBound-lowerBound)/2);
 
         //Get particle id
-        unsigned int midParticleId=_cellFace->m_interpolationData[middleIndex]->m_particle->getId();
+        unsigned int midParticleId=_cellFace->m_interpolationData[middleIndex].m_particleSortedIndex;
 
-        if (_particleId==midParticleId)
+        if (_particleSortedIndex==midParticleId)
         {
 //          o_particle=_cellFace->m_interpolationData[middleIndex]->m_particle;
           o_particleIndexInFace=middleIndex;
@@ -1115,19 +1158,19 @@ void Grid::searchCellsForCommonParticle(unsigned int _particleId, CellFace* _cel
           break;
         }
 
-        if (_particleId<midParticleId)
+        if (_particleSortedIndex<midParticleId)
         {
           upperBound=middleIndex-1;
         }
 
-        if (_particleId>midParticleId)
+        if (_particleSortedIndex>midParticleId)
         {
           lowerBound=middleIndex+1;
         }
       }
     }
 
-    if (_particleId==particleId_Max)
+    if (_particleSortedIndex==particleId_Max)
     {
 //      o_particle=_cellFace->m_interpolationData[noParticlesInList-1]->m_particle;
       o_particleIndexInFace=noParticlesInList-1;
@@ -1135,7 +1178,7 @@ void Grid::searchCellsForCommonParticle(unsigned int _particleId, CellFace* _cel
     }
   }
 
-  if (_particleId==particleId_Min)
+  if (_particleSortedIndex==particleId_Min)
   {
 //    o_particle=_cellFace->m_interpolationData[0]->m_particle;
     o_particleIndexInFace=0;
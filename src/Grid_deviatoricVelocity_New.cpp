@@ -597,11 +597,6 @@ void Grid::implicitUpdate_DeviatoricVelocity_New()
   solution_Y.setZero();
   Eigen::VectorXf solution_Z(m_totNoCells);
   solution_Z.setZero();
-  Eigen::MatrixXf emptyPreconditioner;
-
-  float shift=(0.0);
-  float tolerance=0.0000001;
-  int maxNoLoops=20;
 
 //  //Testing symmetry of A matrix
 //  Eigen::MatrixXf A_X_trans=m_Amatrix_deviatoric_X.transpose();
@@ -639,14 +634,14 @@ void Grid::implicitUpdate_DeviatoricVelocity_New()
 //  }
 //  float determinant=testSingular.determinant();
 
-  //Set to display details or not
-  bool displayDetails=true;
-//  bool displayDetails=false;
-
-  //Solve system using MINRES
-  MathFunctions::MinRes(m_Amatrix_deviatoric_X, m_Bvector_deviatoric_X, solution_X, emptyPreconditioner, shift, maxNoLoops, tolerance, displayDetails);
-  MathFunctions::MinRes(m_Amatrix_deviatoric_Y, m_Bvector_deviatoric_Y, solution_Y, emptyPreconditioner, shift, maxNoLoops, tolerance, displayDetails);
-  MathFunctions::MinRes(m_Amatrix_deviatoric_Z, m_Bvector_deviatoric_Z, solution_Z, emptyPreconditioner, shift, maxNoLoops, tolerance, displayDetails);
+  //Solve system with the deviatoric solver settings, MINRES unless set
+  SolverRecord solverRecord;
+  LinearSolver::solve(m_deviatoricSolver, m_Amatrix_deviatoric_X, m_isDeterministic, m_Bvector_deviatoric_X, solution_X, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricX, solverRecord);
+  LinearSolver::solve(m_deviatoricSolver, m_Amatrix_deviatoric_Y, m_isDeterministic, m_Bvector_deviatoric_Y, solution_Y, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricY, solverRecord);
+  LinearSolver::solve(m_deviatoricSolver, m_Amatrix_deviatoric_Z, m_isDeterministic, m_Bvector_deviatoric_Z, solution_Z, solverRecord);
+  SolverMetrics::instance()->addSolve(SolverMetrics::DeviatoricZ, solverRecord);
 
 
   //Read in solutions
@@ -679,89 +674,96 @@ void Grid::setBoundaryVelocity()
   ---------------------------------------------------------------------------------------------------------------------
   */
 
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  PROFILE_STAGE(BoundaryVelocity);
+
+#pragma omp parallel
   {
-    //Test parallel
-//    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
+    TRACE_SCOPE("BoundaryVelocity", "thread");
 
-    //Check whether current cell is colliding, if so set stick collision to all faces
-    if (m_cellCentres[cellIndex]->m_state==State::Colliding)
-    {
-      m_cellFacesX[cellIndex]->m_velocity=0.0;
-      m_cellFacesY[cellIndex]->m_velocity=0.0;
-      m_cellFacesZ[cellIndex]->m_velocity=0.0;
-    }
-    else
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
     {
-      //Get cell index in ijk values
-      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
-      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
-      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
-
-      //If current cell isn't colliding, then still need to check the cell before in each direction, unless i||j||k=0
-      //FaceX
-      if (m_cellFacesX[cellIndex]->m_state==State::Colliding)
+      //Test parallel
+//    printf("The parallel region is executed by thread %d\n", omp_get_thread_num());
+
+      //Check whether current cell is colliding, if so set stick collision to all faces
+      if (m_cellCentres[cellIndex]->m_state==State::Colliding)
       {
-        //Set velocity to zero if iIndex=0
-        if (iIndex==0)
-        {
-          m_cellFacesX[cellIndex]->m_velocity=0.0;
-        }
-        //Else check the cell before it in i direction
-        else
+        m_cellFacesX[cellIndex]->m_velocity=0.0;
+        m_cellFacesY[cellIndex]->m_velocity=0.0;
+        m_cellFacesZ[cellIndex]->m_velocity=0.0;
+      }
+      else
+      {
+        //Get cell index in ijk values
+        int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+        int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+        int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+        //If current cell isn't colliding, then still need to check the cell before in each direction, unless i||j||k=0
+        //FaceX
+        if (m_cellFacesX[cellIndex]->m_state==State::Colliding)
         {
-          //Get index of cell before in i direction
-          int neighbourIndex=MathFunctions::getVectorIndex(iIndex-1, jIndex, kIndex, m_noCells);
-
-          //Check if colliding
-          if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+          //Set velocity to zero if iIndex=0
+          if (iIndex==0)
           {
             m_cellFacesX[cellIndex]->m_velocity=0.0;
           }
-        }
-      }
+          //Else check the cell before it in i direction
+          else
+          {
+            //Get index of cell before in i direction
+            int neighbourIndex=MathFunctions::getVectorIndex(iIndex-1, jIndex, kIndex, m_noCells);
 
-      //FaceY
-      if (m_cellFacesY[cellIndex]->m_state==State::Colliding)
-      {
-        //Set velocity to zero if jIndex=0
-        if (jIndex==0)
-        {
-          m_cellFacesY[cellIndex]->m_velocity=0.0;
+            //Check if colliding
+            if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+            {
+              m_cellFacesX[cellIndex]->m_velocity=0.0;
+            }
+          }
         }
-        //Else check the cell before it in j direction
-        else
-        {
-          //Get index of cell before in j direction
-          int neighbourIndex=MathFunctions::getVectorIndex(iIndex, jIndex-1, kIndex, m_noCells);
 
-          //Check if colliding
-          if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+        //FaceY
+        if (m_cellFacesY[cellIndex]->m_state==State::Colliding)
+        {
+          //Set velocity to zero if jIndex=0
+          if (jIndex==0)
           {
             m_cellFacesY[cellIndex]->m_velocity=0.0;
           }
+          //Else check the cell before it in j direction
+          else
+          {
+            //Get index of cell before in j direction
+            int neighbourIndex=MathFunctions::getVectorIndex(iIndex, jIndex-1, kIndex, m_noCells);
+
+            //Check if colliding
+            if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+            {
+              m_cellFacesY[cellIndex]->m_velocity=0.0;
+            }
+          }
         }
-      }
-      //FaceZ
-      if (m_cellFacesZ[cellIndex]->m_state==State::Colliding)
-      {
-        //Set velocity to zero if kIndex=0
-        if (kIndex==0)
-        {
-          m_cellFacesZ[cellIndex]->m_velocity=0.0;
-        }
-        //Else check the cell before it in k direction
-        else
+        //FaceZ
+        if (m_cellFacesZ[cellIndex]->m_state==State::Colliding)
         {
-          //Get index of cell before in k direction
-          int neighbourIndex=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex-1, m_noCells);
-
-          //Check if colliding
-          if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+          //Set velocity to zero if kIndex=0
+          if (kIndex==0)
           {
             m_cellFacesZ[cellIndex]->m_velocity=0.0;
           }
+          //Else check the cell before it in k direction
+          else
+          {
+            //Get index of cell before in k direction
+            int neighbourIndex=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex-1, m_noCells);
+
+            //Check if colliding
+            if (m_cellCentres[neighbourIndex]->m_state==State::Colliding)
+            {
+              m_cellFacesZ[cellIndex]->m_velocity=0.0;
+            }
+          }
         }
       }
     }
@@ -0,0 +1,746 @@
+#include "Grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void Grid::buildParticleStencilCache(Emitter *_emitter)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Sort particles by cell
+
+  Loop over blocks of 4x4x4 cells, colour by colour
+    Count particles in block from the sorted offsets of each row of cells in the block
+  Prefix sum of the counts gives the offset of each block in the cache
+
+  Loop over blocks
+    Loop over rows of cells in block and particles of each row in sorted order
+      For each node type find the base cell, ie. one below the cell the particle is in or above along each axis.
+      Faces are half a cell lower along their axis
+      Calculate cubic B spline, tight quadratic stencil and their derivatives for the 4 nodes along each axis. Zero
+      for nodes outside grid
+      Store products of the 1D weights for the 64 nodes, the same way as calcInterpolationWeights
+
+  Account cache to memory tracker
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  PROFILE_STAGE(FindParticleContribution);
+
+  sortParticlesByCell(_emitter);
+
+  int totNoParticles=_emitter->m_noParticles;
+  int noBlocks=(m_noCells+3)/4;
+  int totNoBlocks=noBlocks*noBlocks*noBlocks;
+
+  //Lower cell of each block along each axis
+  std::vector<int> blockFirstCells(3*totNoBlocks);
+  m_blockCacheOffsets.assign(totNoBlocks+1, 0);
+
+  int blockIndex=0;
+  for (int colour=0; colour<8; colour++)
+  {
+    m_colourBlockOffsets[colour]=blockIndex;
+
+    for (int kBlock=((colour>>2)&1); kBlock<noBlocks; kBlock+=2)
+    {
+      for (int jBlock=((colour>>1)&1); jBlock<noBlocks; jBlock+=2)
+      {
+        for (int iBlock=(colour&1); iBlock<noBlocks; iBlock+=2)
+        {
+          int iFirst=4*iBlock;
+          int jFirst=4*jBlock;
+          int kFirst=4*kBlock;
+          blockFirstCells[(3*blockIndex)]=iFirst;
+          blockFirstCells[(3*blockIndex)+1]=jFirst;
+          blockFirstCells[(3*blockIndex)+2]=kFirst;
+
+          //Particles of a row of cells are contiguous in the sorted list. Cell after end of row is start of next row
+          int iEnd=std::min(iFirst+4, m_noCells);
+          int noParticlesInBlock=0;
+          for (int kIndex=kFirst; kIndex<std::min(kFirst+4, m_noCells); kIndex++)
+          {
+            for (int jIndex=jFirst; jIndex<std::min(jFirst+4, m_noCells); jIndex++)
+            {
+              noParticlesInBlock+=m_cellParticleOffsets[MathFunctions::getVectorIndex(iEnd, jIndex, kIndex, m_noCells)]
+                                  -m_cellParticleOffsets[MathFunctions::getVectorIndex(iFirst, jIndex, kIndex, m_noCells)];
+            }
+          }
+
+          m_blockCacheOffsets[blockIndex+1]=m_blockCacheOffsets[blockIndex]+noParticlesInBlock;
+          blockIndex++;
+        }
+      }
+    }
+  }
+  m_colourBlockOffsets[8]=blockIndex;
+
+  m_particleStencilCache.resize(totNoParticles);
+
+  float halfCellSize=m_cellSize/2.0;
+  float invCellSize=1.0/m_cellSize;
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("FindParticleContribution", "thread");
+
+#pragma omp for schedule(dynamic) nowait
+    for (int blockItr=0; blockItr<totNoBlocks; blockItr++)
+    {
+      int iFirst=blockFirstCells[(3*blockItr)];
+      int jFirst=blockFirstCells[(3*blockItr)+1];
+      int kFirst=blockFirstCells[(3*blockItr)+2];
+      int iEnd=std::min(iFirst+4, m_noCells);
+
+      int cacheIndex=m_blockCacheOffsets[blockItr];
+
+      for (int kIndex=kFirst; kIndex<std::min(kFirst+4, m_noCells); kIndex++)
+      {
+        for (int jIndex=jFirst; jIndex<std::min(jFirst+4, m_noCells); jIndex++)
+        {
+          int sortedBegin=m_cellParticleOffsets[MathFunctions::getVectorIndex(iFirst, jIndex, kIndex, m_noCells)];
+          int sortedEnd=m_cellParticleOffsets[MathFunctions::getVectorIndex(iEnd, jIndex, kIndex, m_noCells)];
+
+          for (int sortedIndex=sortedBegin; sortedIndex<sortedEnd; sortedIndex++)
+          {
+            Particle* particle=_emitter->m_particles[m_sortedParticleIndices[sortedIndex]];
+            Eigen::Vector3f particlePosition=particle->getPosition();
+
+            ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+            cache.m_particle=particle;
+
+            for (int nodeType=0; nodeType<4; nodeType++)
+            {
+              //1D weights of the 4 nodes along each axis
+              float N_cubicBS[3][4];
+              float dN_cubicBS[3][4];
+              float N_quadS[3][4];
+              float dN_quadS[3][4];
+
+              for (int axis=0; axis<3; axis++)
+              {
+                bool isFace=(nodeType==(axis+1));
+
+                float gridPosition=(particlePosition(axis)-m_origin(axis))*invCellSize;
+                if (isFace)
+                {
+                  gridPosition+=0.5;
+                }
+                int base=(int)std::floor(gridPosition)-1;
+                cache.m_base[nodeType][axis]=base;
+
+                for (int nodeItr=0; nodeItr<4; nodeItr++)
+                {
+                  int index=base+nodeItr;
+                  if (index<0 || index>=m_noCells)
+                  {
+                    N_cubicBS[axis][nodeItr]=0.0;
+                    dN_cubicBS[axis][nodeItr]=0.0;
+                    N_quadS[axis][nodeItr]=0.0;
+                    dN_quadS[axis][nodeItr]=0.0;
+                    continue;
+                  }
+
+                  float position=(index*m_cellSize)+m_origin(axis);
+                  if (isFace)
+                  {
+                    position-=halfCellSize;
+                  }
+                  float posDiff=(particlePosition(axis)-position)/m_cellSize;
+
+                  N_cubicBS[axis][nodeItr]=MathFunctions::calcCubicBSpline(posDiff);
+                  dN_cubicBS[axis][nodeItr]=MathFunctions::calcCubicBSpline_Diff(posDiff);
+                  N_quadS[axis][nodeItr]=MathFunctions::calcTightQuadraticStencil(posDiff);
+                  dN_quadS[axis][nodeItr]=MathFunctions::calcTightQuadraticStencil_Diff(posDiff);
+                }
+              }
+
+              //Products for the 64 nodes, i fastest
+              for (int node=0; node<64; node++)
+              {
+                int a=node&3;
+                int b=(node>>2)&3;
+                int c=node>>4;
+
+                cache.m_cubicBSpline[nodeType][node]=N_cubicBS[0][a]*N_cubicBS[1][b]*N_cubicBS[2][c];
+                cache.m_tightQuadStencil[nodeType][node]=N_quadS[0][a]*N_quadS[1][b]*N_quadS[2][c];
+
+                //Cell centres only use the weights
+                if (nodeType==0)
+                {
+                  continue;
+                }
+
+                int faceDirection=nodeType-1;
+                cache.m_cubicBSpline_Diff[faceDirection][0][node]=(dN_cubicBS[0][a]*N_cubicBS[1][b]*N_cubicBS[2][c])*invCellSize;
+                cache.m_cubicBSpline_Diff[faceDirection][1][node]=(dN_cubicBS[1][b]*N_cubicBS[0][a]*N_cubicBS[2][c])*invCellSize;
+                cache.m_cubicBSpline_Diff[faceDirection][2][node]=(dN_cubicBS[2][c]*N_cubicBS[0][a]*N_cubicBS[1][b])*invCellSize;
+
+                cache.m_tightQuadStencil_Diff[faceDirection][0][node]=(dN_quadS[0][a]*N_quadS[1][b]*N_quadS[2][c])*invCellSize;
+                cache.m_tightQuadStencil_Diff[faceDirection][1][node]=(dN_quadS[1][b]*N_quadS[0][a]*N_quadS[2][c])*invCellSize;
+                cache.m_tightQuadStencil_Diff[faceDirection][2][node]=(dN_quadS[2][c]*N_quadS[0][a]*N_quadS[1][b])*invCellSize;
+              }
+            }
+
+            cacheIndex++;
+          }
+        }
+      }
+    }
+  }
+
+  //Account the cache to the memory tracker. Storage is kept between steps, so track its capacity
+  int64_t interpolationBytes=(m_particleStencilCache.capacity()*sizeof(ParticleStencilCache))
+                             +((m_blockCacheOffsets.capacity()+m_particleCellIndices.capacity()+m_sortedParticleIndices.capacity()
+                                +m_cellParticleOffsets.capacity())*sizeof(int))
+                             +(m_particleStencils.capacity()*sizeof(ParticleStencil))
+                             +((m_faceWeightSums[0].capacity()+m_faceWeightSums[1].capacity()+m_faceWeightSums[2].capacity())*sizeof(float));
+
+  MemoryTracker::instance()->release(MemoryTracker::Interpolation, m_trackedInterpolationBytes);
+  m_trackedInterpolationBytes=interpolationBytes;
+  MemoryTracker::instance()->allocate(MemoryTracker::Interpolation, m_trackedInterpolationBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::transferParticleData_Cached(Emitter *_emitter)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Same sums as transferParticleData, but scattered from particles
+
+  Loop over colours
+    Loop over blocks of colour, in parallel as they don't share cells
+      Loop over particles in block
+        Get particle data once
+        Add weighted data to each face and centre in stencil with non-zero weight, and count the particle
+        Add weight to face weight sums used by the deviatoric B components
+
+  Loop over cells
+    Multiply data by 1/m_{i} or 1/m_{c}
+    Calculate J_{Pc}=J_{c}/J_{Ec}
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  PROFILE_STAGE(TransferParticleData);
+
+  std::vector<CellFace*>* cellFaces[3]={&m_cellFacesX, &m_cellFacesY, &m_cellFacesZ};
+
+  for (int faceDirection=0; faceDirection<3; faceDirection++)
+  {
+    m_faceWeightSums[faceDirection].assign(m_totNoCells, 0.0);
+  }
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("TransferParticleData", "thread");
+
+    for (int colour=0; colour<8; colour++)
+    {
+#pragma omp for schedule(dynamic)
+      for (int blockIndex=m_colourBlockOffsets[colour]; blockIndex<m_colourBlockOffsets[colour+1]; blockIndex++)
+      {
+        for (int cacheIndex=m_blockCacheOffsets[blockIndex]; cacheIndex<m_blockCacheOffsets[blockIndex+1]; cacheIndex++)
+        {
+          const ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+
+          //Get particle data
+          float mass=0.0;
+          Eigen::Vector3f velocity;
+          Phase phase=Phase::Solid;
+          cache.m_particle->getParticleData_CellFace(mass, velocity, phase);
+
+          float detDeformGrad=0.0;
+          float detDeformGradElast=0.0;
+          float temperature=0.0;
+          float lameLambdaInverse=0.0;
+          cache.m_particle->getParticleData_CellCentre(mass, detDeformGrad, detDeformGradElast, phase, temperature, lameLambdaInverse);
+
+          //Find heat conductivity and capacity depending on phase
+          float heatConductivity=0.0;
+          float heatCapacity=0.0;
+          if (phase==Phase::Solid)
+          {
+            heatConductivity=_emitter->m_heatConductivitySolid;
+            heatCapacity=_emitter->m_heatCapacitySolid;
+          }
+          else
+          {
+            heatConductivity=_emitter->m_heatConductivityFluid;
+            heatCapacity=_emitter->m_heatCapacityFluid;
+          }
+
+          //Faces. Nodes outside grid have zero weight, so are skipped
+          for (int faceDirection=0; faceDirection<3; faceDirection++)
+          {
+            const int* base=cache.m_base[faceDirection+1];
+            const float* weights=cache.m_cubicBSpline[faceDirection+1];
+
+            for (int node=0; node<64; node++)
+            {
+              float weight=weights[node];
+              if (weight==0)
+              {
+                continue;
+              }
+
+              int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+              CellFace* cellFace=(*cellFaces[faceDirection])[cellIndex];
+
+              cellFace->m_noParticlesContributing+=1;
+              cellFace->m_mass+=(weight*mass);
+              cellFace->m_velocity+=((weight*mass)*velocity(faceDirection));
+              cellFace->m_heatConductivity+=((weight*mass)*heatConductivity);
+
+              m_faceWeightSums[faceDirection][cellIndex]+=weight;
+            }
+          }
+
+          //Cell centres
+          const int* base=cache.m_base[0];
+          const float* weights=cache.m_cubicBSpline[0];
+
+          for (int node=0; node<64; node++)
+          {
+            float weight=weights[node];
+            if (weight==0)
+            {
+              continue;
+            }
+
+            int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+            CellCentre* cellCentre=m_cellCentres[cellIndex];
+
+            cellCentre->m_noParticlesContributing+=1;
+            cellCentre->m_mass+=(weight*mass);
+            cellCentre->m_detDeformationGrad+=((weight*mass)*detDeformGrad);
+            cellCentre->m_detDeformationGradElastic+=((weight*mass)*detDeformGradElast);
+            cellCentre->m_temperature+=((weight*mass)*temperature);
+            cellCentre->m_lameLambdaInverse+=((weight*mass)*lameLambdaInverse);
+            cellCentre->m_heatCapacity+=((weight*mass)*heatCapacity);
+          }
+        }
+      }
+    }
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      //Multiply data by 1/m_{i}
+      for (int faceDirection=0; faceDirection<3; faceDirection++)
+      {
+        CellFace* cellFace=(*cellFaces[faceDirection])[cellIndex];
+        if (cellFace->m_noParticlesContributing!=0)
+        {
+          cellFace->m_velocity*=(1.0/cellFace->m_mass);
+          cellFace->m_heatConductivity*=(1.0/cellFace->m_mass);
+        }
+      }
+
+      //Multiply data by 1/m_{c}
+      CellCentre* cellCentre=m_cellCentres[cellIndex];
+      if (cellCentre->m_noParticlesContributing!=0)
+      {
+        cellCentre->m_detDeformationGrad*=(1.0/cellCentre->m_mass);
+        cellCentre->m_detDeformationGradElastic*=(1.0/cellCentre->m_mass);
+        cellCentre->m_heatCapacity*=(1.0/cellCentre->m_mass);
+        cellCentre->m_temperature*=(1.0/cellCentre->m_mass);
+        cellCentre->m_lameLambdaInverse*=(1.0/cellCentre->m_mass);
+
+        //Calculate detDeformationGrad_Plastic, ie. J_{Pc}=J_{c}/J_{Ec}
+        cellCentre->m_detDeformationGradPlastic=cellCentre->m_detDeformationGrad;
+        cellCentre->m_detDeformationGradPlastic*=(1.0/cellCentre->m_detDeformationGradElastic);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::calcInitialParticleVolumes_Cached()
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Loop over cached particles
+    Add density contribution of each cell centre in stencil to particle
+    Calculate particle volume
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  //Cell volume
+  float cellVolume=pow(m_cellSize,3);
+
+  int noParticles=m_particleStencilCache.size();
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("InitialParticleVolumes", "thread");
+
+#pragma omp for nowait
+    for (int cacheIndex=0; cacheIndex<noParticles; cacheIndex++)
+    {
+      const ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+      const int* base=cache.m_base[0];
+
+      for (int node=0; node<64; node++)
+      {
+        float weight=cache.m_cubicBSpline[0][node];
+        if (weight==0)
+        {
+          continue;
+        }
+
+        int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+
+        //Add density from this cell to particle
+        float density=(weight*m_cellCentres[cellIndex]->m_mass)/cellVolume;
+        cache.m_particle->addParticleDensity(density);
+      }
+
+      cache.m_particle->calcInitialVolume();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::calcDeviatoricForce_Cached()
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  f_{i}=-sum_p(V_{p}*e_{a(i)}^T*dYdFE_{p}*FE_{p}^T*cubicBSpline_Diff_{ip}), same as calcDeviatoricForce
+
+  Loop over colours
+    Loop over blocks of colour, in parallel as they don't share cells
+      Loop over particles in block
+        Calc -V_{p}*dYdFE_{p}*FE_{p}^T once. Row a gives the force on faces along axis a
+        Calc force for the 64 faces of each direction from the weight gradients
+        Add to m_deviatoricForce of faces with non-zero weight
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  std::vector<CellFace*>* cellFaces[3]={&m_cellFacesX, &m_cellFacesY, &m_cellFacesZ};
+
+#pragma omp parallel
+  {
+    for (int colour=0; colour<8; colour++)
+    {
+#pragma omp for schedule(dynamic)
+      for (int blockIndex=m_colourBlockOffsets[colour]; blockIndex<m_colourBlockOffsets[colour+1]; blockIndex++)
+      {
+        for (int cacheIndex=m_blockCacheOffsets[blockIndex]; cacheIndex<m_blockCacheOffsets[blockIndex+1]; cacheIndex++)
+        {
+          const ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+          Particle* particle=cache.m_particle;
+
+          Eigen::Matrix3f forceMatrix=particle->getPotentialEnergyDiff()*particle->getDeformationElastic().transpose();
+          forceMatrix*=(-1.0*particle->getVolume());
+
+          for (int faceDirection=0; faceDirection<3; faceDirection++)
+          {
+            const float* weightDiffX=cache.m_cubicBSpline_Diff[faceDirection][0];
+            const float* weightDiffY=cache.m_cubicBSpline_Diff[faceDirection][1];
+            const float* weightDiffZ=cache.m_cubicBSpline_Diff[faceDirection][2];
+            float forceX=forceMatrix(faceDirection,0);
+            float forceY=forceMatrix(faceDirection,1);
+            float forceZ=forceMatrix(faceDirection,2);
+
+            float force[64];
+#pragma omp simd
+            for (int node=0; node<64; node++)
+            {
+              force[node]=(forceX*weightDiffX[node])+(forceY*weightDiffY[node])+(forceZ*weightDiffZ[node]);
+            }
+
+            const int* base=cache.m_base[faceDirection+1];
+            for (int node=0; node<64; node++)
+            {
+              if (cache.m_cubicBSpline[faceDirection+1][node]==0)
+              {
+                continue;
+              }
+
+              int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+              (*cellFaces[faceDirection])[cellIndex]->m_deviatoricForce+=force[node];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float Grid::calcBComponent_DeviatoricVelocity_Cached(CellFace *_cellFace, float _weightSum, Eigen::Vector3f _eVector)
+{
+  /* Outline
+  --------------------------------------------------------------------------------------------------------------
+  b_{i}=m_{i}*v_{i}^{n} + dt*f_{i} + dt*m_{i}*g_{i}*sum_p(w_{ip})
+
+  where f_{i} was scattered to the face by calcDeviatoricForce_Cached
+  --------------------------------------------------------------------------------------------------------------
+  */
+
+  float BComponent=0.0;
+
+  if (_cellFace->m_noParticlesContributing!=0)
+  {
+    float cellMass=_cellFace->m_mass;
+
+    //External forces component
+    float externalForce=m_externalForce.dot(_eVector);
+    externalForce*=(m_dt*_weightSum*cellMass);
+
+    //Deviatoric force component
+    float deviatoricForce=(m_dt*_cellFace->m_deviatoricForce);
+
+    BComponent=(_cellFace->m_velocity*cellMass) + deviatoricForce + externalForce;
+  }
+
+  return BComponent;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::calcAComponents_DeviatoricVelocity_Cached(Eigen::MatrixXf &o_AX, Eigen::MatrixXf &o_AY, Eigen::MatrixXf &o_AZ)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Loop over colours
+    Loop over blocks of colour, in parallel as rows of A belong to faces and blocks don't share faces
+      Loop over particles in block
+        For each direction, find interior faces in stencil with non-zero weight
+        Loop over pairs of these faces that are at most 2 cells apart along each axis, as in
+        calcAComponent_DeviatoricVelocity
+          Add contribution of particle to A_ij
+
+  Loop over cells
+    Add mass of interior faces to diagonal
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  //Set e_{a(i)} vectors
+  Eigen::Vector3f eVectors[3];
+  eVectors[0]=Eigen::Vector3f(1.0, 0.0, 0.0);
+  eVectors[1]=Eigen::Vector3f(0.0, 1.0, 0.0);
+  eVectors[2]=Eigen::Vector3f(0.0, 0.0, 1.0);
+
+  std::vector<CellFace*>* cellFaces[3]={&m_cellFacesX, &m_cellFacesY, &m_cellFacesZ};
+  Eigen::MatrixXf* AMatrices[3]={&o_AX, &o_AY, &o_AZ};
+
+#pragma omp parallel
+  {
+    for (int colour=0; colour<8; colour++)
+    {
+#pragma omp for schedule(dynamic)
+      for (int blockIndex=m_colourBlockOffsets[colour]; blockIndex<m_colourBlockOffsets[colour+1]; blockIndex++)
+      {
+        for (int cacheIndex=m_blockCacheOffsets[blockIndex]; cacheIndex<m_blockCacheOffsets[blockIndex+1]; cacheIndex++)
+        {
+          const ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+
+          for (int faceDirection=0; faceDirection<3; faceDirection++)
+          {
+            const int* base=cache.m_base[faceDirection+1];
+
+            //Interior faces of stencil
+            int noFaces=0;
+            int nodes[64];
+            int cellIndices[64];
+            for (int node=0; node<64; node++)
+            {
+              if (cache.m_cubicBSpline[faceDirection+1][node]==0)
+              {
+                continue;
+              }
+
+              int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+              if ((*cellFaces[faceDirection])[cellIndex]->m_state==State::Interior)
+              {
+                nodes[noFaces]=node;
+                cellIndices[noFaces]=cellIndex;
+                noFaces++;
+              }
+            }
+
+            for (int face_i=0; face_i<noFaces; face_i++)
+            {
+              int node_i=nodes[face_i];
+              Eigen::Vector3f weight_i_diff(cache.m_cubicBSpline_Diff[faceDirection][0][node_i],
+                                            cache.m_cubicBSpline_Diff[faceDirection][1][node_i],
+                                            cache.m_cubicBSpline_Diff[faceDirection][2][node_i]);
+
+              for (int face_j=0; face_j<noFaces; face_j++)
+              {
+                int node_j=nodes[face_j];
+                if (std::abs((node_i&3)-(node_j&3))>2 || std::abs(((node_i>>2)&3)-((node_j>>2)&3))>2 || std::abs((node_i>>4)-(node_j>>4))>2)
+                {
+                  continue;
+                }
+
+                Eigen::Vector3f weight_j_diff(cache.m_cubicBSpline_Diff[faceDirection][0][node_j],
+                                              cache.m_cubicBSpline_Diff[faceDirection][1][node_j],
+                                              cache.m_cubicBSpline_Diff[faceDirection][2][node_j]);
+
+                (*AMatrices[faceDirection])(cellIndices[face_i], cellIndices[face_j])+=calcAValue_DeviatoricVelocity(cache.m_particle, weight_i_diff, weight_j_diff, eVectors[faceDirection]);
+              }
+            }
+          }
+        }
+      }
+    }
+
+    //Add mass to diagonal elements
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      for (int faceDirection=0; faceDirection<3; faceDirection++)
+      {
+        CellFace* cellFace=(*cellFaces[faceDirection])[cellIndex];
+        if (cellFace->m_state==State::Interior)
+        {
+          (*AMatrices[faceDirection])(cellIndex, cellIndex)+=cellFace->m_mass;
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::updateParticleFromGrid_Cached(float _velocityContribAlpha, float _tempContribBeta)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Same contributions as updateParticleFromGrid, but gathered per particle from its cached stencil
+
+  Loop over cached particles
+    If particle is awake, for each face direction
+      Gather velocity and previous velocity of the 64 faces, zero outside stencil
+      Sum PIC/FLIP velocity and velocity gradient over faces
+    Add velocity and velocity gradient to particle once
+
+    If heat equation was solved this step
+      Gather temperature and previous temperature of the 64 centres, zero outside stencil
+      Sum PIC/FLIP temperature and add to particle
+  ---------------------------------------------------------------------------------------------------------------------
+  */
+
+  std::vector<CellFace*>* cellFaces[3]={&m_cellFacesX, &m_cellFacesY, &m_cellFacesZ};
+
+  float velocityFLIPFactor=_velocityContribAlpha;
+  float velocityPICFactor=1.0-_velocityContribAlpha;
+  float temperatureFLIPFactor=_tempContribBeta;
+  float temperaturePICFactor=1.0-_tempContribBeta;
+
+  int noParticles=m_particleStencilCache.size();
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("GridToParticle", "thread");
+
+#pragma omp for nowait
+    for (int cacheIndex=0; cacheIndex<noParticles; cacheIndex++)
+    {
+      const ParticleStencilCache &cache=m_particleStencilCache[cacheIndex];
+      Particle* particle=cache.m_particle;
+
+      //Faces. Sleeping particles keep zero velocity
+      if (!particle->isSleeping())
+      {
+        Eigen::Vector3f velContribVector;
+        Eigen::Matrix3f velGradContribution;
+
+        for (int faceDirection=0; faceDirection<3; faceDirection++)
+        {
+          const int* base=cache.m_base[faceDirection+1];
+
+          float velocity[64];
+          float prevVelocity[64];
+          for (int node=0; node<64; node++)
+          {
+            velocity[node]=0.0;
+            prevVelocity[node]=0.0;
+
+            if (cache.m_cubicBSpline[faceDirection+1][node]!=0)
+            {
+              int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+              velocity[node]=(*cellFaces[faceDirection])[cellIndex]->m_velocity;
+              prevVelocity[node]=(*cellFaces[faceDirection])[cellIndex]->m_previousVelocity;
+            }
+          }
+
+          const float* quadStencil=cache.m_tightQuadStencil[faceDirection+1];
+          const float* quadStencil_DiffX=cache.m_tightQuadStencil_Diff[faceDirection][0];
+          const float* quadStencil_DiffY=cache.m_tightQuadStencil_Diff[faceDirection][1];
+          const float* quadStencil_DiffZ=cache.m_tightQuadStencil_Diff[faceDirection][2];
+
+          float velocityContribution=0.0;
+          float velGradX=0.0;
+          float velGradY=0.0;
+          float velGradZ=0.0;
+#pragma omp simd reduction(+:velocityContribution,velGradX,velGradY,velGradZ)
+          for (int node=0; node<64; node++)
+          {
+            //PIC and FLIP velocity
+            float velocityPIC=velocity[node]*quadStencil[node];
+            float velocityFLIP=(velocity[node]-prevVelocity[node])*quadStencil[node];
+
+            velocityContribution+=(velocityFLIPFactor*velocityFLIP)+(velocityPICFactor*velocityPIC);
+
+            //Velocity gradient contribution
+            velGradX+=velocity[node]*quadStencil_DiffX[node];
+            velGradY+=velocity[node]*quadStencil_DiffY[node];
+            velGradZ+=velocity[node]*quadStencil_DiffZ[node];
+          }
+
+          velContribVector(faceDirection)=velocityContribution;
+          velGradContribution(faceDirection,0)=velGradX;
+          velGradContribution(faceDirection,1)=velGradY;
+          velGradContribution(faceDirection,2)=velGradZ;
+        }
+
+        //Update particle
+        particle->addParticleVelocity(velContribVector);
+        particle->addParticleVelocityGradient(velGradContribution);
+      }
+
+      //Cell centres. Only transfer temperature back if heat equation was solved this step
+      if (m_isTemperatureSolved)
+      {
+        const int* base=cache.m_base[0];
+
+        float temperature[64];
+        float prevTemperature[64];
+        for (int node=0; node<64; node++)
+        {
+          temperature[node]=0.0;
+          prevTemperature[node]=0.0;
+
+          if (cache.m_cubicBSpline[0][node]!=0)
+          {
+            int cellIndex=MathFunctions::getVectorIndex(base[0]+(node&3), base[1]+((node>>2)&3), base[2]+(node>>4), m_noCells);
+            temperature[node]=m_cellCentres[cellIndex]->m_temperature;
+            prevTemperature[node]=m_cellCentres[cellIndex]->m_previousTemperature;
+          }
+        }
+
+        const float* quadStencil=cache.m_tightQuadStencil[0];
+
+        float temperatureContribution=0.0;
+#pragma omp simd reduction(+:temperatureContribution)
+        for (int node=0; node<64; node++)
+        {
+          //PIC and FLIP temperature
+          float temperaturePIC=temperature[node]*quadStencil[node];
+          float temperatureFLIP=(temperature[node]-prevTemperature[node])*quadStencil[node];
+
+          temperatureContribution+=(temperatureFLIPFactor*temperatureFLIP)+(temperaturePICFactor*temperaturePIC);
+        }
+
+        particle->addParticleTemperature(temperatureContribution);
+      }
+    }
+  }
+}
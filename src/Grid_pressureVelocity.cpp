@@ -8,19 +8,20 @@ void Grid::projectVelocity()
   ----------------------------------------------------------------------------------------------------------------
   Calculate face densities
 
-  Set up eigen matrices to store values in
-
   Set up B
 
-  Set up A
+  Matrix free solver methods: set up A as stencil operator and solve it
 
-  Solve using conjugate gradient
+  Other methods: set up A in the cached pattern, writing values in place. Pattern is rebuilt only if the
+  interior cells have changed. Solve the test matrix with the pressure solver settings
 
   Set result to cells
 
   ----------------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(ProjectVelocity);
+
   //Calculate cell face densities for interior cells
 //#pragma omp parallel for
 //  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
@@ -32,169 +33,204 @@ void Grid::projectVelocity()
 //  }
 
 //Calculate cell face densities for interior cells
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+#pragma omp parallel
   {
-    //Only update if cell centres are interior
-    if (m_cellCentres[cellIndex]->m_state==State::Interior)
+    TRACE_SCOPE("ProjectVelocity", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
     {
-      //Get index of cell
-      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
-      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
-      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
-
-      //Get mass of cell faces
-      float massX=m_cellFacesX[cellIndex]->m_mass;
-      float massY=m_cellFacesY[cellIndex]->m_mass;
-      float massZ=m_cellFacesZ[cellIndex]->m_mass;
-
-      //Calculate control volumes of cell faces
-      float volumeX=calcFaceVolume(iIndex, jIndex, kIndex, 0);
-      float volumeY=calcFaceVolume(iIndex, jIndex, kIndex, 1);
-      float volumeZ=calcFaceVolume(iIndex, jIndex, kIndex, 2);
-
-      //Set cell face densities
-      m_cellFacesX[cellIndex]->m_density=massX/volumeX;
-      m_cellFacesY[cellIndex]->m_density=massY/volumeY;
-      m_cellFacesZ[cellIndex]->m_density=massZ/volumeZ;
-
-      //Check if cells of the upper faces are empty or colliding, if so calculate their density too
-      int cellIndex_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
-      int cellIndex_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
-      int cellIndex_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
-
-      if (m_cellCentres[cellIndex_i1jk]->m_state!=State::Interior)
+      //Only update if cell centres are interior
+      if (m_cellCentres[cellIndex]->m_state==State::Interior)
       {
-        float mass=m_cellFacesX[cellIndex_i1jk]->m_mass;
-        float volume=calcFaceVolume(iIndex+1, jIndex, kIndex, 0);
-        //Make sure volume isn't zero
-        if (volume!=0.0)
+        //Get index of cell
+        int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+        int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+        int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+        //Get mass of cell faces
+        float massX=m_cellFacesX[cellIndex]->m_mass;
+        float massY=m_cellFacesY[cellIndex]->m_mass;
+        float massZ=m_cellFacesZ[cellIndex]->m_mass;
+
+        //Calculate control volumes of cell faces
+        float volumeX=calcFaceVolume(iIndex, jIndex, kIndex, 0);
+        float volumeY=calcFaceVolume(iIndex, jIndex, kIndex, 1);
+        float volumeZ=calcFaceVolume(iIndex, jIndex, kIndex, 2);
+
+        //Set cell face densities
+        m_cellFacesX[cellIndex]->m_density=massX/volumeX;
+        m_cellFacesY[cellIndex]->m_density=massY/volumeY;
+        m_cellFacesZ[cellIndex]->m_density=massZ/volumeZ;
+
+        //Check if cells of the upper faces are empty or colliding, if so calculate their density too
+        int cellIndex_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
+        int cellIndex_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
+        int cellIndex_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
+
+        if (m_cellCentres[cellIndex_i1jk]->m_state!=State::Interior)
         {
-          m_cellFacesX[cellIndex_i1jk]->m_density=mass/volume;
+          float mass=m_cellFacesX[cellIndex_i1jk]->m_mass;
+          float volume=calcFaceVolume(iIndex+1, jIndex, kIndex, 0);
+          //Make sure volume isn't zero
+          if (volume!=0.0)
+          {
+            m_cellFacesX[cellIndex_i1jk]->m_density=mass/volume;
+          }
         }
-      }
-      if (m_cellCentres[cellIndex_ij1k]->m_state!=State::Interior)
-      {
-        float mass=m_cellFacesY[cellIndex_ij1k]->m_mass;
-        float volume=calcFaceVolume(iIndex, jIndex+1, kIndex, 1);
-        //Make sure volume isn't zero
-        if (volume!=0.0)
+        if (m_cellCentres[cellIndex_ij1k]->m_state!=State::Interior)
         {
-          m_cellFacesY[cellIndex_ij1k]->m_density=mass/volume;
+          float mass=m_cellFacesY[cellIndex_ij1k]->m_mass;
+          float volume=calcFaceVolume(iIndex, jIndex+1, kIndex, 1);
+          //Make sure volume isn't zero
+          if (volume!=0.0)
+          {
+            m_cellFacesY[cellIndex_ij1k]->m_density=mass/volume;
+          }
         }
-      }
-      if (m_cellCentres[cellIndex_ijk1]->m_state!=State::Interior)
-      {
-        float mass=m_cellFacesZ[cellIndex_ijk1]->m_mass;
-        float volume=calcFaceVolume(iIndex, jIndex, kIndex+1, 2);
-        //Make sure volume isn't zero
-        if (volume!=0.0)
+        if (m_cellCentres[cellIndex_ijk1]->m_state!=State::Interior)
         {
-          m_cellFacesZ[cellIndex_ijk1]->m_density=mass/volume;
+          float mass=m_cellFacesZ[cellIndex_ijk1]->m_mass;
+          float volume=calcFaceVolume(iIndex, jIndex, kIndex+1, 2);
+          //Make sure volume isn't zero
+          if (volume!=0.0)
+          {
+            m_cellFacesZ[cellIndex_ijk1]->m_density=mass/volume;
+          }
         }
-      }
 
+      }
     }
   }
 
-  //Set up matrices for linear system
-  Eigen::SparseMatrix<double> A_matrix(m_totNoCells, m_totNoCells);
+  //Set up vectors for linear system, B is zero for cells that aren't interior
   Eigen::VectorXd B_vector(m_totNoCells);
   Eigen::VectorXd solution(m_totNoCells);
-
-  Eigen::MatrixXf A_matrix_test(m_totNoCells, m_totNoCells);
-  A_matrix_test.setZero();
-
-  //Initialise A and B to zero
-  A_matrix.setZero();
   B_vector.setZero();
   solution.setZero();
 
-  //Calculate A and B elements
-  ///NB! This doesn't work when threaded because of the workings of the sparse matrix.
-  /// TODO: Check if faster if create just Eigen::MatrixXf then copy values across, or do B_vector separately and threaded
-//#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+  SolverRecord solverRecord;
+
+  if (LinearSolver::isMatrixFree(m_pressureSolver.m_method))
   {
-    //Only fill in interior cells
-    if (m_cellCentres[cellIndex]->m_state==State::Interior)
-    {
-      //Get ijk
-      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
-      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
-      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+    //Set operator from cell states and pressure constants, without a matrix
+    m_pressureOperator.resize(m_noCells);
 
-      //Calculate B element
-      B_vector(cellIndex)=calcBComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex);
+#pragma omp parallel for
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      if (m_cellCentres[cellIndex]->m_state==State::Interior)
+      {
+        int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+        int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+        int kIndex=m_cellCentres[cellIndex]->m_kIndex;
 
-      //Insert A elements
-      calcAComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex, A_matrix, A_matrix_test);
+        B_vector(cellIndex)=calcBComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex);
+        calcAComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex, m_pressureOperator);
+      }
     }
 
+    LinearSolver::solve(m_pressureSolver, m_pressureOperator, m_pressureMultigrid, B_vector, solution, solverRecord);
   }
-
-   //TEST FOR WHETHER 1 AT EMPTY DIAGONALS WILL MAKE A DIFFERENCE
-  //Remake matrix to check if determinant is zero
-  Eigen::SparseMatrix<double> testSingular(m_totNoCells, m_totNoCells);
-  for (int testItr=0; testItr<m_totNoCells; testItr++)
+  else
   {
-    for (int testItr2=0; testItr2<m_totNoCells; testItr2++)
+    updateStencilPattern(m_pressureSystem);
+
+    Eigen::MatrixXf A_matrix_test(m_totNoCells, m_totNoCells);
+    A_matrix_test.setZero();
+
+    //Calculate A and B elements. Each interior cell writes its own row of the cached pattern, so can be threaded
+#pragma omp parallel for
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+    {
+      //Only fill in interior cells
+      if (m_cellCentres[cellIndex]->m_state==State::Interior)
+      {
+        //Get ijk
+        int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+        int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+        int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+        //Calculate B element
+        B_vector(cellIndex)=calcBComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex);
+
+        //Insert A elements
+        calcAComponent_projectVelocity(cellIndex, iIndex, jIndex, kIndex, m_pressureSystem, A_matrix_test);
+      }
+
+    }
+
+    //TEST FOR WHETHER 1 AT EMPTY DIAGONALS WILL MAKE A DIFFERENCE
+    //Remake matrix to check if determinant is zero
+    Eigen::SparseMatrix<double> testSingular(m_totNoCells, m_totNoCells);
+    for (int testItr=0; testItr<m_totNoCells; testItr++)
     {
-      if (testItr==testItr2)
+      for (int testItr2=0; testItr2<m_totNoCells; testItr2++)
       {
-        if (m_Amatrix_deviatoric_X(testItr, testItr2)!=0)
+        if (testItr==testItr2)
         {
-          testSingular.insert(testItr,testItr2)=m_Amatrix_deviatoric_X(testItr, testItr2);
+          if (m_Amatrix_deviatoric_X(testItr, testItr2)!=0)
+          {
+            testSingular.insert(testItr,testItr2)=m_Amatrix_deviatoric_X(testItr, testItr2);
+          }
+          else
+          {
+            testSingular.insert(testItr,testItr2)=1.0;
+          }
         }
         else
         {
-          testSingular.insert(testItr,testItr2)=1.0;
-        }
-      }
-      else
-      {
-        if (m_Amatrix_deviatoric_X(testItr, testItr2)!=0)
-        {
-          testSingular.insert(testItr,testItr2)=m_Amatrix_deviatoric_X(testItr, testItr2);
+          if (m_Amatrix_deviatoric_X(testItr, testItr2)!=0)
+          {
+            testSingular.insert(testItr,testItr2)=m_Amatrix_deviatoric_X(testItr, testItr2);
+          }
         }
-      }
 
+      }
     }
-  }
-//  float determinant=testSingular.determinant();
+    //  float determinant=testSingular.determinant();
+
+    //Account system temporaries to memory tracker while they are alive
+    ScopedAllocation systemAllocation(MemoryTracker::LinearSystems,
+                                      MemoryTracker::getSparseMatrixBytes(testSingular)
+                                      +((int64_t)A_matrix_test.size()*sizeof(float))+((B_vector.size()+solution.size())*sizeof(double)));
 
+    //Solve system
+    //  MathFunctions::conjugateGradient(A_matrix, B_vector, solution, maxLoops, minResidual);
+    LinearSolver::solve(m_pressureSolver, testSingular, m_isDeterministic, B_vector, solution, solverRecord);
+  }
 
-  //Solve system
-  float maxLoops=3000;
-  float minResidual=0.00001;
-//  MathFunctions::conjugateGradient(A_matrix, B_vector, solution, maxLoops, minResidual);
-  MathFunctions::conjugateGradient(testSingular, B_vector, solution, maxLoops, minResidual);
+  SolverMetrics::instance()->addSolve(SolverMetrics::Pressure, solverRecord);
 
 
   //Use results to calculate projected velocities
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
+#pragma omp parallel
   {
-    //Only correct faces surrounding interior cells
-    if (m_cellCentres[cellIndex]->m_state==State::Interior)
+    TRACE_SCOPE("ProjectVelocity", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; cellIndex++)
     {
-      //Get indices of cell
-      int iIndex=m_cellCentres[cellIndex]->m_iIndex;
-      int jIndex=m_cellCentres[cellIndex]->m_jIndex;
-      int kIndex=m_cellCentres[cellIndex]->m_kIndex;
-
-      //Get indices of surrounding cells
-      int indexCell_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
-      int indexCell_i_1jk=MathFunctions::getVectorIndex(iIndex-1, jIndex, kIndex, m_noCells);
-      int indexCell_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
-      int indexCell_ij_1k=MathFunctions::getVectorIndex(iIndex, jIndex-1, kIndex, m_noCells);
-      int indexCell_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
-      int indexCell_ijk_1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex-1, m_noCells);
-
-      ///Update all faces or only the non-colliding?
-
-      //Get pressure for all indices
-      float pressure_ijk=solution(cellIndex);
+      //Only correct faces surrounding interior cells
+      if (m_cellCentres[cellIndex]->m_state==State::Interior)
+      {
+        //Get indices of cell
+        int iIndex=m_cellCentres[cellIndex]->m_iIndex;
+        int jIndex=m_cellCentres[cellIndex]->m_jIndex;
+        int kIndex=m_cellCentres[cellIndex]->m_kIndex;
+
+        //Get indices of surrounding cells
+        int indexCell_i1jk=MathFunctions::getVectorIndex(iIndex+1, jIndex, kIndex, m_noCells);
+        int indexCell_i_1jk=MathFunctions::getVectorIndex(iIndex-1, jIndex, kIndex, m_noCells);
+        int indexCell_ij1k=MathFunctions::getVectorIndex(iIndex, jIndex+1, kIndex, m_noCells);
+        int indexCell_ij_1k=MathFunctions::getVectorIndex(iIndex, jIndex-1, kIndex, m_noCells);
+        int indexCell_ijk1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex+1, m_noCells);
+        int indexCell_ijk_1=MathFunctions::getVectorIndex(iIndex, jIndex, kIndex-1, m_noCells);
+
+        ///Update all faces or only the non-colliding?
+
+        //Get pressure for all indices
+        float pressure_ijk=solution(cellIndex);
 //      float pressure_i1jk=solution(indexCell_i1jk);
 //      float pressure_i_1jk=solution(indexCell_i_1jk);
 //      float pressure_ij1k=solution(indexCell_ij1k);
@@ -202,162 +238,163 @@ void Grid::projectVelocity()
 //      float pressure_ijk1=solution(indexCell_ijk1);
 //      float pressure_ijk_1=solution(indexCell_ijk_1);
 
-        float pressure_i1jk=0.0;
-        float pressure_i_1jk=0.0;
-        float pressure_ij1k=0.0;
-        float pressure_ij_1k=0.0;
-        float pressure_ijk1=0.0;
-        float pressure_ijk_1=0.0;
-
-      //Get state of neighbouring cells
-      State state_i1jk=m_cellCentres[indexCell_i1jk]->m_state;
-      State state_i_1jk=m_cellCentres[indexCell_i_1jk]->m_state;
-      State state_ij1k=m_cellCentres[indexCell_ij1k]->m_state;
-      State state_ij_1k=m_cellCentres[indexCell_ij_1k]->m_state;
-      State state_ijk1=m_cellCentres[indexCell_ijk1]->m_state;
-      State state_ijk_1=m_cellCentres[indexCell_ijk_1]->m_state;
-
-      //Enforce boundaries
-      //If neighbour cells is interior, set to solution
-      //if colliding set to pressure of ijk so pressure gradient is zero
-      //If empty, leave pressure as zero.
-      if (state_i1jk==State::Interior)
-      {
-        pressure_i1jk=solution(indexCell_i1jk);
-      }
-      else if (state_i1jk==State::Colliding)
-      {
-        pressure_i1jk=pressure_ijk;
-      }
+          float pressure_i1jk=0.0;
+          float pressure_i_1jk=0.0;
+          float pressure_ij1k=0.0;
+          float pressure_ij_1k=0.0;
+          float pressure_ijk1=0.0;
+          float pressure_ijk_1=0.0;
+
+        //Get state of neighbouring cells
+        State state_i1jk=m_cellCentres[indexCell_i1jk]->m_state;
+        State state_i_1jk=m_cellCentres[indexCell_i_1jk]->m_state;
+        State state_ij1k=m_cellCentres[indexCell_ij1k]->m_state;
+        State state_ij_1k=m_cellCentres[indexCell_ij_1k]->m_state;
+        State state_ijk1=m_cellCentres[indexCell_ijk1]->m_state;
+        State state_ijk_1=m_cellCentres[indexCell_ijk_1]->m_state;
+
+        //Enforce boundaries
+        //If neighbour cells is interior, set to solution
+        //if colliding set to pressure of ijk so pressure gradient is zero
+        //If empty, leave pressure as zero.
+        if (state_i1jk==State::Interior)
+        {
+          pressure_i1jk=solution(indexCell_i1jk);
+        }
+        else if (state_i1jk==State::Colliding)
+        {
+          pressure_i1jk=pressure_ijk;
+        }
 
-      if (state_i_1jk==State::Interior)
-      {
-        pressure_i_1jk=solution(indexCell_i_1jk);
-      }
-      else if (state_i_1jk==State::Colliding)
-      {
-        pressure_i_1jk=pressure_ijk;
-      }
+        if (state_i_1jk==State::Interior)
+        {
+          pressure_i_1jk=solution(indexCell_i_1jk);
+        }
+        else if (state_i_1jk==State::Colliding)
+        {
+          pressure_i_1jk=pressure_ijk;
+        }
 
-      if (state_ij1k==State::Interior)
-      {
-        pressure_ij1k=solution(indexCell_ij1k);
-      }
-      else if (state_ij1k==State::Colliding)
-      {
-        pressure_ij1k=pressure_ijk;
-      }
+        if (state_ij1k==State::Interior)
+        {
+          pressure_ij1k=solution(indexCell_ij1k);
+        }
+        else if (state_ij1k==State::Colliding)
+        {
+          pressure_ij1k=pressure_ijk;
+        }
 
-      if (state_ij_1k==State::Interior)
-      {
-        pressure_ij_1k=solution(indexCell_ij_1k);
-      }
-      else if (state_ij_1k==State::Colliding)
-      {
-        pressure_ij_1k=pressure_ijk;
-      }
+        if (state_ij_1k==State::Interior)
+        {
+          pressure_ij_1k=solution(indexCell_ij_1k);
+        }
+        else if (state_ij_1k==State::Colliding)
+        {
+          pressure_ij_1k=pressure_ijk;
+        }
 
-      if (state_ijk1==State::Interior)
-      {
-        pressure_ijk1=solution(indexCell_ijk1);
-      }
-      else if (state_ijk1==State::Colliding)
-      {
-        pressure_ijk1=pressure_ijk;
-      }
+        if (state_ijk1==State::Interior)
+        {
+          pressure_ijk1=solution(indexCell_ijk1);
+        }
+        else if (state_ijk1==State::Colliding)
+        {
+          pressure_ijk1=pressure_ijk;
+        }
 
-      if (state_ijk_1==State::Interior)
-      {
-        pressure_ijk_1=solution(indexCell_ijk_1);
-      }
-      else if (state_ijk_1==State::Colliding)
-      {
-        pressure_ijk_1=pressure_ijk;
-      }
+        if (state_ijk_1==State::Interior)
+        {
+          pressure_ijk_1=solution(indexCell_ijk_1);
+        }
+        else if (state_ijk_1==State::Colliding)
+        {
+          pressure_ijk_1=pressure_ijk;
+        }
 
-      //Check pressure isn't zero
-      if (pressure_ijk<0)
-      {
-        pressure_ijk=0.0;
+        //Check pressure isn't zero
+        if (pressure_ijk<0)
+        {
+          pressure_ijk=0.0;
 //        pressure_ijk=std::abs(pressure_ijk);
-      }
+        }
 
-      if (pressure_i1jk<0)
-      {
-        pressure_i1jk=0.0;
+        if (pressure_i1jk<0)
+        {
+          pressure_i1jk=0.0;
 //        pressure_i1jk=std::abs(pressure_i1jk);
-      }
-      if (pressure_i_1jk<0)
-      {
-        pressure_i_1jk=0.0;
+        }
+        if (pressure_i_1jk<0)
+        {
+          pressure_i_1jk=0.0;
 //        pressure_i_1jk=std::abs(pressure_i_1jk);
-      }
-      if (pressure_ij1k<0)
-      {
-        pressure_ij1k=0.0;
+        }
+        if (pressure_ij1k<0)
+        {
+          pressure_ij1k=0.0;
 //        pressure_ij1k=std::abs(pressure_ij1k);
-      }
-      if (pressure_ij_1k<0)
-      {
-        pressure_ij_1k=0.0;
+        }
+        if (pressure_ij_1k<0)
+        {
+          pressure_ij_1k=0.0;
 //        pressure_ij_1k=std::abs(pressure_ij_1k);
-      }
-      if (pressure_ijk1<0)
-      {
-        pressure_ijk1=0.0;
+        }
+        if (pressure_ijk1<0)
+        {
+          pressure_ijk1=0.0;
 //        pressure_ijk1=std::abs(pressure_ijk1);
-      }
-      if (pressure_ijk_1<0)
-      {
-        pressure_ijk_1=0.0;
+        }
+        if (pressure_ijk_1<0)
+        {
+          pressure_ijk_1=0.0;
 //        pressure_ijk_1=std::abs(pressure_ijk_1);
-      }
+        }
 
-      //Calculate pressure gradients
-      float pressureGradient_i1jk=pressure_i1jk-pressure_ijk;
-      float pressureGradient_i_1jk=pressure_ijk-pressure_i_1jk;
-      float pressureGradient_ij1k=pressure_ij1k-pressure_ijk;
-      float pressureGradient_ij_1k=pressure_ijk-pressure_ij_1k;
-      float pressureGradient_ijk1=pressure_ijk1-pressure_ijk;
-      float pressureGradient_ijk_1=pressure_ijk-pressure_ijk_1;
-
-      //Calculate constant to be multiplied with gradient
-      float constant=m_dt/m_cellSize;
-      float constantX=constant/m_cellFacesX[cellIndex]->m_density;
-      float constantY=constant/m_cellFacesY[cellIndex]->m_density;
-      float constantZ=constant/m_cellFacesZ[cellIndex]->m_density;
+        //Calculate pressure gradients
+        float pressureGradient_i1jk=pressure_i1jk-pressure_ijk;
+        float pressureGradient_i_1jk=pressure_ijk-pressure_i_1jk;
+        float pressureGradient_ij1k=pressure_ij1k-pressure_ijk;
+        float pressureGradient_ij_1k=pressure_ijk-pressure_ij_1k;
+        float pressureGradient_ijk1=pressure_ijk1-pressure_ijk;
+        float pressureGradient_ijk_1=pressure_ijk-pressure_ijk_1;
+
+        //Calculate constant to be multiplied with gradient
+        float constant=m_dt/m_cellSize;
+        float constantX=constant/m_cellFacesX[cellIndex]->m_density;
+        float constantY=constant/m_cellFacesY[cellIndex]->m_density;
+        float constantZ=constant/m_cellFacesZ[cellIndex]->m_density;
 //      float constantX=constant;
 //      float constantY=constant;
 //      float constantZ=constant;
 
 
-      //Calculate projected velocity
-      m_cellFacesX[cellIndex]->m_velocity=m_cellFacesX[cellIndex]->m_velocity - (constantX*pressureGradient_i_1jk);
-      m_cellFacesY[cellIndex]->m_velocity=m_cellFacesY[cellIndex]->m_velocity - (constantY*pressureGradient_ij_1k);
-      m_cellFacesZ[cellIndex]->m_velocity=m_cellFacesZ[cellIndex]->m_velocity - (constantZ*pressureGradient_ijk_1);
+        //Calculate projected velocity
+        m_cellFacesX[cellIndex]->m_velocity=m_cellFacesX[cellIndex]->m_velocity - (constantX*pressureGradient_i_1jk);
+        m_cellFacesY[cellIndex]->m_velocity=m_cellFacesY[cellIndex]->m_velocity - (constantY*pressureGradient_ij_1k);
+        m_cellFacesZ[cellIndex]->m_velocity=m_cellFacesZ[cellIndex]->m_velocity - (constantZ*pressureGradient_ijk_1);
+
+        //Update upper surrounding faces, if the cells they belong to are empty or colliding
+        //Face X
+        if (m_cellCentres[indexCell_i1jk]->m_state!=State::Interior)
+        {
+          float constantX1=constant/m_cellFacesX[indexCell_i1jk]->m_density;
+          m_cellFacesX[indexCell_i1jk]->m_velocity=m_cellFacesX[indexCell_i1jk]->m_velocity - (constantX1*pressureGradient_i1jk);
+        }
+        //Face Y
+        if (m_cellCentres[indexCell_ij1k]->m_state!=State::Interior)
+        {
+          float constantY1=constant/m_cellFacesY[indexCell_ij1k]->m_density;
+          m_cellFacesY[indexCell_ij1k]->m_velocity=m_cellFacesY[indexCell_ij1k]->m_velocity - (constantY1*pressureGradient_ij1k);
+        }
+        //Face Z
+        if (m_cellCentres[indexCell_ijk1]->m_state!=State::Interior)
+        {
+          float constantZ1=constant/m_cellFacesZ[indexCell_ijk1]->m_density;
+          m_cellFacesZ[indexCell_ijk1]->m_velocity=m_cellFacesZ[indexCell_ijk1]->m_velocity - (constantZ1*pressureGradient_ijk1);
+        }
 
-      //Update upper surrounding faces, if the cells they belong to are empty or colliding
-      //Face X
-      if (m_cellCentres[indexCell_i1jk]->m_state!=State::Interior)
-      {
-        float constantX1=constant/m_cellFacesX[indexCell_i1jk]->m_density;
-        m_cellFacesX[indexCell_i1jk]->m_velocity=m_cellFacesX[indexCell_i1jk]->m_velocity - (constantX1*pressureGradient_i1jk);
-      }
-      //Face Y
-      if (m_cellCentres[indexCell_ij1k]->m_state!=State::Interior)
-      {
-        float constantY1=constant/m_cellFacesY[indexCell_ij1k]->m_density;
-        m_cellFacesY[indexCell_ij1k]->m_velocity=m_cellFacesY[indexCell_ij1k]->m_velocity - (constantY1*pressureGradient_ij1k);
-      }
-      //Face Z
-      if (m_cellCentres[indexCell_ijk1]->m_state!=State::Interior)
-      {
-        float constantZ1=constant/m_cellFacesZ[indexCell_ijk1]->m_density;
-        m_cellFacesZ[indexCell_ijk1]->m_velocity=m_cellFacesZ[indexCell_ijk1]->m_velocity - (constantZ1*pressureGradient_ijk1);
       }
 
     }
-
   }
 
 
@@ -432,7 +469,7 @@ float Grid::calcBComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIn
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, Eigen::SparseMatrix<double> &o_A, Eigen::MatrixXf &o_A_test)
+void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, StencilSystem &io_system, Eigen::MatrixXf &o_A_test)
 {
   /* Outline
   ----------------------------------------------------------------------------------------------------------------
@@ -457,7 +494,7 @@ void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jInd
 
   Add pressure constant to A[ijk,ijk]
 
-  Insert all A components into matrix
+  Write all A components into the entries of the cached pattern
 
   ----------------------------------------------------------------------------------------------------------------
   */
@@ -473,11 +510,6 @@ void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jInd
   //Calculate constant=dt/cellSize^2
   float constant=(m_dt/(pow(m_cellSize,2)));
 
-  //Get densities for cell faces of current cell
-  float densityX_ijk=m_cellFacesX[_cellIndex]->m_density;
-  float densityY_ijk=m_cellFacesY[_cellIndex]->m_density;
-  float densityZ_ijk=m_cellFacesZ[_cellIndex]->m_density;
-
   //Set up sumInvDensity
 //  float A_ijk_X=(-2.0);
 //  float A_ijk_Y=(-2.0);
@@ -629,33 +661,19 @@ void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jInd
   A_ijk*=constant;
 
   //Add pressureConstant to A_ijk
-  float pressureConst;
-  float detDeformGradElastic=m_cellCentres[_cellIndex]->m_detDeformationGradElastic;
-//  float detDeformGradPlastic=m_cellCentres[_cellIndex]->m_detDeformationGradPlastic;
-
-  float detDeformGrad=m_cellCentres[_cellIndex]->m_detDeformationGrad;
-  float detDeformGradPlastic=detDeformGrad/detDeformGradElastic;
-
-  float lambdaInv=m_cellCentres[_cellIndex]->m_lameLambdaInverse;
-  pressureConst=detDeformGradPlastic/detDeformGradElastic;
-  pressureConst*=lambdaInv;
-  pressureConst*=(1.0/m_dt);
-
-  //Add density here
-  pressureConst*=(densityX_ijk + densityY_ijk + densityZ_ijk);
+  float pressureConst=calcPressureConstant(_cellIndex);
 
   A_ijk+=pressureConst;
 
 
-  //Insert values into matrix
-  //Might need to do this in main function for parallelisation
-  o_A.insert(_cellIndex, _cellIndex)=A_ijk;
-  o_A.insert(_cellIndex, cellIndex_i1jk)=A_i1jk;
-  o_A.insert(_cellIndex, cellIndex_i_1jk)=A_i_1jk;
-  o_A.insert(_cellIndex, cellIndex_ij1k)=A_ij1k;
-  o_A.insert(_cellIndex, cellIndex_ij_1k)=A_ij_1k;
-  o_A.insert(_cellIndex, cellIndex_ijk1)=A_ijk1;
-  o_A.insert(_cellIndex, cellIndex_ijk_1)=A_ijk_1;
+  //Write values into the entries of the cached pattern
+  io_system.setValue(_cellIndex, StencilSystem::Diagonal, A_ijk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_i1jk, A_i1jk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_i_1jk, A_i_1jk);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ij1k, A_ij1k);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ij_1k, A_ij_1k);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ijk1, A_ijk1);
+  io_system.setValue(_cellIndex, StencilSystem::Neighbour_ijk_1, A_ijk_1);
 
   //Insert values into matrix
   //TEST
@@ -672,6 +690,83 @@ void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jInd
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Grid::calcAComponent_projectVelocity(int _cellIndex, int _iIndex, int _jIndex, int _kIndex, StencilOperator &io_operator)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Same A components as for the stencil system
+
+  Diagonal is (6 - number of colliding neighbours)*(dt/cellSize^2) + pressure constant
+
+  Couplings over the lower faces are dt/cellSize^2 if the lower neighbour is interior, otherwise zero. Couplings
+  over the upper faces are set by the upper neighbours if they are interior, and stay zero otherwise
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  //Calculate constant=dt/cellSize^2
+  float constant=(m_dt/(pow(m_cellSize,2)));
+
+  int neighbourIndices[6]={MathFunctions::getVectorIndex(_iIndex+1, _jIndex, _kIndex, m_noCells),
+                           MathFunctions::getVectorIndex(_iIndex-1, _jIndex, _kIndex, m_noCells),
+                           MathFunctions::getVectorIndex(_iIndex, _jIndex+1, _kIndex, m_noCells),
+                           MathFunctions::getVectorIndex(_iIndex, _jIndex-1, _kIndex, m_noCells),
+                           MathFunctions::getVectorIndex(_iIndex, _jIndex, _kIndex+1, m_noCells),
+                           MathFunctions::getVectorIndex(_iIndex, _jIndex, _kIndex-1, m_noCells)};
+
+  int noCollidingNeighbours=0;
+  for (int neighbour=0; neighbour<6; neighbour++)
+  {
+    if (m_cellCentres[neighbourIndices[neighbour]]->m_state==State::Colliding)
+    {
+      noCollidingNeighbours+=1;
+    }
+  }
+
+  //Lower neighbours are every second entry
+  for (int direction=0; direction<3; direction++)
+  {
+    if (m_cellCentres[neighbourIndices[(2*direction)+1]]->m_state==State::Interior)
+    {
+      io_operator.m_coupling[direction][_cellIndex]=constant;
+    }
+  }
+
+  float A_ijk=(6.0-noCollidingNeighbours);
+  A_ijk*=constant;
+  A_ijk+=calcPressureConstant(_cellIndex);
+
+  io_operator.m_diagonal[_cellIndex]=A_ijk;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float Grid::calcPressureConstant(int _cellIndex)
+{
+  /// @brief J_Pc/(J_Ec*lambda*dt), times the sum of the face densities of the cell
+
+  float pressureConst;
+  float detDeformGradElastic=m_cellCentres[_cellIndex]->m_detDeformationGradElastic;
+//  float detDeformGradPlastic=m_cellCentres[_cellIndex]->m_detDeformationGradPlastic;
+
+  float detDeformGrad=m_cellCentres[_cellIndex]->m_detDeformationGrad;
+  float detDeformGradPlastic=detDeformGrad/detDeformGradElastic;
+
+  float lambdaInv=m_cellCentres[_cellIndex]->m_lameLambdaInverse;
+  pressureConst=detDeformGradPlastic/detDeformGradElastic;
+  pressureConst*=lambdaInv;
+  pressureConst*=(1.0/m_dt);
+
+  //Add density here
+  float densityX_ijk=m_cellFacesX[_cellIndex]->m_density;
+  float densityY_ijk=m_cellFacesY[_cellIndex]->m_density;
+  float densityZ_ijk=m_cellFacesZ[_cellIndex]->m_density;
+  pressureConst*=(densityX_ijk + densityY_ijk + densityZ_ijk);
+
+  return pressureConst;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Grid::calcFaceDensities(int _cellIndex)
 {
   /* Outline
@@ -1,5 +1,8 @@
 #include "Grid.h"
 
+#include <algorithm>
+#include <cmath>
+
 void Grid::updateParticleFromGrid(float _velocityContribAlpha, float _tempContribBeta)
 {
   /* Outline
@@ -10,7 +13,7 @@ void Grid::updateParticleFromGrid(float _velocityContribAlpha, float _tempContri
     Get quadratic stencil of centre
     Get temperature and previous temp
 
-    Calc PIC velocity for each face
+    Calc PIC velocity for each face, skipping sleeping particles
     Calc FLIP velocity for each face
     Add to particle
 
@@ -26,170 +29,362 @@ void Grid::updateParticleFromGrid(float _velocityContribAlpha, float _tempContri
   ---------------------------------------------------------------------------------------------------------------------
   */
 
+  PROFILE_STAGE(GridToParticle);
+
+  if (m_isParticleStencilCache)
+  {
+    updateParticleFromGrid_Cached(_velocityContribAlpha, _tempContribBeta);
+    return;
+  }
+
+  if (m_isDeterministic)
+  {
+    updateParticleFromGrid_Deterministic(_velocityContribAlpha, _tempContribBeta);
+    return;
+  }
+
   //Set e_{a(i)} vectors
   Eigen::Vector3f e_x(1.0, 0.0, 0.0);
   Eigen::Vector3f e_y(0.0, 1.0, 0.0);
   Eigen::Vector3f e_z(0.0, 0.0, 1.0);
 
-#pragma omp parallel for
-  for (int cellIndex=0; cellIndex<m_totNoCells; ++cellIndex)
+#pragma omp parallel
   {
-    //Get velocity and previous velocity of faces
-    float velocity_FaceX=m_cellFacesX[cellIndex]->m_velocity;
-    float velocity_FaceY=m_cellFacesY[cellIndex]->m_velocity;
-    float velocity_FaceZ=m_cellFacesZ[cellIndex]->m_velocity;
-    float prevVelocity_FaceX=m_cellFacesX[cellIndex]->m_previousVelocity;
-    float prevVelocity_FaceY=m_cellFacesY[cellIndex]->m_previousVelocity;
-    float prevVelocity_FaceZ=m_cellFacesZ[cellIndex]->m_previousVelocity;
+    TRACE_SCOPE("GridToParticle", "thread");
+
+#pragma omp for nowait
+    for (int cellIndex=0; cellIndex<m_totNoCells; ++cellIndex)
+    {
+      //Get velocity and previous velocity of faces
+      float velocity_FaceX=m_cellFacesX[cellIndex]->m_velocity;
+      float velocity_FaceY=m_cellFacesY[cellIndex]->m_velocity;
+      float velocity_FaceZ=m_cellFacesZ[cellIndex]->m_velocity;
+      float prevVelocity_FaceX=m_cellFacesX[cellIndex]->m_previousVelocity;
+      float prevVelocity_FaceY=m_cellFacesY[cellIndex]->m_previousVelocity;
+      float prevVelocity_FaceZ=m_cellFacesZ[cellIndex]->m_previousVelocity;
 
-    //Get temperature and previous temperature
-    float temperature=m_cellCentres[cellIndex]->m_temperature;
-    float prevTemperature=m_cellCentres[cellIndex]->m_previousTemperature;
+      //Get temperature and previous temperature
+      float temperature=m_cellCentres[cellIndex]->m_temperature;
+      float prevTemperature=m_cellCentres[cellIndex]->m_previousTemperature;
 
-    //Face X
+      //Face X
 
 //    if (cellIndex==170)
 //    {
 //      std::cout<<"test\n";
 //    }
 
-    int noParticles_FaceX=m_cellFacesX[cellIndex]->m_interpolationData.size();
-    for (int particleIterator=0; particleIterator<noParticles_FaceX; particleIterator++)
-    {
-      //Get quadratic stencil and its derivative
-      float quadStencil=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
-
-      //Check that quad stencil isn't zero
-      if (quadStencil!=0)
+      int noParticles_FaceX=m_cellFacesX[cellIndex]->m_noParticlesContributing;
+      for (int particleIterator=0; particleIterator<noParticles_FaceX; particleIterator++)
       {
-        Eigen::Vector3f quadStencil_Diff=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil_Diff;
+        //Get quadratic stencil and its derivative
+        float quadStencil=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
+        Particle* particle=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator].m_particle;
 
-        //PIC velocity
-        float velocityPIC=velocity_FaceX*quadStencil;
+        //Check that quad stencil isn't zero. Sleeping particles keep zero velocity
+        if (quadStencil!=0 && !particle->isSleeping())
+        {
+          Eigen::Vector3f quadStencil_Diff=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil_Diff;
 
-        //FLIP velocity
-        float velocityFLIP=(velocity_FaceX-prevVelocity_FaceX)*quadStencil;
+          //PIC velocity
+          float velocityPIC=velocity_FaceX*quadStencil;
 
-        //Velocity contribution
-        float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
-        Eigen::Vector3f velContribVector=velocityContribution*e_x;
+          //FLIP velocity
+          float velocityFLIP=(velocity_FaceX-prevVelocity_FaceX)*quadStencil;
 
-        //Set up velocity gradient contribution
-        Eigen::Matrix3f velGradContribution;
-        velGradContribution.setZero();
-        velGradContribution(0,0)=velocity_FaceX*quadStencil_Diff(0);
-        velGradContribution(0,1)=velocity_FaceX*quadStencil_Diff(1);
-        velGradContribution(0,2)=velocity_FaceX*quadStencil_Diff(2);
+          //Velocity contribution
+          float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
+          Eigen::Vector3f velContribVector=velocityContribution*e_x;
 
-        //Update particle
-        Particle* particle=m_cellFacesX[cellIndex]->m_interpolationData[particleIterator]->m_particle;
-        particle->addParticleVelocity(velContribVector);
-        particle->addParticleVelocityGradient(velGradContribution);
-      }
+          //Set up velocity gradient contribution
+          Eigen::Matrix3f velGradContribution;
+          velGradContribution.setZero();
+          velGradContribution(0,0)=velocity_FaceX*quadStencil_Diff(0);
+          velGradContribution(0,1)=velocity_FaceX*quadStencil_Diff(1);
+          velGradContribution(0,2)=velocity_FaceX*quadStencil_Diff(2);
 
-    }
+          //Update particle
+          particle->addParticleVelocity(velContribVector);
+          particle->addParticleVelocityGradient(velGradContribution);
+        }
 
-    //Face Y
-    int noParticles_FaceY=m_cellFacesY[cellIndex]->m_interpolationData.size();
-    for (int particleIterator=0; particleIterator<noParticles_FaceY; particleIterator++)
-    {
-      //Get quadratic stencil and its derivative
-      float quadStencil=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
+      }
 
-      if (quadStencil!=0)
+      //Face Y
+      int noParticles_FaceY=m_cellFacesY[cellIndex]->m_noParticlesContributing;
+      for (int particleIterator=0; particleIterator<noParticles_FaceY; particleIterator++)
       {
-        Eigen::Vector3f quadStencil_Diff=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil_Diff;
+        //Get quadratic stencil and its derivative
+        float quadStencil=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
+        Particle* particle=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator].m_particle;
+
+        if (quadStencil!=0 && !particle->isSleeping())
+        {
+          Eigen::Vector3f quadStencil_Diff=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil_Diff;
+
+          //PIC velocity
+          float velocityPIC=velocity_FaceY*quadStencil;
+
+          //FLIP velocity
+          float velocityFLIP=(velocity_FaceY-prevVelocity_FaceY)*quadStencil;
+
+          //Velocity contribution
+          float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
+          Eigen::Vector3f velContribVector=velocityContribution*e_y;
+
+          //Set up velocity gradient contribution
+          Eigen::Matrix3f velGradContribution;
+          velGradContribution.setZero();
+          velGradContribution(1,0)=velocity_FaceY*quadStencil_Diff(0);
+          velGradContribution(1,1)=velocity_FaceY*quadStencil_Diff(1);
+          velGradContribution(1,2)=velocity_FaceY*quadStencil_Diff(2);
+
+          //Update particle
+          particle->addParticleVelocity(velContribVector);
+          particle->addParticleVelocityGradient(velGradContribution);
+        }
+      }
 
-        //PIC velocity
-        float velocityPIC=velocity_FaceY*quadStencil;
+      //Face Z
+      int noParticles_FaceZ=m_cellFacesZ[cellIndex]->m_noParticlesContributing;
+      for (int particleIterator=0; particleIterator<noParticles_FaceZ; particleIterator++)
+      {
+        //Get quadratic stencil and its derivative
+        float quadStencil=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
+        Particle* particle=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator].m_particle;
+
+        if (quadStencil!=0 && !particle->isSleeping())
+        {
+          Eigen::Vector3f quadStencil_Diff=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil_Diff;
+
+          //PIC velocity
+          float velocityPIC=velocity_FaceZ*quadStencil;
+
+          //FLIP velocity
+          float velocityFLIP=(velocity_FaceZ-prevVelocity_FaceZ)*quadStencil;
+
+          //Velocity contribution
+          float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
+          Eigen::Vector3f velContribVector=velocityContribution*e_z;
+
+          //Set up velocity gradient contribution
+          Eigen::Matrix3f velGradContribution;
+          velGradContribution.setZero();
+          velGradContribution(2,0)=velocity_FaceZ*quadStencil_Diff(0);
+          velGradContribution(2,1)=velocity_FaceZ*quadStencil_Diff(1);
+          velGradContribution(2,2)=velocity_FaceZ*quadStencil_Diff(2);
+
+          //Update particle
+          particle->addParticleVelocity(velContribVector);
+          particle->addParticleVelocityGradient(velGradContribution);
+        }
+      }
 
-        //FLIP velocity
-        float velocityFLIP=(velocity_FaceY-prevVelocity_FaceY)*quadStencil;
+      //Cell centre. Only transfer temperature back if heat equation was solved this step
+      int noParticles_cellCentre=(m_isTemperatureSolved ? m_cellCentres[cellIndex]->m_noParticlesContributing : 0);
+      for (int particleIterator=0; particleIterator<noParticles_cellCentre; particleIterator++)
+      {
+        //Get quadratic stencil
+        float quadStencil=m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
 
-        //Velocity contribution
-        float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
-        Eigen::Vector3f velContribVector=velocityContribution*e_y;
+        if (quadStencil!=0)
+        {
+          //PIC temperature
+          float temperaturePIC=temperature*quadStencil;
 
-        //Set up velocity gradient contribution
-        Eigen::Matrix3f velGradContribution;
-        velGradContribution.setZero();
-        velGradContribution(1,0)=velocity_FaceY*quadStencil_Diff(0);
-        velGradContribution(1,1)=velocity_FaceY*quadStencil_Diff(1);
-        velGradContribution(1,2)=velocity_FaceY*quadStencil_Diff(2);
+          //FLIP temperature
+          float temperatureFLIP=(temperature-prevTemperature)*quadStencil;
 
-        //Update particle
-        Particle* particle=m_cellFacesY[cellIndex]->m_interpolationData[particleIterator]->m_particle;
-        particle->addParticleVelocity(velContribVector);
-        particle->addParticleVelocityGradient(velGradContribution);
+          //Calculate temperature contribution
+          float temperatureContribution=(_tempContribBeta*temperatureFLIP)+((1.0-_tempContribBeta)*temperaturePIC);
+
+          //Update particle
+          Particle* particle=m_cellCentres[cellIndex]->m_interpolationData[particleIterator].m_particle;
+          particle->addParticleTemperature(temperatureContribution);
+        }
       }
+
+//    updateParticlePositionDirectly(_velocityContribAlpha, cellIndex);
+
     }
+  }
 
-    //Face Z
-    int noParticles_FaceZ=m_cellFacesZ[cellIndex]->m_interpolationData.size();
-    for (int particleIterator=0; particleIterator<noParticles_FaceZ; particleIterator++)
-    {
-      //Get quadratic stencil and its derivative
-      float quadStencil=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
 
-      if (quadStencil!=0)
-      {
-        Eigen::Vector3f quadStencil_Diff=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil_Diff;
+}
+
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Grid::updateParticleFromGrid_Deterministic(float _velocityContribAlpha, float _tempContribBeta)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Same contributions as updateParticleFromGrid, but gathered per particle instead of scattered from cells
+
+  Loop over sorted particles
+    Loop over interpolation data of particle, centres first then X, Y and Z faces, each in increasing cell index
+      If face and particle is awake, calc PIC/FLIP velocity and velocity gradient contribution and add to particle
+      If centre and heat equation solved, calc PIC/FLIP temperature and add to particle
+  ---------------------------------------------------------------------------------------------------------------------
+  */
 
-        //PIC velocity
-        float velocityPIC=velocity_FaceZ*quadStencil;
+  //Set e_{a(i)} vectors
+  Eigen::Vector3f eVectors[3];
+  eVectors[0]=Eigen::Vector3f(1.0, 0.0, 0.0);
+  eVectors[1]=Eigen::Vector3f(0.0, 1.0, 0.0);
+  eVectors[2]=Eigen::Vector3f(0.0, 0.0, 1.0);
+
+  int noParticles=m_particleInterpolationOffsets.size()-1;
+
+#pragma omp parallel
+  {
+    TRACE_SCOPE("GridToParticle", "thread");
 
-        //FLIP velocity
-        float velocityFLIP=(velocity_FaceZ-prevVelocity_FaceZ)*quadStencil;
+#pragma omp for nowait
+    for (int particleIndex=0; particleIndex<noParticles; particleIndex++)
+    {
+      for (int dataIndex=m_particleInterpolationOffsets[particleIndex]; dataIndex<m_particleInterpolationOffsets[particleIndex+1]; dataIndex++)
+      {
+        const InterpolationData* interpolationData=&m_interpolationData[m_particleInterpolationData[dataIndex]];
+
+        //Get quadratic stencil and check that it isn't zero
+        float quadStencil=interpolationData->m_tightQuadStencil;
+        if (quadStencil==0)
+        {
+          continue;
+        }
+
+        int cellIndex=interpolationData->m_cellIndex;
+        int faceDirection=interpolationData->m_faceDirection;
+        Particle* particle=interpolationData->m_particle;
+
+        //Cell centre. Only transfer temperature back if heat equation was solved this step
+        if (faceDirection==-1)
+        {
+          if (m_isTemperatureSolved)
+          {
+            float temperature=m_cellCentres[cellIndex]->m_temperature;
+            float prevTemperature=m_cellCentres[cellIndex]->m_previousTemperature;
+
+            //PIC and FLIP temperature
+            float temperaturePIC=temperature*quadStencil;
+            float temperatureFLIP=(temperature-prevTemperature)*quadStencil;
+
+            //Calculate temperature contribution
+            float temperatureContribution=(_tempContribBeta*temperatureFLIP)+((1.0-_tempContribBeta)*temperaturePIC);
+
+            particle->addParticleTemperature(temperatureContribution);
+          }
+          continue;
+        }
+
+        //Face. Sleeping particles keep zero velocity
+        if (particle->isSleeping())
+        {
+          continue;
+        }
+
+        CellFace* cellFace;
+        if (faceDirection==0)
+        {
+          cellFace=m_cellFacesX[cellIndex];
+        }
+        else if (faceDirection==1)
+        {
+          cellFace=m_cellFacesY[cellIndex];
+        }
+        else
+        {
+          cellFace=m_cellFacesZ[cellIndex];
+        }
+
+        float velocity=cellFace->m_velocity;
+        float prevVelocity=cellFace->m_previousVelocity;
+        Eigen::Vector3f quadStencil_Diff=interpolationData->m_tightQuadStencil_Diff;
+
+        //PIC and FLIP velocity
+        float velocityPIC=velocity*quadStencil;
+        float velocityFLIP=(velocity-prevVelocity)*quadStencil;
 
         //Velocity contribution
         float velocityContribution=(_velocityContribAlpha*velocityFLIP)+((1.0-_velocityContribAlpha)*velocityPIC);
-        Eigen::Vector3f velContribVector=velocityContribution*e_z;
+        Eigen::Vector3f velContribVector=velocityContribution*eVectors[faceDirection];
 
         //Set up velocity gradient contribution
         Eigen::Matrix3f velGradContribution;
         velGradContribution.setZero();
-        velGradContribution(2,0)=velocity_FaceZ*quadStencil_Diff(0);
-        velGradContribution(2,1)=velocity_FaceZ*quadStencil_Diff(1);
-        velGradContribution(2,2)=velocity_FaceZ*quadStencil_Diff(2);
+        velGradContribution(faceDirection,0)=velocity*quadStencil_Diff(0);
+        velGradContribution(faceDirection,1)=velocity*quadStencil_Diff(1);
+        velGradContribution(faceDirection,2)=velocity*quadStencil_Diff(2);
 
         //Update particle
-        Particle* particle=m_cellFacesZ[cellIndex]->m_interpolationData[particleIterator]->m_particle;
         particle->addParticleVelocity(velContribVector);
         particle->addParticleVelocityGradient(velGradContribution);
       }
     }
+  }
 
-    //Cell centre
-    int noParticles_cellCentre=m_cellCentres[cellIndex]->m_interpolationData.size();
-    for (int particleIterator=0; particleIterator<noParticles_cellCentre; particleIterator++)
-    {
-      //Get quadratic stencil
-      float quadStencil=m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
+}
 
-      if (quadStencil!=0)
-      {
-        //PIC temperature
-        float temperaturePIC=temperature*quadStencil;
+//----------------------------------------------------------------------------------------------------------------------
 
-        //FLIP temperature
-        float temperatureFLIP=(temperature-prevTemperature)*quadStencil;
+void Grid::wakeParticles(Emitter *_emitter)
+{
+  /* Outline
+  ---------------------------------------------------------------------------------------------------------------------
+  Loop over sleeping particles
+    Wake if temperature is within margin of transition temperature
+    Find cell of particle and wake if any of its six faces has speed above threshold
+  ---------------------------------------------------------------------------------------------------------------------
+  */
 
-        //Calculate temperature contribution
-        float temperatureContribution=(_tempContribBeta*temperatureFLIP)+((1.0-_tempContribBeta)*temperaturePIC);
+  float maxSleepTemperature=_emitter->m_transitionTemperature-_emitter->m_sleepTemperatureMargin;
+  float velocityThreshold=_emitter->m_sleepVelocityThreshold;
 
-        //Update particle
-        Particle* particle=m_cellCentres[cellIndex]->m_interpolationData[particleIterator]->m_particle;
-        particle->addParticleTemperature(temperatureContribution);
-      }
+  //Particle positions are relative to grid edge
+  float halfCellSize=m_cellSize/2.0;
+  Eigen::Vector3f gridEdgePosition=m_origin;
+  gridEdgePosition(0)-=halfCellSize;
+  gridEdgePosition(1)-=halfCellSize;
+  gridEdgePosition(2)-=halfCellSize;
+
+  int noParticles=_emitter->m_noParticles;
+
+#pragma omp parallel for
+  for (int particleIndex=0; particleIndex<noParticles; particleIndex++)
+  {
+    Particle* particle=_emitter->m_particles[particleIndex];
+    if (!particle->isSleeping())
+    {
+      continue;
     }
 
-//    updateParticlePositionDirectly(_velocityContribAlpha, cellIndex);
+    if (particle->getTemperature()>=maxSleepTemperature)
+    {
+      particle->wake();
+      continue;
+    }
 
-  }
+    Eigen::Vector3i cell=MathFunctions::getParticleGridCell(particle->getPosition(), m_cellSize, gridEdgePosition);
+    int i=std::min<int>(std::max<int>(cell(0), 0), m_noCells-2);
+    int j=std::min<int>(std::max<int>(cell(1), 0), m_noCells-2);
+    int k=std::min<int>(std::max<int>(cell(2), 0), m_noCells-2);
 
+    int cellIndex=MathFunctions::getVectorIndex(i, j, k, m_noCells);
+    int cellIndex_i1jk=MathFunctions::getVectorIndex(i+1, j, k, m_noCells);
+    int cellIndex_ij1k=MathFunctions::getVectorIndex(i, j+1, k, m_noCells);
+    int cellIndex_ijk1=MathFunctions::getVectorIndex(i, j, k+1, m_noCells);
 
-}
+    float maxFaceSpeed=std::max<float>(std::abs(m_cellFacesX[cellIndex]->m_velocity), std::abs(m_cellFacesX[cellIndex_i1jk]->m_velocity));
+    maxFaceSpeed=std::max<float>(maxFaceSpeed, std::max<float>(std::abs(m_cellFacesY[cellIndex]->m_velocity), std::abs(m_cellFacesY[cellIndex_ij1k]->m_velocity)));
+    maxFaceSpeed=std::max<float>(maxFaceSpeed, std::max<float>(std::abs(m_cellFacesZ[cellIndex]->m_velocity), std::abs(m_cellFacesZ[cellIndex_ijk1]->m_velocity)));
 
+    if (maxFaceSpeed>velocityThreshold)
+    {
+      particle->wake();
+    }
+  }
+}
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -242,47 +437,47 @@ void Grid::updateParticlePositionDirectly(float _velocityContribAlpha, int _cell
   newFaceZVector=faceZVector + m_dt*velocityZ;
 
   //Contribute to new particle position
-  int noParticles_FaceX=m_cellFacesX[_cellIndex]->m_interpolationData.size();
+  int noParticles_FaceX=m_cellFacesX[_cellIndex]->m_noParticlesContributing;
   for (int particleIterator=0; particleIterator<noParticles_FaceX; particleIterator++)
   {
     //Get quadratic stencil and its derivative
-    float quadStencil=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
+    float quadStencil=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
 
     //Check that quad stencil isn't zero
     if (quadStencil!=0)
     {
       //Update particle
-      Particle* particle=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator]->m_particle;
+      Particle* particle=m_cellFacesX[_cellIndex]->m_interpolationData[particleIterator].m_particle;
       particle->addParticlePosition(quadStencil*newFaceXVector);
     }
   }
 
-  int noParticles_FaceY=m_cellFacesY[_cellIndex]->m_interpolationData.size();
+  int noParticles_FaceY=m_cellFacesY[_cellIndex]->m_noParticlesContributing;
   for (int particleIterator=0; particleIterator<noParticles_FaceY; particleIterator++)
   {
     //Get quadratic stencil and its derivative
-    float quadStencil=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
+    float quadStencil=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
 
     //Check that quad stencil isn't zero
     if (quadStencil!=0)
     {
       //Update particle
-      Particle* particle=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator]->m_particle;
+      Particle* particle=m_cellFacesY[_cellIndex]->m_interpolationData[particleIterator].m_particle;
       particle->addParticlePosition(quadStencil*newFaceYVector);
     }
   }
 
-  int noParticles_FaceZ=m_cellFacesZ[_cellIndex]->m_interpolationData.size();
+  int noParticles_FaceZ=m_cellFacesZ[_cellIndex]->m_noParticlesContributing;
   for (int particleIterator=0; particleIterator<noParticles_FaceZ; particleIterator++)
   {
     //Get quadratic stencil and its derivative
-    float quadStencil=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator]->m_tightQuadStencil;
+    float quadStencil=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator].m_tightQuadStencil;
 
     //Check that quad stencil isn't zero
     if (quadStencil!=0)
     {
       //Update particle
-      Particle* particle=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator]->m_particle;
+      Particle* particle=m_cellFacesZ[_cellIndex]->m_interpolationData[particleIterator].m_particle;
       particle->addParticlePosition(quadStencil*newFaceXVector);
     }
   }
@@ -0,0 +1,197 @@
+#include "LinearSolver.h"
+#include "MathFunctions.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void LinearSolver::solve(const SolverSettings &_settings, StencilSystem &io_system, int _noCells, bool _isDeterministic, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  MIC: compute factor for current values and solve with preconditioned conjugate gradient
+
+  LDLT: add one to the diagonal of rows without a pivot, ie. cells that aren't interior, then factorise
+
+  LDLT_Reuse: update kept factor and solve with it, or with conjugate gradient if it can't be used
+
+  GaussSeidel_RedBlack: copy lower triangle to the kept stencil operator and sweep from the given x
+
+  Other methods are solved as any sparse matrix
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  switch (_settings.m_method)
+  {
+  case SolverSettings::ConjugateGradient_MIC :
+  {
+    io_system.m_micPreconditioner.compute(io_system, _noCells);
+    MathFunctions::conjugateGradient_MIC(io_system.m_micPreconditioner, _B, io_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  case SolverSettings::LDLT :
+  {
+    int noRows=io_system.m_A.rows();
+    Eigen::VectorXd diagonal=io_system.m_A.diagonal();
+
+    std::vector<Eigen::Triplet<double>> pivots;
+    for (int row=0; row<noRows; row++)
+    {
+      if (diagonal(row)==0.0)
+      {
+        pivots.push_back(Eigen::Triplet<double>(row, row, 1.0));
+      }
+    }
+
+    Eigen::SparseMatrix<double> emptyRows(noRows, noRows);
+    emptyRows.setFromTriplets(pivots.begin(), pivots.end());
+
+    Eigen::SparseMatrix<double> A=io_system.m_A+emptyRows;
+    MathFunctions::sparseLDLT(A, _B, io_x, o_record);
+    break;
+  }
+  case SolverSettings::LDLT_Reuse :
+  {
+    if (io_system.m_directFactor.update(io_system, _settings.m_refactorThreshold))
+    {
+      MathFunctions::conjugateGradient_LDLT(io_system.m_directFactor, io_system.m_A, _B, io_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    }
+    else
+    {
+      SolverSettings iterativeSettings=_settings;
+      iterativeSettings.m_method=SolverSettings::ConjugateGradient;
+      solve(iterativeSettings, io_system.m_A, _isDeterministic, _B, io_x, o_record);
+    }
+    break;
+  }
+  case SolverSettings::GaussSeidel_RedBlack :
+  {
+    io_system.m_stencilOperator.assign(io_system, _noCells);
+    MathFunctions::gaussSeidel_RedBlack(io_system.m_stencilOperator, _B, io_x, _settings.m_maxLoops, _settings.m_tolerance, _settings.m_relaxation, o_record);
+    break;
+  }
+  default:
+  {
+    solve(_settings, io_system.m_A, _isDeterministic, _B, io_x, o_record);
+    break;
+  }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void LinearSolver::solve(const SolverSettings &_settings, const Eigen::SparseMatrix<double> &_A, bool _isDeterministic, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record)
+{
+  switch (_settings.m_method)
+  {
+  case SolverSettings::ConjugateGradient :
+  {
+    if (_isDeterministic)
+    {
+      MathFunctions::conjugateGradient_Deterministic(_A, _B, o_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    }
+    else
+    {
+      MathFunctions::conjugateGradient(_A, _B, o_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    }
+    break;
+  }
+  case SolverSettings::ConjugateGradient_MixedPrecision :
+  {
+    MathFunctions::conjugateGradient_MixedPrecision(_A, _B, o_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  case SolverSettings::BiCGSTAB :
+  {
+    MathFunctions::biConjugateGradientStabilised(_A, _B, o_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  case SolverSettings::MinRes :
+  {
+    MathFunctions::MinRes(_A, _B, o_x, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  case SolverSettings::LDLT :
+  {
+    MathFunctions::sparseLDLT(_A, _B, o_x, o_record);
+    break;
+  }
+  default:
+  {
+    std::cout<<"Solver method "<<getMethodName(_settings.m_method)<<" needs a stencil system or operator\n";
+    exit(EXIT_FAILURE);
+  }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void LinearSolver::solve(const SolverSettings &_settings, const Eigen::MatrixXf &_A, bool _isDeterministic, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, SolverRecord &o_record)
+{
+  if (_settings.m_method==SolverSettings::MinRes)
+  {
+    Eigen::MatrixXf emptyPreconditioner;
+    float shift=0.0;
+    MathFunctions::MinRes(_A, _B, io_x, emptyPreconditioner, shift, _settings.m_maxLoops, _settings.m_tolerance, false, o_record);
+  }
+  else
+  {
+    Eigen::SparseMatrix<double> A=_A.cast<double>().sparseView();
+    Eigen::VectorXd B=_B.cast<double>();
+    Eigen::VectorXd x(B.size());
+
+    solve(_settings, A, _isDeterministic, B, x, o_record);
+    io_x=x.cast<float>();
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void LinearSolver::solve(const SolverSettings &_settings, const StencilOperator &_A, Multigrid &io_multigrid, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record)
+{
+  switch (_settings.m_method)
+  {
+  case SolverSettings::ConjugateGradient_MatrixFree :
+  {
+    MathFunctions::conjugateGradient_MatrixFree(_A, nullptr, _B, o_x, false, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  case SolverSettings::ConjugateGradient_Multigrid :
+  {
+    MathFunctions::conjugateGradient_MatrixFree(_A, &io_multigrid, _B, o_x, false, _settings.m_maxLoops, _settings.m_tolerance, o_record);
+    break;
+  }
+  default:
+  {
+    std::cout<<"Solver method "<<getMethodName(_settings.m_method)<<" needs a matrix\n";
+    exit(EXIT_FAILURE);
+  }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool LinearSolver::isMatrixFree(SolverSettings::Method _method)
+{
+  return (_method==SolverSettings::ConjugateGradient_MatrixFree || _method==SolverSettings::ConjugateGradient_Multigrid);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* LinearSolver::getMethodName(SolverSettings::Method _method)
+{
+  switch (_method)
+  {
+  case SolverSettings::ConjugateGradient: return "ConjugateGradient";
+  case SolverSettings::ConjugateGradient_MIC: return "ConjugateGradient_MIC";
+  case SolverSettings::BiCGSTAB: return "BiCGSTAB";
+  case SolverSettings::MinRes: return "MinRes";
+  case SolverSettings::LDLT: return "LDLT";
+  case SolverSettings::LDLT_Reuse: return "LDLT_Reuse";
+  case SolverSettings::ConjugateGradient_MixedPrecision: return "ConjugateGradient_MixedPrecision";
+  case SolverSettings::ConjugateGradient_MatrixFree: return "ConjugateGradient_MatrixFree";
+  case SolverSettings::ConjugateGradient_Multigrid: return "ConjugateGradient_Multigrid";
+  case SolverSettings::GaussSeidel_RedBlack: return "GaussSeidel_RedBlack";
+  default: return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MICPreconditioner.h"
+#include "StencilSystem.h"
+#include "MemoryTracker.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MICPreconditioner::MICPreconditioner()
+{
+  m_patternVersion=-1;
+  m_offsets[0]=0;
+  m_offsets[1]=0;
+  m_offsets[2]=0;
+  m_trackedBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MICPreconditioner::~MICPreconditioner()
+{
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MICPreconditioner::buildLevels(const StencilSystem &_system, int _noCells)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Count rows of the pattern in each line (j,k), and lines with rows on each level j+k
+
+  Prefix sum to get level offsets, and give each line its position within its level. Lines within a
+  level are in cell order
+
+  Insert cells in cell order, so the cells of a line are in order, and set line offsets
+
+  Resize coefficient arrays to the grid and account to memory tracker
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int totNoCells=_system.m_isInterior.size();
+  int noLines=_noCells*_noCells;
+  int noLevels=(2*(_noCells-1))+1;
+
+  m_offsets[0]=1;
+  m_offsets[1]=_noCells;
+  m_offsets[2]=_noCells*_noCells;
+
+  //Line (j,k) is cellIndex/_noCells, and lines are counted per level
+  std::vector<int> lineCounts(noLines, 0);
+  for (int cellIndex=0; cellIndex<totNoCells; cellIndex++)
+  {
+    if (_system.m_isInterior[cellIndex])
+    {
+      lineCounts[cellIndex/_noCells]+=1;
+    }
+  }
+
+  m_levelOffsets.assign(noLevels+1, 0);
+  for (int line=0; line<noLines; line++)
+  {
+    if (lineCounts[line]>0)
+    {
+      int level=(line%_noCells)+(line/_noCells);
+      m_levelOffsets[level+1]+=1;
+    }
+  }
+  for (int level=0; level<noLevels; level++)
+  {
+    m_levelOffsets[level+1]+=m_levelOffsets[level];
+  }
+
+  //Position of each line among all lines, ordered by level
+  std::vector<int> linePositions(noLines, -1);
+  std::vector<int> levelPositions(m_levelOffsets.begin(), m_levelOffsets.end()-1);
+  for (int line=0; line<noLines; line++)
+  {
+    if (lineCounts[line]>0)
+    {
+      int level=(line%_noCells)+(line/_noCells);
+      linePositions[line]=levelPositions[level];
+      levelPositions[level]+=1;
+    }
+  }
+
+  int noPatternLines=m_levelOffsets[noLevels];
+  m_lineOffsets.assign(noPatternLines+1, 0);
+  for (int line=0; line<noLines; line++)
+  {
+    if (lineCounts[line]>0)
+    {
+      m_lineOffsets[linePositions[line]+1]=lineCounts[line];
+    }
+  }
+  for (int line=0; line<noPatternLines; line++)
+  {
+    m_lineOffsets[line+1]+=m_lineOffsets[line];
+  }
+
+  m_levelCells.resize(m_lineOffsets[noPatternLines]);
+  std::vector<int> cellPositions(m_lineOffsets.begin(), m_lineOffsets.end()-1);
+  for (int cellIndex=0; cellIndex<totNoCells; cellIndex++)
+  {
+    if (_system.m_isInterior[cellIndex])
+    {
+      int line=linePositions[cellIndex/_noCells];
+      m_levelCells[cellPositions[line]]=cellIndex;
+      cellPositions[line]+=1;
+    }
+  }
+
+  m_diagonal.assign(totNoCells, 0.0);
+  m_precon.assign(totNoCells, 1.0);
+  for (int direction=0; direction<3; direction++)
+  {
+    m_lower[direction].assign(totNoCells, 0.0);
+  }
+
+  m_patternVersion=_system.m_patternVersion;
+
+  int64_t bytes=((m_levelCells.capacity()+m_lineOffsets.capacity()+m_levelOffsets.capacity())*sizeof(int))
+                +((m_diagonal.capacity()+m_precon.capacity()+(3*m_lower[0].capacity()))*sizeof(double));
+
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+  m_trackedBytes=bytes;
+  MemoryTracker::instance()->allocate(MemoryTracker::LinearSystems, m_trackedBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MICPreconditioner::compute(const StencilSystem &_system, int _noCells)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Rebuild levels if pattern has changed
+
+  Copy diagonal and lower x, y, z coefficients of each row from the system values
+
+  Loop over levels, lines of a level in parallel, cells of a line in order:
+    e = a_cc - sum_d (a_cd*precon_d)^2
+             - tuning * sum_d a_cd*(sum of the other two upper coefficients of d)*precon_d^2
+    where d are the lower neighbours of c. Use a_cc if e < safety*a_cc
+    precon_c = 1/sqrt(e)
+
+  Rows that have been zeroed in the pattern get precon 1, like the Jacobi preconditioner
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  if (m_patternVersion!=_system.m_patternVersion || m_offsets[1]!=_noCells)
+  {
+    buildLevels(_system, _noCells);
+  }
+
+  int noRows=m_levelCells.size();
+  int noLevels=m_levelOffsets.size()-1;
+  const double* values=_system.m_A.valuePtr();
+  const StencilSystem::Entry lowerEntries[3]={StencilSystem::Neighbour_i_1jk, StencilSystem::Neighbour_ij_1k, StencilSystem::Neighbour_ijk_1};
+
+#pragma omp parallel
+  {
+#pragma omp for
+    for (int row=0; row<noRows; row++)
+    {
+      int cellIndex=m_levelCells[row];
+      const int* positions=&_system.m_entryPositions[StencilSystem::NoEntries*cellIndex];
+
+      m_diagonal[cellIndex]=values[positions[StencilSystem::Diagonal]];
+      for (int direction=0; direction<3; direction++)
+      {
+        m_lower[direction][cellIndex]=values[positions[lowerEntries[direction]]];
+      }
+    }
+
+    for (int level=0; level<noLevels; level++)
+    {
+#pragma omp for
+      for (int line=m_levelOffsets[level]; line<m_levelOffsets[level+1]; line++)
+      {
+        for (int row=m_lineOffsets[line]; row<m_lineOffsets[line+1]; row++)
+        {
+          int cellIndex=m_levelCells[row];
+          double diagonal=m_diagonal[cellIndex];
+
+          if (diagonal==0.0)
+          {
+            m_precon[cellIndex]=1.0;
+            continue;
+          }
+
+          double e=diagonal;
+          for (int direction=0; direction<3; direction++)
+          {
+            int neighbour=cellIndex-m_offsets[direction];
+            double coefficient=m_lower[direction][cellIndex];
+            double precon=m_precon[neighbour];
+
+            //Upper coefficients of the neighbour, other than the one to this cell
+            double otherUpper=0.0;
+            for (int otherDirection=0; otherDirection<3; otherDirection++)
+            {
+              if (otherDirection!=direction)
+              {
+                otherUpper+=m_lower[otherDirection][neighbour+m_offsets[otherDirection]];
+              }
+            }
+
+            e-=(coefficient*precon)*(coefficient*precon);
+            e-=m_tuning*coefficient*otherUpper*precon*precon;
+          }
+
+          if (e<m_safety*diagonal)
+          {
+            e=diagonal;
+          }
+
+          m_precon[cellIndex]=1.0/std::sqrt(e);
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MICPreconditioner::solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z) const
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Start from z=r, so cells without a row are done
+
+  Forward sweep over levels, cells of a line in increasing order, storing q in z:
+    q_c = (r_c - sum_d a_cd*precon_d*q_d)*precon_c          d lower neighbours
+
+  Backward sweep over levels in reverse order, cells of a line in decreasing order:
+    z_c = (q_c - sum_u a_uc*precon_c*z_u)*precon_c          u upper neighbours
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noLevels=m_levelOffsets.size()-1;
+
+  o_z=_residual;
+
+#pragma omp parallel
+  {
+    for (int level=0; level<noLevels; level++)
+    {
+#pragma omp for
+      for (int line=m_levelOffsets[level]; line<m_levelOffsets[level+1]; line++)
+      {
+        for (int row=m_lineOffsets[line]; row<m_lineOffsets[line+1]; row++)
+        {
+          int cellIndex=m_levelCells[row];
+
+          double sum=_residual(cellIndex);
+          for (int direction=0; direction<3; direction++)
+          {
+            int neighbour=cellIndex-m_offsets[direction];
+            sum-=m_lower[direction][cellIndex]*m_precon[neighbour]*o_z(neighbour);
+          }
+
+          o_z(cellIndex)=sum*m_precon[cellIndex];
+        }
+      }
+    }
+
+    for (int level=noLevels-1; level>=0; level--)
+    {
+#pragma omp for
+      for (int line=m_levelOffsets[level]; line<m_levelOffsets[level+1]; line++)
+      {
+        for (int row=m_lineOffsets[line+1]-1; row>=m_lineOffsets[line]; row--)
+        {
+          int cellIndex=m_levelCells[row];
+          double precon=m_precon[cellIndex];
+
+          double sum=o_z(cellIndex);
+          for (int direction=0; direction<3; direction++)
+          {
+            int neighbour=cellIndex+m_offsets[direction];
+            sum-=m_lower[direction][neighbour]*precon*o_z(neighbour);
+          }
+
+          o_z(cellIndex)=sum*precon;
+        }
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MICPreconditioner::multiply(const Eigen::VectorXd &_p, Eigen::VectorXd &o_Ap) const
+{
+  /// @brief Each row is summed by one thread in a fixed order, so the product doesn't depend on the number of threads
+
+  int noRows=m_levelCells.size();
+
+#pragma omp parallel for
+  for (int row=0; row<noRows; row++)
+  {
+    int cellIndex=m_levelCells[row];
+
+    double sum=m_diagonal[cellIndex]*_p(cellIndex);
+    for (int direction=0; direction<3; direction++)
+    {
+      int lowerNeighbour=cellIndex-m_offsets[direction];
+      int upperNeighbour=cellIndex+m_offsets[direction];
+      sum+=m_lower[direction][cellIndex]*_p(lowerNeighbour);
+      sum+=m_lower[direction][upperNeighbour]*_p(upperNeighbour);
+    }
+
+    o_Ap(cellIndex)=sum;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -1,5 +1,10 @@
 #include "MathFunctions.h"
+#include "TraceRecorder.h"
 
+#include <eigen3/unsupported/Eigen/IterativeSolvers>
+
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <cmath>
 #include <math.h>
@@ -416,12 +421,14 @@ float MathFunctions::calcTightQuadraticStencil_Diff(float _x)
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void MathFunctions::conjugateGradient(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual)
+void MathFunctions::conjugateGradient(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
 {
   /// @brief Function which uses Conjugate Gradient to solve Ax=b
   /// A has to be symmetric, definite and square.
   /// @todo Implement so can solve with preconditioner.
 
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
   //Initialise the Conjugate Gradient solver
   Eigen::ConjugateGradient<Eigen::SparseMatrix<double>> conjGrad;
 
@@ -436,11 +443,885 @@ void MathFunctions::conjugateGradient(const Eigen::SparseMatrix<double> &_A, con
   //Solve
   o_x=conjGrad.solve(_B);
 
+#ifdef PROFILING
+  //Eigen iterates internally, so the whole solve is one event on the timeline
+  TraceRecorder::instance()->addEvent("ConjugateGradient", "solver", startTime, std::chrono::steady_clock::now(), "iterations", conjGrad.iterations());
+#endif
+
   //Print out iteration number and error
   std::cout<<"Number of iterations: "<<conjGrad.iterations()<<"\n";
   std::cout<<"Error: "<<conjGrad.error()<<"\n";
 
+  //Eigen starts from x=0, so initial residual is ||b||, and error is the residual relative to ||b||
+  double initialResidual=_B.norm();
+
+  o_record.m_solverName="ConjugateGradient";
+  o_record.m_iterations=conjGrad.iterations();
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=conjGrad.error()*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(conjGrad.info()==Eigen::Success);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::conjugateGradient_Deterministic(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Follows Eigen's ConjugateGradient step by step so iterations and convergence match conjugateGradient:
+    Uses lower triangle of A as a symmetric matrix, Jacobi preconditioner and x0=0
+    Stops when ||r||^2 < tolerance^2*||b||^2 or after _maxLoops iterations
+
+  A is copied to a full row major matrix so each row of Ap is summed by one thread in column order.
+  Dot products use deterministicDot. Vector updates are element wise so are already order independent.
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_A.rows();
+  int maxLoops=_maxLoops;
+
+  Eigen::SparseMatrix<double, Eigen::RowMajor> A=_A.selfadjointView<Eigen::Lower>();
+
+  //Jacobi preconditioner as in Eigen::DiagonalPreconditioner
+  Eigen::VectorXd inverseDiagonal(noRows);
+#pragma omp parallel for
+  for (int row=0; row<noRows; row++)
+  {
+    double diagonal=A.coeff(row, row);
+    inverseDiagonal(row)=(diagonal!=0.0) ? (1.0/diagonal) : 1.0;
+  }
+
+  Eigen::VectorXd residual=_B;
+  Eigen::VectorXd p(noRows);
+  Eigen::VectorXd z(noRows);
+  Eigen::VectorXd Ap(noRows);
+  o_x.setZero(noRows);
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=rhsNorm2;
+  int iteration=0;
+
+  if (rhsNorm2!=0.0 && residualNorm2>=threshold)
+  {
+#pragma omp parallel for
+    for (int row=0; row<noRows; row++)
+    {
+      p(row)=inverseDiagonal(row)*residual(row);
+    }
+
+    double absNew=deterministicDot(residual, p);
+
+    while (iteration<maxLoops)
+    {
+      //Ap, one row per thread iteration
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        double sum=0.0;
+        for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(A, row); it; ++it)
+        {
+          sum+=it.value()*p(it.col());
+        }
+        Ap(row)=sum;
+      }
+
+      double alpha=absNew/deterministicDot(p, Ap);
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        o_x(row)+=alpha*p(row);
+        residual(row)-=alpha*Ap(row);
+      }
+
+      residualNorm2=deterministicDot(residual, residual);
+      if (residualNorm2<threshold)
+      {
+        break;
+      }
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        z(row)=inverseDiagonal(row)*residual(row);
+      }
+
+      double absOld=absNew;
+      absNew=deterministicDot(residual, z);
+      double beta=absNew/absOld;
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        p(row)=z(row)+(beta*p(row));
+      }
+
+      iteration++;
+    }
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<iteration<<"\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+  double initialResidual=std::sqrt(rhsNorm2);
+
+#ifdef PROFILING
+  //One event per solve, with the iteration count as argument like the Eigen solvers
+  TraceRecorder::instance()->addEvent("ConjugateGradient_Deterministic", "solver", startTime, std::chrono::steady_clock::now(), "iterations", iteration);
+#endif
+
+  o_record.m_solverName="ConjugateGradient_Deterministic";
+  o_record.m_iterations=iteration;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=error*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(error<=_minResidual);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::conjugateGradient_MixedPrecision(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Copy lower triangle of A to a full row major matrix as in conjugateGradient_Deterministic, and that
+  to float. Jacobi preconditioner in float
+
+  Start from x0=0, so r=b. Loop while ||r|| > tolerance*||b||, in double:
+    Inner solve of Ad=r in float with Jacobi preconditioned CG, as in conjugateGradient_Deterministic,
+    from d0=0. Stops when residual has been reduced by what is left to reach the tolerance, but no
+    further than m_innerTolerance, or when the iteration cap, which counts all inner iterations, is hit
+    x=x+d
+    r=b-Ax with the double copy of A, one row per thread iteration
+
+  Float dot products are summed in double with deterministicDot, so result doesn't depend on the
+  number of threads
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_A.rows();
+  int maxLoops=_maxLoops;
+
+  Eigen::SparseMatrix<double, Eigen::RowMajor> doubleA=_A.selfadjointView<Eigen::Lower>();
+  Eigen::SparseMatrix<float, Eigen::RowMajor> A=doubleA.cast<float>();
+
+  Eigen::VectorXf inverseDiagonal(noRows);
+#pragma omp parallel for
+  for (int row=0; row<noRows; row++)
+  {
+    float diagonal=A.coeff(row, row);
+    inverseDiagonal(row)=(diagonal!=0.0f) ? (1.0f/diagonal) : 1.0f;
+  }
+
+  Eigen::VectorXd residual=_B;
+  Eigen::VectorXf innerResidual(noRows);
+  Eigen::VectorXf d(noRows);
+  Eigen::VectorXf p(noRows);
+  Eigen::VectorXf z(noRows);
+  Eigen::VectorXf Ap(noRows);
+  o_x.setZero(noRows);
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=rhsNorm2;
+  int iteration=0;
+  int noRefinements=0;
+
+  while (rhsNorm2!=0.0 && residualNorm2>=threshold && iteration<maxLoops)
+  {
+    //Inner residual reduction, relative to the current residual
+    double innerTolerance2=std::max(m_innerTolerance*m_innerTolerance, threshold/residualNorm2);
+
+#pragma omp parallel for
+    for (int row=0; row<noRows; row++)
+    {
+      innerResidual(row)=residual(row);
+      d(row)=0.0f;
+      p(row)=inverseDiagonal(row)*innerResidual(row);
+    }
+
+    double innerNorm2=deterministicDot(innerResidual, innerResidual);
+    double innerThreshold=innerTolerance2*innerNorm2;
+    float absNew=deterministicDot(innerResidual, p);
+
+    while (iteration<maxLoops)
+    {
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        float sum=0.0f;
+        for (Eigen::SparseMatrix<float, Eigen::RowMajor>::InnerIterator it(A, row); it; ++it)
+        {
+          sum+=it.value()*p(it.col());
+        }
+        Ap(row)=sum;
+      }
+
+      float alpha=absNew/deterministicDot(p, Ap);
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        d(row)+=alpha*p(row);
+        innerResidual(row)-=alpha*Ap(row);
+      }
+
+      iteration++;
+
+      if (deterministicDot(innerResidual, innerResidual)<innerThreshold)
+      {
+        break;
+      }
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        z(row)=inverseDiagonal(row)*innerResidual(row);
+      }
+
+      float absOld=absNew;
+      absNew=deterministicDot(innerResidual, z);
+      float beta=absNew/absOld;
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        p(row)=z(row)+(beta*p(row));
+      }
+    }
+
+    //Correct in double, with the residual of the double system
+#pragma omp parallel for
+    for (int row=0; row<noRows; row++)
+    {
+      o_x(row)+=d(row);
+    }
+
+#pragma omp parallel for
+    for (int row=0; row<noRows; row++)
+    {
+      double sum=0.0;
+      for (Eigen::SparseMatrix<double, Eigen::RowMajor>::InnerIterator it(doubleA, row); it; ++it)
+      {
+        sum+=it.value()*o_x(it.col());
+      }
+      residual(row)=_B(row)-sum;
+    }
+    residualNorm2=deterministicDot(residual, residual);
+    noRefinements++;
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<iteration<<" in "<<noRefinements<<" refinements\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+  double initialResidual=std::sqrt(rhsNorm2);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("ConjugateGradient_MixedPrecision", "solver", startTime, std::chrono::steady_clock::now(), "iterations", iteration);
+#endif
+
+  o_record.m_solverName="ConjugateGradient_MixedPrecision";
+  o_record.m_iterations=iteration;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=error*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(error<=_minResidual);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::conjugateGradient_MIC(const MICPreconditioner &_preconditioner, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Same iteration as conjugateGradient_Deterministic with z=M^-1 r from the MIC(0) preconditioner and Ap
+  from the stencil coefficients it holds. Starts from x0=0
+
+  Rows without a row in the system stay zero in Ap, x and r, and z=r=0 there
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_B.size();
+  int maxLoops=_maxLoops;
+
+  Eigen::VectorXd residual=_B;
+  Eigen::VectorXd p(noRows);
+  Eigen::VectorXd z(noRows);
+  Eigen::VectorXd Ap=Eigen::VectorXd::Zero(noRows);
+  o_x.setZero(noRows);
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=rhsNorm2;
+  int iteration=0;
+
+  if (rhsNorm2!=0.0 && residualNorm2>=threshold)
+  {
+    _preconditioner.solve(residual, p);
+
+    double absNew=deterministicDot(residual, p);
+
+    while (iteration<maxLoops)
+    {
+      _preconditioner.multiply(p, Ap);
+
+      double alpha=absNew/deterministicDot(p, Ap);
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        o_x(row)+=alpha*p(row);
+        residual(row)-=alpha*Ap(row);
+      }
+
+      residualNorm2=deterministicDot(residual, residual);
+      if (residualNorm2<threshold)
+      {
+        break;
+      }
+
+      _preconditioner.solve(residual, z);
+
+      double absOld=absNew;
+      absNew=deterministicDot(residual, z);
+      double beta=absNew/absOld;
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        p(row)=z(row)+(beta*p(row));
+      }
+
+      iteration++;
+    }
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<iteration<<"\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+  double initialResidual=std::sqrt(rhsNorm2);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("ConjugateGradient_MIC", "solver", startTime, std::chrono::steady_clock::now(), "iterations", iteration);
+#endif
+
+  o_record.m_solverName="ConjugateGradient_MIC";
+  o_record.m_iterations=iteration;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=error*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(error<=_minResidual);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::conjugateGradient_MatrixFree(const StencilOperator &_A, Multigrid *io_multigrid, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, bool _isWarmStart, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Same iteration as conjugateGradient_MIC with Ap from the stencil operator, and z=M^-1 r from a
+  multigrid V-cycle, or from the operator diagonal as Jacobi preconditioner if there is no multigrid.
+  Starts from x0=0, or from io_x with r=b-Ax0 if warm started
+
+  Rows without a row in the operator stay zero in Ap and r, and z=0 there. x is left as it is there
+
+  Initial and final residuals of the record are ||b-Ax||, the final one found from x after the loop
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_B.size();
+  int maxLoops=_maxLoops;
+
+  Eigen::VectorXd residual=_B;
+  Eigen::VectorXd p(noRows);
+  Eigen::VectorXd z(noRows);
+  Eigen::VectorXd Ap=Eigen::VectorXd::Zero(noRows);
+
+  if (_isWarmStart)
+  {
+    _A.multiply(io_x, Ap);
+    residual-=Ap;
+  }
+  else
+  {
+    io_x.setZero(noRows);
+  }
+
+  //Jacobi preconditioner as in conjugateGradient_Deterministic
+  Eigen::VectorXd inverseDiagonal(noRows);
+#pragma omp parallel for
+  for (int row=0; row<noRows; row++)
+  {
+    double diagonal=_A.m_diagonal[row];
+    inverseDiagonal(row)=(diagonal!=0.0) ? (1.0/diagonal) : 1.0;
+  }
+
+  if (io_multigrid!=nullptr)
+  {
+    io_multigrid->compute(_A);
+  }
+
+  auto precondition=[&](const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z)
+  {
+    if (io_multigrid!=nullptr)
+    {
+      io_multigrid->solve(_residual, o_z);
+    }
+    else
+    {
+      o_z=inverseDiagonal.cwiseProduct(_residual);
+    }
+  };
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=deterministicDot(residual, residual);
+  double initialResidual=std::sqrt(residualNorm2);
+  int iteration=0;
+
+  if (rhsNorm2!=0.0 && residualNorm2>=threshold)
+  {
+    precondition(residual, p);
+
+    double absNew=deterministicDot(residual, p);
+
+    while (iteration<maxLoops)
+    {
+      _A.multiply(p, Ap);
+
+      double alpha=absNew/deterministicDot(p, Ap);
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        io_x(row)+=alpha*p(row);
+        residual(row)-=alpha*Ap(row);
+      }
+
+      residualNorm2=deterministicDot(residual, residual);
+      if (residualNorm2<threshold)
+      {
+        break;
+      }
+
+      precondition(residual, z);
+
+      double absOld=absNew;
+      absNew=deterministicDot(residual, z);
+      double beta=absNew/absOld;
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        p(row)=z(row)+(beta*p(row));
+      }
+
+      iteration++;
+    }
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<iteration<<"\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+  //Residual of the solution rather than of the recurrence, as in gaussSeidel_RedBlack
+  _A.multiply(io_x, Ap);
+#pragma omp parallel for
+  for (int row=0; row<noRows; row++)
+  {
+    residual(row)=_B(row)-Ap(row);
+  }
+  double finalResidualNorm2=deterministicDot(residual, residual);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent((io_multigrid!=nullptr) ? "ConjugateGradient_Multigrid" : "ConjugateGradient_MatrixFree", "solver", startTime, std::chrono::steady_clock::now(), "iterations", iteration);
+#endif
+
+  o_record.m_solverName=(io_multigrid!=nullptr) ? "ConjugateGradient_Multigrid" : "ConjugateGradient_MatrixFree";
+  o_record.m_iterations=iteration;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=std::sqrt(finalResidualNorm2);
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(error<=_minResidual);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::gaussSeidel_RedBlack(const StencilOperator &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, float _maxLoops, float _minResidual, float _relaxation, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Find residual of the initial guess
+
+  Sweep until residual is below the tolerance or max loops is reached. Residual b-Ax is found every
+  m_gaussSeidelCheckInterval sweeps and after the last sweep
+    Stops when ||r||^2 < tolerance^2*||b||^2 as conjugateGradient
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_B.size();
+  int maxLoops=_maxLoops;
+
+  Eigen::VectorXd residual(noRows);
+  Eigen::VectorXd Ax(noRows);
+
+  auto calcResidualNorm2=[&]()
+  {
+    _A.multiply(io_x, Ax);
+
+#pragma omp parallel for
+    for (int row=0; row<noRows; row++)
+    {
+      residual(row)=_B(row)-Ax(row);
+    }
+
+    return deterministicDot(residual, residual);
+  };
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=calcResidualNorm2();
+  double initialResidual=std::sqrt(residualNorm2);
+  int sweep=0;
+
+  while (residualNorm2>=threshold && sweep<maxLoops)
+  {
+    _A.smoothRedBlack(_B, io_x, _relaxation, StencilOperator::Red);
+    sweep++;
+
+    if (sweep%m_gaussSeidelCheckInterval==0 || sweep==maxLoops)
+    {
+      residualNorm2=calcResidualNorm2();
+    }
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<sweep<<"\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("GaussSeidel_RedBlack", "solver", startTime, std::chrono::steady_clock::now(), "iterations", sweep);
+#endif
+
+  o_record.m_solverName="GaussSeidel_RedBlack";
+  o_record.m_iterations=sweep;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=std::sqrt(residualNorm2);
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(residualNorm2<threshold);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::conjugateGradient_LDLT(const DirectFactor &_factor, const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Same iteration as conjugateGradient_MIC with z=M^-1 r from the LDLT factor and Ap from the lower
+  triangle of A. Starts from x0=0
+
+  With a factor of the current A the first step is the direct solution, and the residual check ends
+  the loop. With a factor of older coefficients it takes a few more
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  int noRows=_B.size();
+  int maxLoops=_maxLoops;
+
+  Eigen::VectorXd residual=_B;
+  Eigen::VectorXd p(noRows);
+  Eigen::VectorXd z(noRows);
+  Eigen::VectorXd Ap=Eigen::VectorXd::Zero(noRows);
+  o_x.setZero(noRows);
+
+  double rhsNorm2=deterministicDot(_B, _B);
+  double threshold=std::max((double)_minResidual*(double)_minResidual*rhsNorm2, (double)std::numeric_limits<double>::min());
+  double residualNorm2=rhsNorm2;
+  int iteration=0;
+
+  if (rhsNorm2!=0.0 && residualNorm2>=threshold)
+  {
+    _factor.solve(residual, p);
+
+    double absNew=deterministicDot(residual, p);
+
+    while (iteration<maxLoops)
+    {
+      Ap=_A.selfadjointView<Eigen::Lower>()*p;
+
+      double alpha=absNew/deterministicDot(p, Ap);
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        o_x(row)+=alpha*p(row);
+        residual(row)-=alpha*Ap(row);
+      }
+
+      residualNorm2=deterministicDot(residual, residual);
+      if (residualNorm2<threshold)
+      {
+        break;
+      }
+
+      _factor.solve(residual, z);
+
+      double absOld=absNew;
+      absNew=deterministicDot(residual, z);
+      double beta=absNew/absOld;
+
+#pragma omp parallel for
+      for (int row=0; row<noRows; row++)
+      {
+        p(row)=z(row)+(beta*p(row));
+      }
+
+      iteration++;
+    }
+  }
+
+  double error=(rhsNorm2!=0.0) ? std::sqrt(residualNorm2/rhsNorm2) : 0.0;
+
+  //Print out iteration number and error
+  std::cout<<"Number of iterations: "<<iteration<<"\n";
+  std::cout<<"Error: "<<error<<"\n";
+
+  double initialResidual=std::sqrt(rhsNorm2);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("ConjugateGradient_LDLT", "solver", startTime, std::chrono::steady_clock::now(), "iterations", iteration);
+#endif
+
+  o_record.m_solverName="ConjugateGradient_LDLT";
+  o_record.m_iterations=iteration;
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=error*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(error<=_minResidual);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::biConjugateGradientStabilised(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _minResidual, SolverRecord &o_record)
+{
+  /// @brief Eigen's BiCGSTAB starts from x=0 and stops on the residual relative to ||b||, as conjugateGradient
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  Eigen::BiCGSTAB<Eigen::SparseMatrix<double>> biCGSTAB;
+  biCGSTAB.compute(_A);
+  biCGSTAB.setMaxIterations(_maxLoops);
+  biCGSTAB.setTolerance(_minResidual);
+
+  o_x=biCGSTAB.solve(_B);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("BiCGSTAB", "solver", startTime, std::chrono::steady_clock::now(), "iterations", biCGSTAB.iterations());
+#endif
+
+  std::cout<<"Number of iterations: "<<biCGSTAB.iterations()<<"\n";
+  std::cout<<"Error: "<<biCGSTAB.error()<<"\n";
+
+  double initialResidual=_B.norm();
+
+  o_record.m_solverName="BiCGSTAB";
+  o_record.m_iterations=biCGSTAB.iterations();
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_minResidual;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=biCGSTAB.error()*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(biCGSTAB.info()==Eigen::Success);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::MinRes(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, float _maxLoops, float _tolerance, SolverRecord &o_record)
+{
+  /// @brief Eigen's MINRES starts from x=0 and stops on the residual relative to ||b||. Identity preconditioner, as
+  /// MINRES needs a positive definite preconditioner and the diagonal may be negative
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  Eigen::MINRES<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::IdentityPreconditioner> minRes;
+  minRes.compute(_A);
+  minRes.setMaxIterations(_maxLoops);
+  minRes.setTolerance(_tolerance);
+
+  o_x=minRes.solve(_B);
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("MinRes", "solver", startTime, std::chrono::steady_clock::now(), "iterations", minRes.iterations());
+#endif
+
+  std::cout<<"Number of iterations: "<<minRes.iterations()<<"\n";
+  std::cout<<"Error: "<<minRes.error()<<"\n";
+
+  double initialResidual=_B.norm();
+
+  o_record.m_solverName="MinRes_Sparse";
+  o_record.m_iterations=minRes.iterations();
+  o_record.m_maxIterations=_maxLoops;
+  o_record.m_tolerance=_tolerance;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=minRes.error()*initialResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=(minRes.info()==Eigen::Success);
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MathFunctions::sparseLDLT(const Eigen::SparseMatrix<double> &_A, const Eigen::VectorXd &_B, Eigen::VectorXd &o_x, SolverRecord &o_record)
+{
+  /// @brief Factorises and solves in one go. Residual is calculated with the same symmetric matrix that was factorised
+
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower> LDLT;
+  LDLT.compute(_A);
+
+  bool isFactorised=(LDLT.info()==Eigen::Success);
+  if (isFactorised)
+  {
+    o_x=LDLT.solve(_B);
+  }
+  else
+  {
+    std::cout<<"LDLT factorisation failed\n";
+    o_x.setZero(_B.size());
+  }
+
+#ifdef PROFILING
+  TraceRecorder::instance()->addEvent("LDLT", "solver", startTime, std::chrono::steady_clock::now(), "iterations", 0);
+#endif
+
+  double initialResidual=_B.norm();
+  double finalResidual=(_B-(_A.selfadjointView<Eigen::Lower>()*o_x)).norm();
+
+  o_record.m_solverName="LDLT";
+  o_record.m_iterations=0;
+  o_record.m_maxIterations=0;
+  o_record.m_tolerance=0.0;
+  o_record.m_initialResidual=initialResidual;
+  o_record.m_finalResidual=finalResidual;
+  o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+  o_record.m_isConverged=isFactorised;
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+double MathFunctions::deterministicDot(const Eigen::VectorXd &_a, const Eigen::VectorXd &_b)
+{
+  /// @brief Block boundaries only depend on the vector size, so every block sum and the final sum are done in the
+  /// same order whatever the number of threads
+
+  int size=_a.size();
+  int noBlocks=(size+m_reductionBlockSize-1)/m_reductionBlockSize;
+
+  std::vector<double> blockSums(noBlocks, 0.0);
+
+#pragma omp parallel for
+  for (int block=0; block<noBlocks; block++)
+  {
+    int start=block*m_reductionBlockSize;
+    int blockSize=std::min(m_reductionBlockSize, size-start);
+
+    blockSums[block]=_a.segment(start, blockSize).dot(_b.segment(start, blockSize));
+  }
+
+  double sum=0.0;
+  for (int block=0; block<noBlocks; block++)
+  {
+    sum+=blockSums[block];
+  }
+
+  return sum;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+double MathFunctions::deterministicDot(const Eigen::VectorXf &_a, const Eigen::VectorXf &_b)
+{
+  /// @brief Same blocks as the double version. Products are summed in double, so long vectors don't lose the
+  /// precision float would
+
+  int size=_a.size();
+  int noBlocks=(size+m_reductionBlockSize-1)/m_reductionBlockSize;
+
+  std::vector<double> blockSums(noBlocks, 0.0);
+
+#pragma omp parallel for
+  for (int block=0; block<noBlocks; block++)
+  {
+    int start=block*m_reductionBlockSize;
+    int end=std::min(start+m_reductionBlockSize, size);
+
+    double blockSum=0.0;
+    for (int index=start; index<end; index++)
+    {
+      blockSum+=(double)_a(index)*(double)_b(index);
+    }
+    blockSums[block]=blockSum;
+  }
+
+  double sum=0.0;
+  for (int block=0; block<noBlocks; block++)
+  {
+    sum+=blockSums[block];
+  }
 
+  return sum;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,319 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+#include "MemoryTracker.h"
+#include "CellCentre.h"
+#include "CellFace.h"
+#include "InterpolationData.h"
+#include "Particle.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryTracker* MemoryTracker::m_instance=nullptr;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryTracker::MemoryTracker()
+{
+  for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+  {
+    m_currentBytes[subsystem]=0;
+    m_peakBytes[subsystem]=0;
+  }
+
+  m_totalCurrentBytes=0;
+  m_totalPeakBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+MemoryTracker* MemoryTracker::instance()
+{
+  /// @brief Create memory tracker if doesn't exist, then return instance pointer.
+  /// NB! First call must not be made from several threads at once
+
+  if (m_instance==nullptr)
+  {
+    m_instance=new MemoryTracker();
+  }
+
+  return m_instance;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::allocate(Subsystem _subsystem, int64_t _bytes)
+{
+  int64_t current=m_currentBytes[_subsystem].fetch_add(_bytes, std::memory_order_relaxed)+_bytes;
+  int64_t totalCurrent=m_totalCurrentBytes.fetch_add(_bytes, std::memory_order_relaxed)+_bytes;
+
+  updatePeak(m_peakBytes[_subsystem], current);
+  updatePeak(m_totalPeakBytes, totalCurrent);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::release(Subsystem _subsystem, int64_t _bytes)
+{
+  m_currentBytes[_subsystem].fetch_sub(_bytes, std::memory_order_relaxed);
+  m_totalCurrentBytes.fetch_sub(_bytes, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::updatePeak(std::atomic<int64_t> &_peak, int64_t _value)
+{
+  int64_t currentPeak=_peak.load(std::memory_order_relaxed);
+  while (_value>currentPeak && !_peak.compare_exchange_weak(currentPeak, _value, std::memory_order_relaxed))
+  {
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::endFrame(int _frameNo)
+{
+  /// @brief Peaks of the next frame start from the usage at the end of this frame
+
+  FrameRecord frame;
+  frame.m_frameNo=_frameNo;
+
+  for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+  {
+    frame.m_currentBytes[subsystem]=m_currentBytes[subsystem].load();
+    frame.m_peakBytes[subsystem]=m_peakBytes[subsystem].exchange(frame.m_currentBytes[subsystem]);
+  }
+
+  frame.m_totalCurrentBytes=m_totalCurrentBytes.load();
+  frame.m_totalPeakBytes=m_totalPeakBytes.exchange(frame.m_totalCurrentBytes);
+  frame.m_residentBytes=getResidentBytes();
+
+  m_frames.push_back(frame);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::printLastFrame()
+{
+  if (m_frames.empty())
+  {
+    return;
+  }
+
+  const FrameRecord &frame=m_frames.back();
+  const double toMB=1.0/(1024.0*1024.0);
+
+  printf("Memory usage in MB after frame %d (current / peak):\n", frame.m_frameNo);
+  for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+  {
+    printf("  %-16s %10.2f / %10.2f\n", getSubsystemName((Subsystem)subsystem), frame.m_currentBytes[subsystem]*toMB, frame.m_peakBytes[subsystem]*toMB);
+  }
+  printf("  %-16s %10.2f / %10.2f\n", "Total", frame.m_totalCurrentBytes*toMB, frame.m_totalPeakBytes*toMB);
+  printf("  %-16s %10.2f\n", "Resident", frame.m_residentBytes*toMB);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::writeCSV(std::string _fileName)
+{
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  const double toMB=1.0/(1024.0*1024.0);
+
+  file<<"frame,subsystem,current_mb,peak_mb\n";
+
+  for (const FrameRecord &frame : m_frames)
+  {
+    for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+    {
+      file<<frame.m_frameNo<<","<<getSubsystemName((Subsystem)subsystem)<<","<<frame.m_currentBytes[subsystem]*toMB<<","
+          <<frame.m_peakBytes[subsystem]*toMB<<"\n";
+    }
+    file<<frame.m_frameNo<<",Total,"<<frame.m_totalCurrentBytes*toMB<<","<<frame.m_totalPeakBytes*toMB<<"\n";
+    file<<frame.m_frameNo<<",Resident,"<<frame.m_residentBytes*toMB<<","<<frame.m_residentBytes*toMB<<"\n";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::writeJSON(std::string _fileName)
+{
+  /// @brief Writes [{"frame":n,"resident_mb":..,"subsystems":{"Name":{"current_mb":..,"peak_mb":..},..}},..]
+
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  const double toMB=1.0/(1024.0*1024.0);
+
+  file<<"[\n";
+
+  for (size_t frameIndex=0; frameIndex<m_frames.size(); frameIndex++)
+  {
+    const FrameRecord &frame=m_frames[frameIndex];
+
+    file<<"  {\"frame\":"<<frame.m_frameNo<<",\"resident_mb\":"<<frame.m_residentBytes*toMB<<",\"subsystems\":{";
+
+    for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+    {
+      file<<"\""<<getSubsystemName((Subsystem)subsystem)<<"\":{\"current_mb\":"<<frame.m_currentBytes[subsystem]*toMB
+          <<",\"peak_mb\":"<<frame.m_peakBytes[subsystem]*toMB<<"},";
+    }
+    file<<"\"Total\":{\"current_mb\":"<<frame.m_totalCurrentBytes*toMB<<",\"peak_mb\":"<<frame.m_totalPeakBytes*toMB<<"}";
+
+    file<<"}}"<<(frameIndex+1<m_frames.size() ? "," : "")<<"\n";
+  }
+
+  file<<"]\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void MemoryTracker::estimateUsage(int _noCells, int _noParticles, int64_t o_bytes[NoSubsystems])
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Grid fields: one cell centre and three faces per cell, and the pointer lists to them
+
+  Interpolation index: the cubic B-spline is non-zero for 4 nodes along each axis, so each particle has 4^3 entries
+  in each of the centre and three face grids, plus the per particle index of deterministic mode. The counting sort
+  stores a cell, sorted position and stencil per particle, and offsets for each cell and its centre and faces
+
+  Particle storage: particle objects, the pointer list and the solid, liquid and sleeping lists
+
+  Linear systems: three dense deviatoric matrices of noCells^3 x noCells^3 floats and their B vectors, the dense
+  test matrix of the same size built in the pressure projection, plus the sparse pressure and temperature systems
+  with up to 7 entries per row. Pressure builds two sparse matrices
+
+  Export buffers: one Imath::V3f position and one 64 bit id per particle
+
+  Collision objects: not estimated, as the distance field size depends on the mesh, which is read after the estimate
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  int64_t totNoCells=(int64_t)_noCells*_noCells*_noCells;
+  int64_t noParticles=_noParticles;
+
+  o_bytes[GridFields]=totNoCells*(sizeof(CellCentre)+(3*sizeof(CellFace))+(4*sizeof(void*)));
+
+  int64_t noInterpolationEntries=noParticles*4*64;
+  o_bytes[Interpolation]=(noInterpolationEntries*(sizeof(InterpolationData)+sizeof(int)))
+                         +(noParticles*((3*sizeof(int))+sizeof(ParticleStencil)))+(totNoCells*5*sizeof(int));
+
+  o_bytes[ParticleStorage]=noParticles*(sizeof(Particle)+(4*sizeof(Particle*)));
+
+  int64_t deviatoricBytes=3*((totNoCells*totNoCells*sizeof(float))+(totNoCells*sizeof(float)));
+  int64_t pressureTestBytes=totNoCells*totNoCells*sizeof(float);
+  int64_t sparseMatrixBytes=(totNoCells*7*(sizeof(double)+sizeof(int)))+((totNoCells+1)*sizeof(int));
+  int64_t sparseSystemsBytes=(3*sparseMatrixBytes)+(4*totNoCells*sizeof(double));
+  o_bytes[LinearSystems]=deviatoricBytes+pressureTestBytes+sparseSystemsBytes;
+
+  o_bytes[ExportBuffers]=noParticles*(3*sizeof(float)+sizeof(uint64_t));
+
+  o_bytes[CollisionObjects]=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool MemoryTracker::checkEstimate(int _noCells, int _noParticles, int64_t _limitBytes)
+{
+  int64_t bytes[NoSubsystems];
+  estimateUsage(_noCells, _noParticles, bytes);
+
+  int64_t totalBytes=0;
+  for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+  {
+    totalBytes+=bytes[subsystem];
+  }
+
+  int64_t limitBytes=(_limitBytes>0) ? _limitBytes : getPhysicalBytes();
+
+  const double toMB=1.0/(1024.0*1024.0);
+
+  printf("Estimated memory usage in MB for %d^3 cells and %d particles:\n", _noCells, _noParticles);
+  for (int subsystem=0; subsystem<NoSubsystems; subsystem++)
+  {
+    printf("  %-16s %10.2f\n", getSubsystemName((Subsystem)subsystem), bytes[subsystem]*toMB);
+  }
+  printf("  %-16s %10.2f of %.2f available\n", "Total", totalBytes*toMB, limitBytes*toMB);
+
+  //If limit can't be found, don't reject
+  if (limitBytes<=0)
+  {
+    return true;
+  }
+
+  return (totalBytes<=limitBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int64_t MemoryTracker::getPhysicalBytes()
+{
+  long noPages=sysconf(_SC_PHYS_PAGES);
+  long pageSize=sysconf(_SC_PAGE_SIZE);
+
+  if (noPages<=0 || pageSize<=0)
+  {
+    return 0;
+  }
+
+  return (int64_t)noPages*pageSize;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int64_t MemoryTracker::getResidentBytes()
+{
+  /// @brief Reads resident pages from /proc/self/statm, so is only available on linux
+
+  FILE* file=fopen("/proc/self/statm", "r");
+
+  if (file==nullptr)
+  {
+    return 0;
+  }
+
+  long noPagesTotal=0;
+  long noPagesResident=0;
+  int noRead=fscanf(file, "%ld %ld", &noPagesTotal, &noPagesResident);
+  fclose(file);
+
+  if (noRead!=2)
+  {
+    return 0;
+  }
+
+  return (int64_t)noPagesResident*sysconf(_SC_PAGE_SIZE);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* MemoryTracker::getSubsystemName(Subsystem _subsystem)
+{
+  switch (_subsystem)
+  {
+  case GridFields: return "GridFields";
+  case Interpolation: return "Interpolation";
+  case ParticleStorage: return "ParticleStorage";
+  case LinearSystems: return "LinearSystems";
+  case ExportBuffers: return "ExportBuffers";
+  case CollisionObjects: return "CollisionObjects";
+  default: return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
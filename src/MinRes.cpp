@@ -2,6 +2,7 @@
 
 #include <eigen3/Eigen/Core>
 
+#include <chrono>
 #include <limits>
 #include <vector>
 #include <cmath>
@@ -9,8 +10,10 @@
 #include <iomanip>
 
 
-void MathFunctions::MinRes(const Eigen::MatrixXf &_A, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, const Eigen::MatrixXf &_preconditioner, float _shift, float _maxLoops, float _tolerance, bool _show)
+void MathFunctions::MinRes(const Eigen::MatrixXf &_A, const Eigen::VectorXf &_B, Eigen::VectorXf &io_x, const Eigen::MatrixXf &_preconditioner, float _shift, float _maxLoops, float _tolerance, bool _show, SolverRecord &o_record)
 {
+  std::chrono::steady_clock::time_point startTime=std::chrono::steady_clock::now();
+
   /* Check whether A matrix and preconditioner are symmetric and that A is not singular
   -----------------------------------------------------------------------------------------------
 
@@ -465,4 +468,22 @@ void MathFunctions::MinRes(const Eigen::MatrixXf &_A, const Eigen::VectorXf &_B,
 
       calcDone=true;
     }
+
+
+    /* Store solve record
+    ----------------------------------------------------------------------------------------
+    iterations is one more than the number of loops done, or zero if no loops were done.
+    rnorm is the estimate of ||b-(A-shift*I)x|| from the last loop.
+    Exact solution, solution within tolerance and solution within machine accuracy count as converged
+    ----------------------------------------------------------------------------------------
+    */
+
+    o_record.m_solverName="MinRes";
+    o_record.m_iterations=std::max(iterations-1, 0);
+    o_record.m_maxIterations=_maxLoops;
+    o_record.m_tolerance=_tolerance;
+    o_record.m_initialResidual=beta_1;
+    o_record.m_finalResidual=(iterations>0) ? rnorm : beta_1;
+    o_record.m_milliseconds=std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-startTime).count();
+    o_record.m_isConverged=(stopMessage==0 || stopMessage==1 || stopMessage==2 || stopMessage==3 || stopMessage==10);
 }
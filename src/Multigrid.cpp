@@ -0,0 +1,186 @@
+#include <algorithm>
+
+#include "Multigrid.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Multigrid::Multigrid()
+{
+  m_fineOperator=nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Multigrid::compute(const StencilOperator &_fine)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Coarsen until the coarsest level is small enough. Coarse operators are kept between calls, so only
+  reallocated if the grid size changes
+
+  Size vectors of each level
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  m_fineOperator=&_fine;
+
+  int noLevels=1;
+  int noCells=_fine.getNoCells();
+  while ((noCells-2)>m_coarsestNoCells)
+  {
+    noCells=((noCells-2+1)/2)+2;
+    noLevels++;
+  }
+
+  m_coarseOperators.resize(noLevels-1);
+  for (int level=1; level<noLevels; level++)
+  {
+    getOperator(level-1).coarsen(m_coarseOperators[level-1]);
+  }
+
+  m_rightHandSides.resize(noLevels);
+  m_solutions.resize(noLevels);
+  m_products.resize(noLevels);
+  for (int level=0; level<noLevels; level++)
+  {
+    int totNoCells=getOperator(level).getTotNoCells();
+    m_rightHandSides[level].resize(totNoCells);
+    m_solutions[level].resize(totNoCells);
+    m_products[level].resize(totNoCells);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const StencilOperator& Multigrid::getOperator(int _level) const
+{
+  if (_level==0)
+  {
+    return *m_fineOperator;
+  }
+
+  return m_coarseOperators[_level-1];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Multigrid::solve(const Eigen::VectorXd &_residual, Eigen::VectorXd &o_z)
+{
+  m_rightHandSides[0]=_residual;
+  cycle(0);
+  o_z=m_solutions[0];
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Multigrid::cycle(int _level)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Start from x=0
+
+  Coarsest level: smooth until approximately solved, alternating the first colour so the sweeps are
+  symmetric
+
+  Other levels:
+    Pre-smooth starting with red
+    Restrict residual b-Ax to the coarse level by summing it over the fine cells of each coarse cell
+    Cycle on the coarse level
+    Add coarse solution to the fine cells of each coarse cell
+    Post-smooth starting with black, which reverses the pre-smoothing so the cycle is symmetric
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  Eigen::VectorXd &x=m_solutions[_level];
+  x.setZero();
+
+  if (_level==(getNoLevels()-1))
+  {
+    for (int sweep=0; sweep<m_noCoarsestSweeps; sweep++)
+    {
+      smooth(_level, 1, (sweep%2==0) ? StencilOperator::Red : StencilOperator::Black);
+    }
+    return;
+  }
+
+  smooth(_level, m_noSmoothingSweeps, StencilOperator::Red);
+
+  const StencilOperator &A=getOperator(_level);
+  const Eigen::VectorXd &b=m_rightHandSides[_level];
+  Eigen::VectorXd &Ax=m_products[_level];
+  A.multiply(x, Ax);
+
+  int noCells=A.getNoCells();
+  int noCoarseCells=getOperator(_level+1).getNoCells();
+  int noCoarseLines=noCoarseCells*noCoarseCells;
+  Eigen::VectorXd &coarseB=m_rightHandSides[_level+1];
+
+#pragma omp parallel for
+  for (int coarseLine=0; coarseLine<noCoarseLines; coarseLine++)
+  {
+    int coarseJ=coarseLine%noCoarseCells;
+    int coarseK=coarseLine/noCoarseCells;
+
+    for (int coarseI=0; coarseI<noCoarseCells; coarseI++)
+    {
+      int coarseIndex=coarseI+(coarseLine*noCoarseCells);
+      double sum=0.0;
+
+      if (coarseI>0 && coarseJ>0 && coarseK>0 && coarseI<(noCoarseCells-1) && coarseJ<(noCoarseCells-1) && coarseK<(noCoarseCells-1))
+      {
+        for (int kIndex=(2*coarseK)-1; kIndex<=std::min(2*coarseK, noCells-2); kIndex++)
+        {
+          for (int jIndex=(2*coarseJ)-1; jIndex<=std::min(2*coarseJ, noCells-2); jIndex++)
+          {
+            for (int iIndex=(2*coarseI)-1; iIndex<=std::min(2*coarseI, noCells-2); iIndex++)
+            {
+              int cellIndex=iIndex+(noCells*(jIndex+(noCells*kIndex)));
+              sum+=b(cellIndex)-Ax(cellIndex);
+            }
+          }
+        }
+      }
+
+      coarseB(coarseIndex)=sum;
+    }
+  }
+
+  cycle(_level+1);
+
+  const Eigen::VectorXd &coarseX=m_solutions[_level+1];
+  int noLines=noCells*noCells;
+
+#pragma omp parallel for
+  for (int line=0; line<noLines; line++)
+  {
+    int jIndex=line%noCells;
+    int kIndex=line/noCells;
+
+    if (jIndex==0 || kIndex==0 || jIndex==(noCells-1) || kIndex==(noCells-1))
+    {
+      continue;
+    }
+
+    int coarseLineStart=noCoarseCells*(((jIndex+1)/2)+(noCoarseCells*((kIndex+1)/2)));
+    for (int iIndex=1; iIndex<(noCells-1); iIndex++)
+    {
+      x(iIndex+(line*noCells))+=coarseX(coarseLineStart+((iIndex+1)/2));
+    }
+  }
+
+  smooth(_level, m_noSmoothingSweeps, StencilOperator::Black);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Multigrid::smooth(int _level, int _noSweeps, StencilOperator::Colour _firstColour)
+{
+  const StencilOperator &A=getOperator(_level);
+
+  for (int sweep=0; sweep<_noSweeps; sweep++)
+  {
+    A.smoothRedBlack(m_rightHandSides[_level], m_solutions[_level], 1.0, _firstColour);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -6,6 +6,7 @@
 
 #include "MathFunctions.h"
 #include "Emitter.h"
+#include "CollisionSDF.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -94,6 +95,10 @@ Particle::Particle(unsigned int _id, Eigen::Vector3f _position, float _mass, flo
     m_transitionHeat=_latentHeat;
   }
 
+  //All particles start awake
+  m_isSleeping=false;
+  m_noStillSteps=0;
+
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -235,6 +240,27 @@ Eigen::Matrix3f Particle::getZ_DeformEDevDiff(const Eigen::Matrix3f &_Z)
 //----------------------------------------------------------------------------------------------------------------------
 
 void Particle::presetParticlesForTimeStep(float _velocityContribAlpha, float _tempContribBeta)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Call the preset specialised for the current phase
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  if (m_phase==Phase::Liquid)
+  {
+    presetForTimeStep<Phase::Liquid>(_velocityContribAlpha, _tempContribBeta);
+  }
+  else
+  {
+    presetForTimeStep<Phase::Solid>(_velocityContribAlpha, _tempContribBeta);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+template <Phase _phase>
+void Particle::presetForTimeStep(float _velocityContribAlpha, float _tempContribBeta)
 {
   /* Outline
   ------------------------------------------------------------------------------------------------------
@@ -251,6 +277,9 @@ void Particle::presetParticlesForTimeStep(float _velocityContribAlpha, float _te
   Calculate deviatoric elastic matrices + polar decomposition
 
   Calculate differentiated elasto-plastic energy
+
+  Liquid particles have FE=JE^{1/d}I and lame mu zero, so their deviatoric part is a scaled identity with
+  R=I and the elasto-plastic energy differential is zero. These are set directly instead of calculated
   ------------------------------------------------------------------------------------------------------
   */
 
@@ -267,17 +296,21 @@ void Particle::presetParticlesForTimeStep(float _velocityContribAlpha, float _te
 
 
   //For now, update elastic deformation gradient if liquid, here
-  if (m_phase==Phase::Liquid)
+  if (_phase==Phase::Liquid)
   {
     m_detDeformGradElastic=m_deformationElastic.determinant();
     float fluidCorrection=pow(m_detDeformGradElastic,(1.0/m_dimension));
     m_deformationElastic=m_deformationElastic.Identity();
     m_deformationElastic*=fluidCorrection;
-  }
-
 
-  //Apply plasticity contribution
-  applyPlasticity();
+    //Apply plasticity contribution
+    applyLiquidPlasticity();
+  }
+  else
+  {
+    //Apply plasticity contribution
+    applyPlasticity();
+  }
 
 
   //For test set determinant to absolute value. Determinant should always be positive
@@ -302,7 +335,7 @@ void Particle::presetParticlesForTimeStep(float _velocityContribAlpha, float _te
   hardnessImpact=std::max<float>(hardnessImpact, 0.1);
 
 
-  if (m_phase==Phase::Liquid)
+  if (_phase==Phase::Liquid)
   {
     m_lameMu=0.0; /// Unsure about this or whether I should just set FE=JE^(1/d)I? -> Should do both I believe
   }
@@ -372,12 +405,75 @@ void Particle::presetParticlesForTimeStep(float _velocityContribAlpha, float _te
   float elasticCorrectionForElastic=pow(m_detDeformGradElastic, -dimensionInv);
   m_deformationElastic_Deviatoric=elasticCorrectionForElastic*m_deformationElastic;
 
-  MathFunctions::polarDecomposition(m_deformationElastic_Deviatoric, m_R_deformationElastic_Deviatoric, m_S_deformationElastic_Deviatoric);
+  if (_phase==Phase::Liquid)
+  {
+    //Polar decomposition of a scaled identity, and 2*mu*(FE-RE) with mu zero
+    m_R_deformationElastic_Deviatoric.setIdentity();
+    m_S_deformationElastic_Deviatoric=m_deformationElastic_Deviatoric;
+    m_potentialEnergyDiff.setZero();
+  }
+  else
+  {
+    MathFunctions::polarDecomposition(m_deformationElastic_Deviatoric, m_R_deformationElastic_Deviatoric, m_S_deformationElastic_Deviatoric);
+
+    //Calculate differential of elasto-plastic potential energy
+    calcPotentialEnergyDiff();
+  }
+
+}
+
+template void Particle::presetForTimeStep<Phase::Solid>(float _velocityContribAlpha, float _tempContribBeta);
+template void Particle::presetForTimeStep<Phase::Liquid>(float _velocityContribAlpha, float _tempContribBeta);
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Particle::presetSleepingForTimeStep(float _tempContribBeta)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Store old temperature and reset current temperature to beta*Tn from FLIP update, as in
+  presetForTimeStep. Velocity and velocity gradient stay zero while sleeping
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  m_previousTemperature=m_temperature;
+  m_temperature=_tempContribBeta*m_previousTemperature;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Particle::updateSleepState(float _dt, float _velocityThreshold, float _deformationThreshold, float _maxTemperature, int _noStillSteps)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Particle is still if solid, speed below threshold, largest entry of dt*velGrad below threshold and
+  temperature below max temperature
+
+  Count still steps in a row. When enough, go to sleep with zero velocity and velocity gradient so
+  the particle adds no momentum to the grid
+  ------------------------------------------------------------------------------------------------------
+  */
 
+  float deformationChange=_dt*m_velocityGradient.cwiseAbs().maxCoeff();
 
-  //Calculate differential of elasto-plastic potential energy
-  calcPotentialEnergyDiff();
+  bool isStill=(m_phase==Phase::Solid && m_velocity.norm()<_velocityThreshold && deformationChange<_deformationThreshold
+                && m_temperature<_maxTemperature);
 
+  if (!isStill)
+  {
+    m_noStillSteps=0;
+    return;
+  }
+
+  m_noStillSteps+=1;
+
+  if (m_noStillSteps>=_noStillSteps)
+  {
+    m_isSleeping=true;
+    m_velocity.setZero();
+    m_previousVelocity.setZero();
+    m_velocityGradient.setZero();
+  }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -410,6 +506,205 @@ void Particle::update(float _dt, float _xMin, float _xMax, float _yMin, float _y
 
 //----------------------------------------------------------------------------------------------------------------------
 
+template <Phase _phase>
+void Particle::updateBatch(Particle* const* _particles, int _noParticles, const ParticleUpdateConstants &_constants)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Same steps as update, for up to m_updateBatchSize particles at once:
+
+  Gather velocity gradient, FE, velocity, position, temperatures and transition heat into arrays with one
+  entry per particle, padding unused entries with harmless values
+
+  Deformation gradient: R=I+dt*velGrad and FE^{n+1}=R*FE^{n}. Particles where det(I+dt*velGrad)<=0 need
+  the exponential series, so they are left to the scalar updateDeformationGradient
+
+  Phase transition, collision and position as in update, written with selects so the loops have no
+  branches. Heat capacity is picked at compile time since all particles of the batch have phase _phase
+
+  Before the box collision, particles moving into a collision object lose their velocity along the
+  object's normal, found from the distance field gradient at the possible new position
+
+  Scatter the results back to the particles
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  const int batchSize=m_updateBatchSize;
+
+  const float dt=_constants.m_dt;
+  const float transitionTemp=_constants.m_transitionTemperature;
+  const float latentHeat=_constants.m_latentHeat;
+  const float heatCapacity=(_phase==Phase::Liquid) ? _constants.m_heatCapacityFluid : _constants.m_heatCapacitySolid;
+
+  //Batch arrays. Matrices are stored row by row, ie. entry i*3+j is element (i,j)
+  float velocityGradient[9][batchSize];
+  float deformationElastic[9][batchSize];
+  float velocity[3][batchSize];
+  float position[3][batchSize];
+  float mass[batchSize];
+  float temperature[batchSize];
+  float previousTemperature[batchSize];
+  float transitionHeat[batchSize];
+  int phase[batchSize];
+  bool isSeriesNeeded[batchSize];
+
+  //Gather
+  for (int lane=0; lane<batchSize; lane++)
+  {
+    bool isUsed=(lane<_noParticles);
+    Particle* particle=_particles[isUsed ? lane : 0];
+
+    for (int i=0; i<3; i++)
+    {
+      for (int j=0; j<3; j++)
+      {
+        velocityGradient[(i*3)+j][lane]=isUsed ? particle->m_velocityGradient(i,j) : 0.0;
+        deformationElastic[(i*3)+j][lane]=isUsed ? particle->m_deformationElastic(i,j) : ((i==j) ? 1.0 : 0.0);
+      }
+
+      velocity[i][lane]=particle->m_velocity(i);
+      position[i][lane]=particle->m_position(i);
+    }
+
+    mass[lane]=particle->m_mass;
+    temperature[lane]=particle->m_temperature;
+    previousTemperature[lane]=particle->m_previousTemperature;
+    transitionHeat[lane]=particle->m_transitionHeat;
+    phase[lane]=_phase;
+  }
+
+  //Deformation gradient, FE^{n+1}=(I+dt*velGrad)FE^{n}
+  float newDeformationElastic[9][batchSize];
+
+#pragma omp simd
+  for (int lane=0; lane<batchSize; lane++)
+  {
+    float R[9];
+    for (int entry=0; entry<9; entry++)
+    {
+      R[entry]=dt*velocityGradient[entry][lane];
+    }
+    R[0]+=1.0;
+    R[4]+=1.0;
+    R[8]+=1.0;
+
+    float determinant=R[0]*((R[4]*R[8])-(R[7]*R[5]))-R[3]*((R[1]*R[8])-(R[7]*R[2]))+R[6]*((R[1]*R[5])-(R[4]*R[2]));
+    isSeriesNeeded[lane]=!(determinant>0);
+
+    for (int i=0; i<3; i++)
+    {
+      for (int j=0; j<3; j++)
+      {
+        //Summed in the same order as Eigen's 3x3 product
+        newDeformationElastic[(i*3)+j][lane]=(R[i*3]*deformationElastic[j][lane])+((R[(i*3)+1]*deformationElastic[3+j][lane])
+                                             +(R[(i*3)+2]*deformationElastic[6+j][lane]));
+      }
+    }
+  }
+
+  //Phase transition
+#pragma omp simd
+  for (int lane=0; lane<batchSize; lane++)
+  {
+    float previousTemp=previousTemperature[lane];
+    float temp=temperature[lane];
+
+    //Previous temperature at transition temperature, so transition heat changes
+    float heatIncrement=(heatCapacity*mass[lane])*(temp-previousTemp);
+    float newTransitionHeat=std::min<float>(std::max<float>(transitionHeat[lane]+heatIncrement, 0.0), latentHeat);
+    bool isAtTransition=(previousTemp==transitionTemp);
+    bool isFilled=(newTransitionHeat==latentHeat);
+    bool isEmptied=(newTransitionHeat==0.0);
+
+    //Otherwise check if transition temperature is passed
+    bool isPassingTransition=((previousTemp<transitionTemp && temp>=transitionTemp) || (previousTemp>transitionTemp && temp<=transitionTemp));
+
+    transitionHeat[lane]=isAtTransition ? newTransitionHeat : transitionHeat[lane];
+    phase[lane]=(isAtTransition && isFilled) ? Phase::Liquid : ((isAtTransition && !isFilled && isEmptied) ? Phase::Solid : phase[lane]);
+    bool isSetToTransition=(isAtTransition && !isFilled && !isEmptied) || (!isAtTransition && isPassingTransition);
+    temperature[lane]=isSetToTransition ? transitionTemp : temp;
+  }
+
+  //Collision objects
+  for (int objectNo=0; objectNo<_constants.m_noCollisionObjects; objectNo++)
+  {
+    const CollisionSDF* collisionObject=_constants.m_collisionObjects[objectNo];
+
+    for (int lane=0; lane<_noParticles; lane++)
+    {
+      Eigen::Vector3f possiblePosition(position[0][lane]+(dt*velocity[0][lane]), position[1][lane]+(dt*velocity[1][lane]), position[2][lane]+(dt*velocity[2][lane]));
+
+      if (collisionObject->getDistance(possiblePosition)<=0.0)
+      {
+        Eigen::Vector3f normal=collisionObject->getGradient(possiblePosition);
+        float normalVelocity=(normal(0)*velocity[0][lane])+(normal(1)*velocity[1][lane])+(normal(2)*velocity[2][lane]);
+
+        if (normalVelocity<0.0)
+        {
+          for (int i=0; i<3; i++)
+          {
+            velocity[i][lane]-=(normalVelocity*normal(i));
+          }
+        }
+      }
+    }
+  }
+
+  //Collision and position
+#pragma omp simd
+  for (int lane=0; lane<batchSize; lane++)
+  {
+    float possibleX=position[0][lane]+(dt*velocity[0][lane]);
+    float possibleY=position[1][lane]+(dt*velocity[1][lane]);
+    float possibleZ=position[2][lane]+(dt*velocity[2][lane]);
+
+    bool isColliding=(possibleX<=_constants.m_xMin || possibleX>=_constants.m_xMax || possibleY<=_constants.m_yMin
+                      || possibleY>=_constants.m_yMax || possibleZ<=_constants.m_zMin || possibleZ>=_constants.m_zMax);
+
+    for (int i=0; i<3; i++)
+    {
+      velocity[i][lane]=isColliding ? 0.0f : velocity[i][lane];
+      position[i][lane]+=(dt*velocity[i][lane]);
+    }
+  }
+
+  //Scatter
+  for (int lane=0; lane<_noParticles; lane++)
+  {
+    Particle* particle=_particles[lane];
+
+    if (isSeriesNeeded[lane])
+    {
+      particle->updateDeformationGradient(dt);
+    }
+    else
+    {
+      for (int i=0; i<3; i++)
+      {
+        for (int j=0; j<3; j++)
+        {
+          particle->m_deformationElastic(i,j)=newDeformationElastic[(i*3)+j][lane];
+        }
+      }
+    }
+
+    for (int i=0; i<3; i++)
+    {
+      particle->m_velocity(i)=velocity[i][lane];
+      particle->m_position(i)=position[i][lane];
+    }
+
+    particle->m_temperature=temperature[lane];
+    particle->m_transitionHeat=transitionHeat[lane];
+    particle->m_phase=(Phase)phase[lane];
+  }
+}
+
+template void Particle::updateBatch<Phase::Solid>(Particle* const* _particles, int _noParticles, const ParticleUpdateConstants &_constants);
+template void Particle::updateBatch<Phase::Liquid>(Particle* const* _particles, int _noParticles, const ParticleUpdateConstants &_constants);
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Particle::applyPlasticity()
 {
   /* Outline
@@ -483,6 +778,42 @@ void Particle::applyPlasticity()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void Particle::applyLiquidPlasticity()
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  FE=a*I, so its singular values are all a and U=V=I
+
+  Clamp a to compression and stretch limits, giving FE=a_clamped*I
+  Calculate new FP=(1/a_clamped)*F^{n+1}
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  //Calculate F^{n+1}
+  Eigen::Matrix3f deformationGradient=m_deformationElastic*m_deformationPlastic;
+
+  //Get compression and stretch limits
+  float compressionLimit=m_emitter->getCompressionLimit();
+  float stretchLimit=m_emitter->getStretchLimit();
+
+  //Clamp singular value
+  float clampedValue=m_deformationElastic(0,0);
+  clampedValue=std::min<float>(clampedValue, (1.0+stretchLimit));
+  clampedValue=std::max<float>(clampedValue, (1.0-compressionLimit));
+
+  //Recalculate FE and FP
+  m_deformationElastic.setIdentity();
+  m_deformationElastic*=clampedValue;
+  m_deformationPlastic=(1.0/clampedValue)*deformationGradient;
+
+  //Calculate new determinants
+  m_detDeformGrad=deformationGradient.determinant();
+  m_detDeformGradElastic=clampedValue*clampedValue*clampedValue;
+  m_detDeformGradPlastic=m_deformationPlastic.determinant();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void Particle::calcPotentialEnergyDiff()
 {
   /* Outline
@@ -0,0 +1,208 @@
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+#include "PerfCounters.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+PerfCounters* PerfCounters::m_instance=nullptr;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+PerfCounters::PerfCounters()
+{
+  m_isAvailable=false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+PerfCounters* PerfCounters::instance()
+{
+  /// @brief Create counters if doesn't exist, then return instance pointer.
+  /// NB! First call must not be made from several threads at once
+
+  if (m_instance==nullptr)
+  {
+    m_instance=new PerfCounters();
+  }
+
+  return m_instance;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void PerfCounters::start()
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Run a parallel region so every thread of the pool opens its own counter group. perf_event_open counts
+  per thread, and the pool threads are kept alive between parallel regions, so the groups stay valid.
+
+  If any thread fails, close everything and report counters as unavailable
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  stop();
+
+  bool isOpened=true;
+
+#pragma omp parallel reduction(&&:isOpened)
+  {
+    isOpened=openThreadCounters();
+  }
+
+  if (!isOpened)
+  {
+    std::cout<<"Hardware performance counters are unavailable, only wall time is reported\n";
+    stop();
+    return;
+  }
+
+  m_isAvailable=true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void PerfCounters::stop()
+{
+#ifdef __linux__
+  for (std::vector<int> &fileDescriptors : m_threadFileDescriptors)
+  {
+    for (int fileDescriptor : fileDescriptors)
+    {
+      close(fileDescriptor);
+    }
+  }
+#endif
+
+  m_threadFileDescriptors.clear();
+  m_isAvailable=false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool PerfCounters::openThreadCounters()
+{
+  /// @brief Kernel and hypervisor are excluded so the counters can be opened with the default perf_event_paranoid
+
+#ifdef __linux__
+  const uint64_t configs[NoCounters]={PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                      PERF_COUNT_HW_BRANCH_MISSES};
+
+  std::vector<int> fileDescriptors;
+  int groupLeader=-1;
+
+  for (int counter=0; counter<NoCounters; counter++)
+  {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type=PERF_TYPE_HARDWARE;
+    attributes.size=sizeof(attributes);
+    attributes.config=configs[counter];
+    attributes.exclude_kernel=1;
+    attributes.exclude_hv=1;
+    attributes.read_format=PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    //Only the leader starts disabled, the others follow it
+    attributes.disabled=(groupLeader==-1) ? 1 : 0;
+
+    //Count calling thread on any cpu
+    int fileDescriptor=syscall(__NR_perf_event_open, &attributes, 0, -1, groupLeader, 0);
+
+    if (fileDescriptor<0)
+    {
+      for (int openedDescriptor : fileDescriptors)
+      {
+        close(openedDescriptor);
+      }
+      return false;
+    }
+
+    if (groupLeader==-1)
+    {
+      groupLeader=fileDescriptor;
+    }
+    fileDescriptors.push_back(fileDescriptor);
+  }
+
+  ioctl(groupLeader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(groupLeader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+  std::lock_guard<std::mutex> lock(m_threadFileDescriptorsMutex);
+  m_threadFileDescriptors.push_back(fileDescriptors);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void PerfCounters::read(uint64_t o_values[NoCounters])
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  A group read gives {nr, time_enabled, time_running, value[nr]}. If the kernel multiplexed the group
+  with other users of the counters, time_running<time_enabled and the values are scaled up to estimate
+  the full count.
+
+  Counters of other threads can be read from this thread. They are read between parallel regions, when
+  the other threads are idle, so the counts are up to date
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  for (int counter=0; counter<NoCounters; counter++)
+  {
+    o_values[counter]=0;
+  }
+
+  if (!m_isAvailable)
+  {
+    return;
+  }
+
+#ifdef __linux__
+  for (std::vector<int> &fileDescriptors : m_threadFileDescriptors)
+  {
+    uint64_t buffer[3+NoCounters];
+
+    if (::read(fileDescriptors[0], buffer, sizeof(buffer))!=(ssize_t)sizeof(buffer) || buffer[0]!=NoCounters)
+    {
+      continue;
+    }
+
+    uint64_t timeEnabled=buffer[1];
+    uint64_t timeRunning=buffer[2];
+    double scale=(timeRunning>0 && timeRunning<timeEnabled) ? (double)timeEnabled/timeRunning : 1.0;
+
+    for (int counter=0; counter<NoCounters; counter++)
+    {
+      o_values[counter]+=(uint64_t)(buffer[3+counter]*scale);
+    }
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* PerfCounters::getCounterName(Counter _counter)
+{
+  switch (_counter)
+  {
+  case Cycles: return "cycles";
+  case Instructions: return "instructions";
+  case CacheMisses: return "llc_misses";
+  case BranchMisses: return "branch_misses";
+  default: return "unknown";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,241 @@
+#include <fstream>
+#include <iostream>
+
+#include "Profiler.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Profiler* Profiler::m_instance=nullptr;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Profiler::Profiler()
+{
+  /// @brief Set all current frame aggregates to zero
+
+  for (int stage=0; stage<NoStages; stage++)
+  {
+    m_calls[stage]=0;
+    m_totalNanoseconds[stage]=0;
+    m_maxNanoseconds[stage]=0;
+
+    for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+    {
+      m_counters[stage][counter]=0;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Profiler* Profiler::instance()
+{
+  /// @brief Create profiler if doesn't exist, then return instance pointer.
+  /// NB! First call must not be made from several threads at once
+
+  if (m_instance==nullptr)
+  {
+    m_instance=new Profiler();
+  }
+
+  return m_instance;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Profiler::addStageTime(Stage _stage, uint64_t _nanoseconds)
+{
+  /// @brief Atomic updates so stages running concurrently, eg. temperature and velocity, can be recorded
+
+  m_calls[_stage].fetch_add(1, std::memory_order_relaxed);
+  m_totalNanoseconds[_stage].fetch_add(_nanoseconds, std::memory_order_relaxed);
+
+  uint64_t currentMax=m_maxNanoseconds[_stage].load(std::memory_order_relaxed);
+  while (_nanoseconds>currentMax && !m_maxNanoseconds[_stage].compare_exchange_weak(currentMax, _nanoseconds, std::memory_order_relaxed))
+  {
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Profiler::addStageCounters(Stage _stage, const uint64_t _counts[PerfCounters::NoCounters])
+{
+  for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+  {
+    m_counters[_stage][counter].fetch_add(_counts[counter], std::memory_order_relaxed);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Profiler::endFrame(int _frameNo)
+{
+  /// @brief Copy current aggregates into frame list and reset them
+
+  FrameRecord frame;
+  frame.m_frameNo=_frameNo;
+  frame.m_hasCounters=PerfCounters::instance()->isAvailable();
+
+  for (int stage=0; stage<NoStages; stage++)
+  {
+    frame.m_calls[stage]=m_calls[stage].exchange(0);
+    frame.m_totalNanoseconds[stage]=m_totalNanoseconds[stage].exchange(0);
+    frame.m_maxNanoseconds[stage]=m_maxNanoseconds[stage].exchange(0);
+
+    for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+    {
+      frame.m_counters[stage][counter]=m_counters[stage][counter].exchange(0);
+    }
+  }
+
+  m_frames.push_back(frame);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Profiler::writeCSV(std::string _fileName)
+{
+  /// @brief Stages that were not called in a frame are left out. Counter columns are left empty for frames without
+  /// hardware counters
+
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"frame,stage,calls,total_ms,mean_ms,max_ms";
+  for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+  {
+    file<<","<<PerfCounters::getCounterName((PerfCounters::Counter)counter);
+  }
+  file<<",ipc\n";
+
+  for (const FrameRecord &frame : m_frames)
+  {
+    for (int stage=0; stage<NoStages; stage++)
+    {
+      if (frame.m_calls[stage]==0)
+      {
+        continue;
+      }
+
+      double totalMs=frame.m_totalNanoseconds[stage]*1e-6;
+      file<<frame.m_frameNo<<","<<getStageName((Stage)stage)<<","<<frame.m_calls[stage]<<","<<totalMs<<","
+          <<totalMs/frame.m_calls[stage]<<","<<frame.m_maxNanoseconds[stage]*1e-6;
+
+      for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+      {
+        file<<",";
+        if (frame.m_hasCounters)
+        {
+          file<<frame.m_counters[stage][counter];
+        }
+      }
+
+      file<<",";
+      if (frame.m_hasCounters)
+      {
+        file<<getInstructionsPerCycle(frame, (Stage)stage);
+      }
+
+      file<<"\n";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void Profiler::writeJSON(std::string _fileName)
+{
+  /// @brief Writes [{"frame":n,"stages":{"Stage":{"calls":..,"total_ms":..,"mean_ms":..,"max_ms":..},..}},..]
+  /// Frames with hardware counters also have "cycles", "instructions", "llc_misses", "branch_misses" and "ipc" per stage
+
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"[\n";
+
+  for (size_t frameIndex=0; frameIndex<m_frames.size(); frameIndex++)
+  {
+    const FrameRecord &frame=m_frames[frameIndex];
+
+    file<<"  {\"frame\":"<<frame.m_frameNo<<",\"stages\":{";
+
+    bool isFirstStage=true;
+    for (int stage=0; stage<NoStages; stage++)
+    {
+      if (frame.m_calls[stage]==0)
+      {
+        continue;
+      }
+
+      double totalMs=frame.m_totalNanoseconds[stage]*1e-6;
+      file<<(isFirstStage ? "" : ",")<<"\""<<getStageName((Stage)stage)<<"\":{\"calls\":"<<frame.m_calls[stage]
+          <<",\"total_ms\":"<<totalMs<<",\"mean_ms\":"<<totalMs/frame.m_calls[stage]
+          <<",\"max_ms\":"<<frame.m_maxNanoseconds[stage]*1e-6;
+
+      if (frame.m_hasCounters)
+      {
+        for (int counter=0; counter<PerfCounters::NoCounters; counter++)
+        {
+          file<<",\""<<PerfCounters::getCounterName((PerfCounters::Counter)counter)<<"\":"<<frame.m_counters[stage][counter];
+        }
+        file<<",\"ipc\":"<<getInstructionsPerCycle(frame, (Stage)stage);
+      }
+
+      file<<"}";
+      isFirstStage=false;
+    }
+
+    file<<"}}"<<(frameIndex+1<m_frames.size() ? "," : "")<<"\n";
+  }
+
+  file<<"]\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+double Profiler::getInstructionsPerCycle(const FrameRecord &_frame, Stage _stage)
+{
+  uint64_t cycles=_frame.m_counters[_stage][PerfCounters::Cycles];
+
+  if (cycles==0)
+  {
+    return 0.0;
+  }
+
+  return (double)_frame.m_counters[_stage][PerfCounters::Instructions]/cycles;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* Profiler::getStageName(Stage _stage)
+{
+  switch (_stage)
+  {
+  case ClearCellData: return "ClearCellData";
+  case FindParticleContribution: return "FindParticleContribution";
+  case TransferParticleData: return "TransferParticleData";
+  case ClassifyCells: return "ClassifyCells";
+  case InitialParticleVolumes: return "InitialParticleVolumes";
+  case DeviatoricVelocity: return "DeviatoricVelocity";
+  case BoundaryVelocity: return "BoundaryVelocity";
+  case ProjectVelocity: return "ProjectVelocity";
+  case Temperature: return "Temperature";
+  case GridToParticle: return "GridToParticle";
+  case PresetParticles: return "PresetParticles";
+  case UpdateParticles: return "UpdateParticles";
+  case ExportParticles: return "ExportParticles";
+  default: return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
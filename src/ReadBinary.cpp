@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ReadBinary.h"
+#include "ReadGeo.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char ReadBinary::m_binaryMagic[8]={'M','E','L','T','P','A','R','T'};
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ReadBinary::ReadBinary(std::string _fileName)
+{
+  /// @brief Maps the file and checks that the header and arrays fit inside it. The mapping is kept until destruction
+  /// so particle arrays can be read in place
+
+  //Open file
+  int fileDescriptor=open(_fileName.c_str(), O_RDONLY);
+
+  if (fileDescriptor==-1)
+  {
+    std::cout<<"Failed to open file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+  else
+  {
+    std::cout<<"Opening file for reading.\n";
+  }
+
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus)==-1 || (size_t)fileStatus.st_size<sizeof(BinaryHeader))
+  {
+    std::cout<<"File "<<_fileName<<" is too small to be a binary particle file\n";
+    close(fileDescriptor);
+    exit(EXIT_FAILURE);
+  }
+  m_size=fileStatus.st_size;
+
+  void* mappedFile=mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+  close(fileDescriptor);
+
+  if (mappedFile==MAP_FAILED)
+  {
+    std::cout<<"Failed to map file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  m_data=static_cast<const char*>(mappedFile);
+  m_header=reinterpret_cast<const BinaryHeader*>(m_data);
+  m_parameters=reinterpret_cast<const BinaryParameter*>(m_data+sizeof(BinaryHeader));
+
+  //Check header
+  if (memcmp(m_header->m_magic, m_binaryMagic, sizeof(m_binaryMagic))!=0 || m_header->m_version!=m_binaryVersion)
+  {
+    std::cout<<"File "<<_fileName<<" is not a version "<<m_binaryVersion<<" binary particle file\n";
+    exit(EXIT_FAILURE);
+  }
+
+  //Check that all data is inside the file
+  uint64_t noPoints=m_header->m_noPoints;
+  bool isValid=(sizeof(BinaryHeader)+(m_header->m_noParameters*sizeof(BinaryParameter)))<=m_size;
+  isValid=isValid && (m_header->m_positionOffset+(3*noPoints*sizeof(float)))<=m_size;
+  isValid=isValid && (m_header->m_massOffset+(noPoints*sizeof(float)))<=m_size;
+  isValid=isValid && (m_header->m_phaseOffset+(noPoints*sizeof(float)))<=m_size;
+  isValid=isValid && (m_header->m_temperatureOffset+(noPoints*sizeof(float)))<=m_size;
+
+  if (!isValid)
+  {
+    std::cout<<"File "<<_fileName<<" is truncated\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::cout<<"Number of points: "<<noPoints<<"\n";
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+ReadBinary::~ReadBinary()
+{
+  /// @brief Unmaps file
+
+  std::cout<<"Closing file for reading.\n";
+  munmap(const_cast<char*>(m_data), m_size);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+float ReadBinary::getSimulationParameter_Float(std::string _paramName)
+{
+  /// @brief Returns parameter value. In case it isn't found, then returns 100000 as ReadGeo does.
+
+  float value=100000;
+
+  const BinaryParameter* parameter=findParameter(_paramName);
+
+  if (parameter!=nullptr)
+  {
+    value=parameter->m_value[0];
+  }
+
+  return value;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Eigen::Vector3f ReadBinary::getSimulationParameter_Vec3(std::string _paramName)
+{
+  /// @brief Returns vec3 parameter value. In case it isn't found, then returns [0,0,0].
+
+  Eigen::Vector3f result=Eigen::Vector3f::Zero();
+
+  const BinaryParameter* parameter=findParameter(_paramName);
+
+  if (parameter!=nullptr)
+  {
+    result(0)=parameter->m_value[0];
+    result(1)=parameter->m_value[1];
+    result(2)=parameter->m_value[2];
+  }
+
+  return result;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ReadBinary::hasSimulationParameter(std::string _paramName)
+{
+  /// @brief Searches parameter table without printing when not found
+
+  for (uint32_t i=0; i<m_header->m_noParameters; i++)
+  {
+    if (strncmp(m_parameters[i].m_name, _paramName.c_str(), sizeof(m_parameters[i].m_name))==0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const ReadBinary::BinaryParameter* ReadBinary::findParameter(std::string _paramName)
+{
+  /// @brief Linear search of parameter table. Only used at setup and the table is short
+
+  for (uint32_t i=0; i<m_header->m_noParameters; i++)
+  {
+    if (strncmp(m_parameters[i].m_name, _paramName.c_str(), sizeof(m_parameters[i].m_name))==0)
+    {
+      return &m_parameters[i];
+    }
+  }
+
+  std::cout<<"Parameter "<<_paramName<<" was not found.\n";
+
+  return nullptr;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+uint64_t ReadBinary::alignOffset(uint64_t _offset)
+{
+  /// @brief Rounds offset up to next multiple of the alignment
+
+  return ((_offset+m_binaryAlignment-1)/m_binaryAlignment)*m_binaryAlignment;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool ReadBinary::isBinaryFile(std::string _fileName)
+{
+  /// @brief Reads first bytes of file and compares to identifier
+
+  std::ifstream file(_fileName, std::ios::binary);
+
+  char magic[sizeof(m_binaryMagic)]={0};
+  file.read(magic, sizeof(magic));
+
+  return (file.gcount()==sizeof(magic)) && (memcmp(magic, m_binaryMagic, sizeof(magic))==0);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void ReadBinary::convertGeo(std::string _geoFileName, std::string _binaryFileName)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Read geo file
+
+  Fill parameter table from all global attributes of size 1 or 3, sorted by name
+
+  Calculate offsets of aligned arrays
+
+  Write header, parameter table and arrays
+  ----------------------------------------------------------------------------------------------------------------
+  */
+
+  ReadGeo geoFile(_geoFileName);
+
+  int noPoints=0;
+  std::vector<Eigen::Vector3f> positionList;
+  std::vector<float> massList;
+  std::vector<float> phaseList;
+  std::vector<float> temperatureList;
+
+  geoFile.getPointPositions(noPoints, positionList);
+  geoFile.getPointParameter_Float("mass", massList);
+  geoFile.getPointParameter_Float("phase", phaseList);
+  geoFile.getPointParameter_Float("temperature", temperatureList);
+
+  noPoints=positionList.size();
+
+  if ((int)massList.size()!=noPoints || (int)phaseList.size()!=noPoints || (int)temperatureList.size()!=noPoints)
+  {
+    std::cout<<"Point attributes in "<<_geoFileName<<" do not match number of points. Not converting.\n";
+    exit(EXIT_FAILURE);
+  }
+
+  //Parameter table
+  std::vector<BinaryParameter> parameters;
+
+  for (const std::pair<const std::string, std::vector<float>> &attribute : geoFile.getSimulationParameters())
+  {
+    size_t size=attribute.second.size();
+
+    if ((size!=1 && size!=3) || attribute.first.size()>=sizeof(BinaryParameter::m_name))
+    {
+      continue;
+    }
+
+    BinaryParameter parameter;
+    memset(&parameter, 0, sizeof(BinaryParameter));
+    strncpy(parameter.m_name, attribute.first.c_str(), sizeof(parameter.m_name)-1);
+    parameter.m_size=size;
+    std::copy(attribute.second.begin(), attribute.second.end(), parameter.m_value);
+
+    parameters.push_back(parameter);
+  }
+
+  std::sort(parameters.begin(), parameters.end(), [](const BinaryParameter &_a, const BinaryParameter &_b)
+  {
+    return strncmp(_a.m_name, _b.m_name, sizeof(_a.m_name))<0;
+  });
+
+  //Header and offsets
+  BinaryHeader header;
+  memset(&header, 0, sizeof(BinaryHeader));
+  memcpy(header.m_magic, m_binaryMagic, sizeof(m_binaryMagic));
+  header.m_version=m_binaryVersion;
+  header.m_noParameters=parameters.size();
+  header.m_noPoints=noPoints;
+
+  uint64_t arrayBytes=noPoints*sizeof(float);
+  header.m_positionOffset=alignOffset(sizeof(BinaryHeader)+(parameters.size()*sizeof(BinaryParameter)));
+  header.m_massOffset=alignOffset(header.m_positionOffset+(3*arrayBytes));
+  header.m_phaseOffset=alignOffset(header.m_massOffset+arrayBytes);
+  header.m_temperatureOffset=alignOffset(header.m_phaseOffset+arrayBytes);
+
+  //Flatten positions
+  std::vector<float> positions(3*noPoints);
+  for (int i=0; i<noPoints; i++)
+  {
+    positions[3*i]=positionList[i](0);
+    positions[(3*i)+1]=positionList[i](1);
+    positions[(3*i)+2]=positionList[i](2);
+  }
+
+  //Write file
+  std::ofstream file(_binaryFileName, std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_binaryFileName<<" for writing\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::vector<char> padding(m_binaryAlignment, 0);
+
+  //Writes _bytes from _data starting at _offset, padding up to it first
+  auto writeAt=[&](uint64_t _offset, const void* _data, uint64_t _bytes)
+  {
+    uint64_t current=file.tellp();
+    file.write(padding.data(), _offset-current);
+    file.write(static_cast<const char*>(_data), _bytes);
+  };
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+  file.write(reinterpret_cast<const char*>(parameters.data()), parameters.size()*sizeof(BinaryParameter));
+  writeAt(header.m_positionOffset, positions.data(), 3*arrayBytes);
+  writeAt(header.m_massOffset, massList.data(), arrayBytes);
+  writeAt(header.m_phaseOffset, phaseList.data(), arrayBytes);
+  writeAt(header.m_temperatureOffset, temperatureList.data(), arrayBytes);
+
+  if (!file.good())
+  {
+    std::cout<<"Failed writing file "<<_binaryFileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  std::cout<<"Wrote "<<noPoints<<" points and "<<parameters.size()<<" parameters to "<<_binaryFileName<<"\n";
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -1,15 +1,30 @@
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <omp.h>
+
 #include "ReadGeo.h"
 
 //----------------------------------------------------------------------------------------------------------------------
 
 ReadGeo::ReadGeo(std::string _fileName)
 {
-  /// @brief Opens the file for reading
+  /// @brief Memory maps the file and reads every attribute in one pass. The mapping is released again once read,
+  /// so all later calls are served from memory
+
+  m_isRead=false;
+  m_noPoints=0;
 
   //Open file
-  m_file.open(_fileName);
+  int fileDescriptor=open(_fileName.c_str(), O_RDONLY);
 
-  if (!m_file.is_open())
+  if (fileDescriptor==-1)
   {
     std::cout<<"Failed to open file "<<_fileName<<"\n";
     exit(EXIT_FAILURE);
@@ -19,6 +34,34 @@ ReadGeo::ReadGeo(std::string _fileName)
     std::cout<<"Opening file for reading.\n";
   }
 
+  //Find file size
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus)==-1 || fileStatus.st_size==0)
+  {
+    std::cout<<"Failed to read size of file "<<_fileName<<"\n";
+    close(fileDescriptor);
+    exit(EXIT_FAILURE);
+  }
+  size_t fileSize=fileStatus.st_size;
+
+  //Map file into memory
+  void* mappedFile=mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+  close(fileDescriptor);
+
+  if (mappedFile==MAP_FAILED)
+  {
+    std::cout<<"Failed to map file "<<_fileName<<"\n";
+    exit(EXIT_FAILURE);
+  }
+
+  //File is read from start to end once
+  madvise(mappedFile, fileSize, MADV_SEQUENTIAL);
+
+  parseFile(static_cast<const char*>(mappedFile), fileSize);
+
+  munmap(mappedFile, fileSize);
+
+  m_isRead=true;
 
 }
 
@@ -26,466 +69,394 @@ ReadGeo::ReadGeo(std::string _fileName)
 
 ReadGeo::~ReadGeo()
 {
-  /// @brief Closes file
+  /// @brief Nothing to close as file is unmapped after reading
 
-  if (m_file.is_open())
+  if (m_isRead)
   {
     std::cout<<"Closing file for reading.\n";
-    m_file.close();
   }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void ReadGeo::getPointPositions(int o_noPoints, std::vector<Eigen::Vector3f> &o_positionData)
+void ReadGeo::parseFile(const char* _data, size_t _size)
 {
-  /// @brief Reads in number of points and position data. Done by searching for certain words in the file and reading the values after it
-  /// Also checks that it has found the same number of position data as there are points according to the file
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  Step through file one quoted token at a time
 
-  if (m_file.is_open())
-  {
-    //Words to search for
-    std::string pointCount="\"pointcount\"";
-    std::string attributeType="\"pointattributes\"";
-    std::string dataType="\"tuples\"";
-    std::string paramName="P";
+  If "pointcount"
+    Read number of points
 
-    //Data that is read from file
-    o_noPoints=0;
+  If "pointattributes" or "globalattributes"
+    Set which attribute list following data belongs to
 
-    //Return pointer to beginning of file
-    m_file.clear();
-    m_file.seekg(0, std::ios::beg);
+  If "name"
+    Next quoted token is the attribute name
 
-    //Line to read in
-    std::string line;
+  If "tuples" or "arrays" and have an attribute name
+    Parse bracketed data block and store it under name
+    Continue reading after the data block
+  ----------------------------------------------------------------------------------------------------------------
+  */
 
-    //Find number of points
-    while (m_file>>line)
-    {
-      //Find number of points
-      if (line.find(pointCount)!=std::string::npos)
-      {
-//        std::cout<<line<<"\n";
-
-        int start=line.find_first_of(",")+1;
-        int end=line.find_last_of(",");
-        std::string noPointsString;
-        for (int i=start; i<end; i++)
-        {
-          noPointsString+=line[i];
-        }
-        o_noPoints=std::stoi(noPointsString);
-//        std::cout<<"Number of points: "<<noPoints<<"\n";
+  enum class Section {None, Point, Global};
 
-        break;
-      }
-    }
+  const char* current=_data;
+  const char* end=_data+_size;
 
-    //If no points found, then return.
-    if (o_noPoints==0)
+  Section section=Section::None;
+  bool isNextTokenName=false;
+  std::string attributeName;
+
+  while (current<end)
+  {
+    //Jump to next quoted token
+    current=static_cast<const char*>(memchr(current, '"', end-current));
+    if (current==nullptr)
     {
-      std::cout<<"No points found\n";
-      return;
+      break;
     }
 
-    //Find line with position data
-    std::string dataString;
-    getDataLine(attributeType, paramName, dataType, &dataString);
-
-//    std::cout<<dataString<<"\n";
-
-    //Go through remaining part of line
-    std::string xPos;
-    std::string yPos;
-    std::string zPos;
-
-    int readDimension=0;
-    int dataStringSize=dataString.size();
-
-    for (int i=0; i<dataStringSize; i++)
+    const char* tokenStart=current+1;
+    const char* tokenEnd=static_cast<const char*>(memchr(tokenStart, '"', end-tokenStart));
+    if (tokenEnd==nullptr)
     {
-      //Read one letter at a time
-      char letter=dataString[i];
-
-      //If "[" then beginning of one set of position data
-      if (letter=='[')
-      {
-        //Set to read into x
-        readDimension=0;
-      }
-      //If "," then between x and y or y and z
-      else if (letter==',')
-      {
-        readDimension+=1;
-      }
-      //If "]" then at the end of a set of position data.
-      else if (letter==']')
-      {
-        //Turn string to floats
-        float x=std::stof(xPos);
-        float y=std::stof(yPos);
-        float z=std::stof(zPos);
-
-//          std::cout<<"x:"<<x<<" y:"<<y<<" z:"<<z<<"\n";
-
-        //Store position data
-        Eigen::Vector3f position;
-        position(0)=x;
-        position(1)=y;
-        position(2)=z;
-        o_positionData.push_back(position);
+      break;
+    }
 
-        //Clear strings for new read in
-        xPos.clear();
-        yPos.clear();
-        zPos.clear();
+    std::string_view token(tokenStart, tokenEnd-tokenStart);
+    current=tokenEnd+1;
 
-      }
-      //If not [ or ] or , then read into position data
-      else
+    if (isNextTokenName)
+    {
+      attributeName=std::string(token);
+      isNextTokenName=false;
+    }
+    else if (token=="pointcount")
+    {
+      //Skip "," after token then read integer
+      while (current<end && (*current==',' || isspace(*current)))
       {
-        if(readDimension==0)
-        {
-          xPos+=letter;
-        }
-        else if (readDimension==1)
-        {
-          yPos+=letter;
-        }
-        else if (readDimension==2)
-        {
-          zPos+=letter;
-        }
+        current++;
       }
+      std::from_chars(current, end, m_noPoints);
     }
-
-  //Check that the data stored in pointPositions is the same as the number of points
-    int positionDataSize=o_positionData.size();
-    std::cout<<"Number of points: "<<o_noPoints<<"\n";
-    std::cout<<"Size of position data: "<<positionDataSize<<"\n";
-    if (positionDataSize==o_noPoints)
+    else if (token=="pointattributes")
     {
-      std::cout<<"Same number of points as position data\n";
+      section=Section::Point;
     }
-    else
+    else if (token=="globalattributes")
     {
-      std::cout<<"Mismatch between number of points and number of position data\n";
+      section=Section::Global;
+    }
+    else if (token=="vertexattributes" || token=="primitiveattributes")
+    {
+      section=Section::None;
     }
+    else if (token=="name")
+    {
+      isNextTokenName=true;
+    }
+    else if ((token=="tuples" || token=="arrays") && !attributeName.empty() && section!=Section::None)
+    {
+      //Data block starts after the next "["
+      const char* dataStart=static_cast<const char*>(memchr(current, '[', end-current));
+      if (dataStart==nullptr)
+      {
+        break;
+      }
+      dataStart+=1;
+      const char* dataEnd=findDataEnd(dataStart, end);
 
+      std::vector<float> &data=(section==Section::Point) ? m_pointAttributes[attributeName] : m_globalAttributes[attributeName];
+      data.clear();
+      parseValues(dataStart, dataEnd, data);
 
+      attributeName.clear();
+      current=dataEnd;
+    }
   }
+
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void ReadGeo::getPointParameter_Float(std::string _paramName, std::vector<float> &o_data)
+const char* ReadGeo::findDataEnd(const char* _begin, const char* _end)
 {
-  /// @brief Read float parameters from file. Return file read to beginning as don't know what order these will be called in.
+  /// @brief Counts bracket depth until the "[" just before _begin is closed. Returns _end if never closed
+
+  int depth=1;
 
-  if (m_file.is_open())
+  for (const char* current=_begin; current<_end; current++)
   {
-    //Set words to find
-    std::string pointCount="\"pointcount\"";
-    std::string attributeType="\"pointattributes\"";
-    std::string dataType="\"arrays\"";
-    std::string paramName=_paramName;
-
-    //Setup for read
-    std::string line;
-    float noPoints=0;
-
-    //Return pointer to beginning of file
-    m_file.clear();
-    m_file.seekg(0, std::ios::beg);
-
-    //Find number of points
-    while (m_file>>line)
+    if (*current=='[')
     {
-      //Find number of points
-      if (line.find(pointCount)!=std::string::npos)
-      {
-//          std::cout<<line<<"\n";
-
-        int start=line.find_first_of(",")+1;
-        int end=line.find_last_of(",");
-        std::string noPointsString;
-        for (int i=start; i<end; i++)
-        {
-          noPointsString+=line[i];
-        }
-        noPoints=std::stoi(noPointsString);
-//          std::cout<<"Number of points: "<<noPoints<<"\n";
+      depth+=1;
+    }
+    else if (*current==']')
+    {
+      depth-=1;
 
-        break;
+      if (depth==0)
+      {
+        return current;
       }
     }
+  }
 
-    if (noPoints==0)
-    {
-      std::cout<<"No points found\n";
-      return;
-    }
+  return _end;
+}
 
-    //Get parameter data string
-    std::string dataString;
-    getDataLine(attributeType, paramName, dataType, &dataString);
+//----------------------------------------------------------------------------------------------------------------------
 
-    //Set up for reading values
-    int dataStringSize=dataString.size();
-    int dataNo=0;
-    std::string singleDataString;
+void ReadGeo::parseValues(const char* _begin, const char* _end, std::vector<float> &o_data)
+{
+  /* Outline
+  ----------------------------------------------------------------------------------------------------------------
+  If data block is small
+    Parse serially
 
-    for (int i=0; i<dataStringSize; i++)
-    {
-      //Read one letter at a time
-      char letter=dataString[i];
+  Else
+    Split block into one chunk per thread, moving each split forward to the next separator
+    Parse chunks in parallel into separate vectors
+    Append chunks in order
+  ----------------------------------------------------------------------------------------------------------------
+  */
 
-//      std::cout<<letter<<"\n";
+  size_t dataSize=_end-_begin;
 
-      //If "[" then beginning of one set of position data
-      if (letter=='[')
-      {
-        //Do nothing
-      }
-      //If "," then next value
-      else if (letter==',')
-      {
-        //Set current read to parameter data
-        float singleDataValue=std::stof(singleDataString);
-        o_data.push_back(singleDataValue);
+  if (dataSize<m_parallelParseThreshold)
+  {
+    parseValueRange(_begin, _end, o_data);
+    return;
+  }
 
-        //Start reading into next value
-        dataNo+=1;
-        singleDataString.clear();
+  int noChunks=omp_get_max_threads();
 
-      }
-      //If "]" then at the end of parameter data, so save final entry
-      else if (letter==']')
-      {
-        //Set current read to parameter data
-        float singleDataValue=std::stof(singleDataString);
-        o_data.push_back(singleDataValue);
+  //Find chunk boundaries that do not split a number
+  std::vector<const char*> chunkStart(noChunks+1);
+  chunkStart[0]=_begin;
+  chunkStart[noChunks]=_end;
 
-      }
-      //If not [ or ] or , then read into position data
-      else
-      {
-        singleDataString+=letter;
-      }
+  for (int chunk=1; chunk<noChunks; chunk++)
+  {
+    const char* split=_begin+((dataSize*chunk)/noChunks);
+
+    while (split<_end && *split!=',' && *split!='[' && *split!=']' && !isspace(*split))
+    {
+      split++;
     }
 
-    //Check that the data stored in o_data is the same size as the number of points
-      int dataSize=o_data.size();
-      std::cout<<"Number of points: "<<noPoints<<"\n";
-      std::cout<<"Size of data: "<<dataSize<<"\n";
-      if (dataSize==noPoints)
-      {
-        std::cout<<"Same number of points as "<<paramName<<" data\n";
-      }
-      else
-      {
-        std::cout<<"Mismatch between number of points and number of "<<paramName<<" data\n";
-      }
+    chunkStart[chunk]=std::max(split, chunkStart[chunk-1]);
+  }
+
+  //Parse chunks
+  std::vector<std::vector<float>> chunkData(noChunks);
 
+#pragma omp parallel for
+  for (int chunk=0; chunk<noChunks; chunk++)
+  {
+    chunkData[chunk].reserve((chunkStart[chunk+1]-chunkStart[chunk])/8);
+    parseValueRange(chunkStart[chunk], chunkStart[chunk+1], chunkData[chunk]);
+  }
+
+  //Join chunks in order
+  size_t totalNoValues=o_data.size();
+  for (int chunk=0; chunk<noChunks; chunk++)
+  {
+    totalNoValues+=chunkData[chunk].size();
+  }
+  o_data.reserve(totalNoValues);
+
+  for (int chunk=0; chunk<noChunks; chunk++)
+  {
+    o_data.insert(o_data.end(), chunkData[chunk].begin(), chunkData[chunk].end());
   }
+
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-float ReadGeo::getSimulationParameter_Float(std::string _paramName)
+void ReadGeo::parseValueRange(const char* _begin, const char* _end, std::vector<float> &o_data)
 {
-  /// @brief Searches for "globalattributes" then paramName then "arrays" to find line with value.
-  /// Single value found is then returned. In case file isn't open, then returns 10000.
+  /// @brief Skips brackets, commas and whitespace and converts everything else with from_chars.
+  /// Anything that is not a number is skipped up to the next separator.
 
-  //Set return value in case file isn't open
-  float value=100000;
+  const char* current=_begin;
 
-  if (m_file.is_open())
+  while (current<_end)
   {
-    //Set words to look for
-    std::string attributeType="globalattributes";
-    std::string dataType="arrays";
-    std::string paramName=_paramName;
-
-    std::string dataString;
-
-    getDataLine(attributeType, paramName, dataType, &dataString);
+    char letter=*current;
 
+    if (letter=='[' || letter==']' || letter==',' || isspace(letter))
+    {
+      current++;
+      continue;
+    }
 
-    int dataStringSize=dataString.size();
-    std::string valueString;
+    float value=0.0;
+    std::from_chars_result result=std::from_chars(current, _end, value);
 
-    //Add every number to the string
-    if (dataStringSize!=0)
+    if (result.ec==std::errc())
+    {
+      o_data.push_back(value);
+      current=result.ptr;
+    }
+    else
     {
-      for (int i=0; i<dataStringSize; i++)
+      while (current<_end && *current!=',' && *current!=']')
       {
-        char letter=dataString[i];
-
-        if (letter!='[' && letter!=']')
-        {
-          valueString+=letter;
-        }
+        current++;
       }
-
-      //Turn string into float
-      value=std::stof(valueString);
     }
   }
 
-  return value;
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-Eigen::Vector3f ReadGeo::getSimulationParameter_Vec3(std::string _paramName)
+void ReadGeo::getPointPositions(int &o_noPoints, std::vector<Eigen::Vector3f> &o_positionData)
 {
-  /// @brief Searches for "globalattributes" then paramName then "tuples" to find line with value.
-  /// Single value found is then returned. In case file isn't open, then returns [0,0,0].
+  /// @brief Returns number of points and position data read in constructor.
+  /// Also checks that it has found the same number of position data as there are points according to the file
 
-  Eigen::Vector3f result;
+  o_noPoints=0;
 
-  if (m_file.is_open())
+  if (m_isRead)
   {
+    o_noPoints=m_noPoints;
 
-    //Set words to look for
-    std::string attributeType="globalattributes";
-    std::string dataType="tuples";
-    std::string paramName=_paramName;
+    //If no points found, then return.
+    if (o_noPoints==0)
+    {
+      std::cout<<"No points found\n";
+      return;
+    }
 
-    std::string dataString;
-    getDataLine(attributeType, paramName, dataType, &dataString);
+    std::unordered_map<std::string, std::vector<float>>::const_iterator attribute=m_pointAttributes.find("P");
 
-//    std::cout<<dataString<<"\n";
+    if (attribute==m_pointAttributes.end())
+    {
+      std::cout<<"Parameter P was not found.\n";
+      return;
+    }
 
-      //Read values from line
-      //Set up for reading values
-      int dataStringSize=dataString.size();
-      std::string x_str;
-      std::string y_str;
-      std::string z_str;
-      int dimension=0;
+    //Store position data
+    const std::vector<float> &positions=attribute->second;
+    int noPositions=positions.size()/3;
 
-      for (int i=0; i<dataStringSize; i++)
-      {
-        //Read one letter at a time
-        char letter=dataString[i];
-
-  //      std::cout<<letter<<"\n";
-
-        //If "[" then beginning of one set of position data
-        if (letter=='[')
-        {
-          //Do nothing
-        }
-        //If "," then next value
-        else if (letter==',')
-        {
-          //Set dimension to one higher
-          dimension+=1;
-
-        }
-        //If "]" then at the end of parameter data, so save final entry
-        else if (letter==']')
-        {
-          //Store data
-          float x=std::stof(x_str);
-          float y=std::stof(y_str);
-          float z=std::stof(z_str);
-
-          result(0)=x;
-          result(1)=y;
-          result(2)=z;
-
-          //Set dimension to start
-          dimension=0;
-
-        }
-        //If not [ or ] or , then read into position data
-        else
-        {
-          if (dimension==0)
-          {
-            x_str+=letter;
-          }
-          else if (dimension==1)
-          {
-            y_str+=letter;
-          }
-          else if (dimension==2)
-          {
-            z_str+=letter;
-          }
-        }
-      }
-  }
+    o_positionData.reserve(o_positionData.size()+noPositions);
+    for (int i=0; i<noPositions; i++)
+    {
+      o_positionData.push_back(Eigen::Vector3f(positions[3*i], positions[(3*i)+1], positions[(3*i)+2]));
+    }
 
-  return result;
+    //Check that the data stored in pointPositions is the same as the number of points
+    int positionDataSize=o_positionData.size();
+    std::cout<<"Number of points: "<<o_noPoints<<"\n";
+    std::cout<<"Size of position data: "<<positionDataSize<<"\n";
+    if (positionDataSize==o_noPoints)
+    {
+      std::cout<<"Same number of points as position data\n";
+    }
+    else
+    {
+      std::cout<<"Mismatch between number of points and number of position data\n";
+    }
+  }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void ReadGeo::getDataLine(std::string _attributeType, std::string _paramName, std::string _dataType, std::string *o_data)
+void ReadGeo::getPointParameter_Float(std::string _paramName, std::vector<float> &o_data)
 {
-  /// @brief Uses 3 nested while loops to find the line of data. If parameter not found, returns empty o_data
+  /// @brief Returns float point parameter read in constructor.
 
-  std::string line;
-  std::string paramName="\"name\",\"";
-  paramName.append(_paramName);
-  paramName.append("\"");
+  if (m_isRead)
+  {
+    if (m_noPoints==0)
+    {
+      std::cout<<"No points found\n";
+      return;
+    }
 
-  //Set pointer to start of file
-  m_file.clear();
-  m_file.seekg(0, std::ios::beg);
+    std::unordered_map<std::string, std::vector<float>>::const_iterator attribute=m_pointAttributes.find(_paramName);
 
+    if (attribute==m_pointAttributes.end())
+    {
+      std::cout<<"Parameter "<<_paramName<<" was not found.\n";
+      return;
+    }
 
-  while (m_file>>line)
-  {
-    if(line.find(_attributeType)!=std::string::npos)
+    o_data.insert(o_data.end(), attribute->second.begin(), attribute->second.end());
+
+    //Check that the data stored in o_data is the same size as the number of points
+    int dataSize=o_data.size();
+    std::cout<<"Number of points: "<<m_noPoints<<"\n";
+    std::cout<<"Size of data: "<<dataSize<<"\n";
+    if (dataSize==m_noPoints)
     {
-      while (m_file>>line)
-      {
-        if (line.find(paramName)!=std::string::npos)
-        {
-          while (m_file>>line)
-          {
-            if (line.find(_dataType)!=std::string::npos)
-            {
-              break;
-            }
-          }
-          break;
-        }
-      }
-      break;
+      std::cout<<"Same number of points as "<<_paramName<<" data\n";
+    }
+    else
+    {
+      std::cout<<"Mismatch between number of points and number of "<<_paramName<<" data\n";
     }
   }
+}
 
-  //Check if parameter was found
-  if (m_file.eof())
-  {
-    std::cout<<"Parameter "<<_paramName<<" was not found.\n";
-  }
-  else
-  {
-//    std::cout<<line<<"\n";
+//----------------------------------------------------------------------------------------------------------------------
+
+float ReadGeo::getSimulationParameter_Float(std::string _paramName)
+{
+  /// @brief Returns single global attribute value read in constructor. In case it isn't found, then returns 100000.
 
-    //Erase part of the line that doesn't contain the position data
-    int endErase=line.find_first_of(",")+2;
-    line.erase(0,endErase);
+  //Set return value in case parameter isn't found
+  float value=100000;
 
-    //Make sure that all data is on one line, if not add the next line onto it
-    std::string dataString;
+  if (m_isRead)
+  {
+    std::unordered_map<std::string, std::vector<float>>::const_iterator attribute=m_globalAttributes.find(_paramName);
 
-    while (line!="]")
+    if (attribute==m_globalAttributes.end() || attribute->second.empty())
     {
-      dataString+=line;
-      m_file>>line;
+      std::cout<<"Parameter "<<_paramName<<" was not found.\n";
     }
+    else
+    {
+      value=attribute->second[0];
+    }
+  }
 
-    //Return data line
-    o_data->append(dataString);
+  return value;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+Eigen::Vector3f ReadGeo::getSimulationParameter_Vec3(std::string _paramName)
+{
+  /// @brief Returns global vec3 attribute read in constructor. In case it isn't found, then returns [0,0,0].
 
+  Eigen::Vector3f result=Eigen::Vector3f::Zero();
+
+  if (m_isRead)
+  {
+    std::unordered_map<std::string, std::vector<float>>::const_iterator attribute=m_globalAttributes.find(_paramName);
+
+    if (attribute==m_globalAttributes.end() || attribute->second.size()<3)
+    {
+      std::cout<<"Parameter "<<_paramName<<" was not found.\n";
+    }
+    else
+    {
+      result(0)=attribute->second[0];
+      result(1)=attribute->second[1];
+      result(2)=attribute->second[2];
+    }
   }
+
+  return result;
 }
+
+//----------------------------------------------------------------------------------------------------------------------
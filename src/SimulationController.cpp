@@ -53,6 +53,55 @@ SimulationController::SimulationController()
   m_latentHeat=1.0;
   m_freezingTemperature=0.0;
 
+  //Solve heat equation every step unless file says otherwise
+  m_temperatureSubsteps=1;
+  m_isReportingTemperatureDrift=false;
+
+  //Check memory estimate against physical memory unless file gives a limit
+  m_memoryLimitMB=0.0;
+
+  //Use fast threaded transfers and solves unless file asks for deterministic results
+  m_isDeterministic=false;
+
+  //Use cell interpolation lists unless file asks for the particle stencil cache
+  m_isParticleStencilCache=false;
+
+  //Solve with conjugate gradient for pressure and temperature and MINRES for deviatoric velocity unless file says
+  //otherwise. Same iteration caps and tolerances as the grid uses by default
+  m_pressureSolver.m_method=SolverSettings::ConjugateGradient;
+  m_pressureSolver.m_maxLoops=3000;
+  m_pressureSolver.m_tolerance=0.00001;
+  m_pressureSolver.m_refactorThreshold=0.01;
+  m_pressureSolver.m_relaxation=1.0;
+  m_temperatureSolver.m_method=SolverSettings::ConjugateGradient;
+  m_temperatureSolver.m_maxLoops=3000;
+  m_temperatureSolver.m_tolerance=0.00001;
+  m_temperatureSolver.m_refactorThreshold=0.01;
+  m_temperatureSolver.m_relaxation=1.0;
+  m_deviatoricSolver.m_method=SolverSettings::MinRes;
+  m_deviatoricSolver.m_maxLoops=20;
+  m_deviatoricSolver.m_tolerance=0.0000001;
+  m_deviatoricSolver.m_refactorThreshold=0.01;
+  m_deviatoricSolver.m_relaxation=1.0;
+
+  //Only time stages unless file asks for hardware counters
+  m_isCountingHardwareEvents=false;
+
+  //Simulate all particles every step unless file turns on sleeping of still, cold solid particles
+  m_isSleepingEnabled=false;
+  m_sleepVelocityThreshold=0.001;
+  m_sleepDeformationThreshold=0.0001;
+  m_sleepTemperatureMargin=5.0;
+  m_noSleepSteps=10;
+
+  //No collision object from mesh unless file asks for one
+  m_collisionObjectFileName="../HoudiniFiles/stanfordBunny.obj";
+  m_hasCollisionObject=false;
+  m_collisionObjectScale=1.0;
+  m_collisionObjectOffset=Eigen::Vector3f(0.0, 0.0, 0.0);
+  m_collisionObjectVoxelSize=0.0;
+  m_collisionObjectBandWidth=0.0;
+
   //Set PIC FLIP contribution constants
   m_velocityContributionAlpha=0.95;
   m_temperatureContributionBeta=0.95;
@@ -61,17 +110,43 @@ SimulationController::SimulationController()
   //Read in simulation parameters
 //  m_readFileName="../HoudiniFiles/particles.geo";
   m_readFileName="../HoudiniFiles/particles2.geo";
-  readSimulationParameters();
 
-  //Create emitter and particles
+  //Create emitter
   m_emitter=new Emitter();
-  m_emitter->setStrainConstants(m_lameMuConstant, m_lameLambdaConstant, m_compressionLimit, m_stretchLimit, m_hardnessCoefficient);
-  m_emitter->setTemperatureConstants(m_heatCapacitySolid, m_heatCapacityFluid, m_heatConductivitySolid, m_heatConductivityFluid, m_latentHeat, m_freezingTemperature);
-  setupParticles();
+
+  //File is read once and then used for both parameters and particles. Binary particle files are used if given,
+  //otherwise the file is read as a Houdini geo file
+  if (ReadBinary::isBinaryFile(m_readFileName))
+  {
+    ReadBinary* file=new ReadBinary(m_readFileName);
+    readSimulationParameters(file);
+    setupParticles(file);
+    delete file;
+  }
+  else
+  {
+    ReadGeo* file=new ReadGeo(m_readFileName);
+    readSimulationParameters(file);
+    setupParticles(file);
+    delete file;
+  }
+
+  //Reject runs whose estimated memory use won't fit before allocating the grid
+  MemoryTracker::instance();
+  if (!MemoryTracker::checkEstimate(m_noCells, m_noParticles, (int64_t)(m_memoryLimitMB*1024.0*1024.0)))
+  {
+    std::cout<<"Estimated memory use exceeds available memory. Reduce noGridCells or number of particles\n";
+    exit(EXIT_FAILURE);
+  }
+  m_memoryUsageFileName="../HoudiniFiles/MemoryUsage";
 
   //Create grid
   m_grid=Grid::createGrid(m_boundingBoxPosition, m_boundingBoxSize, m_noCells);
   m_grid->setSurroundingTemperatures(m_ambientTemperature, m_heatSourceTemperature);
+  m_grid->setTemperatureSubsteps(m_temperatureSubsteps, m_isReportingTemperatureDrift);
+  m_grid->setDeterministic(m_isDeterministic);
+  m_grid->setParticleStencilCache(m_isParticleStencilCache);
+  m_grid->setSolverSettings(m_pressureSolver, m_temperatureSolver, m_deviatoricSolver);
 
   //Set grid as collision object for emitter
   float xMin=m_boundingBoxPosition(0);
@@ -82,12 +157,38 @@ SimulationController::SimulationController()
   float zMax=zMin+m_boundingBoxSize;
   m_emitter->setCollisionObject(xMin, xMax, yMin, yMax, zMin, zMax);
 
+  //Voxelize collision object mesh and mark the grid faces inside it
+  if (m_hasCollisionObject)
+  {
+    float cellSize=m_boundingBoxSize/((float)(m_noCells-2));
+    float voxelSize=(m_collisionObjectVoxelSize>0.0) ? m_collisionObjectVoxelSize : (0.5*cellSize);
+    float bandWidth=(m_collisionObjectBandWidth>0.0) ? m_collisionObjectBandWidth : (3.0*voxelSize);
+
+    m_emitter->addCollisionObject(new CollisionSDF(m_collisionObjectFileName, voxelSize, bandWidth, m_collisionObjectScale, m_collisionObjectOffset));
+    m_grid->setCollisionObjects(m_emitter->getCollisionObjects());
+  }
+
   //Test min no particle in non-empty cells
   std::vector<int> listParticleNoInCells(pow(m_noCells,3),0);
   m_grid->findNoParticlesInCells(m_emitter, listParticleNoInCells);
   int minNoParticles=MathFunctions::findMinVectorValue(listParticleNoInCells);
   std::cout<<"The smallest number of particles in a non-empty cell is: "<<minNoParticles<<"\n";
 
+  //Set up stage timing summaries. Profiler, trace recorder and counters are created here so they exist before any
+  //threaded stage is timed
+  m_profileFileName="../HoudiniFiles/StageTimings";
+  m_solverMetricsFileName="../HoudiniFiles/SolverMetrics";
+  m_traceFileName="../HoudiniFiles/Timeline.json";
+#ifdef PROFILING
+  Profiler::instance();
+  TraceRecorder::instance();
+  PerfCounters::instance();
+  if (m_isCountingHardwareEvents)
+  {
+    PerfCounters::instance()->start();
+  }
+#endif
+
   //Set up alembic file for export
   m_exportFileName="../HoudiniFiles/MeltingParticles.abc";
 //  m_isExporting=false;
@@ -151,7 +252,8 @@ void SimulationController::setRenderParameters(ngl::Camera *_camera, std::string
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void SimulationController::readSimulationParameters()
+template <typename FileType>
+void SimulationController::readSimulationParameters(FileType *_file)
 {
   /// @brief Sets all simulation parameters from geo file
 
@@ -179,43 +281,175 @@ void SimulationController::readSimulationParameters()
   std::string ambientTemp="ambientTemperature";
   std::string heatSourceTemp="heatSourceTemperature";
 
-  //Need to read in each value from file
-  ReadGeo* file=new ReadGeo(m_readFileName);
-
-  m_simTimeStep=file->getSimulationParameter_Float(simStep);
-  m_totalNoFrames=file->getSimulationParameter_Float(totNoFrames);
-
-  m_boundingBoxPosition=file->getSimulationParameter_Vec3(boundingBoxPos);
-  m_boundingBoxSize=file->getSimulationParameter_Float(boundingBoxSize);
-  m_noCells=file->getSimulationParameter_Float(noCells);
+  std::string temperatureSubsteps="temperatureSubsteps";
+  std::string reportTemperatureDrift="reportTemperatureDrift";
+  std::string memoryLimit="memoryLimitMB";
+  std::string deterministic="deterministic";
+  std::string particleStencilCache="particleStencilCache";
+  std::string hardwareCounters="hardwareCounters";
+  std::string particleSleeping="particleSleeping";
+  std::string sleepVelocity="sleepVelocityThreshold";
+  std::string sleepDeformation="sleepDeformationThreshold";
+  std::string sleepTemperatureMargin="sleepTemperatureMargin";
+  std::string sleepSteps="sleepSteps";
+  std::string collisionObject="collisionObject";
+  std::string collisionObjectScale="collisionObjectScale";
+  std::string collisionObjectOffset="collisionObjectOffset";
+  std::string collisionObjectVoxelSize="collisionObjectVoxelSize";
+  std::string collisionObjectBandWidth="collisionObjectBandWidth";
+
+  m_simTimeStep=_file->getSimulationParameter_Float(simStep);
+  m_totalNoFrames=_file->getSimulationParameter_Float(totNoFrames);
+
+  m_boundingBoxPosition=_file->getSimulationParameter_Vec3(boundingBoxPos);
+  m_boundingBoxSize=_file->getSimulationParameter_Float(boundingBoxSize);
+  m_noCells=_file->getSimulationParameter_Float(noCells);
 
   //Since add cells on the outside of bounding box for collisions.
   m_noCells+=2.0;
 
-  m_lameMuConstant=file->getSimulationParameter_Float(lameMu);
-  m_lameLambdaConstant=file->getSimulationParameter_Float(lameLambda);
-  m_compressionLimit=file->getSimulationParameter_Float(compLimit);
-  m_stretchLimit=file->getSimulationParameter_Float(stretchLimit);
-  m_hardnessCoefficient=file->getSimulationParameter_Float(hardnessCoeff);
+  m_lameMuConstant=_file->getSimulationParameter_Float(lameMu);
+  m_lameLambdaConstant=_file->getSimulationParameter_Float(lameLambda);
+  m_compressionLimit=_file->getSimulationParameter_Float(compLimit);
+  m_stretchLimit=_file->getSimulationParameter_Float(stretchLimit);
+  m_hardnessCoefficient=_file->getSimulationParameter_Float(hardnessCoeff);
 
-  m_heatCapacitySolid=file->getSimulationParameter_Float(heatCapSolid);
-  m_heatCapacityFluid=file->getSimulationParameter_Float(heatCapFluid);
-  m_heatConductivitySolid=file->getSimulationParameter_Float(heatCondSolid);
-  m_heatConductivityFluid=file->getSimulationParameter_Float(heatCondFluid);
-  m_latentHeat=file->getSimulationParameter_Float(latentHeat);
+  m_heatCapacitySolid=_file->getSimulationParameter_Float(heatCapSolid);
+  m_heatCapacityFluid=_file->getSimulationParameter_Float(heatCapFluid);
+  m_heatConductivitySolid=_file->getSimulationParameter_Float(heatCondSolid);
+  m_heatConductivityFluid=_file->getSimulationParameter_Float(heatCondFluid);
+  m_latentHeat=_file->getSimulationParameter_Float(latentHeat);
 
   //File gives temp in Celsius, need to change to Kelvin
-  m_freezingTemperature=file->getSimulationParameter_Float(freezeTemp)+273.0;
-  m_ambientTemperature=file->getSimulationParameter_Float(ambientTemp)+273.0;
-  m_heatSourceTemperature=file->getSimulationParameter_Float(heatSourceTemp)+273.0;
+  m_freezingTemperature=_file->getSimulationParameter_Float(freezeTemp)+273.0;
+  m_ambientTemperature=_file->getSimulationParameter_Float(ambientTemp)+273.0;
+  m_heatSourceTemperature=_file->getSimulationParameter_Float(heatSourceTemp)+273.0;
 
-  delete file;
+  //Optional multi-rate heat integration parameters
+  if (_file->hasSimulationParameter(temperatureSubsteps))
+  {
+    m_temperatureSubsteps=_file->getSimulationParameter_Float(temperatureSubsteps);
+  }
+  if (_file->hasSimulationParameter(reportTemperatureDrift))
+  {
+    m_isReportingTemperatureDrift=(_file->getSimulationParameter_Float(reportTemperatureDrift)!=0.0);
+  }
+  //Optional memory limit for the startup estimate
+  if (_file->hasSimulationParameter(memoryLimit))
+  {
+    m_memoryLimitMB=_file->getSimulationParameter_Float(memoryLimit);
+  }
+  //Optional deterministic mode, giving the same results for any number of threads
+  if (_file->hasSimulationParameter(deterministic))
+  {
+    m_isDeterministic=(_file->getSimulationParameter_Float(deterministic)!=0.0);
+  }
+  //Optional particle stencil cache instead of the cell interpolation lists
+  if (_file->hasSimulationParameter(particleStencilCache))
+  {
+    m_isParticleStencilCache=(_file->getSimulationParameter_Float(particleStencilCache)!=0.0);
+  }
+  //Optional solver method, iteration cap and tolerance of each system
+  readSolverSettings(_file, "pressure", m_pressureSolver);
+  readSolverSettings(_file, "temperature", m_temperatureSolver);
+  readSolverSettings(_file, "deviatoric", m_deviatoricSolver);
+  //Optional hardware counters in stage timings. Only used when built with PROFILING
+  if (_file->hasSimulationParameter(hardwareCounters))
+  {
+    m_isCountingHardwareEvents=(_file->getSimulationParameter_Float(hardwareCounters)!=0.0);
+  }
+  //Optional particle sleeping and its thresholds
+  if (_file->hasSimulationParameter(particleSleeping))
+  {
+    m_isSleepingEnabled=(_file->getSimulationParameter_Float(particleSleeping)!=0.0);
+  }
+  if (_file->hasSimulationParameter(sleepVelocity))
+  {
+    m_sleepVelocityThreshold=_file->getSimulationParameter_Float(sleepVelocity);
+  }
+  if (_file->hasSimulationParameter(sleepDeformation))
+  {
+    m_sleepDeformationThreshold=_file->getSimulationParameter_Float(sleepDeformation);
+  }
+  if (_file->hasSimulationParameter(sleepTemperatureMargin))
+  {
+    m_sleepTemperatureMargin=_file->getSimulationParameter_Float(sleepTemperatureMargin);
+  }
+  if (_file->hasSimulationParameter(sleepSteps))
+  {
+    m_noSleepSteps=_file->getSimulationParameter_Float(sleepSteps);
+  }
+  //Optional collision object read from m_collisionObjectFileName, and its placement and resolution
+  if (_file->hasSimulationParameter(collisionObject))
+  {
+    m_hasCollisionObject=(_file->getSimulationParameter_Float(collisionObject)!=0.0);
+  }
+  if (_file->hasSimulationParameter(collisionObjectScale))
+  {
+    m_collisionObjectScale=_file->getSimulationParameter_Float(collisionObjectScale);
+  }
+  if (_file->hasSimulationParameter(collisionObjectOffset))
+  {
+    m_collisionObjectOffset=_file->getSimulationParameter_Vec3(collisionObjectOffset);
+  }
+  if (_file->hasSimulationParameter(collisionObjectVoxelSize))
+  {
+    m_collisionObjectVoxelSize=_file->getSimulationParameter_Float(collisionObjectVoxelSize);
+  }
+  if (_file->hasSimulationParameter(collisionObjectBandWidth))
+  {
+    m_collisionObjectBandWidth=_file->getSimulationParameter_Float(collisionObjectBandWidth);
+  }
+
+  //Set emitter constants from parameters
+  m_emitter->setStrainConstants(m_lameMuConstant, m_lameLambdaConstant, m_compressionLimit, m_stretchLimit, m_hardnessCoefficient);
+  m_emitter->setTemperatureConstants(m_heatCapacitySolid, m_heatCapacityFluid, m_heatConductivitySolid, m_heatConductivityFluid, m_latentHeat, m_freezingTemperature);
+  m_emitter->setSleepParameters(m_isSleepingEnabled, m_sleepVelocityThreshold, m_sleepDeformationThreshold, m_sleepTemperatureMargin, m_noSleepSteps);
 
 }
 
 //----------------------------------------------------------------------------------------------------------------------
 
-void SimulationController::setupParticles()
+template <typename FileType>
+void SimulationController::readSolverSettings(FileType *_file, std::string _systemName, SolverSettings &io_settings)
+{
+  std::string method=_systemName+"Solver";
+  std::string maxLoops=_systemName+"MaxLoops";
+  std::string tolerance=_systemName+"Tolerance";
+  std::string refactorThreshold=_systemName+"RefactorThreshold";
+  std::string relaxation=_systemName+"Relaxation";
+
+  if (_file->hasSimulationParameter(method))
+  {
+    int methodNo=_file->getSimulationParameter_Float(method);
+    if (methodNo<0 || methodNo>=SolverSettings::NoMethods)
+    {
+      std::cout<<method<<" "<<methodNo<<" is not a solver method. Must be 0 to "<<SolverSettings::NoMethods-1<<"\n";
+      exit(EXIT_FAILURE);
+    }
+    io_settings.m_method=(SolverSettings::Method)methodNo;
+  }
+  if (_file->hasSimulationParameter(maxLoops))
+  {
+    io_settings.m_maxLoops=_file->getSimulationParameter_Float(maxLoops);
+  }
+  if (_file->hasSimulationParameter(tolerance))
+  {
+    io_settings.m_tolerance=_file->getSimulationParameter_Float(tolerance);
+  }
+  if (_file->hasSimulationParameter(refactorThreshold))
+  {
+    io_settings.m_refactorThreshold=_file->getSimulationParameter_Float(refactorThreshold);
+  }
+  if (_file->hasSimulationParameter(relaxation))
+  {
+    io_settings.m_relaxation=_file->getSimulationParameter_Float(relaxation);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SimulationController::setupParticles(ReadGeo *_file)
 {
   //Set up vectors to contain positions, mass, phase and temperature
   std::string mass="mass";
@@ -227,15 +461,11 @@ void SimulationController::setupParticles()
   std::vector<float> phaseList;
   std::vector<float> temperatureList;
 
-  //Read in the data from file
-  ReadGeo* file=new ReadGeo(m_readFileName);
-
-  file->getPointPositions(m_noParticles, positionList);
-  file->getPointParameter_Float(mass, massList);
-  file->getPointParameter_Float(phase, phaseList);
-  file->getPointParameter_Float(temperature, temperatureList);
-
-  delete file;
+  //Get the data read from file
+  _file->getPointPositions(m_noParticles, positionList);
+  _file->getPointParameter_Float(mass, massList);
+  _file->getPointParameter_Float(phase, phaseList);
+  _file->getPointParameter_Float(temperature, temperatureList);
 
   //Create emitter by passing in the data
   m_noParticles=positionList.size();
@@ -246,6 +476,17 @@ void SimulationController::setupParticles()
 
 //----------------------------------------------------------------------------------------------------------------------
 
+void SimulationController::setupParticles(ReadBinary *_file)
+{
+  /// @brief Creates particles directly from the mapped arrays, so no intermediate copies are made
+
+  m_noParticles=_file->getNoPoints();
+  m_emitter->createParticles(m_noParticles, _file->getPointPositions(), _file->getPointMass(), _file->getPointTemperature(), _file->getPointPhase());
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
 void SimulationController::update()
 {
   /// @brief Steps the simulation. This controls the interlink between the particles and the grid
@@ -268,25 +509,33 @@ void SimulationController::update()
 
   if (m_noFrames<=10)
   {
-  //Update elastic/plastic
-  m_emitter->presetParticles(m_velocityContributionAlpha, m_temperatureContributionBeta);
-
-  //Update grid which includes
-  //Calculate interpolation weights
-  //Transfer data from particles to grid
-  //Calculate new velocity and temperature
-  //Transfer data back to particles
-  m_grid->update(m_simTimeStep, m_emitter, isFirstStep, m_velocityContributionAlpha, m_temperatureContributionBeta);
-
-
-  //Update particles
-  m_emitter->updateParticles(m_simTimeStep);
+  //Preset particles, update grid and particles, and store solver records of the step
+  m_grid->simulateStep(m_simTimeStep, m_emitter, isFirstStep, m_velocityContributionAlpha, m_temperatureContributionBeta);
 
   //Update number of frames
   m_elapsedTimeAfterFrame+=m_simTimeStep;
 
   if (m_elapsedTimeAfterFrame>=(1.0/25.0))
   {
+#ifdef PROFILING
+    //Store stage timings of finished frame and rewrite summaries
+    Profiler::instance()->endFrame(m_noFrames);
+    Profiler::instance()->writeCSV(m_profileFileName+".csv");
+    Profiler::instance()->writeJSON(m_profileFileName+".json");
+    SolverMetrics::instance()->writeCSV(m_solverMetricsFileName+".csv");
+    SolverMetrics::instance()->writeJSON(m_solverMetricsFileName+".json");
+    TraceRecorder::instance()->writeJSON(m_traceFileName);
+#endif
+
+    //Store current and peak memory use of finished frame and rewrite summaries
+    MemoryTracker::instance()->endFrame(m_noFrames);
+    MemoryTracker::instance()->printLastFrame();
+
+    //Particle preset throughput over the steps of the finished frame
+    m_emitter->printPhaseThroughput();
+    MemoryTracker::instance()->writeCSV(m_memoryUsageFileName+".csv");
+    MemoryTracker::instance()->writeJSON(m_memoryUsageFileName+".json");
+
     m_noFrames+=1;
     m_elapsedTimeAfterFrame=0.0;
   }
@@ -0,0 +1,160 @@
+#include <fstream>
+#include <iostream>
+
+#include "SolverMetrics.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SolverMetrics* SolverMetrics::m_instance=nullptr;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SolverMetrics::SolverMetrics()
+{
+  m_currentStep.m_stepNo=0;
+
+  for (int system=0; system<NoSystems; system++)
+  {
+    m_currentStep.m_isSolved[system]=false;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+SolverMetrics* SolverMetrics::instance()
+{
+  /// @brief Create solver metrics if doesn't exist, then return instance pointer.
+  /// NB! First call must not be made from several threads at once
+
+  if (m_instance==nullptr)
+  {
+    m_instance=new SolverMetrics();
+  }
+
+  return m_instance;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SolverMetrics::addSolve(System _system, const SolverRecord &_record)
+{
+  /// @brief Each system is written to its own element, so concurrent solves of different systems don't clash
+
+  m_currentStep.m_solves[_system]=_record;
+  m_currentStep.m_isSolved[_system]=true;
+
+  if (!_record.m_isConverged)
+  {
+    std::cout<<getSystemName(_system)<<" solve did not converge. "<<_record.m_solverName<<" stopped after "
+             <<_record.m_iterations<<" of "<<_record.m_maxIterations<<" iterations with residual "<<_record.m_finalResidual<<"\n";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SolverMetrics::endStep()
+{
+  /// @brief Store current step and clear it for the next step
+
+  m_steps.push_back(m_currentStep);
+
+  m_currentStep.m_stepNo+=1;
+
+  for (int system=0; system<NoSystems; system++)
+  {
+    m_currentStep.m_isSolved[system]=false;
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SolverMetrics::writeCSV(std::string _fileName)
+{
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"step,system,solver,iterations,max_iterations,tolerance,initial_residual,final_residual,time_ms,converged\n";
+
+  for (const StepRecord &step : m_steps)
+  {
+    for (int system=0; system<NoSystems; system++)
+    {
+      if (!step.m_isSolved[system])
+      {
+        continue;
+      }
+
+      const SolverRecord &solve=step.m_solves[system];
+      file<<step.m_stepNo<<","<<getSystemName((System)system)<<","<<solve.m_solverName<<","<<solve.m_iterations<<","
+          <<solve.m_maxIterations<<","<<solve.m_tolerance<<","<<solve.m_initialResidual<<","<<solve.m_finalResidual<<","
+          <<solve.m_milliseconds<<","<<solve.m_isConverged<<"\n";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void SolverMetrics::writeJSON(std::string _fileName)
+{
+  /// @brief Writes [{"step":n,"solves":{"System":{"solver":..,"iterations":..,..},..}},..]
+
+  std::ofstream file(_fileName);
+
+  if (!file.is_open())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  file<<"[\n";
+
+  for (size_t stepIndex=0; stepIndex<m_steps.size(); stepIndex++)
+  {
+    const StepRecord &step=m_steps[stepIndex];
+
+    file<<"  {\"step\":"<<step.m_stepNo<<",\"solves\":{";
+
+    bool isFirstSystem=true;
+    for (int system=0; system<NoSystems; system++)
+    {
+      if (!step.m_isSolved[system])
+      {
+        continue;
+      }
+
+      const SolverRecord &solve=step.m_solves[system];
+      file<<(isFirstSystem ? "" : ",")<<"\""<<getSystemName((System)system)<<"\":{\"solver\":\""<<solve.m_solverName
+          <<"\",\"iterations\":"<<solve.m_iterations<<",\"max_iterations\":"<<solve.m_maxIterations
+          <<",\"tolerance\":"<<solve.m_tolerance<<",\"initial_residual\":"<<solve.m_initialResidual
+          <<",\"final_residual\":"<<solve.m_finalResidual<<",\"time_ms\":"<<solve.m_milliseconds
+          <<",\"converged\":"<<(solve.m_isConverged ? "true" : "false")<<"}";
+      isFirstSystem=false;
+    }
+
+    file<<"}}"<<(stepIndex+1<m_steps.size() ? "," : "")<<"\n";
+  }
+
+  file<<"]\n";
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+const char* SolverMetrics::getSystemName(System _system)
+{
+  switch (_system)
+  {
+  case Pressure: return "Pressure";
+  case Temperature: return "Temperature";
+  case DeviatoricX: return "DeviatoricX";
+  case DeviatoricY: return "DeviatoricY";
+  case DeviatoricZ: return "DeviatoricZ";
+  default: return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
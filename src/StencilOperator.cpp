@@ -0,0 +1,299 @@
+#include <algorithm>
+
+#include "StencilOperator.h"
+#include "StencilSystem.h"
+#include "MemoryTracker.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+StencilOperator::StencilOperator()
+{
+  m_noCells=0;
+  m_trackedBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+StencilOperator::StencilOperator(StencilOperator &&_other)
+{
+  m_diagonal=std::move(_other.m_diagonal);
+  for (int direction=0; direction<3; direction++)
+  {
+    m_coupling[direction]=std::move(_other.m_coupling[direction]);
+  }
+  m_noCells=_other.m_noCells;
+  m_trackedBytes=_other.m_trackedBytes;
+
+  _other.m_noCells=0;
+  _other.m_trackedBytes=0;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+StencilOperator::~StencilOperator()
+{
+  MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void StencilOperator::resize(int _noCells)
+{
+  int totNoCells=_noCells*_noCells*_noCells;
+
+  if (_noCells!=m_noCells)
+  {
+    m_noCells=_noCells;
+
+    MemoryTracker::instance()->release(MemoryTracker::LinearSystems, m_trackedBytes);
+    m_trackedBytes=4*(int64_t)totNoCells*sizeof(float);
+    MemoryTracker::instance()->allocate(MemoryTracker::LinearSystems, m_trackedBytes);
+  }
+
+  m_diagonal.assign(totNoCells, 0.0);
+  for (int direction=0; direction<3; direction++)
+  {
+    m_coupling[direction].assign(totNoCells, 0.0);
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void StencilOperator::assign(const StencilSystem &_system, int _noCells)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Zero all rows
+
+  Loop over cells with a row in the system pattern in parallel
+    Diagonal from the diagonal entry
+    Coupling over each lower face is minus the entry to the lower neighbour, which is in the lower
+    triangle. Rows of cells that have left the system are zero, so they get no row
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  resize(_noCells);
+
+  int totNoCells=getTotNoCells();
+  const double* values=_system.m_A.valuePtr();
+  const StencilSystem::Entry lowerEntries[3]={StencilSystem::Neighbour_i_1jk, StencilSystem::Neighbour_ij_1k, StencilSystem::Neighbour_ijk_1};
+
+#pragma omp parallel for
+  for (int cellIndex=0; cellIndex<totNoCells; cellIndex++)
+  {
+    if (!_system.m_isInterior[cellIndex])
+    {
+      continue;
+    }
+
+    const int* entryPositions=&_system.m_entryPositions[StencilSystem::NoEntries*cellIndex];
+
+    m_diagonal[cellIndex]=values[entryPositions[StencilSystem::Diagonal]];
+    for (int direction=0; direction<3; direction++)
+    {
+      m_coupling[direction][cellIndex]=-values[entryPositions[lowerEntries[direction]]];
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+int StencilOperator::getNoRows() const
+{
+  return std::count_if(m_diagonal.begin(), m_diagonal.end(), [](float _diagonal){return _diagonal!=0.0f;});
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void StencilOperator::multiply(const Eigen::VectorXd &_x, Eigen::VectorXd &o_y) const
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over lines (j,k) in parallel
+    Lines on the boundary, and the boundary cells of a line, have no rows so are zero
+    Loop over i in the line, vectorised. Coupling over the upper face of c is stored at the upper
+    neighbour
+      y_c = d_c*x_c - wx_c*x_(c-1) - wx_(c+1)*x_(c+1) - wy_c*x_(c-n) - wy_(c+n)*x_(c+n)
+                    - wz_c*x_(c-n^2) - wz_(c+n^2)*x_(c+n^2)
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noLines=m_noCells*m_noCells;
+  int offsetY=m_noCells;
+  int offsetZ=m_noCells*m_noCells;
+
+  o_y.resize(m_diagonal.size());
+
+  const float* diagonal=m_diagonal.data();
+  const float* couplingX=m_coupling[0].data();
+  const float* couplingY=m_coupling[1].data();
+  const float* couplingZ=m_coupling[2].data();
+  const double* x=_x.data();
+  double* y=o_y.data();
+
+#pragma omp parallel for
+  for (int line=0; line<noLines; line++)
+  {
+    int jIndex=line%m_noCells;
+    int kIndex=line/m_noCells;
+    int start=line*m_noCells;
+
+    if (jIndex==0 || kIndex==0 || jIndex==(m_noCells-1) || kIndex==(m_noCells-1))
+    {
+      std::fill(y+start, y+start+m_noCells, 0.0);
+      continue;
+    }
+
+    y[start]=0.0;
+    y[start+m_noCells-1]=0.0;
+
+#pragma omp simd
+    for (int cellIndex=start+1; cellIndex<(start+m_noCells-1); cellIndex++)
+    {
+      y[cellIndex]=(diagonal[cellIndex]*x[cellIndex])
+                   -(couplingX[cellIndex]*x[cellIndex-1])-(couplingX[cellIndex+1]*x[cellIndex+1])
+                   -(couplingY[cellIndex]*x[cellIndex-offsetY])-(couplingY[cellIndex+offsetY]*x[cellIndex+offsetY])
+                   -(couplingZ[cellIndex]*x[cellIndex-offsetZ])-(couplingZ[cellIndex+offsetZ]*x[cellIndex+offsetZ]);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void StencilOperator::coarsen(StencilOperator &o_coarse) const
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Coarse grid has (n-2+1)/2 cells along each side inside the boundary. Fine cell i is in coarse cell
+  (i+1)/2, so coarse cell I holds fine cells 2I-1 and 2I if they are inside the boundary
+
+  Loop over coarse cells in parallel, and their fine cells in order
+    Coarse diagonal is the sum of fine diagonals, less twice the couplings between the fine cells
+    Coarse coupling over a lower face is the sum of the fine couplings over that face, which are the
+    lower face couplings of the fine cells with odd index in that direction
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noCoarseCells=((m_noCells-2+1)/2)+2;
+  o_coarse.resize(noCoarseCells);
+
+  int fineOffsets[3]={1, m_noCells, m_noCells*m_noCells};
+  int noCoarseLines=noCoarseCells*noCoarseCells;
+
+#pragma omp parallel for
+  for (int coarseLine=0; coarseLine<noCoarseLines; coarseLine++)
+  {
+    int coarseJ=coarseLine%noCoarseCells;
+    int coarseK=coarseLine/noCoarseCells;
+
+    if (coarseJ==0 || coarseK==0 || coarseJ==(noCoarseCells-1) || coarseK==(noCoarseCells-1))
+    {
+      continue;
+    }
+
+    for (int coarseI=1; coarseI<(noCoarseCells-1); coarseI++)
+    {
+      int coarseIndex=coarseI+(coarseLine*noCoarseCells);
+
+      float diagonal=0.0;
+      float coupling[3]={0.0, 0.0, 0.0};
+
+      for (int kIndex=(2*coarseK)-1; kIndex<=std::min(2*coarseK, m_noCells-2); kIndex++)
+      {
+        for (int jIndex=(2*coarseJ)-1; jIndex<=std::min(2*coarseJ, m_noCells-2); jIndex++)
+        {
+          for (int iIndex=(2*coarseI)-1; iIndex<=std::min(2*coarseI, m_noCells-2); iIndex++)
+          {
+            int cellIndex=iIndex+(jIndex*fineOffsets[1])+(kIndex*fineOffsets[2]);
+            int cellIJK[3]={iIndex, jIndex, kIndex};
+
+            diagonal+=m_diagonal[cellIndex];
+
+            for (int direction=0; direction<3; direction++)
+            {
+              //Odd index is the lowest fine cell of the coarse cell, so its lower face is on the coarse face
+              if (cellIJK[direction]%2==1)
+              {
+                coupling[direction]+=m_coupling[direction][cellIndex];
+              }
+              else
+              {
+                diagonal-=2.0f*m_coupling[direction][cellIndex];
+              }
+            }
+          }
+        }
+      }
+
+      o_coarse.m_diagonal[coarseIndex]=diagonal;
+      for (int direction=0; direction<3; direction++)
+      {
+        o_coarse.m_coupling[direction][coarseIndex]=coupling[direction];
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void StencilOperator::smoothRedBlack(const Eigen::VectorXd &_B, Eigen::VectorXd &io_x, double _relaxation, Colour _firstColour) const
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Loop over the two colours, starting with _firstColour
+    Loop over lines (j,k) inside the boundary in parallel
+      First cell of the colour in the line is i=1 or i=2. Loop over every second cell, vectorised. All
+      neighbours have the other colour, so no cell reads a value written in the same loop
+        Gauss-Seidel value (b_c + wx_c*x_(c-1) + wx_(c+1)*x_(c+1) + ... + wz_(c+n^2)*x_(c+n^2))/d_c
+        x_c moves the fraction w of the way to it, unless the cell has no row
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  int noLines=m_noCells*m_noCells;
+  int offsetY=m_noCells;
+  int offsetZ=m_noCells*m_noCells;
+
+  const float* diagonal=m_diagonal.data();
+  const float* couplingX=m_coupling[0].data();
+  const float* couplingY=m_coupling[1].data();
+  const float* couplingZ=m_coupling[2].data();
+  const double* b=_B.data();
+  double* x=io_x.data();
+
+  for (int half=0; half<2; half++)
+  {
+    int colour=(_firstColour+half)%2;
+
+#pragma omp parallel for
+    for (int line=0; line<noLines; line++)
+    {
+      int jIndex=line%m_noCells;
+      int kIndex=line/m_noCells;
+
+      if (jIndex==0 || kIndex==0 || jIndex==(m_noCells-1) || kIndex==(m_noCells-1))
+      {
+        continue;
+      }
+
+      int start=line*m_noCells;
+      int firstIIndex=1+((1+jIndex+kIndex+colour)%2);
+
+#pragma omp simd
+      for (int cellIndex=start+firstIIndex; cellIndex<(start+m_noCells-1); cellIndex+=2)
+      {
+        double sum=b[cellIndex]
+                   +(couplingX[cellIndex]*x[cellIndex-1])+(couplingX[cellIndex+1]*x[cellIndex+1])
+                   +(couplingY[cellIndex]*x[cellIndex-offsetY])+(couplingY[cellIndex+offsetY]*x[cellIndex+offsetY])
+                   +(couplingZ[cellIndex]*x[cellIndex-offsetZ])+(couplingZ[cellIndex+offsetZ]*x[cellIndex+offsetZ]);
+
+        //Cells without a row divide by one and move zero of the way. Written so the division isn't conditional,
+        //which would stop vectorisation
+        double cellDiagonal=diagonal[cellIndex];
+        double cellRelaxation=(cellDiagonal!=0.0) ? _relaxation : 0.0;
+        x[cellIndex]+=cellRelaxation*((sum/(cellDiagonal+(cellDiagonal==0.0)))-x[cellIndex]);
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------------------------------------------------
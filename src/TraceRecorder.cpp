@@ -0,0 +1,170 @@
+#include <fstream>
+#include <iostream>
+
+#include "TraceRecorder.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TraceRecorder* TraceRecorder::m_instance=nullptr;
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TraceRecorder::TraceRecorder()
+{
+  m_isEnabled=true;
+  m_noNamedThreads=0;
+  m_startTime=std::chrono::steady_clock::now();
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+TraceRecorder* TraceRecorder::instance()
+{
+  /// @brief Create trace recorder if doesn't exist, then return instance pointer.
+  /// NB! First call must not be made from several threads at once
+
+  if (m_instance==nullptr)
+  {
+    m_instance=new TraceRecorder();
+  }
+
+  return m_instance;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+std::vector<TraceRecorder::Event>* TraceRecorder::getThreadEvents()
+{
+  /// @brief Event list is kept in a thread local pointer, so the mutex is only taken once per thread
+
+  thread_local std::vector<Event>* threadEvents=nullptr;
+
+  if (threadEvents==nullptr)
+  {
+    threadEvents=new std::vector<Event>();
+
+    std::lock_guard<std::mutex> lock(m_threadEventsMutex);
+    m_threadEvents.push_back(threadEvents);
+  }
+
+  return threadEvents;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::addEvent(const char* _name, const char* _category, std::chrono::steady_clock::time_point _start,
+                             std::chrono::steady_clock::time_point _end, const char* _argumentName, int64_t _argumentValue)
+{
+  if (!m_isEnabled)
+  {
+    return;
+  }
+
+  Event event;
+  event.m_name=_name;
+  event.m_category=_category;
+  event.m_startNanoseconds=std::chrono::duration_cast<std::chrono::nanoseconds>(_start-m_startTime).count();
+  event.m_durationNanoseconds=std::chrono::duration_cast<std::chrono::nanoseconds>(_end-_start).count();
+  event.m_argumentName=_argumentName;
+  event.m_argumentValue=_argumentValue;
+
+  getThreadEvents()->push_back(event);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+size_t TraceRecorder::getNoEvents()
+{
+  std::lock_guard<std::mutex> lock(m_threadEventsMutex);
+
+  size_t noEvents=0;
+  for (std::vector<Event>* threadEvents : m_threadEvents)
+  {
+    noEvents+=threadEvents->size();
+  }
+
+  return noEvents;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+void TraceRecorder::writeJSON(std::string _fileName)
+{
+  /* Outline
+  ------------------------------------------------------------------------------------------------------
+  Writes {"traceEvents":[..],"displayTimeUnit":"ms"}
+
+  One thread_name metadata event per thread, then one complete event ("ph":"X") per recorded event with
+  start and duration in microseconds. All events are in process 0 and use the thread list index as tid
+
+  On the first call for a file it is created with the process_name event. On later calls the closing
+  footer is overwritten by the new events and written again, so the file is valid after every call.
+  The written events are then cleared
+  ------------------------------------------------------------------------------------------------------
+  */
+
+  const std::string footer="\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  std::lock_guard<std::mutex> lock(m_threadEventsMutex);
+
+  std::fstream file;
+  bool isAppending=(_fileName==m_fileName);
+
+  if (isAppending)
+  {
+    file.open(_fileName, std::ios::in | std::ios::out);
+    file.seekp(-(std::streamoff)footer.size(), std::ios::end);
+  }
+  else
+  {
+    file.open(_fileName, std::ios::out | std::ios::trunc);
+  }
+
+  if (!file.is_open() || !file.good())
+  {
+    std::cout<<"Failed to open file "<<_fileName<<" for writing\n";
+    return;
+  }
+
+  if (!isAppending)
+  {
+    file<<"{\"traceEvents\":[\n";
+    file<<"  {\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"MeltingSimulation\"}}";
+
+    m_fileName=_fileName;
+    m_noNamedThreads=0;
+  }
+
+  //Name threads that have started recording since the last call
+  for (size_t threadId=m_noNamedThreads; threadId<m_threadEvents.size(); threadId++)
+  {
+    file<<",\n  {\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"<<threadId
+        <<",\"args\":{\"name\":\"Thread "<<threadId<<"\"}}";
+  }
+  m_noNamedThreads=m_threadEvents.size();
+
+  file.precision(3);
+  file<<std::fixed;
+
+  for (size_t threadId=0; threadId<m_threadEvents.size(); threadId++)
+  {
+    for (const Event &event : *m_threadEvents[threadId])
+    {
+      file<<",\n  {\"name\":\""<<event.m_name<<"\",\"cat\":\""<<event.m_category<<"\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+          <<threadId<<",\"ts\":"<<event.m_startNanoseconds*1e-3<<",\"dur\":"<<event.m_durationNanoseconds*1e-3;
+
+      if (event.m_argumentName!=nullptr)
+      {
+        file<<",\"args\":{\""<<event.m_argumentName<<"\":"<<event.m_argumentValue<<"}";
+      }
+
+      file<<"}";
+    }
+
+    m_threadEvents[threadId]->clear();
+  }
+
+  file<<footer;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
@@ -8,10 +8,18 @@
 
 #include "OpenGLWindow.h"
 #include "ReadGeo.h"
+#include "ReadBinary.h"
 #include "MathFunctions.h"
 
 int main(int argc, char *argv[])
 {
+  //Convert geo file to binary particle file without opening window
+  if (argc==4 && std::string(argv[1])=="--convert")
+  {
+    ReadBinary::convertGeo(argv[2], argv[3]);
+    return 0;
+  }
+
   QGuiApplication app(argc, argv);
   QSurfaceFormat format;
   format.setSamples(4);